@@ -37,18 +37,7 @@ void ForumHandler::handleWildcard(Request &req, Response &resp)
             opts.mReqType = GXS_REQUEST_TYPE_MSG_DATA;
             mRsGxsForums->getTokenService()->requestMsgInfo(token, RS_TOKREQ_ANSTYPE_DATA, opts, groupIds);
 
-            time_t start = time(NULL);
-            while((mRsGxsForums->getTokenService()->requestStatus(token) != RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
-                  &&(mRsGxsForums->getTokenService()->requestStatus(token) != RsTokenService::GXS_REQUEST_V2_STATUS_FAILED)
-                  &&((time(NULL) < (start+10)))
-                  )
-            {
-        #ifdef WINDOWS_SYS
-                Sleep(500);
-        #else
-                usleep(500*1000) ;
-        #endif
-            }
+            mRsGxsForums->getTokenService()->waitToken(token, 10*1000);
 
             if(mRsGxsForums->getTokenService()->requestStatus(token) == RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
             {
@@ -85,18 +74,7 @@ void ForumHandler::handleWildcard(Request &req, Response &resp)
         uint32_t token;
         mRsGxsForums->getTokenService()->requestGroupInfo(token, RS_TOKREQ_ANSTYPE_DATA, opts);
 
-        time_t start = time(NULL);
-        while((mRsGxsForums->getTokenService()->requestStatus(token) != RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
-              &&(mRsGxsForums->getTokenService()->requestStatus(token) != RsTokenService::GXS_REQUEST_V2_STATUS_FAILED)
-              &&((time(NULL) < (start+10)))
-              )
-        {
-    #ifdef WINDOWS_SYS
-            Sleep(500);
-    #else
-            usleep(500*1000) ;
-    #endif
-        }
+        mRsGxsForums->getTokenService()->waitToken(token, 10*1000);
         if(mRsGxsForums->getTokenService()->requestStatus(token) == RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
         {
             std::vector<RsGxsForumGroup> grps;
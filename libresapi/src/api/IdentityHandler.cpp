@@ -218,15 +218,7 @@ void IdentityHandler::handleWildcard(Request & /*req*/, Response &resp)
 	mRsIdentity->getTokenService()->requestGroupInfo(
 	            token, RS_TOKREQ_ANSTYPE_DATA, opts);
 
-	time_t timeout = time(NULL)+10;
-	uint8_t rStatus = mRsIdentity->getTokenService()->requestStatus(token);
-	while( rStatus != RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE &&
-	       rStatus != RsTokenService::GXS_REQUEST_V2_STATUS_FAILED &&
-	       time(NULL) < timeout )
-	{
-		usleep(50*1000);
-		rStatus = mRsIdentity->getTokenService()->requestStatus(token);
-	}
+	uint8_t rStatus = mRsIdentity->getTokenService()->waitToken(token, 10*1000);
 
 	if(rStatus == RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
 	{
@@ -275,15 +267,7 @@ void IdentityHandler::handleNotOwnIdsRequest(Request & /*req*/, Response &resp)
 	mRsIdentity->getTokenService()->requestGroupInfo(
 	            token, RS_TOKREQ_ANSTYPE_DATA, opts);
 
-	time_t timeout = time(NULL)+10;
-	uint8_t rStatus = mRsIdentity->getTokenService()->requestStatus(token);
-	while( rStatus != RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE &&
-	       rStatus != RsTokenService::GXS_REQUEST_V2_STATUS_FAILED &&
-	       time(NULL) < timeout )
-	{
-		usleep(50*1000);
-		rStatus = mRsIdentity->getTokenService()->requestStatus(token);
-	}
+	uint8_t rStatus = mRsIdentity->getTokenService()->waitToken(token, 10*1000);
 
 	if(rStatus == RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
 	{
@@ -326,18 +310,7 @@ void IdentityHandler::handleOwnIdsRequest(Request & /*req*/, Response &resp)
 	uint32_t token;
 	mRsIdentity->getTokenService()->requestGroupInfo(token, RS_TOKREQ_ANSTYPE_DATA, opts);
 
-	time_t start = time(NULL);
-	while((mRsIdentity->getTokenService()->requestStatus(token) != RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
-	      &&(mRsIdentity->getTokenService()->requestStatus(token) != RsTokenService::GXS_REQUEST_V2_STATUS_FAILED)
-	      &&((time(NULL) < (start+10)))
-	      )
-	{
-#ifdef WINDOWS_SYS
-		Sleep(500);
-#else
-		usleep(500*1000);
-#endif
-	}
+	mRsIdentity->getTokenService()->waitToken(token, 10*1000);
 
 	if(mRsIdentity->getTokenService()->requestStatus(token) == RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
 	{
@@ -409,18 +382,7 @@ void IdentityHandler::handleGetIdentityDetails(Request& req, Response& resp)
 	groupIds.push_back(RsGxsGroupId(gxs_id));
 	mRsIdentity->getTokenService()->requestGroupInfo(token, RS_TOKREQ_ANSTYPE_DATA, opts, groupIds);
 
-	time_t start = time(NULL);
-	while((mRsIdentity->getTokenService()->requestStatus(token) != RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
-	      &&(mRsIdentity->getTokenService()->requestStatus(token) != RsTokenService::GXS_REQUEST_V2_STATUS_FAILED)
-	      &&((time(NULL) < (start+10)))
-	      )
-	{
-#ifdef WINDOWS_SYS
-		Sleep(500);
-#else
-		usleep(500*1000);
-#endif
-	}
+	mRsIdentity->getTokenService()->waitToken(token, 10*1000);
 
 	RsGxsIdGroup data;
 	std::vector<RsGxsIdGroup> datavector;
@@ -544,18 +506,7 @@ void IdentityHandler::handleSetAvatar(Request& req, Response& resp)
 	groupIds.push_back(RsGxsGroupId(gxs_id));
 	mRsIdentity->getTokenService()->requestGroupInfo(token, RS_TOKREQ_ANSTYPE_DATA, opts, groupIds);
 
-	time_t start = time(NULL);
-	while((mRsIdentity->getTokenService()->requestStatus(token) != RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
-	      &&(mRsIdentity->getTokenService()->requestStatus(token) != RsTokenService::GXS_REQUEST_V2_STATUS_FAILED)
-	      &&((time(NULL) < (start+10)))
-	      )
-	{
-#ifdef WINDOWS_SYS
-		Sleep(500);
-#else
-		usleep(500*1000);
-#endif
-	}
+	mRsIdentity->getTokenService()->waitToken(token, 10*1000);
 
 	RsGxsIdGroup data;
 	std::vector<RsGxsIdGroup> datavector;
@@ -97,6 +97,7 @@ private:
     virtual bool acceptDataFromPeer(const RsGxsId& gxs_id, const RsGxsTunnelService::RsGxsTunnelId& tunnel_id, bool is_client_side) ;
     virtual void notifyTunnelStatus(const RsGxsTunnelService::RsGxsTunnelId& tunnel_id,uint32_t tunnel_status) ;
     virtual void receiveData(const RsGxsTunnelService::RsGxsTunnelId& id,unsigned char *data,uint32_t data_size) ;
+    virtual bool requiresOrderedDelivery() const { return true ; }	// long messages are split in parts that are joined in the order they arrive
 
     // Utility functions.
     
@@ -57,6 +57,7 @@ static const time_t 	LOBBY_LIST_AUTO_UPDATE_TIME        =  121 ; // regularly as
 static const uint32_t MAX_ALLOWED_LOBBIES_IN_LIST_WARNING = 50 ;
 //static const uint32_t MAX_MESSAGES_PER_SECONDS_NUMBER     =  5 ; // max number of messages from a given peer in a window for duration below
 static const uint32_t MAX_MESSAGES_PER_SECONDS_PERIOD     = 10 ; // duration window for max number of messages before messages get dropped.
+static const uint32_t MAX_LOBBY_ITEM_SIZE                 = 32000 ; // larger bouncing items are dropped
 
 #define        IS_PUBLIC_LOBBY(flags) (flags & RS_CHAT_LOBBY_FLAGS_PUBLIC    )
 #define    IS_PGP_SIGNED_LOBBY(flags) (flags & RS_CHAT_LOBBY_FLAGS_PGP_SIGNED)
@@ -414,9 +415,7 @@ void DistributedChatService::checkSizeAndSendLobbyMessage(RsChatItem *msg)
     //    3 - it is unreliable since items are not guarrantied to all arrive in the end (cannot be fixed)
     //    4 - large objects can be used to corrupt end peers (cannot be fixed)
     //
-    static const uint32_t MAX_ITEM_SIZE = 32000 ;
-
-    if(RsChatSerialiser().size(msg) > MAX_ITEM_SIZE)
+    if(RsChatSerialiser().size(msg) > MAX_LOBBY_ITEM_SIZE)
     {
         std::cerr << "(EE) Chat item exceeds maximum serial size. It will be dropped." << std::endl;
         delete msg ;
@@ -898,20 +897,25 @@ bool DistributedChatService::bounceLobbyObject(RsChatLobbyBouncingObject *item,c
 	if(!locked_bouncingObjectCheck(item,peer_id,lobby.participating_friends.size()))
 		return false;
 
-	// Forward to allparticipating friends, except this peer.
+	// Forward to allparticipating friends, except this peer. The item is serialised once for all of them.
+
+	std::list<RsPeerId> destinations ;
 
 	for(std::set<RsPeerId>::const_iterator it(lobby.participating_friends.begin());it!=lobby.participating_friends.end();++it)
 		if((*it)!=peer_id && mServControl->isPeerConnected(mServType, *it)) 
-		{
-			RsChatLobbyBouncingObject *obj2 = item->duplicate() ; // makes a copy
-			RsChatItem *item2 = dynamic_cast<RsChatItem*>(obj2) ;
+			destinations.push_back(*it) ;
 
-			assert(item2 != NULL) ;
+	if(!destinations.empty())
+	{
+		RsChatItem *item2 = dynamic_cast<RsChatItem*>(item) ;
 
-			item2->PeerId(*it) ;	// replaces the virtual peer id with the actual destination.
+		assert(item2 != NULL) ;
 
-            checkSizeAndSendLobbyMessage(item2) ;
-		}
+		if(RsChatSerialiser().size(item2) > MAX_LOBBY_ITEM_SIZE)
+			std::cerr << "(EE) Chat item exceeds maximum serial size. It will be dropped." << std::endl;
+		else
+			sendChatItemToPeers(item2,destinations) ;
+	}
 
 	++lobby.connexion_challenge_count ;
 
@@ -85,6 +85,7 @@ class DistributedChatService
 		bool handleRecvItem(RsChatItem *) ;
 
 		virtual void sendChatItem(RsChatItem *) =0 ;
+		virtual void sendChatItemToPeers(RsChatItem *,const std::list<RsPeerId>&) =0 ;	// serialises once. Does not delete the item.
 		virtual void locked_storeIncomingMsg(RsChatMsgItem *) =0 ;
 		virtual void triggerConfigSave() =0;
 
@@ -258,6 +258,14 @@ void p3ChatService::sendChatItem(RsChatItem *item)
 	sendItem(item);
 }
 
+void p3ChatService::sendChatItemToPeers(RsChatItem *item,const std::list<RsPeerId>& peers)
+{
+#ifdef CHAT_DEBUG
+	std::cerr << "p3ChatService::sendChatItemToPeers(): sending to " << peers.size() << " friend peers." << std::endl;
+#endif
+	sendItemToPeers(item,peers);
+}
+
 void p3ChatService::checkSizeAndSendMessage(RsChatMsgItem *msg)
 {
 	// We check the message item, and possibly split it into multiple messages, if the message is too big.
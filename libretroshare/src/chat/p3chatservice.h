@@ -213,6 +213,7 @@ private:
 	void handleIncomingItem(RsItem *);	// called by the former, and turtle handler for incoming encrypted items
 
 	virtual void sendChatItem(RsChatItem *) ;
+	virtual void sendChatItemToPeers(RsChatItem *,const std::list<RsPeerId>&) ;
 
 	void initChatMessage(RsChatMsgItem *c, ChatMessage& msg);
 
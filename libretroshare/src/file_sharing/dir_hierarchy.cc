@@ -55,6 +55,20 @@ template<class T> typename std::set<T>::iterator erase_from_set(typename std::se
 
 InternalFileHierarchyStorage::InternalFileHierarchyStorage() : mRoot(0)
 {
+    clear() ;
+}
+
+void InternalFileHierarchyStorage::clear()
+{
+    for(uint32_t i=0;i<mNodes.size();++i)
+        delete mNodes[i] ;
+
+    mNodes.clear();
+    mFreeNodes.clear();
+    mFileHashes.clear();
+    mDirHashes.clear();
+    mNameIndex.clear();
+
     DirEntry *de = new DirEntry("") ;
 
     de->row=0;
@@ -63,10 +77,14 @@ InternalFileHierarchyStorage::InternalFileHierarchyStorage() : mRoot(0)
     de->dir_hash=RsFileHash() ; // null hash is root by convention.
 
     mNodes.push_back(de) ;
-    mDirHashes[de->dir_hash] = 0 ;
+    mDirHashes.set(de->dir_hash,0) ;
 
     mTotalSize = 0 ;
     mTotalFiles = 0 ;
+
+    mNameIndexEntries = 0 ;
+    mNameIndexStaleEntries = 0 ;
+    mNameIndexBuilt = false ;
 }
 
 bool InternalFileHierarchyStorage::getDirHashFromIndex(const DirectoryStorage::EntryIndex& index,RsFileHash& hash) const
@@ -80,42 +98,42 @@ bool InternalFileHierarchyStorage::getDirHashFromIndex(const DirectoryStorage::E
 }
 bool InternalFileHierarchyStorage::getIndexFromDirHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& index)
 {
-    std::map<RsFileHash,DirectoryStorage::EntryIndex>::iterator it = mDirHashes.find(hash) ;
-
-    if(it == mDirHashes.end())
+    if(!mDirHashes.find(hash,index))
         return false;
 
-    index = it->second;
-
     // make sure the hash actually points to some existing file. If not, remove it. This is a lazy update of dir hashes: when we need them, we check them.
     if(!checkIndex(index, FileStorageNode::TYPE_DIR) || static_cast<DirEntry*>(mNodes[index])->dir_hash != hash)
     {
         std::cerr << "(II) removing non existing hash from dir hash list: " << hash << std::endl;
 
-        mDirHashes.erase(it) ;
+        mDirHashes.erase(hash) ;
         return false ;
     }
     return true;
 }
 bool InternalFileHierarchyStorage::getIndexFromFileHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& index)
 {
-    std::map<RsFileHash,DirectoryStorage::EntryIndex>::iterator it = mFileHashes.find(hash) ;
+    std::vector<DirectoryStorage::EntryIndex> indices ;
 
-    if(it == mFileHashes.end())
+    if(!mFileHashes.findAll(hash,indices))
         return false;
 
-    index = it->second;
-
     // make sure the hash actually points to some existing file. If not, remove it. This is a lazy update of file hashes: when we need them, we check them.
-    if(!checkIndex(it->second, FileStorageNode::TYPE_FILE) || static_cast<FileEntry*>(mNodes[index])->file_hash != hash)
-    {
-        std::cerr << "(II) removing non existing hash from file hash list: " << hash << std::endl;
+    // The same file may be shared at different places, in which case any of them will do.
 
-        mFileHashes.erase(it) ;
-        return false ;
-    }
+    for(uint32_t i=0;i<indices.size();++i)
+        if(checkIndex(indices[i], FileStorageNode::TYPE_FILE) && static_cast<FileEntry*>(mNodes[indices[i]])->file_hash == hash)
+        {
+            index = indices[i] ;
+            return true ;
+        }
+        else
+        {
+            std::cerr << "(II) removing non existing hash from file hash list: " << hash << std::endl;
+            mFileHashes.erase(hash,indices[i]) ;
+        }
 
-    return true;
+    return false;
 }
 
 bool InternalFileHierarchyStorage::getChildIndex(DirectoryStorage::EntryIndex e,int row,DirectoryStorage::EntryIndex& c) const
@@ -197,7 +215,7 @@ bool InternalFileHierarchyStorage::updateSubDirectoryList(const DirectoryStorage
 		de->dir_parent_path = RsDirUtil::makePath(d.dir_parent_path, d.dir_name) ;
         de->dir_hash = createDirHash(de->dir_name,d.dir_hash,random_hash_seed) ;
 
-        mDirHashes[de->dir_hash] = mNodes.size() ;
+        mDirHashes.set(de->dir_hash,mNodes.size()) ;
 
         d.subdirs.push_back(mNodes.size()) ;
         mNodes.push_back(de) ;
@@ -336,6 +354,8 @@ bool InternalFileHierarchyStorage::updateSubFilesList(const DirectoryStorage::En
         mNodes.back()->row = mNodes.size()-1;
         mNodes.back()->parent_index = indx;
 
+        indexFileName(mNodes.size()-1,it->first) ;
+
         mTotalSize  += it->second.size;
         mTotalFiles += 1;
     }
@@ -353,7 +373,11 @@ bool InternalFileHierarchyStorage::updateHash(const DirectoryStorage::EntryIndex
 #endif
 
     RsFileHash& old_hash (static_cast<FileEntry*>(mNodes[file_index])->file_hash) ;
-    mFileHashes[hash] = file_index ;
+
+    mFileHashes.erase(old_hash,file_index) ;
+
+    if(!hash.isNull())
+        mFileHashes.insert(hash,file_index) ;
 
     old_hash = hash ;
 
@@ -377,13 +401,23 @@ bool InternalFileHierarchyStorage::updateFile(const DirectoryStorage::EntryIndex
 
 	mTotalSize += size ;
 
+    if(fe.file_name != fname)
+    {
+        unindexFileName(fe.file_name) ;
+        indexFileName(file_index,fname) ;
+    }
+    if(fe.file_hash != hash)
+        mFileHashes.erase(fe.file_hash,file_index) ;
+
     fe.file_hash = hash;
     fe.file_size = size;
     fe.file_modtime = modf_time;
     fe.file_name = fname;
 
+    checkNameIndex() ;
+
     if(!hash.isNull())
-        mFileHashes[hash] = file_index ;
+        mFileHashes.insert(hash,file_index) ;
 
     return true;
 }
@@ -400,9 +434,14 @@ void InternalFileHierarchyStorage::deleteFileNode(uint32_t index)
         if(mTotalFiles > 0)
 			mTotalFiles -= 1;
 
+		unindexFileName(fe.file_name) ;
+		mFileHashes.erase(fe.file_hash,index) ;
+
 		delete mNodes[index] ;
 		mFreeNodes.push_back(index) ;
 		mNodes[index] = NULL ;
+
+		checkNameIndex() ;
 	}
 }
 void InternalFileHierarchyStorage::deleteNode(uint32_t index)
@@ -486,7 +525,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
 			de->dir_parent_path = RsDirUtil::makePath(d.dir_parent_path, dir_name) ;
             de->dir_hash        = subdirs_hash[i];
 
-            mDirHashes[subdirs_hash[i]] = dir_index ;
+            mDirHashes.set(subdirs_hash[i],dir_index) ;
 
 #ifdef DEBUG_DIRECTORY_STORAGE
             std::cerr << " created, at new index " << dir_index << std::endl;
@@ -494,7 +533,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
         }
 
         d.subdirs.push_back(dir_index) ;
-        mDirHashes[subdirs_hash[i]] = dir_index ;
+        mDirHashes.set(subdirs_hash[i],dir_index) ;
     }
     // remove subdirs that do not exist anymore
 
@@ -549,7 +588,10 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
             file_index = allocateNewIndex() ;
 
             mNodes[file_index] = new FileEntry(f.file_name,f.file_size,f.file_modtime,f.file_hash) ;
-            mFileHashes[f.file_hash] = file_index ;
+            if(!f.file_hash.isNull())	// files that are not hashed yet would all pile up in the same place of the table
+                mFileHashes.insert(f.file_hash,file_index) ;
+
+            indexFileName(file_index,f.file_name) ;
             mTotalSize += f.file_size ;
             mTotalFiles++;
 
@@ -744,43 +786,203 @@ private:
     const InternalFileHierarchyStorage::DirEntry& mDe ;
 };
 
-int InternalFileHierarchyStorage::searchBoolExp(RsRegularExpression::Expression * exp, std::list<DirectoryStorage::EntryIndex> &results) const
+int InternalFileHierarchyStorage::searchBoolExp(RsRegularExpression::Expression * exp, std::list<DirectoryStorage::EntryIndex> &results)
 {
-    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator it(mFileHashes.begin());it!=mFileHashes.end();++it)
-        if(mNodes[it->second] != NULL && exp->eval(
-                    DirectoryStorageExprFileEntry(*static_cast<const FileEntry*>(mNodes[it->second]),
-                                                  *static_cast<const DirEntry*>(mNodes[mNodes[it->second]->parent_index])
-                                                  )))
-            results.push_back(it->second);
+    // Only evaluate the expression on files that can possibly match, when it constrains the file name.
+
+    std::list<std::string> strings ;
+    std::vector<DirectoryStorage::EntryIndex> candidates ;
+
+    if(!exp->nameSubstrings(strings) || !getNameIndexCandidates(strings,candidates))
+        getAllFileIndices(candidates) ;
+
+    std::set<RsFileHash> found_hashes ;
+
+    for(uint32_t i=0;i<candidates.size();++i)
+    {
+        const FileEntry& fe(*static_cast<const FileEntry*>(mNodes[candidates[i]])) ;
+
+        if(!fe.file_hash.isNull() && found_hashes.find(fe.file_hash) == found_hashes.end()
+                && exp->eval(DirectoryStorageExprFileEntry(fe, *static_cast<const DirEntry*>(mNodes[fe.parent_index]))))
+        {
+            found_hashes.insert(fe.file_hash) ;
+            results.push_back(candidates[i]);
+        }
+    }
 
     return 0;
 }
 
-int InternalFileHierarchyStorage::searchTerms(const std::list<std::string>& terms, std::list<DirectoryStorage::EntryIndex> &results) const
+int InternalFileHierarchyStorage::searchTerms(const std::list<std::string>& terms, std::list<DirectoryStorage::EntryIndex> &results)
 {
-    // most entries are likely to be files, so we could do a linear search over the entries tab.
-    // instead we go through the table of hashes.
+    // The name index gives the files that may contain any of the terms. Without it (e.g. terms too short),
+    // we need to go through all files.
+
+    std::vector<DirectoryStorage::EntryIndex> candidates ;
+
+    if(!getNameIndexCandidates(terms,candidates))
+        getAllFileIndices(candidates) ;
+
+    std::set<RsFileHash> found_hashes ;	// only report each file once, even if shared in different places
+
+    for(uint32_t i=0;i<candidates.size();++i)
+    {
+        const FileEntry& fe(*static_cast<const FileEntry*>(mNodes[candidates[i]])) ;
+        const std::string &str1 = fe.file_name;
 
-    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator it(mFileHashes.begin());it!=mFileHashes.end();++it)
-        if(mNodes[it->second] != NULL)
+        if(fe.file_hash.isNull() || found_hashes.find(fe.file_hash) != found_hashes.end())
+            continue ;
+
+        for(std::list<std::string>::const_iterator iter(terms.begin()); iter != terms.end(); ++iter)
         {
-            const std::string &str1 = static_cast<FileEntry*>(mNodes[it->second])->file_name;
+            /* always ignore case */
+            const std::string &str2 = (*iter);
 
-            for(std::list<std::string>::const_iterator iter(terms.begin()); iter != terms.end(); ++iter)
+            if(str1.end() != std::search( str1.begin(), str1.end(), str2.begin(), str2.end(), RsRegularExpression::CompareCharIC() ))
             {
-                /* always ignore case */
-                const std::string &str2 = (*iter);
-
-                if(str1.end() != std::search( str1.begin(), str1.end(), str2.begin(), str2.end(), RsRegularExpression::CompareCharIC() ))
-                {
-                    results.push_back(it->second);
-                    break;
-                }
+                found_hashes.insert(fe.file_hash) ;
+                results.push_back(candidates[i]);
+                break;
             }
         }
+    }
     return 0 ;
 }
 
+/******************************************************************************************************************/
+/*                                                File name index                                                 */
+/******************************************************************************************************************/
+
+// Number of stale entries below which the index is never rebuilt.
+static const uint32_t NAME_INDEX_MIN_STALE_ENTRIES = 4096 ;
+
+static inline uint32_t nameIndexKey(const std::string& s,uint32_t i)
+{
+    return   (uint32_t(tolower(static_cast<unsigned char>(s[i  ]))) << 16)
+           + (uint32_t(tolower(static_cast<unsigned char>(s[i+1]))) <<  8)
+           +  uint32_t(tolower(static_cast<unsigned char>(s[i+2]))) ;
+}
+
+// lists the distinct keys of a string
+
+static void nameIndexKeys(const std::string& s,std::vector<uint32_t>& keys)
+{
+    keys.clear();
+
+    for(uint32_t i=0;i+2<s.length();++i)
+        keys.push_back(nameIndexKey(s,i)) ;
+
+    std::sort(keys.begin(),keys.end()) ;
+    keys.erase(std::unique(keys.begin(),keys.end()),keys.end()) ;
+}
+
+void InternalFileHierarchyStorage::indexFileName(DirectoryStorage::EntryIndex indx,const std::string& name)
+{
+    if(!mNameIndexBuilt)
+        return ;
+
+    std::vector<uint32_t> keys ;
+    nameIndexKeys(name,keys) ;
+
+    for(uint32_t i=0;i<keys.size();++i)
+        mNameIndex[keys[i]].push_back(indx) ;
+
+    mNameIndexEntries += keys.size() ;
+}
+
+void InternalFileHierarchyStorage::unindexFileName(const std::string& name)
+{
+    if(!mNameIndexBuilt)
+        return ;
+
+    std::vector<uint32_t> keys ;
+    nameIndexKeys(name,keys) ;
+
+    mNameIndexStaleEntries += keys.size() ;
+}
+
+void InternalFileHierarchyStorage::checkNameIndex()
+{
+    if(mNameIndexStaleEntries > NAME_INDEX_MIN_STALE_ENTRIES && 2*mNameIndexStaleEntries > mNameIndexEntries)
+        rebuildNameIndex() ;
+}
+
+void InternalFileHierarchyStorage::rebuildNameIndex()
+{
+#ifdef DEBUG_DIRECTORY_STORAGE
+    std::cerr << "[directory storage] rebuilding file name index. " << mNameIndexStaleEntries << " stale entries out of " << mNameIndexEntries << std::endl;
+#endif
+    mNameIndex.clear();
+    mNameIndexEntries = 0 ;
+    mNameIndexStaleEntries = 0 ;
+    mNameIndexBuilt = true ;
+
+    for(uint32_t i=0;i<mNodes.size();++i)
+        if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+            indexFileName(i,static_cast<FileEntry*>(mNodes[i])->file_name) ;
+}
+
+bool InternalFileHierarchyStorage::getNameIndexCandidates(const std::string& str,std::vector<DirectoryStorage::EntryIndex>& candidates)
+{
+    if(str.length() < 3)
+        return false ;
+
+    if(!mNameIndexBuilt)
+        rebuildNameIndex() ;
+
+    // All keys of str are in the name of a matching file, so any of the lists will do. Take the shortest one.
+
+    const std::vector<DirectoryStorage::EntryIndex> *best = NULL ;
+
+    for(uint32_t i=0;i+2<str.length();++i)
+    {
+        std::map<uint32_t,std::vector<DirectoryStorage::EntryIndex> >::const_iterator it = mNameIndex.find(nameIndexKey(str,i)) ;
+
+        if(it == mNameIndex.end())
+            return true ;	// no file can match
+
+        if(best == NULL || it->second.size() < best->size())
+            best = &it->second ;
+    }
+
+    // skip entries of removed files. Renamed files and re-used indices are filtered out when checking the actual name.
+
+    for(uint32_t i=0;i<best->size();++i)
+        if((*best)[i] < mNodes.size() && mNodes[(*best)[i]] != NULL && mNodes[(*best)[i]]->type() == FileStorageNode::TYPE_FILE)
+            candidates.push_back((*best)[i]) ;
+
+    return true ;
+}
+
+bool InternalFileHierarchyStorage::getNameIndexCandidates(const std::list<std::string>& strings,std::vector<DirectoryStorage::EntryIndex>& candidates)
+{
+    if(strings.empty())
+        return false ;
+
+    for(std::list<std::string>::const_iterator it(strings.begin());it!=strings.end();++it)
+        if(!getNameIndexCandidates(*it,candidates))
+        {
+            candidates.clear();
+            return false ;
+        }
+
+    // the same file can be listed for several strings, or several times in a list after being renamed
+
+    std::sort(candidates.begin(),candidates.end()) ;
+    candidates.erase(std::unique(candidates.begin(),candidates.end()),candidates.end()) ;
+
+    return true ;
+}
+
+void InternalFileHierarchyStorage::getAllFileIndices(std::vector<DirectoryStorage::EntryIndex>& indices) const
+{
+    indices.clear();
+
+    for(uint32_t i=0;i<mNodes.size();++i)
+        if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+            indices.push_back(i) ;
+}
+
 bool InternalFileHierarchyStorage::check(std::string& error_string) // checks consistency of storage.
 {
     // recurs go through all entries, check that all
@@ -852,12 +1054,21 @@ bool InternalFileHierarchyStorage::check(std::string& error_string) // checks co
         {
             if(!bOrphean){ error_string += " - Orphean node!"; bOrphean = true;}
 
-            deleteNode(i) ;	// we don't care if it's a file or a dir.
+            if(mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+                deleteFileNode(i) ;	// also removes the file from the name index and the hash table
+            else
+                deleteNode(i) ;
         }
 
     return error_string.empty();;
 }
 
+class HashPrinter
+{
+public:
+    void operator()(const RsFileHash& hash,DirectoryStorage::EntryIndex index) const { std::cerr << "  " << hash << " at index " << index << std::endl; }
+};
+
 void InternalFileHierarchyStorage::print() const
 {
     int nfiles = 0 ;
@@ -894,13 +1105,13 @@ void InternalFileHierarchyStorage::print() const
 
     recursPrint(0,DirectoryStorage::EntryIndex(0));
 
+    HashPrinter printer ;
+
     std::cerr << "Known dir hashes: " << std::endl;
-    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator  it(mDirHashes.begin());it!=mDirHashes.end();++it)
-        std::cerr << "  " << it->first << " at index " << it->second << std::endl;
+    mDirHashes.forEach(printer) ;
 
     std::cerr << "Known file hashes: " << std::endl;
-    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator  it(mFileHashes.begin());it!=mFileHashes.end();++it)
-        std::cerr << "  " << it->first << " at index " << it->second << std::endl;
+    mFileHashes.forEach(printer) ;
 }
 void InternalFileHierarchyStorage::recursPrint(int depth,DirectoryStorage::EntryIndex node) const
 {
@@ -957,78 +1168,187 @@ bool InternalFileHierarchyStorage::recursRemoveDirectory(DirectoryStorage::Entry
     return true ;
 }
 
+/******************************************************************************************************************/
+/*                                                 Compact file format                                            */
+/******************************************************************************************************************/
+
+// Since version 0002, the hierarchy is saved as a few binary sections (columns) holding arrays of fixed-size values,
+// in the native encoding, instead of one section per field. Names and directory paths are stored once in a string
+// table and referred to by their index. This makes files much smaller (parent paths are very redundant) and loading
+// a matter of sequential copies.
+//
+// Each column starts with the size of its payload, since FileListIO does not return the exact size of binary sections.
+
+class CompactColumnWriter
+{
+public:
+    CompactColumnWriter() : mData(4,0) {}
+
+    template<class T> void push(const T& val)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(&val) ;
+        mData.insert(mData.end(),p,p+sizeof(T)) ;
+    }
+    void push(const RsFileHash& hash)
+    {
+        mData.insert(mData.end(),hash.toByteArray(),hash.toByteArray()+RsFileHash::SIZE_IN_BYTES) ;
+    }
+    void push(const std::string& s)
+    {
+        push((uint32_t)s.length()) ;
+        mData.insert(mData.end(),s.begin(),s.end()) ;
+    }
+
+    bool write(unsigned char *& buffer,uint32_t& buffer_size,uint32_t& buffer_offset)
+    {
+        uint32_t payload_size = mData.size() - 4 ;
+        memcpy(&mData[0],&payload_size,4) ;
+
+        return FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_BINARY_DATA,&mData[0],mData.size()) ;
+    }
+
+private:
+    std::vector<unsigned char> mData ;
+};
+
+class CompactColumnReader
+{
+public:
+    CompactColumnReader(const unsigned char *buffer,uint32_t buffer_size,uint32_t& buffer_offset) : mData(NULL),mSize(0),mOffset(4)
+    {
+        uint32_t allocated_size = 0 ;
+
+        if(!FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_BINARY_DATA,mData,allocated_size) || allocated_size < 4)
+        {
+            free(mData) ;
+            throw read_error("Cannot read column") ;
+        }
+        memcpy(&mSize,mData,4) ;
+
+        if(mSize > allocated_size - 4)
+        {
+            free(mData) ;
+            throw read_error("Wrong column size") ;
+        }
+        mSize += 4 ;
+    }
+    ~CompactColumnReader() { free(mData) ; }
+
+    bool atEnd() const { return mOffset >= mSize ; }
+    void check(uint64_t n) const { if(mOffset + n > mSize) throw read_error("Column too short") ; }
+
+    template<class T> void pop(T& val)
+    {
+        check(sizeof(T)) ;
+        memcpy(&val,mData+mOffset,sizeof(T)) ;
+        mOffset += sizeof(T) ;
+    }
+    void pop(RsFileHash& hash)
+    {
+        check(RsFileHash::SIZE_IN_BYTES) ;
+        hash = RsFileHash(mData+mOffset) ;
+        mOffset += RsFileHash::SIZE_IN_BYTES ;
+    }
+    void pop(std::string& s)
+    {
+        uint32_t len ;
+        pop(len) ;
+        check(len) ;
+        s.assign(reinterpret_cast<const char*>(mData+mOffset),len) ;
+        mOffset += len ;
+    }
+
+private:
+    unsigned char *mData ;
+    uint32_t mSize ;
+    uint32_t mOffset ;
+};
+
+static uint32_t internString(std::map<std::string,uint32_t>& ids,CompactColumnWriter& strings,const std::string& s)
+{
+    std::map<std::string,uint32_t>::const_iterator it = ids.find(s) ;
+
+    if(it != ids.end())
+        return it->second ;
+
+    uint32_t id = ids.size() ;
+    ids[s] = id ;
+    strings.push(s) ;
+
+    return id ;
+}
+
 bool InternalFileHierarchyStorage::save(const std::string& fname)
 {
     unsigned char *buffer = NULL ;
     uint32_t buffer_size = 0 ;
     uint32_t buffer_offset = 0 ;
 
-    unsigned char *tmp_section_data = (unsigned char*)rs_malloc(FL_BASE_TMP_SECTION_SIZE) ;
-
-    if(!tmp_section_data)
-        return false;
-
-    uint32_t tmp_section_size = FL_BASE_TMP_SECTION_SIZE ;
-
     try
     {
         // Write some header
 
-        if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,(uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001)) throw std::runtime_error("Write error") ;
+        if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,(uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0002)) throw std::runtime_error("Write error") ;
         if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t) mNodes.size())) throw std::runtime_error("Write error") ;
 
-        // Write all file/dir entries
+        // Fill the columns. Every node has a type. Non empty nodes have a parent, row and name, followed by the file or
+        // directory specific fields in the corresponding column.
+
+        std::map<std::string,uint32_t> string_ids ;
+        CompactColumnWriter strings_col, nodes_col, files_col, dirs_col, children_col ;
 
         for(uint32_t i=0;i<mNodes.size();++i)
-            if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+        {
+            if(mNodes[i] == NULL)
             {
-                const FileEntry& fe(*static_cast<const FileEntry*>(mNodes[i])) ;
+                nodes_col.push((uint8_t)FileStorageNode::TYPE_UNKNOWN) ;
+                continue ;
+            }
+            nodes_col.push((uint8_t)mNodes[i]->type()) ;
+            nodes_col.push((uint32_t)mNodes[i]->parent_index) ;
+            nodes_col.push((uint32_t)mNodes[i]->row) ;
 
-                uint32_t file_section_offset = 0 ;
+            if(mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+            {
+                const FileEntry& fe(*static_cast<const FileEntry*>(mNodes[i])) ;
 
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_PARENT_INDEX  ,(uint32_t)fe.parent_index)) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_ROW           ,(uint32_t)fe.row         )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX   ,(uint32_t)i              )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME     ,fe.file_name             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SIZE     ,fe.file_size             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,fe.file_hash             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,(uint32_t)fe.file_modtime)) throw std::runtime_error("Write error") ;
+                nodes_col.push(internString(string_ids,strings_col,fe.file_name)) ;
 
-                if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_FILE_ENTRY,tmp_section_data,file_section_offset)) throw std::runtime_error("Write error") ;
+                files_col.push((uint64_t)fe.file_size) ;
+                files_col.push((uint32_t)fe.file_modtime) ;
+                files_col.push(fe.file_hash) ;
             }
-            else if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_DIR)
+            else
             {
                 const DirEntry& de(*static_cast<const DirEntry*>(mNodes[i])) ;
 
-                uint32_t dir_section_offset = 0 ;
-
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_PARENT_INDEX   ,(uint32_t)de.parent_index      )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_ROW            ,(uint32_t)de.row               )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX    ,(uint32_t)i                    )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_FILE_NAME      ,de.dir_name                    )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_DIR_HASH       ,de.dir_hash                    )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,de.dir_parent_path             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_MODIF_TS       ,(uint32_t)de.dir_modtime       )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_UPDATE_TS      ,(uint32_t)de.dir_update_time   )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,(uint32_t)de.dir_most_recent_time  )) throw std::runtime_error("Write error") ;
+                nodes_col.push(internString(string_ids,strings_col,de.dir_name)) ;
 
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subdirs.size())) throw std::runtime_error("Write error") ;
+                dirs_col.push(de.dir_hash) ;
+                dirs_col.push(internString(string_ids,strings_col,de.dir_parent_path)) ;
+                dirs_col.push((uint32_t)de.dir_modtime) ;
+                dirs_col.push((uint32_t)de.dir_update_time) ;
+                dirs_col.push((uint32_t)de.dir_most_recent_time) ;
+                dirs_col.push((uint32_t)de.subdirs.size()) ;
+                dirs_col.push((uint32_t)de.subfiles.size()) ;
 
                 for(uint32_t j=0;j<de.subdirs.size();++j)
-                    if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subdirs[j])) throw std::runtime_error("Write error") ;
-
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subfiles.size())) throw std::runtime_error("Write error") ;
+                    children_col.push((uint32_t)de.subdirs[j]) ;
 
                 for(uint32_t j=0;j<de.subfiles.size();++j)
-                    if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subfiles[j])) throw std::runtime_error("Write error") ;
-
-                if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIR_ENTRY,tmp_section_data,dir_section_offset)) throw std::runtime_error("Write error") ;
+                    children_col.push((uint32_t)de.subfiles[j]) ;
             }
+        }
+
+        if(!strings_col .write(buffer,buffer_size,buffer_offset)) throw std::runtime_error("Write error") ;
+        if(!nodes_col   .write(buffer,buffer_size,buffer_offset)) throw std::runtime_error("Write error") ;
+        if(!files_col   .write(buffer,buffer_size,buffer_offset)) throw std::runtime_error("Write error") ;
+        if(!dirs_col    .write(buffer,buffer_size,buffer_offset)) throw std::runtime_error("Write error") ;
+        if(!children_col.write(buffer,buffer_size,buffer_offset)) throw std::runtime_error("Write error") ;
 
         bool res = FileListIO::saveEncryptedDataToFile(fname,buffer,buffer_offset) ;
 
         free(buffer) ;
-        free(tmp_section_data) ;
 
         return res ;
     }
@@ -1039,13 +1359,122 @@ bool InternalFileHierarchyStorage::save(const std::string& fname)
         if(buffer != NULL)
             free(buffer) ;
 
-        if(tmp_section_data != NULL)
-			free(tmp_section_data) ;
-
         return false;
     }
 }
 
+void InternalFileHierarchyStorage::loadCompact(const unsigned char *buffer,uint32_t buffer_size,uint32_t& buffer_offset)
+{
+    CompactColumnReader strings_col (buffer,buffer_size,buffer_offset) ;
+    CompactColumnReader nodes_col   (buffer,buffer_size,buffer_offset) ;
+    CompactColumnReader files_col   (buffer,buffer_size,buffer_offset) ;
+    CompactColumnReader dirs_col    (buffer,buffer_size,buffer_offset) ;
+    CompactColumnReader children_col(buffer,buffer_size,buffer_offset) ;
+
+    std::vector<std::string> strings ;
+
+    while(!strings_col.atEnd())
+    {
+        strings.push_back(std::string()) ;
+        strings_col.pop(strings.back()) ;
+    }
+
+    for(uint32_t i=0;i<mNodes.size();++i)
+    {
+        uint8_t type ;
+        nodes_col.pop(type) ;
+
+        if(type == FileStorageNode::TYPE_UNKNOWN)
+        {
+            mFreeNodes.push_back(i) ;
+            continue ;
+        }
+
+        uint32_t parent_index, row, name_id ;
+
+        nodes_col.pop(parent_index) ;
+        nodes_col.pop(row) ;
+        nodes_col.pop(name_id) ;
+
+        if(parent_index >= mNodes.size() || name_id >= strings.size())
+            throw read_error("Inconsistent node") ;
+
+        if(type == FileStorageNode::TYPE_FILE)
+        {
+            uint64_t file_size ;
+            uint32_t file_modtime ;
+            RsFileHash file_hash ;
+
+            files_col.pop(file_size) ;
+            files_col.pop(file_modtime) ;
+            files_col.pop(file_hash) ;
+
+            FileEntry *fe = new FileEntry(strings[name_id],file_size,file_modtime,file_hash);
+
+            fe->parent_index = parent_index ;
+            fe->row = row ;
+
+            mNodes[i] = fe ;
+
+            if(!fe->file_hash.isNull())
+                mFileHashes.insert(fe->file_hash,i) ;
+
+            mTotalFiles++ ;
+            mTotalSize += file_size ;
+        }
+        else if(type == FileStorageNode::TYPE_DIR)
+        {
+            DirEntry *de = new DirEntry(strings[name_id]) ;
+            mNodes[i] = de ;
+
+            uint32_t parent_path_id, dir_modtime, dir_update_time, dir_most_recent_time, n_subdirs, n_subfiles ;
+
+            dirs_col.pop(de->dir_hash) ;
+            dirs_col.pop(parent_path_id) ;
+            dirs_col.pop(dir_modtime) ;
+            dirs_col.pop(dir_update_time) ;
+            dirs_col.pop(dir_most_recent_time) ;
+            dirs_col.pop(n_subdirs) ;
+            dirs_col.pop(n_subfiles) ;
+
+            if(parent_path_id >= strings.size())
+                throw read_error("Inconsistent directory") ;
+
+            children_col.check(4*((uint64_t)n_subdirs + n_subfiles)) ;
+
+            de->parent_index         = parent_index ;
+            de->row                  = row ;
+            de->dir_parent_path      = strings[parent_path_id] ;
+            de->dir_modtime          = dir_modtime ;
+            de->dir_update_time      = dir_update_time ;
+            de->dir_most_recent_time = dir_most_recent_time ;
+            de->subdirs.resize(n_subdirs) ;
+            de->subfiles.resize(n_subfiles) ;
+
+            for(uint32_t j=0;j<n_subdirs;++j)
+                children_col.pop(de->subdirs[j]) ;
+
+            for(uint32_t j=0;j<n_subfiles;++j)
+                children_col.pop(de->subfiles[j]) ;
+
+            for(uint32_t j=0;j<n_subdirs;++j)
+                if(de->subdirs[j] >= mNodes.size())
+                    throw read_error("Inconsistent sub-directory index") ;
+
+            for(uint32_t j=0;j<n_subfiles;++j)
+                if(de->subfiles[j] >= mNodes.size())
+                    throw read_error("Inconsistent sub-file index") ;
+
+            mDirHashes.set(de->dir_hash,i) ;
+        }
+        else
+            throw read_error("Unknown node type") ;
+    }
+
+    if(mNodes.empty() || mNodes[0] == NULL || mNodes[0]->type() != FileStorageNode::TYPE_DIR)
+        throw read_error("No root directory") ;
+}
+
 bool InternalFileHierarchyStorage::load(const std::string& fname)
 {
     unsigned char *buffer = NULL ;
@@ -1066,7 +1495,8 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
         uint32_t version, n_nodes ;
 
         if(!FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,version)) throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION) ;
-        if(version != (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001) throw std::runtime_error("Wrong version number") ;
+        if(version != (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001 && version != (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0002)
+            throw read_error("Wrong version number") ;
 
         if(!FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,n_nodes)) throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER) ;
 
@@ -1079,6 +1509,22 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
         mNodes.clear();
         mNodes.resize(n_nodes,NULL) ;
 
+        mNameIndex.clear();
+        mNameIndexEntries = 0 ;
+        mNameIndexStaleEntries = 0 ;
+        mNameIndexBuilt = false ;
+
+        mFileHashes.clear();
+        mDirHashes.clear();
+
+        if(version == (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0002)
+        {
+            loadCompact(buffer,buffer_size,buffer_offset) ;
+            free(buffer) ;
+
+            return true ;
+        }
+
         for(uint32_t i=0;i<mNodes.size() && buffer_offset < buffer_size;++i)	// only the 2nd condition really is needed. The first one ensures that the loop wont go forever.
         {
             unsigned char *node_section_data = NULL ;
@@ -1115,7 +1561,9 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
                 fe->row = row ;
 
                 mNodes[node_index] = fe ;
-                mFileHashes[fe->file_hash] = node_index ;
+
+                if(!fe->file_hash.isNull())
+                    mFileHashes.insert(fe->file_hash,node_index) ;
 
                 mTotalFiles++ ;
                 mTotalSize += file_size ;
@@ -1177,7 +1625,7 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
                     de->subfiles.push_back(fi) ;
                 }
                 mNodes[node_index] = de ;
-                mDirHashes[de->dir_hash] = node_index ;
+                mDirHashes.set(de->dir_hash,node_index) ;
             }
             else
                 throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_FILE_ENTRY) ;
@@ -1196,6 +1644,8 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
 
         if(buffer != NULL)
             free(buffer) ;
+
+        clear() ;	// do not keep a partly loaded hierarchy
         return false;
     }
 }
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 
 #include "directory_storage.h"
+#include "util/rshashtable.h"
 
 class InternalFileHierarchyStorage
 {
@@ -92,6 +93,10 @@ public:
     bool load(const std::string& fname) ;
     bool save(const std::string& fname) ;
 
+    // Drops all entries, leaving an empty root directory.
+
+    void clear() ;
+
     int parentRow(DirectoryStorage::EntryIndex e);
     bool isIndexValid(DirectoryStorage::EntryIndex e) const;
     bool getChildIndex(DirectoryStorage::EntryIndex e,int row,DirectoryStorage::EntryIndex& c) const;
@@ -142,11 +147,11 @@ public:
     DirectoryStorage::EntryIndex getSubFileIndex(DirectoryStorage::EntryIndex parent_index,uint32_t file_tab_index);
     DirectoryStorage::EntryIndex getSubDirIndex(DirectoryStorage::EntryIndex parent_index,uint32_t dir_tab_index);
 
-    // search. SearchHash is logarithmic. The other two are linear.
+    // search. SearchHash is logarithmic. The other two use the file name index when the search terms allow it, and are linear otherwise.
 
     bool searchHash(const RsFileHash& hash, DirectoryStorage::EntryIndex &result);
-    int searchBoolExp(RsRegularExpression::Expression * exp, std::list<DirectoryStorage::EntryIndex> &results) const ;
-    int searchTerms(const std::list<std::string>& terms, std::list<DirectoryStorage::EntryIndex> &results) const ;		// does a logical OR between items of the list of terms
+    int searchBoolExp(RsRegularExpression::Expression * exp, std::list<DirectoryStorage::EntryIndex> &results) ;
+    int searchTerms(const std::list<std::string>& terms, std::list<DirectoryStorage::EntryIndex> &results) ;		// does a logical OR between items of the list of terms
 
     bool check(std::string& error_string)	;// checks consistency of storage.
 
@@ -157,6 +162,8 @@ public:
     void getStatistics(SharedDirStats& stats) const ;
 
 private:
+    void loadCompact(const unsigned char *buffer,uint32_t buffer_size,uint32_t& buffer_offset) ;	// throws FileListIO::read_error
+
     void recursPrint(int depth,DirectoryStorage::EntryIndex node) const;
     static bool nodeAccessError(const std::string& s);
     static RsFileHash createDirHash(const std::string& dir_name, const RsFileHash &dir_parent_hash, const RsFileHash &random_hash_salt) ;
@@ -175,12 +182,37 @@ private:
 
     bool recursRemoveDirectory(DirectoryStorage::EntryIndex dir);
 
+    // File name index. Maps every lower-cased 3 bytes sequence to the files whose name contain it. Lists are only appended to:
+    // entries of deleted/renamed files are skipped when searching, and dropped when the index is rebuilt because
+    // there are too many of them.
+    // The index is only built by the first search that needs it, so that file lists which are never searched (most of
+    // the friends' lists) do not pay for it.
+
+    void indexFileName(DirectoryStorage::EntryIndex indx,const std::string& name) ;
+    void unindexFileName(const std::string& name) ;
+    void checkNameIndex() ;
+    void rebuildNameIndex() ;
+
+    // Returns in candidates a superset of the files which name contains str, ignoring case. Returns false if the index cannot
+    // help for that string (too short), in which case all files must be considered.
+
+    bool getNameIndexCandidates(const std::string& str,std::vector<DirectoryStorage::EntryIndex>& candidates) ;
+
+    // Fills candidates with the files that may contain one of the strings. Returns false if all files must be considered.
+
+    bool getNameIndexCandidates(const std::list<std::string>& strings,std::vector<DirectoryStorage::EntryIndex>& candidates) ;
+    void getAllFileIndices(std::vector<DirectoryStorage::EntryIndex>& indices) const ;
+
+    std::map<uint32_t,std::vector<DirectoryStorage::EntryIndex> > mNameIndex ;
+    uint32_t mNameIndexEntries ;		// total size of the lists in mNameIndex
+    uint32_t mNameIndexStaleEntries ;	// number of entries in mNameIndex that point to removed/renamed files
+    bool mNameIndexBuilt ;				// false until a search needs the index. Files are not indexed meanwhile.
+
     // Map of the hash of all files. The file hashes are the sha1sum of the file data.
     // is used for fast search access for FT.
-    // Note: We should try something faster than std::map. hash_map??
-    // Unlike directories, multiple files may have the same hash. So this cannot be used for anything else than FT.
+    // Unlike directories, multiple files may have the same hash, so all of them are kept. This cannot be used for anything else than FT.
 
-    std::map<RsFileHash,DirectoryStorage::EntryIndex> mFileHashes ;
+    RsHashTable<RsFileHash,DirectoryStorage::EntryIndex> mFileHashes ;
 
     // The directory hashes are the sha1sum of the
     // full public path to the directory.
@@ -189,7 +221,7 @@ private:
     // This is kept separate from mFileHashes because the two are used
     // in very different ways.
     //
-    std::map<RsFileHash,DirectoryStorage::EntryIndex> mDirHashes ;
+    RsHashTable<RsFileHash,DirectoryStorage::EntryIndex> mDirHashes ;
 
     // high level statistics on the full hierarchy. Should be kept up to date.
 
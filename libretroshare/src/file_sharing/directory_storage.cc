@@ -23,6 +23,7 @@
  *
  */
 #include <set>
+#include <algorithm>
 #include <time.h>
 #include "serialiser/rstlvbinary.h"
 #include "retroshare/rspeers.h"
@@ -41,17 +42,31 @@
 
 DirectoryStorage::DirIterator::DirIterator(DirectoryStorage *s,DirectoryStorage::EntryIndex i)
 {
+    s->pin() ;
+
+    mDirStorage = s ;
     mStorage = s->mFileHierarchy ;
     mParentIndex = i;
     mDirTabIndex = 0;
 }
+DirectoryStorage::DirIterator::~DirIterator()
+{
+    mDirStorage->unpin() ;
+}
 
 DirectoryStorage::FileIterator::FileIterator(DirectoryStorage *s,DirectoryStorage::EntryIndex i)
 {
+    s->pin() ;
+
+    mDirStorage = s ;
     mStorage = s->mFileHierarchy ;
     mParentIndex = i;
     mFileTabIndex = 0;
 }
+DirectoryStorage::FileIterator::~FileIterator()
+{
+    mDirStorage->unpin() ;
+}
 
 DirectoryStorage::DirIterator& DirectoryStorage::DirIterator::operator++()
 {
@@ -83,7 +98,8 @@ std::string DirectoryStorage::DirIterator::name()      const { const InternalFil
 /******************************************************************************************************************/
 
 DirectoryStorage::DirectoryStorage(const RsPeerId &pid,const std::string& fname)
-    : mPeerId(pid), mDirStorageMtx("Directory storage "+pid.toStdString()),mLastSavedTime(0),mChanged(false),mFileName(fname)
+    : mPeerId(pid), mDirStorageMtx("Directory storage "+pid.toStdString()),mLastSavedTime(0),mChanged(false),mFileName(fname),
+      mLoaded(true),mPinCount(0),mLastAccessTime(time(NULL)),mLastLoadFailureTime(0),mUnloadedRecursModTime(0),mUnloadedUpdateTime(0)
 {
 	{
 		RS_STACK_MUTEX(mDirStorageMtx) ;
@@ -99,12 +115,14 @@ DirectoryStorage::EntryIndex DirectoryStorage::root() const
 int DirectoryStorage::parentRow(EntryIndex e) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
 
     return mFileHierarchy->parentRow(e) ;
 }
 bool DirectoryStorage::getChildIndex(EntryIndex e,int row,EntryIndex& c) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
 
     return mFileHierarchy->getChildIndex(e,row,c) ;
 }
@@ -112,6 +130,7 @@ bool DirectoryStorage::getChildIndex(EntryIndex e,int row,EntryIndex& c) const
 uint32_t DirectoryStorage::getEntryType(const EntryIndex& indx)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
 
     switch(mFileHierarchy->getType(indx))
     {
@@ -122,17 +141,53 @@ uint32_t DirectoryStorage::getEntryType(const EntryIndex& indx)
     }
 }
 
-bool DirectoryStorage::getDirectoryUpdateTime   (EntryIndex index,time_t& update_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->getTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time     ); }
-bool DirectoryStorage::getDirectoryRecursModTime(EntryIndex index,time_t& rec_md_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->getTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time); }
-bool DirectoryStorage::getDirectoryLocalModTime (EntryIndex index,time_t& loc_md_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->getTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
+// The update time is only used by the sync with the friend, so it does not count as an access.
 
-bool DirectoryStorage::setDirectoryUpdateTime   (EntryIndex index,time_t  update_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->setTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time     ); }
-bool DirectoryStorage::setDirectoryRecursModTime(EntryIndex index,time_t  rec_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->setTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time); }
-bool DirectoryStorage::setDirectoryLocalModTime (EntryIndex index,time_t  loc_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->setTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
+bool DirectoryStorage::getDirectoryUpdateTime(EntryIndex index,time_t& update_TS) const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(!mLoaded && index == 0)
+    {
+        update_TS = mUnloadedUpdateTime ;
+        return true ;
+    }
+    locked_checkLoaded(false) ;
+    return mFileHierarchy->getTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time);
+}
+bool DirectoryStorage::getDirectoryRecursModTime(EntryIndex index,time_t& rec_md_TS) const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(!mLoaded && index == 0)
+    {
+        rec_md_TS = mUnloadedRecursModTime ;	// does not count as an access
+        return true ;
+    }
+    locked_checkLoaded() ;
+    return mFileHierarchy->getTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time);
+}
+bool DirectoryStorage::getDirectoryLocalModTime (EntryIndex index,time_t& loc_md_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; locked_checkLoaded() ; return mFileHierarchy->getTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
+
+bool DirectoryStorage::setDirectoryUpdateTime(EntryIndex index,time_t update_TS)
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(!mLoaded && index == 0)
+    {
+        mUnloadedUpdateTime = update_TS ;	// written to the root when the hierarchy is loaded again
+        return true ;
+    }
+    locked_checkLoaded(false) ;
+    return mFileHierarchy->setTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time);
+}
+bool DirectoryStorage::setDirectoryRecursModTime(EntryIndex index,time_t  rec_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; locked_checkLoaded() ; return mFileHierarchy->setTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time); }
+bool DirectoryStorage::setDirectoryLocalModTime (EntryIndex index,time_t  loc_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; locked_checkLoaded() ; return mFileHierarchy->setTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
 
 bool DirectoryStorage::updateSubDirectoryList(const EntryIndex& indx, const std::set<std::string> &subdirs, const RsFileHash& hash_salt)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
     bool res = mFileHierarchy->updateSubDirectoryList(indx,subdirs,hash_salt) ;
     mChanged = true ;
     return res ;
@@ -140,6 +195,7 @@ bool DirectoryStorage::updateSubDirectoryList(const EntryIndex& indx, const std:
 bool DirectoryStorage::updateSubFilesList(const EntryIndex& indx,const std::map<std::string,FileTS>& subfiles,std::map<std::string,FileTS>& new_files)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
     bool res = mFileHierarchy->updateSubFilesList(indx,subfiles,new_files) ;
     mChanged = true ;
     return res ;
@@ -147,6 +203,7 @@ bool DirectoryStorage::updateSubFilesList(const EntryIndex& indx,const std::map<
 bool DirectoryStorage::removeDirectory(const EntryIndex& indx)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
     bool res = mFileHierarchy->removeDirectory(indx);
     mChanged = true ;
 
@@ -163,6 +220,12 @@ void DirectoryStorage::locked_check()
 void DirectoryStorage::getStatistics(SharedDirStats& stats)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(!mLoaded)
+    {
+        stats = mUnloadedStats ;
+        return ;
+    }
     mFileHierarchy->getStatistics(stats);
 }
 
@@ -170,33 +233,129 @@ bool DirectoryStorage::load(const std::string& local_file_name)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
     mChanged = false ;
+    mLoaded = true ;
+    mLastAccessTime = time(NULL) ;
     return mFileHierarchy->load(local_file_name);
 }
 void DirectoryStorage::save(const std::string& local_file_name)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    mFileHierarchy->save(local_file_name);
+
+    if(mLoaded)	// an unloaded hierarchy is already saved, and is empty in memory
+        mFileHierarchy->save(local_file_name);
+}
+
+void DirectoryStorage::locked_checkLoaded(bool record_access) const
+{
+    time_t now = time(NULL) ;
+
+    if(record_access)
+        mLastAccessTime = now ;
+
+    if(mLoaded || mLastLoadFailureTime + DELAY_BEFORE_RELOAD_RETRY_REMOTE_DIRECTORY > now)
+        return ;
+
+#ifdef DEBUG_REMOTE_DIRECTORY_STORAGE
+    std::cerr << "Re-loading directory storage for peer " << mPeerId << " from " << mFileName << std::endl;
+#endif
+    if(!mFileHierarchy->load(mFileName))
+    {
+        std::cerr << "(EE) Cannot re-load directory storage for peer " << mPeerId << " from " << mFileName << ". The file list stays unloaded." << std::endl;
+        mFileHierarchy->clear() ;
+        mLastLoadFailureTime = now ;
+        return ;
+    }
+    mLoaded = true ;
+    mLastLoadFailureTime = 0 ;
+    mUnloadedFileHashes.clear() ;
+
+    // the sync may have updated the root while the hierarchy was unloaded
+
+    time_t update_TS = 0 ;
+    mFileHierarchy->getTS(0,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time) ;
+
+    if(update_TS != mUnloadedUpdateTime)
+    {
+        update_TS = mUnloadedUpdateTime ;
+        mFileHierarchy->setTS(0,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time) ;
+        mChanged = true ;
+    }
+}
+
+void DirectoryStorage::pin() const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded(false) ;
+    ++mPinCount ;
+}
+
+void DirectoryStorage::unpin() const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+    --mPinCount ;
+}
+
+bool DirectoryStorage::isLoaded() const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+    return mLoaded ;
+}
+
+void DirectoryStorage::checkUnload(time_t max_idle_time)
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(!mLoaded || mChanged || mPinCount > 0 || mLastAccessTime + max_idle_time > time(NULL))
+        return ;
+
+#ifdef DEBUG_REMOTE_DIRECTORY_STORAGE
+    std::cerr << "Unloading directory storage for peer " << mPeerId << ", not accessed since " << time(NULL) - mLastAccessTime << " secs." << std::endl;
+#endif
+    mFileHierarchy->getTS(0,mUnloadedRecursModTime,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time) ;
+    mFileHierarchy->getTS(0,mUnloadedUpdateTime,&InternalFileHierarchyStorage::DirEntry::dir_update_time) ;
+    mFileHierarchy->getStatistics(mUnloadedStats) ;
+
+    mUnloadedFileHashes.clear() ;
+
+    for(uint32_t i=0;i<mFileHierarchy->mNodes.size();++i)
+        if(mFileHierarchy->mNodes[i] != NULL && mFileHierarchy->mNodes[i]->type() == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
+        {
+            const RsFileHash& hash(static_cast<InternalFileHierarchyStorage::FileEntry*>(mFileHierarchy->mNodes[i])->file_hash) ;
+
+            if(!hash.isNull())
+                mUnloadedFileHashes.push_back(hash) ;
+        }
+
+    std::sort(mUnloadedFileHashes.begin(),mUnloadedFileHashes.end()) ;
+    mUnloadedFileHashes.erase(std::unique(mUnloadedFileHashes.begin(),mUnloadedFileHashes.end()),mUnloadedFileHashes.end()) ;
+
+    mFileHierarchy->clear() ;
+    mLoaded = false ;
 }
 void DirectoryStorage::print()
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
     mFileHierarchy->print();
 }
 
 int DirectoryStorage::searchTerms(const std::list<std::string>& terms, std::list<EntryIndex> &results) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
     return mFileHierarchy->searchTerms(terms,results);
 }
 int DirectoryStorage::searchBoolExp(RsRegularExpression::Expression * exp, std::list<EntryIndex> &results) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
     return mFileHierarchy->searchBoolExp(exp,results);
 }
 
 bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
 
     d.children.clear() ;
     uint32_t type = mFileHierarchy->getType(indx) ;
@@ -209,22 +368,26 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
 
         /* extract all the entries */
 
-        for(DirectoryStorage::DirIterator it(this,indx);it;++it)
+        for(uint32_t i=0;i<dir_entry->subdirs.size();++i)
         {
+            const InternalFileHierarchyStorage::DirEntry *sub = mFileHierarchy->getDirEntry(dir_entry->subdirs[i]) ;
+
             DirStub stub;
             stub.type = DIR_TYPE_DIR;
-            stub.name = it.name();
-            stub.ref  = (void*)(intptr_t)*it; // this is updated by the caller, who knows which friend we're dealing with
+            stub.name = sub?(sub->dir_name):std::string();
+            stub.ref  = (void*)(intptr_t)dir_entry->subdirs[i]; // this is updated by the caller, who knows which friend we're dealing with
 
             d.children.push_back(stub);
         }
 
-        for(DirectoryStorage::FileIterator it(this,indx);it;++it)
+        for(uint32_t i=0;i<dir_entry->subfiles.size();++i)
         {
+            const InternalFileHierarchyStorage::FileEntry *sub = mFileHierarchy->getFileEntry(dir_entry->subfiles[i]) ;
+
             DirStub stub;
             stub.type = DIR_TYPE_FILE;
-            stub.name = it.name();
-            stub.ref  = (void*)(intptr_t)*it;
+            stub.name = sub?(sub->file_name):std::string();
+            stub.ref  = (void*)(intptr_t)dir_entry->subfiles[i];
 
             d.children.push_back(stub);
         }
@@ -271,14 +434,30 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
     return true;
 }
 
+// Directory hashes are used by the sync with the friend, which does not count as an access. The root hash is null by convention.
+
 bool DirectoryStorage::getDirHashFromIndex(const EntryIndex& index,RsFileHash& hash) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(!mLoaded && index == 0)
+    {
+        hash.clear() ;
+        return true ;
+    }
+    locked_checkLoaded(false) ;
     return mFileHierarchy->getDirHashFromIndex(index,hash) ;
 }
 bool DirectoryStorage::getIndexFromDirHash(const RsFileHash& hash,EntryIndex& index) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(!mLoaded && hash.isNull())
+    {
+        index = 0 ;
+        return true ;
+    }
+    locked_checkLoaded(false) ;
     return mFileHierarchy->getIndexFromDirHash(hash,index) ;
 }
 
@@ -907,6 +1086,7 @@ bool RemoteDirectoryStorage::deserialiseUpdateDirEntry(const EntryIndex& indx,co
 	free(file_section_data) ;
 
     RS_STACK_MUTEX(mDirStorageMtx) ;
+    locked_checkLoaded() ;
 #ifdef DEBUG_REMOTE_DIRECTORY_STORAGE
     std::cerr << "  updating dir entry..." << std::endl;
 #endif
@@ -923,10 +1103,18 @@ bool RemoteDirectoryStorage::deserialiseUpdateDirEntry(const EntryIndex& indx,co
     return true ;
 }
 
+// Used by file transfer to find sources, every few minutes for each download. This does not count as an access, and
+// only loads the hierarchy when the file is in it.
+
 int RemoteDirectoryStorage::searchHash(const RsFileHash& hash, EntryIndex& result) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
+    if(!mLoaded && !std::binary_search(mUnloadedFileHashes.begin(),mUnloadedFileHashes.end(),hash))
+        return false ;
+
+    locked_checkLoaded(false) ;
+
     return mFileHierarchy->searchHash(hash,result);
 }
 
@@ -28,6 +28,7 @@
 #include <string>
 #include <stdint.h>
 #include <list>
+#include <vector>
 
 #include "retroshare/rsids.h"
 #include "retroshare/rsfiles.h"
@@ -68,14 +69,16 @@ class DirectoryStorage
         virtual bool extractData(const EntryIndex& indx,DirDetails& d);
 
 		// This class allows to abstractly browse the stored directory hierarchy in a depth-first manner.
-        // It gives access to sub-files and sub-directories below. When using it, the client should make sure
-        // that the DirectoryStorage is properly locked, since the iterator cannot lock it.
+        // It gives access to sub-files and sub-directories below. The iterator locks the DirectoryStorage when
+        // created and destroyed, in order to keep the hierarchy loaded meanwhile, so it must not be used with the
+        // storage mutex locked. Creating an iterator does not count as an access to the hierarchy.
 		//
 		class DirIterator
 		{
 			public:
                 DirIterator(const DirIterator& d) ;
                 DirIterator(DirectoryStorage *d,EntryIndex i) ;
+                ~DirIterator() ;
 
 				DirIterator& operator++() ;
                 EntryIndex operator*() const ;
@@ -91,6 +94,7 @@ class DirectoryStorage
                 EntryIndex mParentIndex ;		// index of the parent dir.
                 uint32_t mDirTabIndex ;				// index in the vector of subdirs.
                 InternalFileHierarchyStorage *mStorage ;
+                DirectoryStorage *mDirStorage ;
 
                 friend class DirectoryStorage ;
         };
@@ -99,6 +103,7 @@ class DirectoryStorage
 			public:
                 explicit FileIterator(DirIterator& d);	// crawls all files in specified directory
                 FileIterator(DirectoryStorage *d,EntryIndex e);		// crawls all files in specified directory
+                ~FileIterator() ;
 
 				FileIterator& operator++() ;
                 EntryIndex operator*() const ;	// current file entry
@@ -116,6 +121,7 @@ class DirectoryStorage
                 EntryIndex mParentIndex ;		// index of the parent dir.
                 uint32_t   mFileTabIndex ;		// index in the vector of subdirs.
                 InternalFileHierarchyStorage *mStorage ;
+                DirectoryStorage *mDirStorage ;
         };
 
         struct FileTS
@@ -155,12 +161,31 @@ class DirectoryStorage
 		 */
 		void checkSave() ;
 
+		/*!
+		 * \brief checkUnload
+		 * 			Frees the hierarchy if it is saved and has not been accessed since more than the given delay. It is loaded
+		 * 			again from the file on next access. The root modification time and statistics are kept meanwhile.
+		 */
+		void checkUnload(time_t max_idle_time) ;
+
+		// True when the hierarchy is in memory. Does not count as an access.
+		bool isLoaded() const ;
+
 		const std::string& filename() const { return mFileName ; }
 
     protected:
         bool load(const std::string& local_file_name) ;
 		void save(const std::string& local_file_name) ;
 
+        // Re-loads the hierarchy if it has been unloaded, and records the access time unless the caller only does bookkeeping
+        // (sync time stamps, search by hash). To be called before any access to mFileHierarchy. After a failed reload, the
+        // hierarchy stays empty and the next attempts are delayed.
+        void locked_checkLoaded(bool record_access = true) const ;
+
+        // Used by iterators to keep the hierarchy from being unloaded while they use it. Locks the storage mutex.
+        void pin() const ;
+        void unpin() const ;
+
     private:
 
         // debug
@@ -176,8 +201,17 @@ class DirectoryStorage
         InternalFileHierarchyStorage *mFileHierarchy ;
 
 		time_t mLastSavedTime ;
-		bool mChanged ;
+		mutable bool mChanged ;
 		std::string mFileName;
+
+        mutable bool mLoaded ;
+        mutable uint32_t mPinCount ;			// number of iterators currently using the hierarchy
+        mutable time_t mLastAccessTime ;
+        mutable time_t mLastLoadFailureTime ;	// 0 unless the last reload failed
+        time_t mUnloadedRecursModTime ;		// values of the root dir while the hierarchy is unloaded, used by the periodic cleanup, the sync and the GUI
+        time_t mUnloadedUpdateTime ;
+        SharedDirStats mUnloadedStats ;
+        mutable std::vector<RsFileHash> mUnloadedFileHashes ;	// sorted hashes of the files while the hierarchy is unloaded, for the search by hash
 };
 
 class RemoteDirectoryStorage: public DirectoryStorage
@@ -70,7 +70,7 @@ void LocalDirectoryUpdater::data_tick()
 
     if (mIsEnabled || mForceUpdate)
     {
-        if(now > mDelayBetweenDirectoryUpdates + mLastSweepTime)
+        if(now > delayBetweenSweeps() + mLastSweepTime)
         {
             if(sweepSharedDirectories())
             {
@@ -82,6 +82,8 @@ void LocalDirectoryUpdater::data_tick()
             else
                 std::cerr << "(WW) sweepSharedDirectories() failed. Will do it again in a short time." << std::endl;
         }
+        else if(processDirectoryChanges())
+            mSharedDirectories->notifyTSChanged();
 
         if(now > DELAY_BETWEEN_LOCAL_DIRECTORIES_TS_UPDATE + mLastTSUpdateTime)
         {
@@ -101,6 +103,17 @@ void LocalDirectoryUpdater::data_tick()
 	}
 }
 
+// When all shared directories are watched for changes, the full sweep is only a safety net for changes that the system
+// does not report (e.g. network file systems). It is then done much less often.
+
+uint32_t LocalDirectoryUpdater::delayBetweenSweeps() const
+{
+    if(mDirectoryWatcher.isAvailable() && mDirectoryWatcher.isComplete())
+        return std::max(mDelayBetweenDirectoryUpdates,DELAY_BETWEEN_FULL_DIRECTORY_SWEEPS) ;
+
+    return mDelayBetweenDirectoryUpdates ;
+}
+
 void LocalDirectoryUpdater::forceUpdate()
 {
     mForceUpdate = true ;
@@ -148,19 +161,28 @@ bool LocalDirectoryUpdater::sweepSharedDirectories()
 
     // now for each of them, go recursively and match both files and dirs
 
-    std::set<std::string> existing_dirs ;
+    std::set<std::string>& existing_dirs(mExistingDirectories) ;
+    existing_dirs.clear();
+    mExistingDirectoryPaths.clear();
+
+    mDirectoryWatcher.beginSweep();
 
     for(DirectoryStorage::DirIterator stored_dir_it(mSharedDirectories,mSharedDirectories->root()) ; stored_dir_it;++stored_dir_it)
     {
 #ifdef DEBUG_LOCAL_DIR_UPDATER
         std::cerr << "[directory storage]   recursing into " << stored_dir_it.name() << std::endl;
 #endif
-		existing_dirs.insert(RsDirUtil::removeSymLinks(stored_dir_it.name()));
+		std::string real_path = RsDirUtil::removeSymLinks(stored_dir_it.name()) ;
+
+		existing_dirs.insert(real_path);
+		mExistingDirectoryPaths[stored_dir_it.name()] = real_path ;
 
         recursUpdateSharedDir(stored_dir_it.name(), *stored_dir_it,existing_dirs,1) ;		// here we need to use the list that was stored, instead of the shared dir list, because the two
                                                                             // are not necessarily in the same order.
     }
 
+    mDirectoryWatcher.endSweep();
+
     RsServer::notify()->notifyListChange(NOTIFY_LIST_DIRLIST_LOCAL, 0);
     mIsChecking = false ;
 
@@ -179,6 +201,8 @@ void LocalDirectoryUpdater::recursUpdateSharedDir(const std::string& cumulated_p
 
     librs::util::FolderIterator dirIt(cumulated_path,mFollowSymLinks,false);	// disallow symbolic links and files from the future.
 
+    mDirectoryWatcher.watch(cumulated_path) ;
+
     time_t dir_local_mod_time ;
     if(!mSharedDirectories->getDirectoryLocalModTime(indx,dir_local_mod_time))
     {
@@ -189,6 +213,26 @@ void LocalDirectoryUpdater::recursUpdateSharedDir(const std::string& cumulated_p
     if(mNeedsFullRecheck || dirIt.dir_modtime() > dir_local_mod_time)	// the > is because we may have changed the virtual name, and therefore the TS wont match.
 																		// we only want to detect when the directory has changed on the disk
     {
+        updateSharedDirContent(cumulated_path,indx,dirIt,existing_directories,current_depth) ;
+    }
+#ifdef DEBUG_LOCAL_DIR_UPDATER
+    else
+        std::cerr << "  directory is unchanged. Keeping existing files and subdirs list." << std::endl;
+#endif
+
+    // go through the list of sub-dirs and recursively update
+
+		for(DirectoryStorage::DirIterator stored_dir_it(mSharedDirectories,indx) ; stored_dir_it; ++stored_dir_it)
+		{
+#ifdef DEBUG_LOCAL_DIR_UPDATER
+			std::cerr << "  recursing into " << stored_dir_it.name() << std::endl;
+#endif
+			recursUpdateSharedDir(cumulated_path + "/" + stored_dir_it.name(), *stored_dir_it,existing_directories,current_depth+1) ;
+		}
+}
+
+void LocalDirectoryUpdater::updateSharedDirContent(const std::string& cumulated_path, DirectoryStorage::EntryIndex indx, librs::util::FolderIterator& dirIt, std::set<std::string>& existing_directories, uint32_t current_depth)
+{
        // collect subdirs and subfiles
 
        std::map<std::string,DirectoryStorage::FileTS> subfiles ;
@@ -223,7 +267,10 @@ void LocalDirectoryUpdater::recursUpdateSharedDir(const std::string& cumulated_p
 						   dir_is_accepted = false ;
 					   }
 					   else
+					   {
 						   existing_directories.insert(real_path) ;
+						   mExistingDirectoryPaths[cumulated_path + "/" + dirIt.file_name()] = real_path ;
+					   }
 				   }
 
 				   if(dir_is_accepted)
@@ -262,21 +309,153 @@ void LocalDirectoryUpdater::recursUpdateSharedDir(const std::string& cumulated_p
 		   if(mHashCache->requestHash(cumulated_path + "/" + dit.name(),dit.size(),dit.modtime(),hash,this,*dit))
 			   mSharedDirectories->updateHash(*dit,hash,hash != dit.hash());
 	   }
+}
+
+bool LocalDirectoryUpdater::processDirectoryChanges()
+{
+    std::set<std::string> changed_dirs ;
+
+    if(!mDirectoryWatcher.getChangedDirectories(changed_dirs))
+    {
+        std::cerr << "(WW) Some changes in shared directories were lost. Scheduling a full sweep." << std::endl;
+        mLastSweepTime = 0 ;
     }
-#ifdef DEBUG_LOCAL_DIR_UPDATER
-    else
-        std::cerr << "  directory is unchanged. Keeping existing files and subdirs list." << std::endl;
-#endif
 
-    // go through the list of sub-dirs and recursively update
+    if(changed_dirs.empty() || mHashSalt.isNull())
+        return false ;
 
-		for(DirectoryStorage::DirIterator stored_dir_it(mSharedDirectories,indx) ; stored_dir_it; ++stored_dir_it)
-		{
+    mIsChecking = true ;
+    RsServer::notify()->notifyListPreChange(NOTIFY_LIST_DIRLIST_LOCAL, 0);
+
+    // The set is sorted, so parent directories are updated before their sub-directories. A sub-directory that has been
+    // removed by the update of its parent is not found anymore.
+
+    for(std::set<std::string>::const_iterator it(changed_dirs.begin());it!=changed_dirs.end();++it)
+    {
 #ifdef DEBUG_LOCAL_DIR_UPDATER
-			std::cerr << "  recursing into " << stored_dir_it.name() << std::endl;
+        std::cerr << "[directory storage] directory " << *it << " changed on disk." << std::endl;
 #endif
-			recursUpdateSharedDir(cumulated_path + "/" + stored_dir_it.name(), *stored_dir_it,existing_directories,current_depth+1) ;
-		}
+        std::list<std::pair<DirectoryStorage::EntryIndex,uint32_t> > dirs ;
+        findSharedDirectories(*it,dirs) ;
+
+        for(std::list<std::pair<DirectoryStorage::EntryIndex,uint32_t> >::const_iterator dit(dirs.begin());dit!=dirs.end();++dit)
+            updateChangedDirectory(*it,dit->first,dit->second) ;
+    }
+
+    RsServer::notify()->notifyListChange(NOTIFY_LIST_DIRLIST_LOCAL, 0);
+    mIsChecking = false ;
+
+    return true ;
+}
+
+void LocalDirectoryUpdater::updateChangedDirectory(const std::string& cumulated_path, DirectoryStorage::EntryIndex indx, uint32_t current_depth)
+{
+    // The sub-directories of this directory will be checked again for duplicates, so they should not count as existing.
+    // Their real path is the one that was recorded, since they may not exist anymore.
+
+    std::set<std::string> old_subdirs ;
+
+    for(DirectoryStorage::DirIterator stored_dir_it(mSharedDirectories,indx) ; stored_dir_it; ++stored_dir_it)
+    {
+        old_subdirs.insert(stored_dir_it.name()) ;
+
+        std::map<std::string,std::string>::iterator it = mExistingDirectoryPaths.find(cumulated_path + "/" + stored_dir_it.name()) ;
+
+        if(it != mExistingDirectoryPaths.end())
+        {
+            mExistingDirectories.erase(it->second) ;
+            mExistingDirectoryPaths.erase(it) ;
+        }
+    }
+
+    // The directory is read even if its modification time did not change, since it does not change when a file is written.
+
+    if(!RsDirUtil::checkDirectory(cumulated_path))
+        return ;	// removed. The parent directory is updated as well.
+
+    librs::util::FolderIterator dirIt(cumulated_path,mFollowSymLinks,false);
+
+    updateSharedDirContent(cumulated_path,indx,dirIt,mExistingDirectories,current_depth) ;
+
+    // sub-directories that are not shared anymore take their whole hierarchy with them.
+
+    for(DirectoryStorage::DirIterator stored_dir_it(mSharedDirectories,indx) ; stored_dir_it; ++stored_dir_it)
+        old_subdirs.erase(stored_dir_it.name()) ;
+
+    for(std::set<std::string>::const_iterator it(old_subdirs.begin());it!=old_subdirs.end();++it)
+        removeExistingDirectories(cumulated_path + "/" + *it) ;
+
+    // new sub-directories have never been read. Other sub-directories report their own changes.
+
+    for(DirectoryStorage::DirIterator stored_dir_it(mSharedDirectories,indx) ; stored_dir_it; ++stored_dir_it)
+    {
+        time_t dir_local_mod_time ;
+
+        if(mSharedDirectories->getDirectoryLocalModTime(*stored_dir_it,dir_local_mod_time) && dir_local_mod_time == 0)
+            recursUpdateSharedDir(cumulated_path + "/" + stored_dir_it.name(), *stored_dir_it,mExistingDirectories,current_depth+1) ;
+    }
+}
+
+// Forgets the given directory and all the directories below it, which are not shared anymore, and stops watching them.
+
+void LocalDirectoryUpdater::removeExistingDirectories(const std::string& cumulated_path)
+{
+    std::map<std::string,std::string>::iterator it = mExistingDirectoryPaths.lower_bound(cumulated_path) ;
+
+    while(it != mExistingDirectoryPaths.end() && it->first.compare(0,cumulated_path.length(),cumulated_path) == 0)
+        if(it->first.length() == cumulated_path.length() || it->first[cumulated_path.length()] == '/')
+        {
+            mExistingDirectories.erase(it->second) ;
+            mExistingDirectoryPaths.erase(it++) ;
+        }
+        else
+            ++it ;
+
+    mDirectoryWatcher.unwatchTree(cumulated_path) ;
+}
+
+// Finds the directories of the shared hierarchy that are at the given path on the disk. There can be more than one when
+// shared directories are included in each other.
+
+void LocalDirectoryUpdater::findSharedDirectories(const std::string& path, std::list<std::pair<DirectoryStorage::EntryIndex,uint32_t> >& dirs)
+{
+    for(DirectoryStorage::DirIterator root_it(mSharedDirectories,mSharedDirectories->root()) ; root_it; ++root_it)
+    {
+        const std::string top = root_it.name() ;
+
+        if(path.compare(0,top.length(),top) != 0 || (path.length() > top.length() && path[top.length()] != '/'))
+            continue ;
+
+        DirectoryStorage::EntryIndex indx = *root_it ;
+        uint32_t depth = 1 ;
+        size_t pos = top.length() ;
+        bool found = true ;
+
+        while(found && pos < path.length())
+        {
+            size_t next = path.find('/',pos+1) ;
+
+            if(next == std::string::npos)
+                next = path.length() ;
+
+            std::string name = path.substr(pos+1,next-pos-1) ;
+            found = false ;
+
+            for(DirectoryStorage::DirIterator it(mSharedDirectories,indx) ; it; ++it)
+                if(it.name() == name)
+                {
+                    indx = *it ;
+                    found = true ;
+                    break ;
+                }
+
+            ++depth ;
+            pos = next ;
+        }
+
+        if(found)
+            dirs.push_back(std::make_pair(indx,depth)) ;
+    }
 }
 
 bool LocalDirectoryUpdater::filterFile(const std::string& fname) const
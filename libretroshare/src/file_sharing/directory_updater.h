@@ -31,6 +31,8 @@
 //
 #include "file_sharing/hash_cache.h"
 #include "file_sharing/directory_storage.h"
+#include "file_sharing/directory_watcher.h"
+#include "util/folderiterator.h"
 
 class LocalDirectoryUpdater: public HashStorageClient, public RsTickingThread
 {
@@ -71,8 +73,17 @@ protected:
     virtual bool hash_confirm(uint32_t client_param) ;
 
     void recursUpdateSharedDir(const std::string& cumulated_path, DirectoryStorage::EntryIndex indx, std::set<std::string>& existing_directories, uint32_t current_depth);
+    void updateSharedDirContent(const std::string& cumulated_path, DirectoryStorage::EntryIndex indx, librs::util::FolderIterator& dirIt, std::set<std::string>& existing_directories, uint32_t current_depth);
     bool sweepSharedDirectories();
 
+    // incremental update of the directories reported by the directory watcher.
+
+    bool processDirectoryChanges();
+    void updateChangedDirectory(const std::string& cumulated_path, DirectoryStorage::EntryIndex indx, uint32_t current_depth);
+    void findSharedDirectories(const std::string& path, std::list<std::pair<DirectoryStorage::EntryIndex,uint32_t> >& dirs);
+    void removeExistingDirectories(const std::string& cumulated_path);
+    uint32_t delayBetweenSweeps() const ;
+
 private:
 	bool filterFile(const std::string& fname) const ;	// reponds true if the file passes the ignore lists test.
 
@@ -81,6 +92,10 @@ private:
 
     RsFileHash mHashSalt ;
 
+    DirectoryWatcher mDirectoryWatcher ;
+    std::set<std::string> mExistingDirectories ;	// real path of all shared directories, used to detect duplicates
+    std::map<std::string,std::string> mExistingDirectoryPaths ;	// path in the shared hierarchy => real path, for the entries of mExistingDirectories
+
     time_t mLastSweepTime;
     time_t mLastTSUpdateTime;
 
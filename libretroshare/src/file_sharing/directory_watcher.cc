@@ -0,0 +1,210 @@
+/*
+ * RetroShare Directory change journal.
+ *
+ *      file_sharing/directory_watcher.cc
+ *
+ * Copyright 2016 Mr.Alice
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+#include <iostream>
+#include <list>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+#include "directory_watcher.h"
+
+//#define DEBUG_DIRECTORY_WATCHER 1
+
+#ifdef __linux__
+
+// Files being created are only reported once closed, in order to avoid re-reading the directory while the file is
+// still being written. Directories are reported as soon as they are created.
+
+static const uint32_t WATCH_MASK = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_ONLYDIR ;
+
+DirectoryWatcher::DirectoryWatcher()
+    : mComplete(false)
+{
+    mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC) ;
+
+    if(mFd < 0)
+        std::cerr << "(WW) Cannot initialise inotify: " << strerror(errno) << ". Shared directories will be checked by periodic sweeps only." << std::endl;
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    if(mFd >= 0)
+        close(mFd) ;
+}
+
+bool DirectoryWatcher::isAvailable() const
+{
+    return mFd >= 0 ;
+}
+
+void DirectoryWatcher::beginSweep()
+{
+    mComplete = true ;
+    mSweptDirs.clear() ;
+}
+
+void DirectoryWatcher::endSweep()
+{
+    std::list<int> unswept ;
+
+    for(std::map<int,std::string>::const_iterator it(mWatchedDirs.begin());it!=mWatchedDirs.end();++it)
+        if(mSweptDirs.find(it->first) == mSweptDirs.end())
+            unswept.push_back(it->first) ;
+
+    for(std::list<int>::const_iterator it(unswept.begin());it!=unswept.end();++it)
+        unwatch(*it) ;
+
+    mSweptDirs.clear() ;
+}
+
+void DirectoryWatcher::watch(const std::string& path)
+{
+    if(mFd < 0)
+        return ;
+
+    int wd = inotify_add_watch(mFd, path.c_str(), WATCH_MASK) ;
+
+    if(wd < 0)
+    {
+        if(mComplete)
+            std::cerr << "(WW) Cannot watch directory \"" << path << "\": " << strerror(errno) << ". Some changes will only be seen by periodic sweeps." << std::endl;
+
+        mComplete = false ;
+        return ;
+    }
+
+    // the same directory can be watched again under a new name, when it has been renamed
+
+    std::map<int,std::string>::const_iterator it = mWatchedDirs.find(wd) ;
+
+    if(it != mWatchedDirs.end() && it->second != path)
+        forgetWatch(wd) ;
+
+    mWatchedDirs[wd] = path ;
+    mWatchDescriptors[path] = wd ;
+    mSweptDirs.insert(wd) ;
+}
+
+void DirectoryWatcher::unwatchTree(const std::string& path)
+{
+    std::list<int> wds ;
+
+    for(std::map<std::string,int>::const_iterator it(mWatchDescriptors.lower_bound(path));it!=mWatchDescriptors.end() && it->first.compare(0,path.length(),path) == 0;++it)
+        if(it->first.length() == path.length() || it->first[path.length()] == '/')
+            wds.push_back(it->second) ;
+
+    for(std::list<int>::const_iterator it(wds.begin());it!=wds.end();++it)
+        unwatch(*it) ;
+}
+
+void DirectoryWatcher::unwatch(int wd)
+{
+#ifdef DEBUG_DIRECTORY_WATCHER
+    std::cerr << "[directory watcher] not watching " << mWatchedDirs[wd] << " anymore." << std::endl;
+#endif
+    inotify_rm_watch(mFd, wd) ;	// the IN_IGNORED event that follows is for an unknown descriptor then.
+    forgetWatch(wd) ;
+}
+
+void DirectoryWatcher::forgetWatch(int wd)
+{
+    std::map<int,std::string>::iterator it = mWatchedDirs.find(wd) ;
+
+    if(it == mWatchedDirs.end())
+        return ;
+
+    std::map<std::string,int>::iterator pit = mWatchDescriptors.find(it->second) ;
+
+    if(pit != mWatchDescriptors.end() && pit->second == wd)	// the path may have been given to a new directory since
+        mWatchDescriptors.erase(pit) ;
+
+    mSweptDirs.erase(wd) ;
+    mWatchedDirs.erase(it) ;
+}
+
+bool DirectoryWatcher::getChangedDirectories(std::set<std::string>& dirs)
+{
+    if(mFd < 0)
+        return true ;
+
+    bool overflow = false ;
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event)))) ;
+
+    for(;;)
+    {
+        ssize_t len = read(mFd, buf, sizeof(buf)) ;
+
+        if(len <= 0)	// EAGAIN: no more events
+            break ;
+
+        for(char *ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ((struct inotify_event*)ptr)->len)
+        {
+            const struct inotify_event *ev = (const struct inotify_event*)ptr ;
+
+            if(ev->mask & IN_Q_OVERFLOW)
+            {
+                overflow = true ;
+                continue ;
+            }
+            if(ev->mask & IN_IGNORED)	// directory removed, or not watched anymore
+            {
+                forgetWatch(ev->wd) ;
+                continue ;
+            }
+            if((ev->mask & IN_CREATE) && !(ev->mask & IN_ISDIR))
+                continue ;
+
+            std::map<int,std::string>::const_iterator it = mWatchedDirs.find(ev->wd) ;
+
+            if(it == mWatchedDirs.end())
+                continue ;
+
+#ifdef DEBUG_DIRECTORY_WATCHER
+            std::cerr << "[directory watcher] event " << std::hex << ev->mask << std::dec << " in " << it->second << " for \"" << (ev->len ? ev->name : "") << "\"" << std::endl;
+#endif
+            dirs.insert(it->second) ;
+        }
+    }
+
+    return !overflow ;
+}
+
+#else
+
+DirectoryWatcher::DirectoryWatcher() : mFd(-1), mComplete(false) {}
+DirectoryWatcher::~DirectoryWatcher() {}
+
+bool DirectoryWatcher::isAvailable() const { return false ; }
+void DirectoryWatcher::beginSweep() { mComplete = true ; }
+void DirectoryWatcher::endSweep() {}
+void DirectoryWatcher::watch(const std::string& /*path*/) {}
+void DirectoryWatcher::unwatchTree(const std::string& /*path*/) {}
+bool DirectoryWatcher::getChangedDirectories(std::set<std::string>& /*dirs*/) { return true ; }
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * RetroShare C++ Directory change journal.
+ *
+ *      file_sharing/directory_watcher.h
+ *
+ * Copyright 2016 by Mr.Alice
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+
+// This class records which directories have changed on the disk (files added, removed, renamed or written to), so that
+// the directory updater only needs to re-read these directories instead of the whole shared hierarchy.
+// It relies on inotify, and is therefore only available on Linux. Everywhere else, isAvailable() returns false and the
+// updater keeps sweeping the entire hierarchy.
+//
+// The journal is not thread safe. It is meant to be used by the directory updater thread only.
+
+class DirectoryWatcher
+{
+public:
+    DirectoryWatcher() ;
+    ~DirectoryWatcher() ;
+
+    bool isAvailable() const ;
+
+    // Returns true when all directories passed to watch() since the last call to beginSweep() are actually watched. This
+    // is not the case when the system limit of watches is reached. Changes might be missed then.
+
+    bool isComplete() const { return mComplete ; }
+
+    void beginSweep() ;
+
+    // Stops watching the directories that were not passed to watch() since the last call to beginSweep(), because they
+    // are not shared anymore.
+
+    void endSweep() ;
+
+    // Starts watching the given directory (not its sub-directories). Watching it again only updates its path.
+
+    void watch(const std::string& path) ;
+
+    // Stops watching the given directory and all the directories below it.
+
+    void unwatchTree(const std::string& path) ;
+
+    /*!
+     * \brief getChangedDirectories
+     * 			Gets the directories that changed since the last call, without blocking.
+     *
+     * \param dirs	 Full paths of the changed directories, as supplied to watch().
+     * \return false if some changes were lost (kernel queue overflow). A full sweep is needed in this case.
+     */
+    bool getChangedDirectories(std::set<std::string>& dirs) ;
+
+private:
+    void unwatch(int wd) ;
+    void forgetWatch(int wd) ;
+
+    int mFd ;
+    bool mComplete ;
+
+    std::map<int,std::string> mWatchedDirs ;	// watch descriptor => path
+    std::map<std::string,int> mWatchDescriptors ;	// path => watch descriptor, sorted so that sub-directories follow their parent
+    std::set<int> mSweptDirs ;	// watch descriptors passed to watch() since the last call to beginSweep()
+};
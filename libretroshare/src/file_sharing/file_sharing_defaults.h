@@ -27,6 +27,7 @@
 #pragma once
 
 static const uint32_t DELAY_BETWEEN_DIRECTORY_UPDATES           = 600 ; // 10 minutes
+static const uint32_t DELAY_BETWEEN_FULL_DIRECTORY_SWEEPS       = 3600 ; // 1 hour. Used when directory changes are reported by the system.
 static const uint32_t DELAY_BETWEEN_REMOTE_DIRECTORY_SYNC_REQ   = 120 ; // 2 minutes
 static const uint32_t DELAY_BETWEEN_LOCAL_DIRECTORIES_TS_UPDATE =  20 ; // 20 sec. But we only update for real if something has changed.
 static const uint32_t DELAY_BETWEEN_REMOTE_DIRECTORIES_SWEEP    =  60 ; // 60 sec.
@@ -44,6 +45,8 @@ static const std::string IGNORED_PREFIXES_SS    = "IGNORED_PREFIXES"; 	 	 // ign
 static const std::string IGNORED_SUFFIXES_SS    = "IGNORED_SUFFIXES"; 	 	 // ignore file suffixes
 static const std::string IGNORE_LIST_FLAGS_SS   = "IGNORED_FLAGS"; 	 	 	 // ignore file flags
 static const std::string MAX_SHARE_DEPTH        = "MAX_SHARE_DEPTH"; 	 	 // maximum depth of shared directories
+static const std::string HASH_THREADS_SS        = "HASH_THREADS"; 	 	 	 // maximum number of files hashed in parallel (on different disks)
+static const std::string HASH_USE_MMAP_SS       = "HASH_USE_MMAP"; 	 	 	 // map files in memory for hashing instead of reading them
 
 static const std::string FILE_SHARING_DIR_NAME       = "file_sharing" ;			 // hard-coded directory name to store friend file lists, hash cache, etc.
 static const std::string HASH_CACHE_FILE_NAME        = "hash_cache.bin" ;		 // hard-coded directory name to store encrypted hash cache.
@@ -51,9 +54,12 @@ static const std::string LOCAL_SHARED_DIRS_FILE_NAME = "local_dir_hierarchy.bin"
 
 static const uint32_t MIN_INTERVAL_BETWEEN_HASH_CACHE_SAVE         = 20 ;    // never save hash cache more often than every 20 secs.
 static const uint32_t MIN_INTERVAL_BETWEEN_REMOTE_DIRECTORY_SAVE   = 23 ;    // never save remote directories more often than this
+static const uint32_t DELAY_BEFORE_UNLOAD_REMOTE_DIRECTORY         = 600 ;   // free the memory of friend file lists that have not been accessed since 10 minutes
+static const uint32_t DELAY_BEFORE_RELOAD_RETRY_REMOTE_DIRECTORY   = 300 ;   // do not try to read again a friend file list that could not be loaded before 5 minutes
 
 static const uint32_t MAX_DIR_SYNC_RESPONSE_DATA_SIZE              = 20000 ; // Maximum RsItem data size in bytes for serialised directory transmission
 static const uint32_t DEFAULT_HASH_STORAGE_DURATION_DAYS           = 30 ;    // remember deleted/inaccessible files for 30 days
+static const uint32_t DEFAULT_HASHING_THREADS                      = 4 ;     // hash files of up to 4 disks in parallel
 
 static const uint32_t NB_FRIEND_INDEX_BITS_32BITS                    = 10 ;			// Do not change this!
 static const uint32_t NB_ENTRY_INDEX_BITS_32BITS                     = 22 ;			// Do not change this!
@@ -36,6 +36,7 @@
 // WARNING: the encoding is system-dependent, so this should *not* be used to exchange data between computers.
 
 static const uint32_t FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001 =  0x00000001 ;
+static const uint32_t FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0002 =  0x00000002 ;	// compact format: columns and string table
 static const uint32_t FILE_LIST_IO_LOCAL_DIRECTORY_TREE_VERSION_0001    =  0x00010001 ;
 
 static const uint8_t FILE_LIST_IO_TAG_UNKNOWN                   =  0x00 ;
@@ -31,10 +31,54 @@
 #include "filelist_io.h"
 #include "file_sharing_defaults.h"
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
 //#define HASHSTORAGE_DEBUG 1
 
 static const uint32_t DEFAULT_INACTIVITY_SLEEP_TIME = 50*1000;
 static const uint32_t     MAX_INACTIVITY_SLEEP_TIME = 2*1000*1000;
+static const uint32_t        WORKER_IDLE_SLEEP_TIME = 50*1000;
+static const double      HASHING_SPEED_TIME_WINDOW = 3.0 ;	// seconds of work over which the speed of a worker is averaged
+
+/*!
+ * \brief The HashStorageWorker class
+ * 		One thread of the hashing pool. All the work is done in HashStorage::workerTick().
+ */
+class HashStorageWorker: public RsTickingThread
+{
+public:
+    HashStorageWorker(HashStorage *storage,uint32_t id) : mStorage(storage), mId(id), mWindowTime(0), mWindowBytes(0) {}
+
+    virtual void data_tick() { mStorage->workerTick(this) ; }
+
+    HashStorage *mStorage ;
+    uint32_t mId ;
+
+    // hashing time and bytes since the last speed update. Only used by this thread.
+
+    double mWindowTime ;
+    uint64_t mWindowBytes ;
+};
+
+// Identifies the disk a file is on, so that a single disk is not read by multiple threads at once.
+
+static uint64_t fileDevice(const std::string& path)
+{
+#ifdef WINDOWS_SYS
+    if(path.length() > 1 && path[1] == ':')
+        return toupper(path[0]) ;	// drive letter
+
+    return 0 ;
+#else
+    struct stat buf ;
+
+    if(stat(path.c_str(),&buf) == 0)
+        return buf.st_dev ;
+
+    return 0 ;
+#endif
+}
 
 HashStorage::HashStorage(const std::string& save_file_name)
     : mFilePath(save_file_name), mHashMtx("Hash Storage mutex")
@@ -47,8 +91,8 @@ HashStorage::HashStorage(const std::string& save_file_name)
 	mCurrentHashingSpeed = 0 ;
     mMaxStorageDurationDays = DEFAULT_HASH_STORAGE_DURATION_DAYS ;
 	mHashingProcessPaused = false;
-	mHashedBytes = 0 ;
-	mHashingTime = 0 ;
+    mNbHashingThreads = DEFAULT_HASHING_THREADS ;
+    mUseMmap = false ;
 
     {
         RS_STACK_MUTEX(mHashMtx) ;
@@ -58,6 +102,14 @@ HashStorage::HashStorage(const std::string& save_file_name)
     }
 }
 
+HashStorage::~HashStorage()
+{
+    stopWorkers() ;
+
+    for(uint32_t i=0;i<mWorkers.size();++i)
+        delete mWorkers[i] ;
+}
+
 void HashStorage::togglePauseHashingProcess()
 {
 	RS_STACK_MUTEX(mHashMtx) ;
@@ -69,6 +121,42 @@ bool HashStorage::hashingProcessPaused()
 	return mHashingProcessPaused;
 }
 
+void HashStorage::setHashingThreads(uint32_t n)
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+	mNbHashingThreads = std::max(1u,n) ;
+}
+uint32_t HashStorage::hashingThreads()
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+	return mNbHashingThreads ;
+}
+void HashStorage::setHashingUseMmap(bool b)
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+	mUseMmap = b ;
+}
+bool HashStorage::hashingUseMmap()
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+	return mUseMmap ;
+}
+
+void HashStorage::getWorkerStats(std::vector<HashStorageWorkerStats>& stats)
+{
+	RS_STACK_MUTEX(mHashMtx) ;
+
+	stats.clear() ;
+	for(std::map<uint32_t,HashStorageWorkerStats>::const_iterator it(mWorkerStats.begin());it!=mWorkerStats.end();++it)
+		stats.push_back(it->second) ;
+}
+
+void HashStorage::stopHashing()
+{
+    RsTickingThread::fullstop() ;	// first, so that no worker gets started anymore
+    stopWorkers() ;
+}
+
 static std::string friendlyUnit(uint64_t val)
 {
     const std::string units[5] = {"B","KB","MB","GB","TB"};
@@ -91,143 +179,263 @@ static std::string friendlyUnit(uint64_t val)
 
 void HashStorage::data_tick()
 {
-    FileHashJob job;
-    RsFileHash hash;
-    uint64_t size = 0;
+    bool empty ;
+    bool paused ;
+    uint32_t st ;
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
 
+        if(mChanged && mLastSaveTime + MIN_INTERVAL_BETWEEN_HASH_CACHE_SAVE < time(NULL))
+        {
+            locked_save();
+            mLastSaveTime = time(NULL) ;
+            mChanged = false ;
+        }
 
+        empty = mFilesToHash.empty() && mBusyDevices.empty();
+        paused = mHashingProcessPaused ;
+        st = mInactivitySleepTime ;
+    }
+
+    // sleep off mutex!
+    if(empty)
     {
-        bool empty ;
-        uint32_t st ;
+#ifdef HASHSTORAGE_DEBUG
+        std::cerr << "nothing to hash. Sleeping for " << st << " us" << std::endl;
+#endif
+
+        usleep(st);	// when no files to hash, just wait for 2 secs. This avoids a dramatic loop.
 
+        if(st > MAX_INACTIVITY_SLEEP_TIME)
         {
+            stopWorkers() ;
+
             RS_STACK_MUTEX(mHashMtx) ;
 
-            if(mChanged && mLastSaveTime + MIN_INTERVAL_BETWEEN_HASH_CACHE_SAVE < time(NULL))
+            mInactivitySleepTime = MAX_INACTIVITY_SLEEP_TIME;
+
+            if(!mChanged && mFilesToHash.empty())	// otherwise it might prevent from saving the hash cache
             {
-                locked_save();
-                mLastSaveTime = time(NULL) ;
-                mChanged = false ;
+                std::cerr << "Stopping hashing thread." << std::endl;
+                shutdown();
+                mRunning = false ;
+                mTotalSizeToHash = 0;
+                mTotalFilesToHash = 0;
+                std::cerr << "done." << std::endl;
             }
-        }
 
+            RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_FINISH, "") ;
+        }
+        else
         {
             RS_STACK_MUTEX(mHashMtx) ;
-
-            empty = mFilesToHash.empty();
-            st = mInactivitySleepTime ;
+            mInactivitySleepTime = 2*st ;
         }
 
-        // sleep off mutex!
-        if(empty)
-        {
-#ifdef HASHSTORAGE_DEBUG
-            std::cerr << "nothing to hash. Sleeping for " << st << " us" << std::endl;
-#endif
+        return ;
+    }
 
-            usleep(st);	// when no files to hash, just wait for 2 secs. This avoids a dramatic loop.
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+        mInactivitySleepTime = DEFAULT_INACTIVITY_SLEEP_TIME;
+    }
 
-            if(st > MAX_INACTIVITY_SLEEP_TIME)
-            {
-                RS_STACK_MUTEX(mHashMtx) ;
+    if(paused)	// we need to wait off mutex!!
+    {
+        usleep(MAX_INACTIVITY_SLEEP_TIME) ;
+        std::cerr << "Hashing process currently paused." << std::endl;
+        return;
+    }
 
-                mInactivitySleepTime = MAX_INACTIVITY_SLEEP_TIME;
+    // The actual hashing is done by the workers. We only make sure they are running.
 
-                if(!mChanged)	// otherwise it might prevent from saving the hash cache
-                {
-                    std::cerr << "Stopping hashing thread." << std::endl;
-                    shutdown();
-                    mRunning = false ;
-                    mTotalSizeToHash = 0;
-                    mTotalFilesToHash = 0;
-                    std::cerr << "done." << std::endl;
-                }
+    updateWorkers() ;
+    usleep(DEFAULT_INACTIVITY_SLEEP_TIME) ;
+}
 
-                RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_FINISH, "") ;
-            }
-            else
-            {
-                RS_STACK_MUTEX(mHashMtx) ;
-                mInactivitySleepTime = 2*st ;
-            }
+void HashStorage::updateWorkers()
+{
+    uint32_t n ;
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+        n = mNbHashingThreads ;
+    }
 
-            return ;
-        }
-        mInactivitySleepTime = DEFAULT_INACTIVITY_SLEEP_TIME;
+    while(mWorkers.size() > n)
+    {
+        HashStorageWorker *w = mWorkers.back() ;
+        mWorkers.pop_back() ;
+
+        w->fullstop() ;	// the file it was hashing, if any, is put back in the queue.
 
-		bool paused = false ;
         {
             RS_STACK_MUTEX(mHashMtx) ;
-			paused = mHashingProcessPaused ;
-		}
-
-		if(paused)	// we need to wait off mutex!!
-		{
-			usleep(MAX_INACTIVITY_SLEEP_TIME) ;
-			std::cerr << "Hashing process currently paused." << std::endl;
-			return;
-		}
-		else
+            mWorkerStats.erase(w->mId) ;
+        }
+        delete w ;
+    }
+
+    while(mWorkers.size() < n)
+    {
+        HashStorageWorker *w = new HashStorageWorker(this,mWorkers.size()) ;
+        mWorkers.push_back(w) ;
+
+        RS_STACK_MUTEX(mHashMtx) ;
+        mWorkerStats[w->mId].worker_id = w->mId ;
+    }
+
+    for(uint32_t i=0;i<mWorkers.size();++i)
+        if(!mWorkers[i]->isRunning())
+            mWorkers[i]->start("fs hash worker") ;
+}
+
+void HashStorage::stopWorkers()
+{
+    // ask all of them first, so that they stop in parallel
+
+    for(uint32_t i=0;i<mWorkers.size();++i)
+        mWorkers[i]->shutdown() ;
+
+    for(uint32_t i=0;i<mWorkers.size();++i)
+        mWorkers[i]->fullstop() ;
+}
+
+bool HashStorage::locked_getNextJob(FileHashJob& job)
+{
+    // take the first file of a disk that nobody is reading
+
+    for(std::map<uint64_t,std::map<std::string,FileHashJob> >::iterator it(mFilesToHash.begin());it!=mFilesToHash.end();++it)
+        if(mBusyDevices.find(it->first) == mBusyDevices.end())
         {
-            RS_STACK_MUTEX(mHashMtx) ;
+            job = it->second.begin()->second ;
+            it->second.erase(it->second.begin()) ;
+
+            if(it->second.empty())
+                mFilesToHash.erase(it) ;
 
-            job = mFilesToHash.begin()->second ;
-            mFilesToHash.erase(mFilesToHash.begin()) ;
+            mBusyDevices.insert(job.device) ;
+            return true ;
         }
 
-        if(job.client->hash_confirm(job.client_param))
-        {
+    return false ;
+}
+
+void HashStorage::workerTick(HashStorageWorker *worker)
+{
+    FileHashJob job;
+    RsFileHash hash;
+    uint64_t size = 0;
+    bool found ;
+    bool interrupted = false ;
+    bool use_mmap ;
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        found = !mHashingProcessPaused && locked_getNextJob(job) ;
+        use_mmap = mUseMmap ;
+
+        if(found)
+            mWorkerStats[worker->mId].current_file = job.full_path ;
+    }
+
+    if(!found)
+    {
+        usleep(WORKER_IDLE_SLEEP_TIME) ;
+        return ;
+    }
+
+    if(job.client->hash_confirm(job.client_param))
+    {
 #ifdef HASHSTORAGE_DEBUG
-            std::cerr << "Hashing file " << job.full_path << "..." ; std::cerr.flush();
+        std::cerr << "Hashing file " << job.full_path << "..." ; std::cerr.flush();
 #endif
 
-            std::string tmpout;
+        std::string tmpout;
+
+        {
+            RS_STACK_MUTEX(mHashMtx) ;
 
-			if(mCurrentHashingSpeed > 0)
-				rs_sprintf(tmpout, "%lu/%lu (%s - %d%%, %d MB/s) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), mCurrentHashingSpeed,job.full_path.c_str()) ;
-			else
-				rs_sprintf(tmpout, "%lu/%lu (%s - %d%%) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), job.full_path.c_str()) ;
+            if(mCurrentHashingSpeed > 0)
+                rs_sprintf(tmpout, "%lu/%lu (%s - %d%%, %d MB/s) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), mCurrentHashingSpeed,job.full_path.c_str()) ;
+            else
+                rs_sprintf(tmpout, "%lu/%lu (%s - %d%%) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), job.full_path.c_str()) ;
+        }
 
-            RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_HASH_FILE, tmpout) ;
+        RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_HASH_FILE, tmpout) ;
 
-			double seconds_origin = RsScopeTimer::currentTime() ;
+        double seconds_origin = RsScopeTimer::currentTime() ;
 
-			if(RsDirUtil::getFileHash(job.full_path, hash,size, this))
-			{
-				// store the result
+        if(RsDirUtil::getFileHash(job.full_path, hash,size, worker, use_mmap))
+        {
+            // store the result
 
 #ifdef HASHSTORAGE_DEBUG
-				std::cerr << "done."<< std::endl;
+            std::cerr << "done."<< std::endl;
 #endif
 
-				RS_STACK_MUTEX(mHashMtx) ;
-				HashStorageInfo& info(mFiles[job.real_path]);
+            RS_STACK_MUTEX(mHashMtx) ;
+            HashStorageInfo& info(mFiles[job.real_path]);
 
-				info.filename = job.real_path ;
-				info.size = size ;
-				info.modf_stamp = job.ts ;
-				info.time_stamp = time(NULL);
-				info.hash = hash;
+            info.filename = job.real_path ;
+            info.size = size ;
+            info.modf_stamp = job.ts ;
+            info.time_stamp = time(NULL);
+            info.hash = hash;
 
-				mChanged = true ;
-				mTotalHashedSize += size ;
-			}
-			else
-				std::cerr << "ERROR: cannot hash file " << job.full_path << std::endl;
+            mChanged = true ;
+            mTotalHashedSize += size ;
+        }
+        else if(worker->shouldStop())
+        {
+            // interrupted. Hash it again later, unless it has been requested again in the meantime.
 
-			mHashingTime += RsScopeTimer::currentTime() - seconds_origin ;
-			mHashedBytes += size ;
+            RS_STACK_MUTEX(mHashMtx) ;
+            std::map<std::string,FileHashJob>& jobs(mFilesToHash[job.device]) ;
 
-			if(mHashingTime > 3)
-			{
-				mCurrentHashingSpeed = (int)(mHashedBytes / mHashingTime ) / (1024*1024) ;
-				mHashingTime = 0 ;
-				mHashedBytes = 0 ;
-			}
+            if(jobs.find(job.real_path) == jobs.end())
+                jobs[job.real_path] = job ;
 
-            ++mHashCounter ;
+            interrupted = true ;
+            size = 0 ;
         }
+        else
+            std::cerr << "ERROR: cannot hash file " << job.full_path << std::endl;
+
+        worker->mWindowTime += RsScopeTimer::currentTime() - seconds_origin ;
+        worker->mWindowBytes += size ;
+
+        RS_STACK_MUTEX(mHashMtx) ;
+        HashStorageWorkerStats& wstats(mWorkerStats[worker->mId]) ;
+
+        wstats.hashed_bytes += size ;
+
+        if(!hash.isNull())
+            ++wstats.hashed_files ;
+
+        if(worker->mWindowTime > HASHING_SPEED_TIME_WINDOW)
+        {
+            wstats.speed = (uint32_t)(worker->mWindowBytes / worker->mWindowTime / (1024*1024)) ;
+            worker->mWindowTime = 0 ;
+            worker->mWindowBytes = 0 ;
+
+            mCurrentHashingSpeed = 0 ;
+            for(std::map<uint32_t,HashStorageWorkerStats>::const_iterator it(mWorkerStats.begin());it!=mWorkerStats.end();++it)
+                mCurrentHashingSpeed += it->second.speed ;
+        }
+
+        if(!interrupted)
+            ++mHashCounter ;
     }
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        mBusyDevices.erase(job.device) ;
+        mWorkerStats[worker->mId].current_file.clear() ;
+    }
+
     // call the client
 
     if(!hash.isNull())
@@ -283,7 +491,10 @@ bool HashStorage::requestHash(const std::string& full_path,uint64_t size,time_t
 
     // we need to schedule a re-hashing
 
-    if(mFilesToHash.find(real_path) != mFilesToHash.end())
+    uint64_t device = fileDevice(real_path) ;
+    std::map<uint64_t,std::map<std::string,FileHashJob> >::const_iterator dit = mFilesToHash.find(device) ;
+
+    if(dit != mFilesToHash.end() && dit->second.find(real_path) != dit->second.end())
         return false ;
 
     FileHashJob job ;
@@ -294,11 +505,12 @@ bool HashStorage::requestHash(const std::string& full_path,uint64_t size,time_t
     job.full_path = full_path ;
     job.real_path = real_path ;
     job.ts = mod_time ;
+    job.device = device ;
 
 	// We store the files indexed by their real path, so that we allow to not re-hash files that are pointed multiple times through the directory links
 	// The client will be notified with the full path instead of the real path.
 
-    mFilesToHash[real_path] = job;
+    mFilesToHash[device][real_path] = job;
 
     mTotalSizeToHash += size ;
     ++mTotalFilesToHash;
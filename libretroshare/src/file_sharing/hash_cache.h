@@ -27,6 +27,8 @@
 #pragma once
 
 #include <map>
+#include <set>
+#include <vector>
 #include "util/rsthreads.h"
 #include "retroshare/rsfiles.h"
 
@@ -51,10 +53,19 @@ public:
     virtual bool hash_confirm(uint32_t client_param)=0 ;
 };
 
+class HashStorageWorker ;
+
+/*!
+ * \brief The HashStorage class
+ * 		Keeps the hashes of local files, and computes the missing ones. The HashStorage thread saves the cache and
+ * 		manages a pool of worker threads that do the actual hashing. Each worker takes files from a different disk, so
+ * 		that several disks are read in parallel while a single disk is never read by two threads at once.
+ */
 class HashStorage: public RsTickingThread
 {
 public:
     explicit HashStorage(const std::string& save_file_name) ;
+    virtual ~HashStorage() ;
 
     /*!
      * \brief requestHash  Requests the hash for the given file, assuming size and mod_time are the same.
@@ -87,6 +98,17 @@ public:
 	void togglePauseHashingProcess() ;
 	bool hashingProcessPaused();
 
+    void setHashingThreads(uint32_t n) ;		// maximum number of files hashed at the same time. Only files on different disks are hashed concurrently.
+    uint32_t hashingThreads() ;
+    void setHashingUseMmap(bool b) ;			// map files in memory rather than reading them. See RsDirUtil::getFileHash()
+    bool hashingUseMmap() ;
+
+    void getWorkerStats(std::vector<HashStorageWorkerStats>& stats) ;		// throughput of each hashing thread
+
+    // Stops the HashStorage thread and the worker threads.
+
+    void stopHashing() ;
+
     // Functions called by the thread
 
     virtual void data_tick() ;
@@ -105,6 +127,14 @@ private:
     bool locked_load() ;
     bool try_load_import_old_hash_cache();
 
+    // worker pool
+
+    friend class HashStorageWorker ;
+
+    void workerTick(HashStorageWorker *worker) ;	// hashes one file, called by the workers
+    void updateWorkers() ;						// starts/stops workers to match the requested number. Called off mutex!
+    void stopWorkers() ;
+
     bool readHashStorageInfo(const unsigned char *data,uint32_t total_size,uint32_t& offset,HashStorageInfo& info) const;
     bool writeHashStorageInfo(unsigned char *& data,uint32_t&  total_size,uint32_t& offset,const HashStorageInfo& info) const;
 
@@ -124,11 +154,20 @@ private:
         HashStorageClient *client;
         uint32_t client_param ;
         time_t ts;
+        uint64_t device ;			// disk the file is on
     };
 
-    // current work
+    bool locked_getNextJob(FileHashJob& job) ;
+
+    // current work, sorted by disk
+
+    std::map<uint64_t, std::map<std::string,FileHashJob> > mFilesToHash ;
+    std::set<uint64_t> mBusyDevices ;	// disks currently being read by a worker
 
-    std::map<std::string,FileHashJob> mFilesToHash ;
+    std::vector<HashStorageWorker*> mWorkers ;	// only accessed by the HashStorage thread, and when stopping it
+    std::map<uint32_t,HashStorageWorkerStats> mWorkerStats ;
+    uint32_t mNbHashingThreads ;
+    bool mUseMmap ;
 
     // thread/mutex stuff
 
@@ -143,8 +182,6 @@ private:
 
 	// The following is used to estimate hashing speed.
 
-	double mHashingTime ;
-	uint64_t mHashedBytes ;
-	uint32_t mCurrentHashingSpeed ; // in MB/s
+	uint32_t mCurrentHashingSpeed ; // in MB/s, sum of the speeds of all workers
 };
 
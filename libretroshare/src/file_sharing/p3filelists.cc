@@ -231,6 +231,7 @@ int p3FileDatabase::tick()
                }
 
                mRemoteDirectories[i]->checkSave() ;
+               mRemoteDirectories[i]->checkUnload(DELAY_BEFORE_UNLOAD_REMOTE_DIRECTORY) ;
             }
 
         mLastRemoteDirSweepTS = now;
@@ -264,7 +265,7 @@ void p3FileDatabase::stopThreads()
 #ifdef DEBUG_P3FILELISTS
     P3FILELISTS_DEBUG() << "Stopping hash cache thread..." ; std::cerr.flush() ;
 #endif
-    mHashCache->fullstop();
+    mHashCache->stopHashing();
 #ifdef DEBUG_P3FILELISTS
     P3FILELISTS_DEBUG() << "Done." << std::endl;
     P3FILELISTS_DEBUG() << "Stopping directory watcher thread..." ; std::cerr.flush() ;
@@ -322,6 +323,23 @@ cleanup = true;
 
         rskv->tlvkvs.pairs.push_back(kv);
     }
+    {
+        RS_STACK_MUTEX(mFLSMtx) ;
+        std::string s ;
+        rs_sprintf(s, "%lu", mHashCache->hashingThreads()) ;
+
+        RsTlvKeyValue kv;
+
+        kv.key = HASH_THREADS_SS;
+        kv.value = s ;
+
+        rskv->tlvkvs.pairs.push_back(kv);
+
+        kv.key = HASH_USE_MMAP_SS;
+        kv.value = mHashCache->hashingUseMmap()?"YES":"NO" ;
+
+        rskv->tlvkvs.pairs.push_back(kv);
+    }
 
     {
         std::string s ;
@@ -447,6 +465,16 @@ bool p3FileDatabase::loadList(std::list<RsItem *>& load)
                 if(sscanf(kit->value.c_str(),"%u",&t) == 1)
                     mHashCache->setRememberHashFilesDuration(t);
             }
+            else if(kit->key == HASH_THREADS_SS)
+            {
+                uint32_t t=0 ;
+                if(sscanf(kit->value.c_str(),"%u",&t) == 1)
+                    mHashCache->setHashingThreads(t);
+            }
+            else if(kit->key == HASH_USE_MMAP_SS)
+            {
+                mHashCache->setHashingUseMmap(kit->value == "YES") ;
+            }
             else if(kit->key == WATCH_FILE_DURATION_SS)
             {
                 int t=0 ;
@@ -1088,6 +1116,11 @@ bool p3FileDatabase::hashingProcessPaused()
     RS_STACK_MUTEX(mFLSMtx) ;
     return  mLocalDirWatcher->hashingProcessPaused();
 }
+void p3FileDatabase::getHashingStats(std::vector<HashStorageWorkerStats>& stats)
+{
+    RS_STACK_MUTEX(mFLSMtx) ;
+    mHashCache->getWorkerStats(stats) ;
+}
 bool p3FileDatabase::inDirectoryCheck()
 {
     RS_STACK_MUTEX(mFLSMtx) ;
@@ -1774,6 +1807,12 @@ void p3FileDatabase::locked_recursSweepRemoteDirectory(RemoteDirectoryStorage *r
 #endif
        }
 
+   // Don't load a file list that is not in memory just for the sweep. Its sub-directories are checked again once something
+   // else loads it, e.g. when the friend sends a newer root directory.
+
+   if(e == rds->root() && !rds->isLoaded())
+       return ;
+
    for(DirectoryStorage::DirIterator it(rds,e);it;++it)
        locked_recursSweepRemoteDirectory(rds,*it,depth+1);
 }
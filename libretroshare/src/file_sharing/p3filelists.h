@@ -156,6 +156,7 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
 		bool inDirectoryCheck();
 		void togglePauseHashingProcess();
 		bool hashingProcessPaused();
+		void getHashingStats(std::vector<HashStorageWorkerStats>& stats) ;
 
     protected:
 
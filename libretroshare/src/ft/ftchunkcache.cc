@@ -0,0 +1,135 @@
+/*
+ * libretroshare/src/ft/ ftchunkcache.cc
+ *
+ * File Transfer for RetroShare.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include "ftchunkcache.h"
+
+/*******
+ * #define CHUNK_CACHE_DEBUG 1
+ ******/
+
+ftChunkCache::ftChunkCache(uint64_t max_bytes)
+	: mCacheMtx("ftChunkCache"), mMaxBytes(max_bytes)
+{
+}
+
+bool ftChunkCache::getData(const RsFileHash& hash,uint64_t offset,uint32_t size,void *data)
+{
+	RsStackMutex stack(mCacheMtx); /********** STACK LOCKED MTX ******/
+
+	// Check that all blocks are here before copying anything.
+
+	uint32_t first_block = offset / BLOCK_SIZE ;
+	uint32_t last_block = (offset + size - 1) / BLOCK_SIZE ;
+
+	std::vector<std::map<BlockId,Block>::iterator> blocks ;
+
+	for(uint32_t b=first_block;b<=last_block;++b)
+	{
+		std::map<BlockId,Block>::iterator it = mBlocks.find(BlockId(hash,b)) ;
+
+		if(it == mBlocks.end() || (uint64_t)b*BLOCK_SIZE + it->second.data.size() < std::min(offset + size,(uint64_t)(b+1)*BLOCK_SIZE))
+		{
+			++mStats.misses ;
+			return false ;
+		}
+		blocks.push_back(it) ;
+	}
+
+	uint32_t copied = 0 ;
+
+	for(uint32_t i=0;i<blocks.size();++i)
+	{
+		uint64_t block_start = (uint64_t)(first_block+i)*BLOCK_SIZE ;
+		uint32_t offset_in_block = offset + copied - block_start ;
+		uint32_t n = std::min((uint64_t)(size - copied),(uint64_t)BLOCK_SIZE - offset_in_block) ;
+
+		memcpy((unsigned char*)data + copied,&blocks[i]->second.data[offset_in_block],n) ;
+		copied += n ;
+
+		mLRU.splice(mLRU.begin(),mLRU,blocks[i]->second.lru_pos) ;
+	}
+	++mStats.hits ;
+
+#ifdef CHUNK_CACHE_DEBUG
+	std::cerr << "ftChunkCache: served " << size << " bytes at offset " << offset << " of " << hash << std::endl;
+#endif
+	return true ;
+}
+
+void ftChunkCache::addBlock(const RsFileHash& hash,uint32_t block,std::vector<unsigned char>& data)
+{
+	RsStackMutex stack(mCacheMtx); /********** STACK LOCKED MTX ******/
+
+	BlockId id(hash,block) ;
+	std::map<BlockId,Block>::iterator it = mBlocks.find(id) ;
+
+	if(it != mBlocks.end())		// another provider read it meanwhile
+		return ;
+
+	Block& b(mBlocks[id]) ;
+
+	b.data.swap(data) ;
+	b.lru_pos = mLRU.insert(mLRU.begin(),id) ;
+
+	mStats.cached_bytes += b.data.size() ;
+	++mStats.loaded_blocks ;
+
+#ifdef CHUNK_CACHE_DEBUG
+	std::cerr << "ftChunkCache: added block " << block << " of " << hash << ". Cache size: " << mStats.cached_bytes << std::endl;
+#endif
+	locked_dropOldBlocks() ;
+}
+
+void ftChunkCache::locked_dropOldBlocks()
+{
+	while(mStats.cached_bytes > mMaxBytes && !mLRU.empty())
+	{
+		std::map<BlockId,Block>::iterator it = mBlocks.find(mLRU.back()) ;
+
+		mStats.cached_bytes -= it->second.data.size() ;
+		++mStats.dropped_blocks ;
+
+		mBlocks.erase(it) ;
+		mLRU.pop_back() ;
+	}
+}
+
+void ftChunkCache::setMaxSize(uint64_t max_bytes)
+{
+	RsStackMutex stack(mCacheMtx); /********** STACK LOCKED MTX ******/
+
+	mMaxBytes = max_bytes ;
+	locked_dropOldBlocks() ;
+}
+
+void ftChunkCache::getStats(ftChunkCacheStats& stats)
+{
+	RsStackMutex stack(mCacheMtx); /********** STACK LOCKED MTX ******/
+
+	stats = mStats ;
+	stats.cached_blocks = mBlocks.size() ;
+	stats.max_bytes = mMaxBytes ;
+}
@@ -0,0 +1,99 @@
+/*
+ * libretroshare/src/ft/ ftchunkcache.h
+ *
+ * File Transfer for RetroShare.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#pragma once
+
+/*
+ * ftChunkCache
+ *
+ * Cache of file data shared by all file providers, used for uploads. Popular files are uploaded to many
+ * peers/tunnels at once, which all ask for the same regions. The data is stored in blocks of one chunk (1MB),
+ * keyed by file hash and chunk number. The least recently used blocks are dropped when the cache is full.
+ *
+ * The cache never reads the disk itself: file providers add the blocks they read ahead for peers that
+ * download sequentially.
+ */
+
+#include <map>
+#include <list>
+#include <vector>
+
+#include "util/rsthreads.h"
+#include "retroshare/rstypes.h"
+
+struct ftChunkCacheStats
+{
+	ftChunkCacheStats() : hits(0), misses(0), loaded_blocks(0), dropped_blocks(0), cached_blocks(0), cached_bytes(0), max_bytes(0) {}
+
+	uint64_t hits ;				// requests served from the cache
+	uint64_t misses ;				// requests that needed reading the disk
+	uint64_t loaded_blocks ;		// blocks read ahead and added to the cache
+	uint64_t dropped_blocks ;		// blocks removed to make room
+	uint32_t cached_blocks ;
+	uint64_t cached_bytes ;
+	uint64_t max_bytes ;
+};
+
+class ftChunkCache
+{
+	public:
+		static const uint32_t BLOCK_SIZE = 1024*1024 ;		// same as the chunk size of ChunkMap
+
+		ftChunkCache(uint64_t max_bytes) ;
+
+		// Copies the requested data if all blocks it lies in are cached. Counts a hit or a miss.
+		bool getData(const RsFileHash& hash,uint64_t offset,uint32_t size,void *data) ;
+
+		// Adds a block read from the disk. The data is swapped out of the vector. Blocks are BLOCK_SIZE bytes,
+		// except the last block of the file.
+		void addBlock(const RsFileHash& hash,uint32_t block,std::vector<unsigned char>& data) ;
+
+		void setMaxSize(uint64_t max_bytes) ;
+		void getStats(ftChunkCacheStats& stats) ;
+
+	private:
+		struct BlockId
+		{
+			BlockId(const RsFileHash& h,uint32_t b) : hash(h),block(b) {}
+
+			bool operator<(const BlockId& b) const { return block < b.block || (block == b.block && hash < b.hash) ; }
+
+			RsFileHash hash ;
+			uint32_t block ;
+		};
+		struct Block
+		{
+			std::vector<unsigned char> data ;
+			std::list<BlockId>::iterator lru_pos ;
+		};
+
+		void locked_dropOldBlocks() ;
+
+		RsMutex mCacheMtx ;
+
+		std::map<BlockId,Block> mBlocks ;
+		std::list<BlockId> mLRU ;		// most recently used first
+
+		uint64_t mMaxBytes ;
+		ftChunkCacheStats mStats ;
+};
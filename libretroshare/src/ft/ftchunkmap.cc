@@ -39,6 +39,7 @@
 static const uint32_t SOURCE_CHUNK_MAP_UPDATE_PERIOD	=   60 ; //! TTL for chunkmap info
 static const uint32_t INACTIVE_CHUNK_TIME_LAPSE 		= 3600 ; //! TTL for an inactive chunk
 static const uint32_t FT_CHUNKMAP_MAX_CHUNK_JUMP		=   50 ; //! Maximum chunk jump in progressive DL mode
+static const float    FT_CHUNKMAP_END_GAME_RATE_RATIO	= 0.8f ; //! Only sources at least that fast compared to the fastest one take slices of other sources at end of download
 
 std::ostream& operator<<(std::ostream& o,const ftChunk& c)
 {
@@ -75,6 +76,7 @@ ChunkMap::ChunkMap(uint64_t s,bool availability)
 		++n ;
 
 	_map.resize(n,FileChunksInfo::CHUNK_OUTSTANDING) ;
+	_chunk_sources_count.resize(n,0) ;
 	_strategy = FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE ;
 	_total_downloaded = 0 ;
 	_file_is_complete = false ;
@@ -153,6 +155,8 @@ void ChunkMap::dataReceived(const ftChunk::ChunkId& cid)
 	_total_downloaded += it->second ;
 	itc->second._remains -= it->second ;
 	itc->second._slices.erase(it) ;
+	itc->second._slice_owners.erase(cid) ;
+	itc->second._duplicated_slices.erase(cid) ;
 	itc->second._last_data_received = time(NULL) ;	// update time stamp
 
 #ifdef DEBUG_FTCHUNK
@@ -349,6 +353,7 @@ bool ChunkMap::getDataChunk(const RsPeerId& peer_id,uint32_t size_hint,ftChunk&
 	//
 	it->second.getSlice(size_hint,chunk) ;
 	_slices_to_download[chunk.offset/_chunk_size]._slices[chunk.id] = chunk.size ;
+	_slices_to_download[chunk.offset/_chunk_size]._slice_owners[chunk.id] = peer_id ;
 	_slices_to_download[chunk.offset/_chunk_size]._last_data_received = time(NULL) ;
 
 	chunk.peer_id = peer_id ;
@@ -454,6 +459,8 @@ void ChunkMap::setPeerAvailabilityMap(const RsPeerId& peer_id,const CompressedCh
 	// sets the map.
 	//
 	SourceChunksInfo& mi(_peers_chunks_availability[peer_id]) ;
+
+	updateChunkSourceCounts(mi,-1) ;
 	mi.cmap = cmap ;
 	mi.TS = time(NULL) ;
 	mi.is_full = true ;
@@ -467,11 +474,28 @@ void ChunkMap::setPeerAvailabilityMap(const RsPeerId& peer_id,const CompressedCh
 			break ;
 		}
 
+	updateChunkSourceCounts(mi,1) ;
+
 #ifdef DEBUG_FTCHUNK
 	std::cerr << "ChunkMap::setPeerAvailabilityMap: Setting chunk availability info for peer " << peer_id << std::endl ;
 #endif
 }
 
+void ChunkMap::setSourceRate(const RsPeerId& peer_id,uint32_t rate)
+{
+	getSourceChunksInfo(peer_id)->rate = rate ;
+}
+
+void ChunkMap::updateChunkSourceCounts(const SourceChunksInfo& sci,int delta)
+{
+	if(sci.cmap._map.size() < CompressedChunkMap::getCompressedSize(_map.size()))	// not filled yet
+		return ;
+
+	for(uint32_t i=0;i<_map.size();++i)
+		if(sci.cmap[i])
+			_chunk_sources_count[i] += delta ;
+}
+
 uint32_t ChunkMap::sizeOfChunk(uint32_t cid) const
 {
 	if(cid == _map.size()-1)
@@ -513,6 +537,7 @@ SourceChunksInfo *ChunkMap::getSourceChunksInfo(const RsPeerId& peer_id)
 			pchunks.TS = 0 ;
 			pchunks.is_full = false ;
 		}
+		updateChunkSourceCounts(pchunks,1) ;
 
 		it = _peers_chunks_availability.find(peer_id) ;
 	}
@@ -560,6 +585,34 @@ uint32_t ChunkMap::getAvailableChunk(const RsPeerId& peer_id,bool& map_is_too_ol
 		else
 			available_chunks_before_max_dist = available_chunks ;
 
+	if(available_chunks > 0 && _strategy == FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST)
+	{
+		// Take the chunk with the fewest sources. Ties are broken randomly, so that the sources that
+		// share the same chunks don't all download the same ones.
+
+		uint32_t chosen_chunk = _map.size() ;
+		uint32_t min_sources = ~(uint32_t)0 ;
+		uint32_t nb_ties = 0 ;
+
+		for(uint32_t i=0;i<_map.size();++i)
+			if(_map[i] == FileChunksInfo::CHUNK_OUTSTANDING && (peer_chunks->is_full || peer_chunks->cmap[i]))
+			{
+				if(_chunk_sources_count[i] < min_sources)
+				{
+					min_sources = _chunk_sources_count[i] ;
+					chosen_chunk = i ;
+					nb_ties = 1 ;
+				}
+				else if(_chunk_sources_count[i] == min_sources && rand() % (++nb_ties) == 0)
+					chosen_chunk = i ;
+			}
+
+#ifdef DEBUG_FTCHUNK
+		std::cerr << "ChunkMap::getAvailableChunk: returning chunk " << chosen_chunk << " with " << min_sources << " sources for peer " << peer_id << std::endl;
+#endif
+		return chosen_chunk ;
+	}
+
 	if(available_chunks > 0)
 	{
 		uint32_t chosen_chunk_number ;
@@ -598,6 +651,66 @@ uint32_t ChunkMap::getAvailableChunk(const RsPeerId& peer_id,bool& map_is_too_ol
 	return _map.size() ;
 }
 
+bool ChunkMap::getEndGameSlice(const RsPeerId& peer_id,ftChunk::ChunkId& slice_id)
+{
+	if(_strategy != FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST)
+		return false ;
+
+	// Only at the end: all chunks are being downloaded already.
+
+	for(uint32_t i=0;i<_map.size();++i)
+		if(_map[i] == FileChunksInfo::CHUNK_OUTSTANDING)
+			return false ;
+
+	// Only the fastest sources duplicate slices.
+
+	SourceChunksInfo *sci = getSourceChunksInfo(peer_id) ;
+	uint32_t max_rate = 0 ;
+
+	for(std::map<RsPeerId,SourceChunksInfo>::const_iterator it(_peers_chunks_availability.begin());it!=_peers_chunks_availability.end();++it)
+		max_rate = std::max(max_rate,it->second.rate) ;
+
+	if(sci->rate == 0 || sci->rate < FT_CHUNKMAP_END_GAME_RATE_RATIO * max_rate)
+		return false ;
+
+	// Take the slice of the slowest source, among the ones that this source has and that are not already duplicated.
+
+	bool found = false ;
+	uint32_t min_rate = sci->rate ;
+
+	for(std::map<ChunkNumber,ChunkDownloadInfo>::const_iterator itc(_slices_to_download.begin());itc!=_slices_to_download.end();++itc)
+	{
+		if(!sci->is_full && !sci->cmap[itc->first])
+			continue ;
+
+		for(std::map<ftChunk::ChunkId,RsPeerId>::const_iterator it(itc->second._slice_owners.begin());it!=itc->second._slice_owners.end();++it)
+		{
+			if(it->second == peer_id || itc->second._duplicated_slices.find(it->first) != itc->second._duplicated_slices.end())
+				continue ;
+
+			std::map<RsPeerId,SourceChunksInfo>::const_iterator itp = _peers_chunks_availability.find(it->second) ;
+			uint32_t owner_rate = (itp == _peers_chunks_availability.end())?0:itp->second.rate ;
+
+			if(owner_rate < min_rate)
+			{
+				min_rate = owner_rate ;
+				slice_id = it->first ;
+				found = true ;
+			}
+		}
+	}
+
+	if(!found)
+		return false ;
+
+	_slices_to_download[slice_id / _chunk_size]._duplicated_slices.insert(slice_id) ;
+
+#ifdef DEBUG_FTCHUNK
+	std::cerr << "ChunkMap::getEndGameSlice: asking slice " << slice_id << " of a source at " << min_rate << " B/s to peer " << peer_id << " at " << sci->rate << " B/s" << std::endl;
+#endif
+	return true ;
+}
+
 void ChunkMap::getChunksInfo(FileChunksInfo& info) const 
 {
 	info.file_size = _file_size ;
@@ -623,6 +736,7 @@ void ChunkMap::removeFileSource(const RsPeerId& peer_id)
 	if(it == _peers_chunks_availability.end())
 		return ;
 
+	updateChunkSourceCounts(it->second,-1) ;
 	_peers_chunks_availability.erase(it) ;
 }
 
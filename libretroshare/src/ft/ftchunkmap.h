@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <set>
 #include "retroshare/rstypes.h"
 
 // ftChunkMap: 
@@ -74,6 +75,8 @@ class ChunkDownloadInfo
 {
 	public:
 		std::map<ftChunk::ChunkId,uint32_t> _slices ;
+		std::map<ftChunk::ChunkId,RsPeerId> _slice_owners ;	// source each slice was asked to
+		std::set<ftChunk::ChunkId> _duplicated_slices ;		// slices also asked to a faster source, at end of download
 		uint32_t _remains ;
 		time_t _last_data_received ;
 };
@@ -81,9 +84,12 @@ class ChunkDownloadInfo
 class SourceChunksInfo
 {
 	public:
+		SourceChunksInfo() : TS(0), is_full(false), rate(0) {}
+
 		CompressedChunkMap cmap ;	//! map of what the peer has/doens't have
 		time_t TS ;						//! last update time for this info
 		bool is_full ;					//! is the map full ? In such a case, re-asking for it is unnecessary.
+		uint32_t rate ;				//! current transfer rate from this source in bytes/s. 0 if it's not sending.
 
 		// Returns true if the offset is starting in a mapped chunk.
 		//
@@ -128,10 +134,17 @@ class ChunkMap
 
       virtual void dataReceived(const ftChunk::ChunkId& c_id) ;
 
+      /// Called when getDataChunk() has nothing left for that peer. At the end of the download, slices that
+      /// are pending at a slower source can be asked to a faster one as well, so that the download is not
+      /// held back by the slowest source. Returns the id of the slice to ask again. Only used in RAREST_FIRST mode.
+
+      bool getEndGameSlice(const RsPeerId& peer_id,ftChunk::ChunkId& slice_id) ;
+
       /// Decides how chunks are selected. 
       ///    STREAMING: the 1st chunk is always returned
       ///       RANDOM: a uniformly random chunk is selected among available chunks for the current source.
-      ///              
+      /// RAREST_FIRST: the chunk available at the smallest number of sources is selected, so that chunks that
+      ///              only few sources have are downloaded while these sources are still there.
 
 		void setStrategy(FileChunksInfo::ChunkStrategy s) { _strategy = s ; }
 		FileChunksInfo::ChunkStrategy getStrategy() const { return _strategy ; }
@@ -169,6 +182,10 @@ class ChunkMap
 		//
 		void setPeerAvailabilityMap(const RsPeerId& peer_id,const CompressedChunkMap& peer_map) ;
 
+		/// Updates the transfer rate of that source, in bytes/s.
+		//
+		void setSourceRate(const RsPeerId& peer_id,uint32_t rate) ;
+
 		/// Returns a pointer to the availability chunk map of the given source, and possibly
 		/// allocates it if necessary.
 		//
@@ -210,6 +227,9 @@ class ChunkMap
 	private:
         bool hasChunkState(uint64_t offset, uint32_t chunk_size, FileChunksInfo::ChunkState state) const;
 
+		/// Adds (or removes, when delta=-1) the chunks of that source map to the number of sources per chunk.
+		void updateChunkSourceCounts(const SourceChunksInfo& sci,int delta) ;
+
 		uint64_t												_file_size ;						//! total size of the file in bytes.
 		uint32_t												_chunk_size ;						//! Size of chunks. Common to all chunks.
 		FileChunksInfo::ChunkStrategy 				_strategy ;							//! how do we allocate new chunks
@@ -221,6 +241,7 @@ class ChunkMap
 		bool													_file_is_complete ;           //! set to true when the file is complete.
 		bool													_assume_availability ;			//! true if all sources always have the complete file.
 		std::vector<uint32_t>							_chunks_checking_queue ;		//! Queue of downloaded chunks to be checked.
+		std::vector<uint32_t>							_chunk_sources_count ;			//! number of known sources for each chunk.
 };
 
 
@@ -107,6 +107,7 @@ ftController::ftController(ftDataMultiplex *dm, p3ServiceControl *sc, uint32_t f
     mExtraList(NULL),
     mTurtle(NULL),
     mFtServer(NULL),
+    mFileWriter(NULL),
     mServiceCtrl(sc),
     mFtServiceType(ftServiceId),
     mDefaultEncryptionPolicy(RS_FILE_CTRL_ENCRYPTION_POLICY_PERMISSIVE),
@@ -124,6 +125,7 @@ ftController::ftController(ftDataMultiplex *dm, p3ServiceControl *sc, uint32_t f
 
 void ftController::setTurtleRouter(p3turtle *pt) { mTurtle = pt ; }
 void ftController::setFtServer(ftServer *ft) { mFtServer = ft ; }
+void ftController::setFileWriter(ftFileWriter *fw) { mFileWriter = fw ; }
 
 void ftController::setFtSearchNExtra(ftSearch *search, ftExtraList *list)
 {
@@ -1179,7 +1181,7 @@ bool 	ftController::FileRequest(const std::string& fname, const RsFileHash& hash
 
     bool assume_availability = false;
 
-	ftFileCreator *fc = new ftFileCreator(savepath, size, hash,assume_availability);
+	ftFileCreator *fc = new ftFileCreator(savepath, size, hash,assume_availability,mFileWriter);
 	ftTransferModule *tm = new ftTransferModule(fc, mDataplex,this);
 
 #ifdef CONTROL_DEBUG
@@ -1651,6 +1653,7 @@ bool 	ftController::FileDetails(const RsFileHash &hash, FileInfo &info)
 
 			ti.tfRate = tfRate / 1024.0;
 			ti.peerId = *pit;
+			it->second->mTransfer->getPeerTransferStats(*pit, ti);
 			info.peers.push_back(ti);
 			totalRate += tfRate / 1024.0;
 		}
@@ -1857,6 +1860,8 @@ bool ftController::saveList(bool &cleanup, std::list<RsItem *>& saveData)
 																	  	break ;
 		case FileChunksInfo::CHUNK_STRATEGY_RANDOM:		configMap[default_chunk_strategy_ss] =  "RANDOM" ;
 																		break ;
+		case FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST:configMap[default_chunk_strategy_ss] =  "RAREST_FIRST" ;
+																		break ;
 
 		default:
 		case FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE:configMap[default_chunk_strategy_ss] =  "PROGRESSIVE" ;
@@ -2150,6 +2155,11 @@ bool  ftController::loadConfigMap(std::map<std::string, std::string> &configMap)
 			setDefaultChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE) ;
 			std::cerr << "Note: loading default value for chunk strategy: progressive" << std::endl;
 		}
+		else if(mit->second == "RAREST_FIRST")
+		{
+			setDefaultChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST) ;
+			std::cerr << "Note: loading default value for chunk strategy: rarest first" << std::endl;
+		}
 		else
 			std::cerr << "**** ERROR ***: Unknown value for default chunk strategy in keymap." << std::endl ;
 	}
@@ -45,6 +45,7 @@ class ftSearch;
 class ftServer;
 class ftExtraList;
 class ftDataMultiplex;
+class ftFileWriter;
 class p3turtle ;
 class p3ServiceControl;
 
@@ -122,6 +123,7 @@ class ftController: public RsTickingThread, public pqiServiceMonitor, public p3C
 		void	setFtSearchNExtra(ftSearch *, ftExtraList *);
 		void	setTurtleRouter(p3turtle *) ;
 		void	setFtServer(ftServer *) ;
+		void	setFileWriter(ftFileWriter *) ;
 		bool    activate();
 		bool 	isActiveAndNoPending();
 
@@ -238,6 +240,7 @@ class ftController: public RsTickingThread, public pqiServiceMonitor, public p3C
 		ftExtraList *mExtraList;
 		p3turtle *mTurtle ;
 		ftServer *mFtServer ;
+		ftFileWriter *mFileWriter ;
 		p3ServiceControl *mServiceCtrl;
 		uint32_t mFtServiceType;
 		uint32_t mDefaultEncryptionPolicy;
@@ -73,11 +73,17 @@ ftRequest::ftRequest(uint32_t type, const RsPeerId& peerId, const RsFileHash& ha
 
 ftDataMultiplex::ftDataMultiplex(const RsPeerId& ownId, ftDataSend *server, ftSearch *search)
 	:RsQueueThread(DMULTIPLEX_MIN, DMULTIPLEX_MAX, DMULTIPLEX_RELAX), dataMtx("ftDataMultiplex"),
-	mDataSend(server),  mSearch(search), mOwnId(ownId)
+	mDataSend(server),  mSearch(search), mChunkCache(NULL), mOwnId(ownId)
 {
 	return;
 }
 
+void ftDataMultiplex::setChunkCache(ftChunkCache *cache)
+{
+	RsStackMutex stack(dataMtx); /******* LOCK MUTEX ******/
+	mChunkCache = cache ;
+}
+
 bool ftDataMultiplex::getFileData(const RsFileHash& hash, uint64_t offset, uint32_t& requested_size, uint8_t *data)
 {
     RsStackMutex stack(dataMtx); /******* LOCK MUTEX ******/
@@ -101,7 +107,7 @@ bool ftDataMultiplex::getFileData(const RsFileHash& hash, uint64_t offset, uint3
         FileSearchFlags hintflags =   RS_FILE_HINTS_EXTRA | RS_FILE_HINTS_LOCAL | RS_FILE_HINTS_SPEC_ONLY | RS_FILE_HINTS_NETWORK_WIDE;
         if(mSearch->search(hash, hintflags, info))
         {
-            provider = new ftFileProvider(info.path, info.size, hash);
+            provider = new ftFileProvider(info.path, info.size, hash, mChunkCache);
             mServers[hash] = provider;
         }
     }
@@ -1123,7 +1129,7 @@ bool	ftDataMultiplex::handleSearchRequest(const RsPeerId& peerId, const RsFileHa
 
 		if(it == mServers.end())
 		{
-			provider = new ftFileProvider(info.path, info.size, hash);
+			provider = new ftFileProvider(info.path, info.size, hash, mChunkCache);
 			mServers[hash] = provider;
 #ifdef MPLEX_DEBUG
 			std::cerr << " created new file provider " << (void*)provider << std::endl;
@@ -36,6 +36,7 @@ class ftTransferModule;
 class ftFileProvider;
 class ftFileCreator;
 class ftSearch;
+class ftChunkCache;
 
 #include <string>
 #include <list>
@@ -95,6 +96,9 @@ class ftDataMultiplex: public ftDataRecv, public RsQueueThread
 
 		ftDataMultiplex(const RsPeerId& ownId, ftDataSend *server, ftSearch *search);
 
+		// Cache shared by the providers of uploaded files.
+		void setChunkCache(ftChunkCache *cache) ;
+
         /**
          * @see RsFiles::getFileData
      *
@@ -187,6 +191,7 @@ class ftDataMultiplex: public ftDataRecv, public RsQueueThread
 
 		ftDataSend *mDataSend;
 		ftSearch   *mSearch;
+		ftChunkCache *mChunkCache;
 		RsPeerId mOwnId;
 
 		friend class ftServer;
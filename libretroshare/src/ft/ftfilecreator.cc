@@ -4,10 +4,14 @@
 #endif
 
 #include "ftfilecreator.h"
+#include "ftfilewriter.h"
 #include <errno.h>
 #include <stdio.h>
 #include <time.h>
+#include <unistd.h>
+#include <algorithm>
 #include <sys/stat.h>
+#include <openssl/sha.h>
 #include <util/rsdiscspace.h>
 #include <util/rsdir.h>
 
@@ -18,14 +22,30 @@
 #define CHUNK_MAX_AGE           120
 #define MAX_FTCHUNKS_PER_PEER    20
 
+// Amount of queued data above which the receiving thread writes it itself: without a file writer, this gives
+// larger writes. With a file writer, this means that the disk does not keep up, so the network has to wait.
+#define WRITE_QUEUE_FLUSH_SIZE       (1024*1024)
+#define WRITE_QUEUE_MAX_SIZE    (16*1024*1024)
+
+class ftChunkHasher
+{
+	public:
+		ftChunkHasher() : hashed_size(0), valid(true) { SHA1_Init(&ctx) ; }
+
+		SHA_CTX ctx ;
+		uint32_t hashed_size ;	// size of the data hashed, from the start of the chunk
+		bool valid ;			// false when the received data may differ from the data hashed
+};
+
 /***********************************************************
 *
 *	ftFileCreator methods
 *
 ***********************************************************/
 
-ftFileCreator::ftFileCreator(const std::string& path, uint64_t size, const RsFileHash& hash,bool assume_availability)
-	: ftFileProvider(path,size,hash), chunkMap(size,assume_availability)
+ftFileCreator::ftFileCreator(const std::string& path, uint64_t size, const RsFileHash& hash,bool assume_availability,ftFileWriter *writer)
+	: ftFileProvider(path,size,hash), chunkMap(size,assume_availability),
+	  mWriteQueueSize(0), mWriteInProgress(false), ftcWriteMutex("ftFileCreator write"), mFileWriter(writer)
 {
 	/* 
          * FIXME any inits to do?
@@ -73,6 +93,7 @@ bool ftFileCreator::getFileData(const RsPeerId& peer_id,uint64_t offset, uint32_
 	std::cerr << "ftFileCreator::getFileData(). Asked for offset=" << offset << ", size=" << chunk_size << std::endl ;
 #endif
 	bool have_it = false ;
+	bool queued = false ;
 	{
 		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
@@ -108,6 +129,14 @@ bool ftFileCreator::getFileData(const RsPeerId& peer_id,uint64_t offset, uint32_
                 have_it = false;
         }
 #endif
+		// is some of the data still in the write queue?
+
+		std::map<uint64_t, std::vector<unsigned char> >::const_iterator it = mWriteQueue.lower_bound(offset + chunk_size) ;
+
+		if(have_it && it != mWriteQueue.begin())
+			queued = (--it)->first + it->second.size() > offset ;
+
+		queued = queued || (have_it && mWriteInProgress) ;
 	}
 #ifdef FILE_DEBUG
 	if(have_it)
@@ -116,10 +145,17 @@ bool ftFileCreator::getFileData(const RsPeerId& peer_id,uint64_t offset, uint32_
 		std::cerr << "ftFileCreator::getFileData(). Don't have it" << std::endl ;
 #endif
 
-	if(have_it)
-		return ftFileProvider::getFileData(peer_id,offset, chunk_size, data);
-	else
+	if(!have_it)
 		return false ;
+
+	if(queued)
+		flushWriteQueue() ;
+
+	// closeFile() needs ftcWriteMutex, so the file stays open while the data is read.
+
+	RsStackMutex stack(ftcWriteMutex); /********** STACK LOCKED MTX ******/
+
+	return ftFileProvider::getFileData(peer_id,offset, chunk_size, data);
 }
 
 time_t ftFileCreator::creationTimeStamp() 
@@ -135,6 +171,10 @@ time_t ftFileCreator::lastRecvTimeStamp()
 
 void ftFileCreator::closeFile()
 {
+	// Queued data needs to be on disk once the file is closed, e.g. when it is moved after completion.
+	flushWriteQueue() ;
+
+	RsStackMutex wstack(ftcWriteMutex); /********** STACK LOCKED MTX ******/
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
 	if(fd != NULL)
@@ -171,6 +211,7 @@ bool ftFileCreator::addFileData(uint64_t offset, uint32_t chunk_size, void *data
 		return false ;
 
 	bool complete = false ;
+	bool flush_now = false ;
 	{
 		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
@@ -189,26 +230,16 @@ bool ftFileCreator::addFileData(uint64_t offset, uint32_t chunk_size, void *data
 		}
 
 		/* 
-		 * go to the offset of the file 
+		 * queue the data for writing, and hash it if it follows the data already received for its chunk
 		 */
-		if (0 != fseeko64(this->fd, offset, SEEK_SET))
-		{
-			std::cerr << "ftFileCreator::addFileData() Bad fseek at offset " << offset << ", fd=" << (void*)(this->fd) << ", size=" << mSize << ", errno=" << errno << std::endl;
-			return 0;
-		}
-
-		if (1 != fwrite(data, chunk_size, 1, this->fd))
-		{
-			std::cerr << "ftFileCreator::addFileData() Bad fwrite." << std::endl;
-			std::cerr << "ERRNO: " << errno << std::endl;
-
-			return 0;
-		}
+		locked_queueData(offset,chunk_size,(const unsigned char*)data) ;
+		locked_updateChunkHashes(offset,chunk_size) ;
 
 #ifdef FILE_DEBUG
-		std::cerr << "ftFileCreator::addFileData() added Data...";
+		std::cerr << "ftFileCreator::addFileData() queued Data...";
 		std::cerr << std::endl;
 		std::cerr << " pos: " << offset;
+		std::cerr << ", queued: " << mWriteQueueSize;
 		std::cerr << std::endl;
 #endif
 		/* 
@@ -217,7 +248,18 @@ bool ftFileCreator::addFileData(uint64_t offset, uint32_t chunk_size, void *data
 		locked_notifyReceived(offset,chunk_size);
 
 		complete = chunkMap.isComplete();
+
+		if(mFileWriter == NULL)
+			flush_now = mWriteQueueSize >= WRITE_QUEUE_FLUSH_SIZE ;
+		else
+			flush_now = mWriteQueueSize >= WRITE_QUEUE_MAX_SIZE ;
 	}
+
+	if(flush_now)
+		flushWriteQueue() ;
+	else if(mFileWriter != NULL)
+		mFileWriter->notifyPending(this) ;
+
 	if(complete)
 	{
 #ifdef FILE_DEBUG
@@ -344,11 +386,252 @@ ftFileCreator::~ftFileCreator()
 	std::cerr << "Deleting file creator for " << file_name << std::endl;
 #endif
 
+	if(mFileWriter != NULL)
+		mFileWriter->removeFile(this) ;
+
+	flushWriteQueue() ;
+
 	// Note: The file is actually closed in the parent, that is always a ftFileProvider.
 	//
-	/*
-	 * FIXME Any cleanups specific to filecreator?
-	 */
+	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+	locked_clearChunkHashes() ;
+}
+
+void ftFileCreator::locked_queueData(uint64_t offset, uint32_t chunk_size, const unsigned char *data)
+{
+	/* ALREADY LOCKED */
+
+	uint64_t end = offset + chunk_size ;
+
+	// 1 - data already queued in the same range (e.g. a slice asked twice) is replaced.
+
+	std::map<uint64_t, std::vector<unsigned char> >::iterator it = mWriteQueue.upper_bound(offset) ;
+
+	if(it != mWriteQueue.begin())
+		--it ;
+
+	for(;it!=mWriteQueue.end() && it->first < end;++it)
+	{
+		uint64_t b = std::max(offset,it->first) ;
+		uint64_t e = std::min(end,it->first + it->second.size()) ;
+
+		if(b < e)
+			memcpy(&it->second[b - it->first], data + (b - offset), e - b) ;
+	}
+
+	// 2 - the rest is added to the queue, appended to the data just before when it is contiguous, so that the
+	//     slices of a chunk end up in a single write.
+
+	uint64_t pos = offset ;
+
+	while(pos < end)
+	{
+		std::map<uint64_t, std::vector<unsigned char> >::iterator next = mWriteQueue.upper_bound(pos) ;
+		std::map<uint64_t, std::vector<unsigned char> >::iterator prev = next ;
+		std::vector<unsigned char> *buf = NULL ;
+
+		if(prev != mWriteQueue.begin())
+		{
+			--prev ;
+			uint64_t prev_end = prev->first + prev->second.size() ;
+
+			if(prev_end > pos)	// already queued
+			{
+				pos = prev_end ;
+				continue ;
+			}
+			if(prev_end == pos)
+				buf = &prev->second ;
+		}
+		if(buf == NULL)
+			buf = &mWriteQueue[pos] ;
+
+		uint64_t piece_end = (next != mWriteQueue.end())? std::min(end,next->first) : end ;
+
+		buf->insert(buf->end(), data + (pos - offset), data + (piece_end - offset)) ;
+		mWriteQueueSize += piece_end - pos ;
+
+		if(next != mWriteQueue.end() && next->first == piece_end)
+		{
+			buf->insert(buf->end(), next->second.begin(), next->second.end()) ;
+			mWriteQueue.erase(next) ;
+		}
+		pos = piece_end ;
+	}
+}
+
+void ftFileCreator::getWriteQueueInfo(uint32_t& nb_blocks,uint32_t& size)
+{
+	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+	nb_blocks = mWriteQueue.size() ;
+	size = mWriteQueueSize ;
+}
+
+bool ftFileCreator::flushWriteQueue()
+{
+	RsStackMutex wstack(ftcWriteMutex); /********** STACK LOCKED MTX ******/
+
+	std::map<uint64_t, std::vector<unsigned char> > queue ;
+	bool ok = true ;
+#ifndef WINDOWS_SYS
+	int fdesc ;
+#endif
+	{
+		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+		if(mWriteQueue.empty())
+			return true ;
+
+		queue.swap(mWriteQueue) ;
+		mWriteQueueSize = 0 ;
+
+		if(!locked_initializeFileAttrs())
+		{
+			// The data is lost. Make sure that the chunks it belongs to are checked from the disk, so that they get downloaded again.
+
+			for(std::map<uint64_t, std::vector<unsigned char> >::const_iterator it(queue.begin());it!=queue.end();++it)
+				locked_invalidateChunkHashes(it->first,it->second.size()) ;
+
+			return false ;
+		}
+#ifdef WINDOWS_SYS
+		// No positional writes here. Use the file stream, which other threads only use while holding ftcMutex.
+
+		for(std::map<uint64_t, std::vector<unsigned char> >::const_iterator it(queue.begin());it!=queue.end();++it)
+			if(0 != fseeko64(fd, it->first, SEEK_SET) || 1 != fwrite(&it->second[0], it->second.size(), 1, fd))
+			{
+				std::cerr << "ftFileCreator::flushWriteQueue() Bad write at offset " << it->first << ", size=" << it->second.size() << ", errno=" << errno << std::endl;
+				locked_invalidateChunkHashes(it->first,it->second.size()) ;
+				ok = false ;
+			}
+
+		return ok ;
+#else
+		fdesc = fileno(fd) ;
+		mWriteInProgress = true ;
+#endif
+	}
+
+#ifndef WINDOWS_SYS
+	// The file descriptor stays valid since closing the file needs ftcWriteMutex. Positional writes do not
+	// interfere with the reads done meanwhile through the file stream.
+
+	for(std::map<uint64_t, std::vector<unsigned char> >::const_iterator it(queue.begin());it!=queue.end();++it)
+	{
+		uint64_t written = 0 ;
+
+		while(written < it->second.size())
+		{
+			ssize_t n = pwrite(fdesc, &it->second[written], it->second.size() - written, (off_t)(it->first + written)) ;
+
+			if(n < 0 && errno == EINTR)
+				continue ;
+
+			if(n <= 0)
+				break ;
+
+			written += n ;
+		}
+
+		if(written < it->second.size())
+		{
+			std::cerr << "ftFileCreator::flushWriteQueue() Bad write at offset " << it->first << ", size=" << it->second.size() << ", errno=" << errno << std::endl;
+
+			RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+			locked_invalidateChunkHashes(it->first,it->second.size()) ;
+			ok = false ;
+		}
+	}
+
+	{
+		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+		mWriteInProgress = false ;
+	}
+#endif
+#ifdef FILE_DEBUG
+	std::cerr << "ftFileCreator::flushWriteQueue() wrote " << queue.size() << " blocks of " << file_name << std::endl;
+#endif
+	return ok ;
+}
+
+void ftFileCreator::locked_updateChunkHashes(uint64_t offset, uint32_t chunk_size)
+{
+	/* ALREADY LOCKED */
+
+	static const uint32_t CS = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
+
+	uint64_t end = offset + chunk_size ;
+
+	for(uint32_t c = offset / CS ; (uint64_t)c * CS < end ; ++c)
+	{
+		uint64_t chunk_start = (uint64_t)c * CS ;
+		uint64_t chunk_end = std::min(chunk_start + CS, mSize) ;
+
+		ftChunkHasher *& h(mChunkHashers[c]) ;
+
+		if(h == NULL)
+			h = new ftChunkHasher ;
+
+		if(!h->valid)
+			continue ;
+
+		// Data already hashed is received again. It may differ from what was hashed, so the chunk needs to be hashed from the disk.
+
+		if(std::max(offset,chunk_start) < chunk_start + h->hashed_size)
+		{
+			h->valid = false ;
+			continue ;
+		}
+
+		// Hash the queued data that follows what is already hashed. Data that was already written cannot be hashed
+		// anymore. It will be read from the disk when verifying the chunk.
+
+		while(chunk_start + h->hashed_size < chunk_end)
+		{
+			uint64_t pos = chunk_start + h->hashed_size ;
+
+			std::map<uint64_t, std::vector<unsigned char> >::const_iterator it = mWriteQueue.upper_bound(pos) ;
+
+			if(it == mWriteQueue.begin())
+				break ;
+
+			--it ;
+
+			if(it->first + it->second.size() <= pos)
+				break ;
+
+			uint64_t n = std::min(it->first + it->second.size(), chunk_end) - pos ;
+
+			SHA1_Update(&h->ctx, &it->second[pos - it->first], n) ;
+			h->hashed_size += n ;
+		}
+	}
+}
+
+void ftFileCreator::locked_invalidateChunkHashes(uint64_t offset, uint32_t chunk_size)
+{
+	/* ALREADY LOCKED */
+
+	static const uint32_t CS = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
+
+	for(uint32_t c = offset / CS ; (uint64_t)c * CS < offset + chunk_size ; ++c)
+	{
+		std::map<uint32_t, ftChunkHasher*>::iterator it = mChunkHashers.find(c) ;
+
+		if(it != mChunkHashers.end())
+			it->second->valid = false ;
+	}
+}
+
+void ftFileCreator::locked_clearChunkHashes()
+{
+	/* ALREADY LOCKED */
+
+	for(std::map<uint32_t, ftChunkHasher*>::iterator it(mChunkHashers.begin());it!=mChunkHashers.end();++it)
+		delete it->second ;
+
+	mChunkHashers.clear() ;
 }
 
 
@@ -471,7 +754,8 @@ void ftFileCreator::setChunkStrategy(FileChunksInfo::ChunkStrategy s)
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
 	// Let's check, for safety.
-	if(s != FileChunksInfo::CHUNK_STRATEGY_STREAMING && s != FileChunksInfo::CHUNK_STRATEGY_RANDOM && s != FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE)
+	if(s != FileChunksInfo::CHUNK_STRATEGY_STREAMING && s != FileChunksInfo::CHUNK_STRATEGY_RANDOM && s != FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE
+	        && s != FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST)
 	{
 		std::cerr << "ftFileCreator::ERROR: invalid chunk strategy " << s << "!" << " setting default value " << FileChunksInfo::CHUNK_STRATEGY_STREAMING << std::endl ;
 		s = FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE ;
@@ -531,7 +815,29 @@ bool ftFileCreator::getMissingChunk(const RsPeerId& peer_id,uint32_t size_hint,u
 	ftChunk chunk ;
 
 	if(!chunkMap.getDataChunk(peer_id,size_hint,chunk,source_chunk_map_needed))
+	{
+		// Nothing new to ask. At the end of the download, this peer may also ask what remains of a slice
+		// that is pending at a slower source. The data received first is kept, the other copy is dropped.
+
+		ftChunk::ChunkId slice_id ;
+
+		if(!chunkMap.getEndGameSlice(peer_id,slice_id))
+			return false ;
+
+		for(std::map<uint64_t,ftChunk>::iterator it(mChunks.begin());it!=mChunks.end();++it)
+			if(it->second.id == slice_id)
+			{
+				offset = it->second.offset ;
+				size   = it->second.size ;
+				it->second.ts = now ;
+#ifdef FILE_DEBUG
+				std::cerr << "ftFileCreator::getMissingChunk(): end game: also asking " << offset << " + " << size << " to peer " << peer_id << std::endl;
+#endif
+				return true ;
+			}
+
 		return false ;
+	}
 
 #ifdef FILE_DEBUG
 	std::cerr << "ffc::getMissingChunk() Retrieved new chunk: " << chunk << std::endl ;
@@ -625,6 +931,13 @@ bool ftFileCreator::sourceIsComplete(const RsPeerId& peer_id)
 	return chunkMap.getSourceChunksInfo(peer_id)->is_full ;
 }
 
+void ftFileCreator::setSourceRate(const RsPeerId& peer_id,uint32_t rate)
+{
+	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+	chunkMap.setSourceRate(peer_id,rate) ;
+}
+
 void ftFileCreator::setSourceMap(const RsPeerId& peer_id,const CompressedChunkMap& compressed_map)
 {
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
@@ -675,6 +988,7 @@ void ftFileCreator::forceCheck()
 {
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
+	locked_clearChunkHashes() ;	// check the data that is actually on disk
 	chunkMap.forceCheck(); 
 }
 
@@ -694,18 +1008,83 @@ void ftFileCreator::getChunksToCheck(std::vector<uint32_t>& chunks_to_ask)
 
 bool ftFileCreator::verifyChunk(uint32_t chunk_number,const Sha1CheckSum& sum)
 {
+	// The chunk data needs to be on disk before the chunk is marked as verified, and to read the part that was not hashed on reception.
+
+	flushWriteQueue() ;
+
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
 	if(!locked_initializeFileAttrs() )
 		return false ;
 
 	static const uint32_t chunk_size = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
-	unsigned char *buff = new unsigned char[chunk_size] ;
-	uint32_t len ;
+	uint64_t chunk_start = (uint64_t)chunk_number * (uint64_t)chunk_size ;
+	uint32_t len = (chunk_start < mSize)? std::min((uint64_t)chunk_size, mSize - chunk_start) : 0 ;
+
+	SHA_CTX ctx ;
+	uint32_t hashed_size = 0 ;
+
+	std::map<uint32_t, ftChunkHasher*>::iterator it = mChunkHashers.find(chunk_number) ;
+
+	if(it != mChunkHashers.end() && it->second->valid)
+	{
+		ctx = it->second->ctx ;
+		hashed_size = std::min(it->second->hashed_size, len) ;
+	}
+	else
+		SHA1_Init(&ctx) ;
+
+	if(it != mChunkHashers.end())
+	{
+		delete it->second ;
+		mChunkHashers.erase(it) ;
+	}
+
+	bool ok = (len > 0) ;
 
-	if(fseeko64(fd,(uint64_t)chunk_number * (uint64_t)chunk_size,SEEK_SET)==0 && (len = fread(buff,1,chunk_size,fd)) > 0)
+	if(ok && hashed_size < len)
 	{
-		Sha1CheckSum comp = RsDirUtil::sha1sum(buff,len) ;
+		uint32_t to_read = len - hashed_size ;
+		unsigned char *buff = new unsigned char[to_read] ;
+
+#ifdef WINDOWS_SYS
+		// Queued data is written through the file stream here, so its buffer is up to date.
+		ok = fseeko64(fd,chunk_start + hashed_size,SEEK_SET)==0 && fread(buff,1,to_read,fd) == to_read ;
+#else
+		// The data is written with pwrite(), so reading through the file stream may return stale buffered data.
+
+		uint32_t done = 0 ;
+
+		while(done < to_read)
+		{
+			ssize_t n = pread(fileno(fd), buff + done, to_read - done, (off_t)(chunk_start + hashed_size + done)) ;
+
+			if(n < 0 && errno == EINTR)
+				continue ;
+
+			if(n <= 0)
+				break ;
+
+			done += n ;
+		}
+		ok = (done == to_read) ;
+#endif
+
+		if(ok)
+			SHA1_Update(&ctx, buff, to_read) ;
+
+		delete[] buff ;
+	}
+#ifdef FILE_DEBUG
+	std::cerr << "ftFileCreator::verifyChunk(): chunk " << chunk_number << ": " << hashed_size << " bytes hashed on reception, " << len - hashed_size << " bytes read." << std::endl;
+#endif
+
+	if(ok)
+	{
+		unsigned char md[SHA_DIGEST_LENGTH] ;
+		SHA1_Final(md, &ctx) ;
+
+		Sha1CheckSum comp(md) ;
 
 		if(sum == comp)
 			chunkMap.setChunkCheckingResult(chunk_number,true) ;
@@ -724,9 +1103,5 @@ bool ftFileCreator::verifyChunk(uint32_t chunk_number,const Sha1CheckSum& sum)
 		chunkMap.setChunkCheckingResult(chunk_number,false) ;
 	}
 
-	delete[] buff ;
 	return true ;
 }
-
-
-
@@ -35,6 +35,10 @@
 #include "ftfileprovider.h"
 #include "ftchunkmap.h"
 #include <map>
+#include <vector>
+
+class ftFileWriter ;
+class ftChunkHasher ;
 
 class ZeroInitCounter
 {
@@ -47,7 +51,10 @@ class ftFileCreator: public ftFileProvider
 {
 	public:
 
-		ftFileCreator(const std::string& savepath, uint64_t size, const RsFileHash& hash,bool assume_availability);
+		// When a file writer is supplied, received data is written by the writer thread. Otherwise it is written
+		// by the thread that receives it, once enough data has been queued.
+		//
+		ftFileCreator(const std::string& savepath, uint64_t size, const RsFileHash& hash,bool assume_availability,ftFileWriter *writer = NULL);
 
 		~ftFileCreator();
 
@@ -109,10 +116,19 @@ class ftFileCreator: public ftFileProvider
 		time_t lastRecvTimeStamp() ;
 		time_t creationTimeStamp() ;
 
-		// actually store data in the file, and update chunks info
+		// Queues data to be stored in the file, and update chunks info
 		//
 		bool 	addFileData(uint64_t offset, uint32_t chunk_size, void *data);
 
+		// Actually writes the queued data into the file. Called by the file writer thread, and whenever the data
+		// needs to be on disk.
+		//
+		bool	flushWriteQueue() ;
+
+		// Number of separate writes the queued data makes, and its size.
+		//
+		void	getWriteQueueInfo(uint32_t& nb_blocks,uint32_t& size) ;
+
 		// Load/save the availability map for the file being downloaded, in a compact/compressed form.
 		// This is used for
 		// 	- loading and saving info about the current transfers
@@ -126,6 +142,11 @@ class ftFileCreator: public ftFileProvider
 		//
 		void setSourceMap(const RsPeerId& peer_id,const CompressedChunkMap& map) ;
 
+		// Transfer rate of that source in bytes/s, or 0 if it's not sending. Used to choose the slices to ask
+		// to faster sources at the end of the download.
+		//
+		void setSourceRate(const RsPeerId& peer_id,uint32_t rate) ;
+
 		// Returns true id the given file source is complete.
 		//
 		bool sourceIsComplete(const RsPeerId& peer_id) ;
@@ -138,6 +159,11 @@ class ftFileCreator: public ftFileProvider
 
 		bool 	locked_printChunkMap();
 		int 	locked_notifyReceived(uint64_t offset, uint32_t chunk_size);
+
+		void	locked_queueData(uint64_t offset, uint32_t chunk_size, const unsigned char *data) ;
+		void	locked_updateChunkHashes(uint64_t offset, uint32_t chunk_size) ;
+		void	locked_invalidateChunkHashes(uint64_t offset, uint32_t chunk_size) ;
+		void	locked_clearChunkHashes() ;
 		/* 
 		 * structure to track missing chunks 
 		 */
@@ -149,6 +175,23 @@ class ftFileCreator: public ftFileProvider
 
 		time_t _last_recv_time_t ;	/// last time stamp when data was received. Used for queue control.
 		time_t _creation_time ;		/// time at which the file creator was created. Used to spot long-inactive transfers.
+
+		/*
+		 * Write-behind queue. Received data is kept here, merged with adjacent data, until it is
+		 * written. Data is only written while holding ftcWriteMutex, which needs to be locked before ftcMutex.
+		 */
+		std::map<uint64_t, std::vector<unsigned char> > mWriteQueue ;	/// offset => data
+		uint32_t mWriteQueueSize ;
+		bool mWriteInProgress ;		/// data taken from the queue is being written
+
+		RsMutex ftcWriteMutex ;
+		ftFileWriter *mFileWriter ;
+
+		/*
+		 * SHA1 of the chunks being received, computed on contiguous data from the start of the chunk as
+		 * it arrives, so that verifying a chunk only needs to read from the disk the part that was not hashed.
+		 */
+		std::map<uint32_t, ftChunkHasher*> mChunkHashers ;	/// chunk number => hash context
 };
 
 #endif // FT_FILE_CREATOR_HEADER
@@ -4,11 +4,19 @@
 
 #include "ftfileprovider.h"
 #include "ftchunkmap.h"
+#include "ftchunkcache.h"
 
 #include "util/rsdir.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+#ifndef WINDOWS_SYS
+#include <unistd.h>
+#endif
 
 /********
 * #define DEBUG_FT_FILE_PROVIDER 1
@@ -22,8 +30,8 @@
 
 static const time_t UPLOAD_CHUNK_MAPS_TIME = 20 ;	// time to ask for a new chunkmap from uploaders in seconds.
 
-ftFileProvider::ftFileProvider(const std::string& path, uint64_t size, const RsFileHash& hash)
-	: mSize(size), hash(hash), file_name(path), fd(NULL), ftcMutex("ftFileProvider")
+ftFileProvider::ftFileProvider(const std::string& path, uint64_t size, const RsFileHash& hash, ftChunkCache *cache)
+	: mSize(size), hash(hash), file_name(path), fd(NULL), mCache(cache), ftcMutex("ftFileProvider")
 {
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
@@ -148,89 +156,160 @@ bool ftFileProvider::getFileData(const RsPeerId& peer_id,uint64_t offset, uint32
 		if (!initializeFileAttrs())
 			return false;
 
-	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+	uint32_t data_size ;
+	bool sequential ;
+	{
+		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
-	/* 
-	 * FIXME: Warning of comparison between unsigned and signed int?
-	 */
+		if(offset >= mSize)
+		{
+			std::cerr << "ftFileProvider::getFileData(): request (" << offset << ") exceeds file size (" << mSize << "! " << std::endl;
+			return false ;
+		}
 
-	if(offset >= mSize)
-	{
-		std::cerr << "ftFileProvider::getFileData(): request (" << offset << ") exceeds file size (" << mSize << "! " << std::endl;
-		return false ;
-	}
+		data_size = chunk_size;
 
-	uint32_t data_size    = chunk_size;
-	uint64_t base_loc     = offset;
-	
-	if (base_loc + data_size > mSize)
-	{
-		data_size = mSize - base_loc;
-		chunk_size = mSize - base_loc;
-		std::cerr <<"Chunk Size greater than total file size, adjusting chunk size " << data_size << std::endl;
-	}
+		if (offset + data_size > mSize)
+		{
+			data_size = mSize - offset;
+			chunk_size = mSize - offset;
+			std::cerr <<"Chunk Size greater than total file size, adjusting chunk size " << data_size << std::endl;
+		}
 
-	if(data_size > 0 && data != NULL)
-	{	
-		/*
-		 * seek for base_loc 
-		 */
-        if(fseeko64(fd, base_loc, SEEK_SET) == -1)
-        {
-            #ifdef DEBUG_FT_FILE_PROVIDER
-            std::cerr << "ftFileProvider::getFileData() Failed to seek. Data_size=" << data_size << ", base_loc=" << base_loc << " !" << std::endl;
-            #endif
-            //free(data); No!! It's already freed upwards in ftDataMultiplex::locked_handleServerRequest()
-            return 0;
-        }
-
-		// Data space allocated by caller.
-		//void *data = malloc(chunk_size);
-		
-		/* 
-		 * read the data 
-                 */
-		
-		if (1 != fread(data, data_size, 1, fd))
+		if(data_size == 0 || data == NULL)
 		{
-                        #ifdef DEBUG_FT_FILE_PROVIDER
-                        std::cerr << "ftFileProvider::getFileData() Failed to get data. Data_size=" << data_size << ", base_loc=" << base_loc << " !" << std::endl;
-                        #endif
-			//free(data); No!! It's already freed upwards in ftDataMultiplex::locked_handleServerRequest()
+			std::cerr << "No data to read, or NULL buffer used" << std::endl;
 			return 0;
 		}
 
-		/* 
-		 * Update status of ftFileStatus to reflect last usage (for GUI display)
-		 * We need to store.
-		 * (a) Id, 
-		 * (b) Offset, 
-		 * (c) Size, 
-		 * (d) timestamp
-		 */
+		// The peer downloads sequentially if it asks for the same chunk as before, or for the next one.
+
+		std::map<RsPeerId,PeerUploadInfo>::const_iterator it = uploading_peers.find(peer_id) ;
+
+		sequential = it != uploading_peers.end() && offset >= it->second.req_loc
+		                && offset / ftChunkCache::BLOCK_SIZE <= it->second.req_loc / ftChunkCache::BLOCK_SIZE + 1 ;
+	}
 
-		// This creates the peer info, and updates it.
-		//
-		time_t now = time(NULL) ;
-		uploading_peers[peer_id].updateStatus(offset,data_size,now) ;
+	// Data space allocated by caller.
+	// Don't free data on failure. It's already freed upwards in ftDataMultiplex::locked_handleServerRequest()
+
+	bool ok ;
+
+	if(mCache != NULL && mCache->getData(hash,offset,data_size,data))
+		ok = true ;
+	else if(mCache != NULL && sequential)
+		ok = readAhead(offset,data_size,data) ;
+	else
+		ok = readData(offset,data_size,data) ;
+
+	if(!ok)
+	{
+#ifdef DEBUG_FT_FILE_PROVIDER
+		std::cerr << "ftFileProvider::getFileData() Failed to get data. Data_size=" << data_size << ", base_loc=" << offset << " !" << std::endl;
+#endif
+		return 0;
+	}
+
+	/*
+	 * Update status of ftFileStatus to reflect last usage (for GUI display)
+	 * We need to store.
+	 * (a) Id,
+	 * (b) Offset,
+	 * (c) Size,
+	 * (d) timestamp
+	 */
+
+	// This creates the peer info, and updates it.
+	//
+	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+	time_t now = time(NULL) ;
+	uploading_peers[peer_id].updateStatus(offset,data_size,now) ;
 
 #ifdef DEBUG_TRANSFERS
-		std::cerr << "ftFileProvider::getFileData() ";
-		std::cerr << " at " << RsUtil::AccurateTimeString();
-		std::cerr << " hash: " << hash;
-		std::cerr << " for peerId: " << peer_id;
-		std::cerr << " offset: " << offset;
-		std::cerr << " chunkSize: " << chunk_size;
-		std::cerr << std::endl;
+	std::cerr << "ftFileProvider::getFileData() ";
+	std::cerr << " at " << RsUtil::AccurateTimeString();
+	std::cerr << " hash: " << hash;
+	std::cerr << " for peerId: " << peer_id;
+	std::cerr << " offset: " << offset;
+	std::cerr << " chunkSize: " << chunk_size;
+	std::cerr << std::endl;
 #endif
+	return 1;
+}
 
+bool ftFileProvider::readData(uint64_t offset, uint32_t size, void *data)
+{
+#ifdef WINDOWS_SYS
+	// No positional reads. The file stream is shared, so the lock is needed.
+
+	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+	if(fd == NULL)
+		return false ;
+
+	return fseeko64(fd, offset, SEEK_SET) == 0 && 1 == fread(data, size, 1, fd) ;
+#else
+	int fdesc ;
+	{
+		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+		if(fd == NULL)
+			return false ;
+
+		fdesc = fileno(fd) ;
 	}
-	else 
+
+	// Positional reads can be done concurrently, without the lock. The file is only closed by the
+	// destructor, or by ftFileCreator::closeFile(), which waits for the reads to finish.
+
+	uint32_t done = 0 ;
+
+	while(done < size)
 	{
-		std::cerr << "No data to read, or NULL buffer used" << std::endl;
-		return 0;
+		ssize_t n = pread(fdesc, (unsigned char*)data + done, size - done, (off_t)(offset + done)) ;
+
+		if(n < 0 && errno == EINTR)
+			continue ;
+
+		if(n <= 0)
+			return false ;
+
+		done += n ;
 	}
-	return 1;
+	return true ;
+#endif
+}
+
+bool ftFileProvider::readAhead(uint64_t offset, uint32_t size, void *data)
+{
+	// Reads the whole blocks the requested data lies in, and keeps them in the cache for the next requests
+	// of that peer, and of the other peers downloading the same file.
+
+	uint32_t first_block = offset / ftChunkCache::BLOCK_SIZE ;
+	uint32_t last_block = (offset + size - 1) / ftChunkCache::BLOCK_SIZE ;
+
+	for(uint32_t b=first_block;b<=last_block;++b)
+	{
+		uint64_t block_start = (uint64_t)b * ftChunkCache::BLOCK_SIZE ;
+		uint32_t block_size = std::min((uint64_t)ftChunkCache::BLOCK_SIZE, mSize - block_start) ;
+
+		std::vector<unsigned char> block(block_size) ;
+
+		if(!readData(block_start, block_size, &block[0]))
+			return false ;
+
+		uint64_t copy_start = std::max(offset, block_start) ;
+		uint64_t copy_end = std::min(offset + size, block_start + block_size) ;
+
+		memcpy((unsigned char*)data + (copy_start - offset), &block[copy_start - block_start], copy_end - copy_start) ;
+
+		mCache->addBlock(hash, b, block) ;
+	}
+#ifdef DEBUG_FT_FILE_PROVIDER
+	std::cerr << "ftFileProvider::readAhead() read blocks " << first_block << " to " << last_block << " of " << hash << std::endl;
+#endif
+	return true ;
 }
 
 void ftFileProvider::PeerUploadInfo::updateStatus(uint64_t offset,uint32_t data_size,time_t now)
@@ -35,10 +35,15 @@
 #include "util/rsthreads.h"
 #include "retroshare/rsfiles.h"
 
+class ftChunkCache ;
+
 class ftFileProvider
 {
 	public:
-		ftFileProvider(const std::string& path, uint64_t size, const RsFileHash& hash);
+		// When a cache is given, data is read ahead for peers that download sequentially, and shared with the
+		// other providers through the cache. Only used for complete files.
+		//
+		ftFileProvider(const std::string& path, uint64_t size, const RsFileHash& hash, ftChunkCache *cache = NULL);
 		virtual ~ftFileProvider();
 
         /**
@@ -76,10 +81,15 @@ class ftFileProvider
 	protected:
 		virtual	int initializeFileAttrs(); /* does for both */
 
+		// Reads from the disk. Not to be called with ftcMutex locked.
+		bool readData(uint64_t offset, uint32_t size, void *data);
+		bool readAhead(uint64_t offset, uint32_t size, void *data);
+
 		uint64_t    mSize;
 		RsFileHash hash;
 		std::string file_name;
 		FILE *fd;
+		ftChunkCache *mCache;
 
 		/* 
 		 * Structure to gather statistics FIXME: lastRequestor - figure out a 
@@ -0,0 +1,99 @@
+/*
+ * libretroshare/src/ft/ ftfilewriter.cc
+ *
+ * File Transfer for RetroShare.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <unistd.h>
+#include <algorithm>
+
+#include "ftfilewriter.h"
+#include "ftfilecreator.h"
+
+/*******
+ * #define FILE_WRITER_DEBUG 1
+ ******/
+
+// Time to wait when there is nothing to write. Meanwhile, the slices received for a file get merged into larger writes.
+static const uint32_t FILE_WRITER_IDLE_DELAY_US = 10*1000 ;
+
+ftFileWriter::ftFileWriter()
+	: mWriterMtx("ftFileWriter"), mCurrentFile(NULL)
+{
+}
+
+void ftFileWriter::notifyPending(ftFileCreator *fc)
+{
+	RsStackMutex stack(mWriterMtx); /********** STACK LOCKED MTX ******/
+
+	if(std::find(mPendingFiles.begin(),mPendingFiles.end(),fc) == mPendingFiles.end())
+		mPendingFiles.push_back(fc) ;
+}
+
+void ftFileWriter::removeFile(ftFileCreator *fc)
+{
+	while(true)
+	{
+		{
+			RsStackMutex stack(mWriterMtx); /********** STACK LOCKED MTX ******/
+
+			mPendingFiles.remove(fc) ;
+
+			if(mCurrentFile != fc)
+				return ;
+		}
+		usleep(1000) ;
+	}
+}
+
+bool ftFileWriter::flushNext()
+{
+	ftFileCreator *fc ;
+	{
+		RsStackMutex stack(mWriterMtx); /********** STACK LOCKED MTX ******/
+
+		if(mPendingFiles.empty())
+			return false ;
+
+		fc = mPendingFiles.front() ;
+		mPendingFiles.pop_front() ;
+		mCurrentFile = fc ;
+	}
+#ifdef FILE_WRITER_DEBUG
+	std::cerr << "ftFileWriter: writing data of " << fc->fileName() << std::endl;
+#endif
+	fc->flushWriteQueue() ;
+
+	RsStackMutex stack(mWriterMtx); /********** STACK LOCKED MTX ******/
+	mCurrentFile = NULL ;
+
+	return true ;
+}
+
+void ftFileWriter::flushAll()
+{
+	while(flushNext()) ;
+}
+
+void ftFileWriter::data_tick()
+{
+	if(!flushNext())
+		usleep(FILE_WRITER_IDLE_DELAY_US) ;
+}
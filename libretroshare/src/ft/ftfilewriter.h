@@ -0,0 +1,62 @@
+/*
+ * libretroshare/src/ft/ ftfilewriter.h
+ *
+ * File Transfer for RetroShare.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#pragma once
+
+/*
+ * ftFileWriter
+ *
+ * I/O thread shared by all file creators. Received data is queued in the ftFileCreator, which notifies
+ * the writer. The writer then flushes the queue of each notified file to the disk, so that the thread
+ * that handles incoming data does not wait on the disk.
+ */
+
+#include <list>
+#include "util/rsthreads.h"
+
+class ftFileCreator ;
+
+class ftFileWriter: public RsTickingThread
+{
+	public:
+		ftFileWriter() ;
+
+		// Asks for the queued data of that file to be written.
+		void notifyPending(ftFileCreator *fc) ;
+
+		// To be called before deleting the file creator. Waits for the file to be written, if it currently is.
+		void removeFile(ftFileCreator *fc) ;
+
+		// Writes all pending files in the calling thread. Used at shutdown, once the thread is stopped.
+		void flushAll() ;
+
+		virtual void data_tick() ;
+
+	private:
+		bool flushNext() ;
+
+		RsMutex mWriterMtx ;
+
+		std::list<ftFileCreator*> mPendingFiles ;
+		ftFileCreator *mCurrentFile ;	// file being written
+};
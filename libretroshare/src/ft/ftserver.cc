@@ -41,6 +41,8 @@
 #include "ft/ftcontroller.h"
 #include "ft/ftfileprovider.h"
 #include "ft/ftdatamultiplex.h"
+#include "ft/ftfilewriter.h"
+#include "ft/ftchunkcache.h"
 //#include "ft/ftdwlqueue.h"
 #include "turtle/p3turtle.h"
 #include "pqi/p3notify.h"
@@ -62,6 +64,7 @@
 
 static const time_t FILE_TRANSFER_LOW_PRIORITY_TASKS_PERIOD = 5 ;           // low priority tasks handling every 5 seconds
 static const time_t FILE_TRANSFER_MAX_DELAY_BEFORE_DROP_USAGE_RECORD = 10 ; // keep usage records for 10 secs at most.
+static const uint64_t FT_CHUNK_CACHE_SIZE = 32*1024*1024 ;                 // data of uploaded files kept in memory
 
 /* Setup */
 ftServer::ftServer(p3PeerMgr *pm, p3ServiceControl *sc)
@@ -69,7 +72,7 @@ ftServer::ftServer(p3PeerMgr *pm, p3ServiceControl *sc)
       mPeerMgr(pm), mServiceCtrl(sc),
       mFileDatabase(NULL),
       mFtController(NULL), mFtExtra(NULL),
-      mFtDataplex(NULL), mFtSearch(NULL), srvMutex("ftServer")
+      mFtDataplex(NULL), mFtFileWriter(NULL), mFtChunkCache(NULL), mFtSearch(NULL), srvMutex("ftServer")
 {
 	addSerialType(new RsFileTransferSerialiser()) ;
 }
@@ -141,10 +144,14 @@ void ftServer::SetupFtServer()
 
 	/* Transport */
 	mFtDataplex = new ftDataMultiplex(ownId, this, mFtSearch);
+	mFtFileWriter = new ftFileWriter();
+	mFtChunkCache = new ftChunkCache(FT_CHUNK_CACHE_SIZE);
+	mFtDataplex->setChunkCache(mFtChunkCache);
 
 	/* make Controller */
 	mFtController = new ftController(mFtDataplex, mServiceCtrl, getServiceInfo().mServiceType);
 	mFtController -> setFtSearchNExtra(mFtSearch, mFtExtra);
+	mFtController -> setFileWriter(mFtFileWriter);
 	std::string tmppath = ".";
 	mFtController->setPartialsDirectory(tmppath);
 	mFtController->setDownloadDirectory(tmppath);
@@ -191,6 +198,9 @@ void    ftServer::StartupThreads()
 
 	/* Dataplex */
 	mFtDataplex->start("ft dataplex");
+
+	/* Disk writes of downloaded data */
+	mFtFileWriter->start("ft writer");
 }
 
 void ftServer::StopThreads()
@@ -201,6 +211,10 @@ void ftServer::StopThreads()
 	/* stop Controller thread */
 	mFtController->join();
 
+	/* stop writer thread, and write what is left */
+	mFtFileWriter->join();
+	mFtFileWriter->flushAll();
+
 	/* self contained threads */
 	/* stop ExtraList Thread */
 	mFtExtra->join();
@@ -211,6 +225,12 @@ void ftServer::StopThreads()
 	delete (mFtController);
 	mFtController = NULL;
 
+	delete (mFtFileWriter);
+	mFtFileWriter = NULL;
+
+	delete (mFtChunkCache);
+	mFtChunkCache = NULL;
+
 	delete (mFtExtra);
 	mFtExtra = NULL;
 
@@ -240,6 +260,11 @@ bool ftServer::getFileData(const RsFileHash& hash, uint64_t offset, uint32_t& re
 	return mFtDataplex->getFileData(hash, offset, requested_size,data);
 }
 
+void ftServer::getChunkCacheStats(ftChunkCacheStats& stats)
+{
+	mFtChunkCache->getStats(stats);
+}
+
 bool ftServer::alreadyHaveFile(const RsFileHash& hash, FileInfo &info)
 {
 	return mFileDatabase->search(hash, RS_FILE_HINTS_LOCAL, info);
@@ -850,6 +875,7 @@ void ftServer::setMaxShareDepth(int depth)         { mFileDatabase->setMaxShareD
 
 void ftServer::togglePauseHashingProcess()  { mFileDatabase->togglePauseHashingProcess() ; }
 bool ftServer::hashingProcessPaused() { return mFileDatabase->hashingProcessPaused() ; }
+void ftServer::getHashingStats(std::vector<HashStorageWorkerStats>& stats) { mFileDatabase->getHashingStats(stats) ; }
 
 bool ftServer::getShareDownloadDirectory()
 {
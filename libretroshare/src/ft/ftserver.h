@@ -62,6 +62,9 @@ class ftExtraList;
 class ftFileSearch;
 
 class ftDataMultiplex;
+class ftFileWriter;
+class ftChunkCache;
+struct ftChunkCacheStats;
 class p3turtle;
 
 class p3PeerMgr;
@@ -116,6 +119,9 @@ public:
     ftDataMultiplex *getMultiplexer() const { return mFtDataplex ; }
     ftController *getController() const { return mFtController ; }
 
+    // hits/misses of the cache of uploaded file data
+    void getChunkCacheStats(ftChunkCacheStats& stats) ;
+
     /**
          * @see RsFiles::getFileData
          */
@@ -227,6 +233,7 @@ public:
 	virtual void setFollowSymLinks(bool b);
 	virtual void togglePauseHashingProcess();
 	virtual bool hashingProcessPaused();
+	virtual void getHashingStats(std::vector<HashStorageWorkerStats>& stats) ;
 
 	virtual void setMaxShareDepth(int depth) ;
 	virtual int  maxShareDepth() const;
@@ -299,6 +306,8 @@ private:
     ftController     *mFtController;
     ftExtraList      *mFtExtra;
     ftDataMultiplex  *mFtDataplex;
+    ftFileWriter     *mFtFileWriter;
+    ftChunkCache     *mFtChunkCache;
     p3turtle         *mTurtleRouter ;
     ftFileSearch     *mFtSearch;
 
@@ -28,8 +28,10 @@
  *****/
 
 #include <time.h>
+#include <math.h>
 
 #include "retroshare/rsturtle.h"
+#include "util/rsscopetimer.h"
 #include "fttransfermodule.h"
 
 /*************************************************************************
@@ -62,6 +64,18 @@ const double FT_TM_RATE_INCREASE_SLOWER  = 0.05 ;
 const double FT_TM_RATE_INCREASE_AVERAGE = 0.3 ;
 const double FT_TM_RATE_INCREASE_FASTER  = 1.0 ;
 
+const uint32_t FT_TM_INITIAL_WINDOW        = 64 * 1024;	/* 64KB */
+const uint32_t FT_TM_MINIMUM_WINDOW        = 16 * 1024;	/* 16KB */
+const uint32_t FT_TM_MAXIMUM_WINDOW        = 64 * 1024 * 1024; /* 64MB */
+const double   FT_TM_REQUEST_PERIOD        = 1.0;	/* requests are sent once per tick of the controller */
+const double   FT_TM_MIN_RTO               = 3.0;	/* seconds */
+const double   FT_TM_MAX_RTO               = FT_TM_DOWNLOAD_TIMEOUT;
+const double   FT_TM_MIN_RTT               = 0.001;	/* seconds */
+const time_t   FT_TM_MIN_RTT_PERIOD        = 30;	/* min rtt is forgotten after 30 seconds */
+const double   FT_TM_MAX_RATE_DECAY        = 0.95;	/* per tick */
+const double   FT_TM_SLOW_START_GROWTH     = 1.25;	/* rate increase that keeps slow start going */
+const uint32_t FT_TM_SLOW_START_ROUNDS     = 3;	/* ticks without such an increase before leaving slow start */
+
 //const int32_t FT_TM_FAST_RTT    = 1.0;
 //const int32_t FT_TM_STD_RTT     = 5.0;
 //const int32_t FT_TM_SLOW_RTT    = 20.0;
@@ -76,6 +90,21 @@ const double FT_TM_RATE_INCREASE_FASTER  = 1.0 ;
 #define FT_TM_FLAG_CHECKING 		3
 #define FT_TM_FLAG_CHUNK_CRC 		4
 
+void peerInfo::resetWindow()
+{
+	window = FT_TM_INITIAL_WINDOW;
+	inFlight = 0;
+	slowStart = true;
+	fullRate = 0;
+	fullRateCount = 0;
+	maxRate = 0;
+	srtt = 0;
+	rttVar = 0;
+	minRtt = 0;
+	minRttTS = 0;
+	pendingRequests.clear();
+}
+
 ftTransferModule::ftTransferModule(ftFileCreator *fc, ftDataMultiplex *dm, ftController *c)
 	:mFileCreator(fc), mMultiplexor(dm), mFtController(c), tfMtx("ftTransferModule"), mFlag(FT_TM_FLAG_DOWNLOADING),mPriority(SPEED_NORMAL)
 {
@@ -267,6 +296,21 @@ bool ftTransferModule::getPeerState(const RsPeerId& peerId,uint32_t &state,uint3
   return true;
 }
 
+bool ftTransferModule::getPeerTransferStats(const RsPeerId& peerId,TransferInfo& info)
+{
+  	RsStackMutex stack(tfMtx); /******* STACK LOCKED ******/
+  std::map<RsPeerId,peerInfo>::iterator mit;
+  mit = mFileSources.find(peerId);
+
+  if (mit == mFileSources.end()) return false;
+
+  info.rtt = (mit->second).srtt;
+  info.window = (mit->second).window;
+  info.inFlight = (mit->second).inFlight;
+
+  return true;
+}
+
 uint32_t ftTransferModule::getDataRate(const RsPeerId& peerId)
 {
   	RsStackMutex stack(tfMtx); /******* STACK LOCKED ******/
@@ -431,6 +475,8 @@ bool ftTransferModule::queryInactive()
 	for(mit = mFileSources.begin(); mit != mFileSources.end(); ++mit)
 	{
 		locked_tickPeerTransfer(mit->second);
+
+		mFileCreator->setSourceRate(mit->first, (mit->second.state == PQIPEER_DOWNLOADING)?(uint32_t)mit->second.actualRate:0) ;
 	}
 	if(mFileCreator->finished())	// transfer is complete
 	{
@@ -674,6 +720,13 @@ void ftTransferModule::adjustSpeed()
  *
  * request very tick, at rate
  *
+ * The data requested to each peer and not received yet is limited by a window, which is sized
+ * after the bandwidth delay product of that peer: max recent rate x (min rtt + request period).
+ * The window is multiplied by a gain that depends on the download priority, so that the rate
+ * can keep increasing. Much like TCP, a new source starts in slow start (the window grows with
+ * every byte received) until the rate stops increasing, and requests that are not answered in
+ * time halve the window. This way, sources behind long multi-hop tunnels get enough requests
+ * to fill the pipe, while slow sources don't get their queues filled up.
  *
  **/
 
@@ -725,12 +778,14 @@ bool ftTransferModule::locked_tickPeerTransfer(peerInfo &info)
 		info.state = PQIPEER_DOWNLOADING;
 		info.recvTS = ts; /* reset to activate */
 		info.nResets = std::min(FT_TM_MAX_RESETS,info.nResets + 1);
+		info.resetWindow();
 		ageRecv = 0;
 	}
 
 	if (ageRecv > (int) FT_TM_DOWNLOAD_TIMEOUT)
 	{
 		info.state = PQIPEER_IDLE;
+		info.resetWindow();
 		return false;
 	}
 #ifdef FT_DEBUG
@@ -744,8 +799,27 @@ bool ftTransferModule::locked_tickPeerTransfer(peerInfo &info)
 		info.actualRate = info.actualRate * 0.75 + 0.25 * info.lastTransfers / (float)ageReq;
 		info.lastTransfers = 0;
 		info.lastTS = ts;
+
+		info.maxRate = std::max(info.actualRate, info.maxRate * FT_TM_MAX_RATE_DECAY);
+
+		/* leave slow start when the rate doesn't increase anymore */
+		if (info.slowStart)
+		{
+			if (info.actualRate >= info.fullRate * FT_TM_SLOW_START_GROWTH)
+			{
+				info.fullRate = info.actualRate;
+				info.fullRateCount = 0;
+			}
+			else if (++info.fullRateCount >= FT_TM_SLOW_START_ROUNDS)
+			{
+				info.slowStart = false;
+				locked_updateWindow(info, 0);
+			}
+		}
 	}
 
+	locked_checkPendingRequests(info, RsScopeTimer::currentTime());
+
 	/****************
 	 * NOTE: If we continually increase the request rate thus: ...
 	 * uint32_t next_req = info.actualRate * 1.25;
@@ -776,8 +850,8 @@ bool ftTransferModule::locked_tickPeerTransfer(peerInfo &info)
 //		}
 //	}
 
-	/* request at more than current rate */
-	uint32_t next_req = info.actualRate * (1.0 + info.mRateIncrease);
+	/* request what the window allows */
+	uint32_t next_req = (info.window > info.inFlight)?(info.window - info.inFlight):0;
 #ifdef FT_DEBUG
 	std::cerr << "locked_tickPeerTransfer() actual rate (after): " << actualRate 
 				<< " info.desiredRate=" << info.desiredRate 
@@ -809,6 +883,9 @@ bool ftTransferModule::locked_tickPeerTransfer(peerInfo &info)
 
 	if (next_req < FT_TM_MINIMUM_CHUNK)
 	{
+		if (info.inFlight > 0)	/* window is full. Wait for the data. */
+			return true;
+
 		next_req = FT_TM_MINIMUM_CHUNK;
 #ifdef FT_DEBUG
 		std::cerr << "locked_tickPeerTransfer() small chunk: next_req: " << next_req;
@@ -835,13 +912,15 @@ bool ftTransferModule::locked_tickPeerTransfer(peerInfo &info)
 			info.state = PQIPEER_DOWNLOADING;
 			locked_requestData(info.peerId,req_offset,req_size);
 
-			/* start next rtt measurement */
-			if (!info.rttActive)
-			{
-				info.rttStart = ts;
-				info.rttActive = true;
-				info.rttOffset = req_offset + req_size;
-			}
+			/* keep track of the request for rtt measurement. Old pending chunks may be asked again. */
+			std::map<uint64_t,ftDataRequest>::iterator pit = info.pendingRequests.find(req_offset);
+
+			if (pit != info.pendingRequests.end())
+				info.inFlight -= std::min(pit->second.remaining, info.inFlight);
+
+			info.pendingRequests[req_offset] = ftDataRequest(req_offset + req_size, req_size, RsScopeTimer::currentTime());
+			info.inFlight += req_size;
+
 			next_req -= std::min(req_size,next_req) ;
 		}
 		else
@@ -862,7 +941,6 @@ bool ftTransferModule::locked_recvPeerData(peerInfo &info, uint64_t offset, uint
 #ifdef FT_DEBUG
 	std::cerr << "ftTransferModule::locked_recvPeerData()";
 	std::cerr << " peerId: " << info.peerId;
-	std::cerr << " rttOffset: " << info.rttOffset;
 	std::cerr << " lastTransfers: " << info.lastTransfers;
 	std::cerr << " offset: " << offset;
 	std::cerr << " chunksize: " << chunk_size;
@@ -875,47 +953,110 @@ bool ftTransferModule::locked_recvPeerData(peerInfo &info, uint64_t offset, uint
   info.state = PQIPEER_DOWNLOADING;
   info.lastTransfers += chunk_size;
 
-   if ((info.rttActive) && (info.rttOffset == offset + chunk_size))
-   {
- 	  /* update tip */
- 	  int32_t rtt = time(NULL) - info.rttStart;
- 
- 	  /* 
- 		* FT_TM_FAST_RTT = 1 sec. mRateIncrease =  1.00
- 		* FT_TM_SLOW_RTT =20 sec. mRateIncrease =  0
- 		* 		   11 sec. mRateIncrease = -0.25
- 		* if it is slower than this allow fast data increase.
- 		* initial guess - linear with rtt.
- 		* change if this leads to wild oscillations 
- 		*
- 		*/
- 
-// 	  info.mRateIncrease = (FT_TM_SLOW_RTT - rtt) * 
-// 		  (FT_TM_MAX_INCREASE / (FT_TM_SLOW_RTT - FT_TM_FAST_RTT));
-// 
-// 	  if (info.mRateIncrease > FT_TM_MAX_INCREASE)
-// 		  info.mRateIncrease = FT_TM_MAX_INCREASE;
-// 
-// 	  if (info.mRateIncrease < FT_TM_MIN_INCREASE)
-// 		  info.mRateIncrease = FT_TM_MIN_INCREASE;
- 
+	/* find the request this data belongs to */
+	std::map<uint64_t,ftDataRequest>::iterator pit = info.pendingRequests.upper_bound(offset);
+
+	if (pit == info.pendingRequests.begin())
+		return true;
+	--pit;
+
+	if (offset >= pit->second.end)
+		return true;
+
+	uint32_t received = std::min(chunk_size, pit->second.remaining);
+	pit->second.remaining -= received;
+	info.inFlight -= std::min(received, info.inFlight);
+
+	if ((offset + chunk_size >= pit->second.end) || (pit->second.remaining == 0))
+	{
+		/* request complete: update rtt (same estimator as TCP) */
+		/* srtt == 0 means no sample yet, so the rtt is at least the clock resolution */
+		double rtt = std::max(FT_TM_MIN_RTT, RsScopeTimer::currentTime() - pit->second.sendTS);
+		info.pendingRequests.erase(pit);
+
+		if (info.srtt == 0)
+		{
+			info.srtt = rtt;
+			info.rttVar = rtt / 2;
+		}
+		else
+		{
+			info.rttVar = 0.75 * info.rttVar + 0.25 * fabs(info.srtt - rtt);
+			info.srtt = 0.875 * info.srtt + 0.125 * rtt;
+		}
+
+		if (info.minRtt == 0 || rtt <= info.minRtt || ts > info.minRttTS + FT_TM_MIN_RTT_PERIOD)
+		{
+			info.minRtt = rtt;
+			info.minRttTS = ts;
+		}
+
 	  switch(mPriority)
 	  {
 		  case SPEED_LOW  	: info.mRateIncrease = FT_TM_RATE_INCREASE_SLOWER ; break ;
 		  case SPEED_NORMAL	: info.mRateIncrease = FT_TM_RATE_INCREASE_AVERAGE; break ;
 		  case SPEED_HIGH  	: info.mRateIncrease = FT_TM_RATE_INCREASE_FASTER ; break ;
 	  }
- 	  info.rtt = rtt;
- 	  info.rttActive = false;
 
 #ifdef FT_DEBUG
 	  std::cerr << "ftTransferModule::locked_recvPeerData()";
-	  std::cerr << "Updated Rate based on RTT: " << rtt;
-	  std::cerr << " Rate increase: " << 1.0+info.mRateIncrease;
+	  std::cerr << " rtt: " << rtt << " srtt: " << info.srtt << " min rtt: " << info.minRtt;
+	  std::cerr << " window: " << info.window << " in flight: " << info.inFlight;
 	  std::cerr << std::endl;
 #endif
+	}
+
+	locked_updateWindow(info, received);
 
-  }
   return true;
 }
 
+void ftTransferModule::locked_updateWindow(peerInfo &info, uint32_t received)
+{
+	if (info.slowStart)
+		info.window += received;
+	else
+	{
+		/* bandwidth delay product, with one request period since requests are sent once per tick */
+		double rtt = (info.minRtt > 0)?info.minRtt:info.srtt;
+		double bdp = info.maxRate * (rtt + FT_TM_REQUEST_PERIOD);
+
+		info.window = std::min((double)FT_TM_MAXIMUM_WINDOW, (1.0 + info.mRateIncrease) * bdp);
+	}
+
+	info.window = std::max(FT_TM_MINIMUM_WINDOW, std::min(FT_TM_MAXIMUM_WINDOW, info.window));
+}
+
+void ftTransferModule::locked_checkPendingRequests(peerInfo &info, double ts)
+{
+	double rto = FT_TM_MAX_RTO;
+
+	if (info.srtt > 0)
+		rto = std::max(FT_TM_MIN_RTO, std::min(FT_TM_MAX_RTO, info.srtt + 4 * info.rttVar));
+
+	bool lost = false;
+
+	for (std::map<uint64_t,ftDataRequest>::iterator it = info.pendingRequests.begin(); it != info.pendingRequests.end();)
+		if (ts > it->second.sendTS + rto || ts < it->second.sendTS)	/* the clock wraps every 10000 s */
+		{
+			/* The file creator asks for the missing data again when needed. */
+			info.inFlight -= std::min(it->second.remaining, info.inFlight);
+			info.pendingRequests.erase(it++);
+			lost = true;
+		}
+		else
+			++it;
+
+	if (lost)
+	{
+		info.slowStart = false;
+		info.maxRate = info.actualRate;
+		info.window = std::max(FT_TM_MINIMUM_WINDOW, info.window / 2);
+#ifdef FT_DEBUG
+		std::cerr << "ftTransferModule::locked_checkPendingRequests() requests timed out for peer " << info.peerId;
+		std::cerr << ". Window: " << info.window << std::endl;
+#endif
+	}
+}
+
+
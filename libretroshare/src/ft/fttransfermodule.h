@@ -53,26 +53,41 @@ const uint32_t  PQIPEER_SUSPEND              = 0x0010;
 
 class HashThread ;
 
+// Data requested to a source and not received yet. Requests are answered by one or more data items,
+// the last of which ends at the end of the request.
+class ftDataRequest
+{
+public:
+	ftDataRequest() : end(0), remaining(0), sendTS(0) {}
+	ftDataRequest(uint64_t end_in,uint32_t size_in,double ts_in) : end(end_in), remaining(size_in), sendTS(ts_in) {}
+
+	uint64_t end;
+	uint32_t remaining;
+	double   sendTS;
+};
+
 class peerInfo
 {
 public:
 	explicit peerInfo(const RsPeerId& peerId_in):peerId(peerId_in),state(PQIPEER_NOT_ONLINE),desiredRate(0),actualRate(0),
 		lastTS(0),
 		recvTS(0), lastTransfers(0), nResets(0), 
-		rtt(0), rttActive(false), rttStart(0), rttOffset(0),
 		mRateIncrease(1)
 	{
-		return;
+		resetWindow() ;
 	}
 	peerInfo(const RsPeerId& peerId_in,uint32_t state_in,uint32_t maxRate_in):
 		peerId(peerId_in),state(state_in),desiredRate(maxRate_in),actualRate(0),
 		lastTS(0),
 		recvTS(0), lastTransfers(0), nResets(0), 
-		rtt(0), rttActive(false), rttStart(0), rttOffset(0),
 		mRateIncrease(1)
 	{
-		return;
+		resetWindow() ;
 	}
+
+	// Back to the initial state of the window controller, for sources that start or restart after being idle.
+	void resetWindow() ;
+
   	RsPeerId peerId;
   	uint32_t state;
   	double desiredRate;
@@ -83,12 +98,20 @@ public:
 	uint32_t lastTransfers; /* data recvd in last second */
 	uint32_t nResets; /* count to disable non-existant files */
 
-	/* rrt rate control */
-	uint32_t rtt;       /* last rtt */
-	bool     rttActive; /* have we initialised an rtt measurement */
-	time_t	 rttStart;  /* ts of request */
-	uint64_t rttOffset; /* end of request */
-	float    mRateIncrease; /* current rate */
+	/* window based rate control */
+	uint32_t window;	/* max bytes requested and not received yet */
+	uint32_t inFlight;	/* bytes requested and not received yet */
+	bool     slowStart;	/* window grows with every byte received until the rate stops increasing */
+	double   fullRate;	/* rate at the last significant increase during slow start */
+	uint32_t fullRateCount; /* ticks since that increase */
+	double   maxRate;	/* max recent rate (slowly decaying) */
+	double   srtt;		/* smoothed rtt (seconds) */
+	double   rttVar;	/* rtt variation */
+	double   minRtt;	/* min rtt over the last FT_TM_MIN_RTT_PERIOD seconds */
+	time_t   minRttTS;
+	std::map<uint64_t,ftDataRequest> pendingRequests; /* indexed by start offset */
+
+	float    mRateIncrease; /* window gain over the bandwidth delay product */
 };
 
 class ftFileStatus
@@ -130,6 +153,7 @@ public:
   bool setPeerState(const RsPeerId& peerId,uint32_t state,uint32_t maxRate);  //state = ONLINE/OFFLINE
   bool getFileSources(std::list<RsPeerId> &peerIds);
   bool getPeerState(const RsPeerId& peerId,uint32_t &state,uint32_t &tfRate);
+  bool getPeerTransferStats(const RsPeerId& peerId,TransferInfo& info);	// fills rtt/window/inFlight
   uint32_t getDataRate(const RsPeerId& peerId);
   bool cancelTransfer();
   bool cancelFileTransferUpward();
@@ -166,6 +190,8 @@ private:
   bool locked_tickPeerTransfer(peerInfo &info);
   bool locked_recvPeerData(peerInfo &info, uint64_t offset,
 			uint32_t chunk_size, void *data);
+  void locked_checkPendingRequests(peerInfo &info, double ts);
+  void locked_updateWindow(peerInfo &info, uint32_t received);
   
   bool checkFile() ;
   bool checkCRC() ;
@@ -49,6 +49,16 @@
 
 #define MSG_INDEX_GRPID std::string("INDEX_MESSAGES_GRPID")
 
+// composite indices used by msg meta queries (database release 2)
+#define MSG_INDEX_GRPID_THREADID   std::string("INDEX_MESSAGES_GRPID_THREADID")
+#define MSG_INDEX_GRPID_PARENTID   std::string("INDEX_MESSAGES_GRPID_PARENTID")
+#define MSG_INDEX_GRPID_ORIGMSGID  std::string("INDEX_MESSAGES_GRPID_ORIGMSGID")
+#define MSG_INDEX_GRPID_TIMESTAMP  std::string("INDEX_MESSAGES_GRPID_TIMESTAMP")
+#define MSG_INDEX_GRPID_IDENTITY   std::string("INDEX_MESSAGES_GRPID_IDENTITY")
+
+// number of msgs serialised before being inserted with one prepared statement
+#define MSG_STORE_BATCH_SIZE 64
+
 // generic
 #define KEY_NXS_DATA        std::string("nxsData")
 #define KEY_NXS_DATA_LEN    std::string("nxsDataLen")
@@ -122,13 +132,14 @@ static int addColumn(std::list<std::string> &list, const std::string &attribute)
 }
 
 RsDataService::RsDataService(const std::string &serviceDir, const std::string &dbName, uint16_t serviceType,
-                             RsGxsSearchModule * /* mod */, const std::string& key)
+                             RsGxsSearchModule * /* mod */, const std::string& key, const RetroDbProfile& profile)
     : RsGeneralDataService(), mDbMutex("RsDataService"), mServiceDir(serviceDir), mDbName(dbName), mDbPath(mServiceDir + "/" + dbName), mServType(serviceType), mDb(NULL)
 {
     bool isNewDatabase = !RsDirUtil::fileExists(mDbPath);
     mGrpMetaDataCache_ContainsAllDatabase = false ;
 
     mDb = new RetroDb(mDbPath, RetroDb::OPEN_READWRITE_CREATE, key);
+    mDb->applyProfile(profile);
 
     initialise(isNewDatabase);
 
@@ -293,9 +304,22 @@ static bool moveDataFromFileToDatabase(RetroDb *db, const std::string serviceDir
     return ok;
 }
 
+bool RsDataService::createMsgQueryIndices()
+{
+    bool ok = true;
+
+    ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_THREADID  + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_MSG_THREAD_ID + ");");
+    ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_PARENTID  + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_MSG_PARENT_ID + ");");
+    ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_ORIGMSGID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_ORIG_MSG_ID + ");");
+    ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_TIMESTAMP + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_TIME_STAMP + ");");
+    ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_IDENTITY  + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_NXS_IDENTITY + ");");
+
+    return ok;
+}
+
 void RsDataService::initialise(bool isNewDatabase)
 {
-    const int databaseRelease = 1;
+    const int databaseRelease = 2;
     int currentDatabaseRelease = 0;
     bool ok = true;
 
@@ -370,6 +394,7 @@ void RsDataService::initialise(bool isNewDatabase)
                 + std::string("END;"));
 
         mDb->execSQL("CREATE INDEX " + MSG_INDEX_GRPID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID +  ");");
+        createMsgQueryIndices();
 
         // Insert release, no need to upgrade
         ContentValue cv;
@@ -445,6 +470,18 @@ void RsDataService::initialise(bool isNewDatabase)
                 currentDatabaseRelease = newRelease;
             }
         }
+
+        // Release 2
+        newRelease = 2;
+        if (ok && currentDatabaseRelease < newRelease) {
+            // Add the indices used by msg meta queries
+            ok = startReleaseUpdate(newRelease);
+            ok = ok && createMsgQueryIndices();
+            ok = finishReleaseUpdate(newRelease, ok);
+            if (ok) {
+                currentDatabaseRelease = newRelease;
+            }
+        }
     }
 
     if (ok) {
@@ -731,6 +768,10 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
     // start a transaction
     mDb->beginTransaction();
 
+    // rows are inserted in batches sharing one prepared statement
+    std::list<ContentValue*> cvs;
+    bool ok = true;
+
     for(std::list<RsNxsMsg*>::const_iterator mit = msg.begin(); mit != msg.end(); ++mit)
     {
         RsNxsMsg* msgPtr = *mit;
@@ -753,7 +794,9 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
             continue;
         }
 
-        ContentValue cv;
+        ContentValue* cvPtr = new ContentValue;
+        ContentValue& cv = *cvPtr;
+        cvs.push_back(cvPtr);
 
         uint32_t dataLen = msgPtr->msg.TlvSize();
         char msgData[dataLen];
@@ -793,27 +836,42 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
         cv.put(KEY_MSG_STATUS, (int32_t)msgMetaPtr->mMsgStatus);
         cv.put(KEY_CHILD_TS, (int32_t)msgMetaPtr->mChildTs);
 
-        if (!mDb->sqlInsert(MSG_TABLE_NAME, "", cv))
-        {
-            std::cerr << "RsDataService::storeMessage() sqlInsert Failed";
-            std::cerr << std::endl;
-            std::cerr << "\t For GroupId: " << msgMetaPtr->mGroupId.toStdString();
-            std::cerr << std::endl;
-            std::cerr << "\t & MessageId: " << msgMetaPtr->mMsgId.toStdString();
-            std::cerr << std::endl;
-        }
+        if(cvs.size() >= MSG_STORE_BATCH_SIZE)
+            ok &= locked_insertMsgBatch(cvs);
 
         // This is needed so that mLastPost is correctly updated in the group meta when it is re-loaded.
 
         locked_clearGrpMetaCache(msgMetaPtr->mGroupId);
     }
 
+    ok &= locked_insertMsgBatch(cvs);
+
+    if(!ok)
+    {
+        std::cerr << "RsDataService::storeMessage() sqlInsert Failed for some of the " << msg.size() << " msgs";
+        std::cerr << std::endl;
+    }
+
     // finish transaction
     bool ret = mDb->commitTransaction();
 
     return ret;
 }
 
+bool RsDataService::locked_insertMsgBatch(std::list<ContentValue*>& cvs)
+{
+    if(cvs.empty())
+        return true;
+
+    bool ok = mDb->sqlInsert(MSG_TABLE_NAME, "", cvs);
+
+    for(std::list<ContentValue*>::iterator cit = cvs.begin(); cit != cvs.end(); ++cit)
+        delete *cit;
+
+    cvs.clear();
+    return ok;
+}
+
 bool RsDataService::validSize(RsNxsMsg* msg) const
 {
     if((msg->msg.TlvSize() + msg->meta.TlvSize()) <= GXS_MAX_ITEM_SIZE) return true;
@@ -1021,7 +1079,7 @@ int RsDataService::updateGroup(const std::list<RsNxsGrp *> &grp)
         cv.put(KEY_GRP_STATUS, (int32_t)grpMetaPtr->mGroupStatus);
         cv.put(KEY_GRP_LAST_POST, (int32_t)grpMetaPtr->mLastPost);
 
-        mDb->sqlUpdate(GRP_TABLE_NAME, "grpId='" + grpPtr->grpId.toStdString() + "'", cv);
+        mDb->sqlUpdate(GRP_TABLE_NAME, KEY_GRP_ID + "=?", std::list<std::string>(1, grpPtr->grpId.toStdString()), cv);
 
         locked_updateGrpMetaCache(*grpMetaPtr);
     }
@@ -1051,7 +1109,7 @@ int RsDataService::updateGroupKeys(const RsGxsGroupId& grpId,const RsTlvSecurity
     cv.put(KEY_KEY_SET, keys.TlvSize(), keySetData);
     cv.put(KEY_GRP_SUBCR_FLAG, (int32_t)subscribe_flags);
 
-    mDb->sqlUpdate(GRP_TABLE_NAME, "grpId='" + grpId.toStdString() + "'", cv);
+    mDb->sqlUpdate(GRP_TABLE_NAME, KEY_GRP_ID + "=?", std::list<std::string>(1, grpId.toStdString()), cv);
 
     // finish transaction
     return  mDb->commitTransaction();
@@ -1105,7 +1163,7 @@ int RsDataService::retrieveNxsGrps(std::map<RsGxsGroupId, RsNxsGrp *> &grp, bool
         for(; mit != grp.end(); ++mit)
         {
             const RsGxsGroupId& grpId = mit->first;
-            RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, withMeta ? mGrpColumnsWithMeta : mGrpColumns, "grpId='" + grpId.toStdString() + "'", "");
+            RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, withMeta ? mGrpColumnsWithMeta : mGrpColumns, KEY_GRP_ID + "=?", std::list<std::string>(1, grpId.toStdString()), "");
 
             if(c)
             {
@@ -1185,7 +1243,7 @@ int RsDataService::retrieveNxsMsgs(const GxsMsgReq &reqIds, GxsMsgResult &msg, b
 
             RsStackMutex stack(mDbMutex);
 
-            RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
+            RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID + "=?", std::list<std::string>(1, grpId.toStdString()), "");
 
             if(c)
             {
@@ -1203,8 +1261,12 @@ int RsDataService::retrieveNxsMsgs(const GxsMsgReq &reqIds, GxsMsgResult &msg, b
 
                 RsStackMutex stack(mDbMutex);
 
-                RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID+ "='" + grpId.toStdString()
-                                               + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
+                std::list<std::string> selectionArgs;
+                selectionArgs.push_back(grpId.toStdString());
+                selectionArgs.push_back(msgId.toStdString());
+
+                RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns,
+                                               KEY_GRP_ID + "=? AND " + KEY_MSG_ID + "=?", selectionArgs, "");
 
                 if(c)
                 {
@@ -1270,7 +1332,7 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
         std::vector<RsGxsMsgMetaData*> metaSet;
 
         if(msgIdV.empty()){
-            RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
+            RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID + "=?", std::list<std::string>(1, grpId.toStdString()), "");
 
             if (c)
             {
@@ -1286,8 +1348,12 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
 
             for(; sit!=msgIdV.end(); ++sit){
                 const RsGxsMessageId& msgId = *sit;
-                RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString()
-                                               + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
+
+                std::list<std::string> selectionArgs;
+                selectionArgs.push_back(grpId.toStdString());
+                selectionArgs.push_back(msgId.toStdString());
+
+                RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID + "=? AND " + KEY_MSG_ID + "=?", selectionArgs, "");
 
                 if (c)
                 {
@@ -1313,6 +1379,53 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
     return 1;
 }
 
+int RsDataService::retrieveGxsMsgMetaData(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query, std::vector<RsGxsMsgMetaData*>& msgMeta)
+{
+    RsStackMutex stack(mDbMutex);
+
+#ifdef RS_DATA_SERVICE_DEBUG_TIME
+    RsScopeTimer timer("");
+#endif
+
+    // All predicates start with the group id, so that they are served by the (grpId,xxx) indices.
+
+    std::string where = KEY_GRP_ID + "='" + grpId.toStdString() + "'";
+
+    if(query.mFields & RsGxsMsgMetaQuery::FIELD_PUBLISH_TS)
+    {
+        if(query.mPublishedAfter > 0)
+            rs_sprintf_append(where, " AND %s>=%d", KEY_TIME_STAMP.c_str(), (int32_t)query.mPublishedAfter);
+        if(query.mPublishedBefore > 0)
+            rs_sprintf_append(where, " AND %s<=%d", KEY_TIME_STAMP.c_str(), (int32_t)query.mPublishedBefore);
+    }
+
+    if(query.mFields & RsGxsMsgMetaQuery::FIELD_THREAD_ID)
+        where += " AND " + KEY_MSG_THREAD_ID + "='" + query.mThreadId.toStdString() + "'";
+
+    if(query.mFields & RsGxsMsgMetaQuery::FIELD_PARENT_ID)
+        where += " AND " + KEY_MSG_PARENT_ID + "='" + query.mParentId.toStdString() + "'";
+
+    if(query.mFields & RsGxsMsgMetaQuery::FIELD_ORIG_MSG_ID)
+        where += " AND " + KEY_ORIG_MSG_ID + "='" + query.mOrigMsgId.toStdString() + "'";
+
+    if(query.mFields & RsGxsMsgMetaQuery::FIELD_AUTHOR_ID)
+        where += " AND " + KEY_NXS_IDENTITY + "='" + query.mAuthorId.toStdString() + "'";
+
+    if((query.mFields & RsGxsMsgMetaQuery::FIELD_STATUS) && query.mStatusMask != 0)
+        rs_sprintf_append(where, " AND (%s & %u)=%u", KEY_MSG_STATUS.c_str(), query.mStatusMask, query.mStatusFilter & query.mStatusMask);
+
+    RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, where, "");
+
+    if(c)
+        locked_retrieveMsgMeta(c, msgMeta);
+
+#ifdef RS_DATA_SERVICE_DEBUG_TIME
+    std::cerr << "RsDataService::retrieveGxsMsgMetaData() " << mDbName << ", query: " << where << ", Results: " << msgMeta.size() << ", Time: " << timer.duration() << std::endl;
+#endif
+
+    return 1;
+}
+
 void RsDataService::locked_retrieveMsgMeta(RetroCursor *c, std::vector<RsGxsMsgMetaData *> &msgMeta)
 {
 
@@ -1415,7 +1528,7 @@ int RsDataService::retrieveGxsGrpMetaData(RsGxsGrpMetaTemporaryMap& grp)
 #endif
 
 				  const RsGxsGroupId& grpId = mit->first;
-				  RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, "grpId='" + grpId.toStdString() + "'", "");
+				  RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, KEY_GRP_ID + "=?", std::list<std::string>(1, grpId.toStdString()), "");
 
 				  if(c)
 				  {
@@ -1471,6 +1584,11 @@ int RsDataService::resetDataStore()
         RsStackMutex stack(mDbMutex);
 
         mDb->execSQL("DROP INDEX " + MSG_INDEX_GRPID);
+        mDb->execSQL("DROP INDEX " + MSG_INDEX_GRPID_THREADID);
+        mDb->execSQL("DROP INDEX " + MSG_INDEX_GRPID_PARENTID);
+        mDb->execSQL("DROP INDEX " + MSG_INDEX_GRPID_ORIGMSGID);
+        mDb->execSQL("DROP INDEX " + MSG_INDEX_GRPID_TIMESTAMP);
+        mDb->execSQL("DROP INDEX " + MSG_INDEX_GRPID_IDENTITY);
         mDb->execSQL("DROP TABLE " + DATABASE_RELEASE_TABLE_NAME);
         mDb->execSQL("DROP TABLE " + MSG_TABLE_NAME);
         mDb->execSQL("DROP TABLE " + GRP_TABLE_NAME);
@@ -1498,7 +1616,7 @@ int RsDataService::updateGroupMetaData(GrpLocMetaData &meta)
 
     locked_clearGrpMetaCache(meta.grpId);
 
-    return mDb->sqlUpdate(GRP_TABLE_NAME,  KEY_GRP_ID+ "='" + grpId.toStdString() + "'", meta.val) ? 1 : 0;
+    return mDb->sqlUpdate(GRP_TABLE_NAME, KEY_GRP_ID + "=?", std::list<std::string>(1, grpId.toStdString()), meta.val) ? 1 : 0;
 }
 
 int RsDataService::updateMessageMetaData(MsgLocMetaData &metaData)
@@ -1510,8 +1628,12 @@ int RsDataService::updateMessageMetaData(MsgLocMetaData &metaData)
     RsStackMutex stack(mDbMutex);
     RsGxsGroupId& grpId = metaData.msgId.first;
     RsGxsMessageId& msgId = metaData.msgId.second;
-    return mDb->sqlUpdate(MSG_TABLE_NAME,  KEY_GRP_ID+ "='" + grpId.toStdString()
-                          + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", metaData.val) ? 1 : 0;
+
+    std::list<std::string> whereArgs;
+    whereArgs.push_back(grpId.toStdString());
+    whereArgs.push_back(msgId.toStdString());
+
+    return mDb->sqlUpdate(MSG_TABLE_NAME, KEY_GRP_ID + "=? AND " + KEY_MSG_ID + "=?", whereArgs, metaData.val) ? 1 : 0;
 }
 
 int RsDataService::removeMsgs(const GxsMsgReq& msgIds)
@@ -1590,7 +1712,7 @@ int RsDataService::retrieveMsgIds(const RsGxsGroupId& grpId, RsGxsMessageId::std
     int resultCount = 0;
 #endif
 
-    RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgIdColumn, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
+    RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgIdColumn, KEY_GRP_ID + "=?", std::list<std::string>(1, grpId.toStdString()), "");
 
     if(c)
     {
@@ -43,8 +43,12 @@ class RsDataService : public RsGeneralDataService
 {
 public:
 
+    /*!
+     * @param profile sqlite tuning applied to the database once opened
+     */
     RsDataService(const std::string& serviceDir, const std::string& dbName, uint16_t serviceType,
-    		RsGxsSearchModule* mod = NULL, const std::string& key = "");
+    		RsGxsSearchModule* mod = NULL, const std::string& key = "",
+    		const RetroDbProfile& profile = RetroDbProfile());
     virtual ~RsDataService();
 
     /*!
@@ -82,6 +86,16 @@ public:
      */
     int retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaResult& msgMeta);
 
+    /*!
+     * Retrieves meta data of the messages of a group matching the query. The predicates
+     * are turned into SQL and served by the msg table indices.
+     * @param grpId group to look into
+     * @param query predicates the messages must match
+     * @param msgMeta matching meta data
+     * @return error code
+     */
+    int retrieveGxsMsgMetaData(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query, std::vector<RsGxsMsgMetaData*>& msgMeta);
+
     /*!
      * remove msgs in data store
      * @param grpId group Id of message to be removed
@@ -229,6 +243,11 @@ private:
      */
     void initialise(bool isNewDatabase);
 
+    /*!
+     * Creates the (grpId,xxx) indices used by msg meta queries, if missing
+     */
+    bool createMsgQueryIndices();
+
     /*!
      * Remove entries for data base
      * @param msgIds
@@ -346,6 +365,13 @@ private:
     // the entre list of grp metadata is requested (which happens quite often)
     
     void locked_clearGrpMetaCache(const RsGxsGroupId& gid);
+
+    /*!
+     * inserts the msg rows in cvs with one prepared statement, then
+     * deletes and removes them from cvs
+     * @return false if any insertion failed
+     */
+    bool locked_insertMsgBatch(std::list<ContentValue*>& cvs);
 	void locked_updateGrpMetaCache(const RsGxsGrpMetaData& meta);
 
     std::map<RsGxsGroupId,RsGxsGrpMetaData*> mGrpMetaDataCache ;
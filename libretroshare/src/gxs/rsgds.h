@@ -97,6 +97,37 @@ public:
 	time_t   mLastGroupModificationTS ;
 };
 
+/*!
+ * Predicates on msg meta data, to be evaluated by the data store so that only
+ * matching messages get loaded. mFields tells which predicates are used; all of
+ * them must match.
+ */
+
+class RsGxsMsgMetaQuery
+{
+public:
+    static const uint32_t FIELD_PUBLISH_TS  = 0x01; // mPublishedAfter <= mPublishTs <= mPublishedBefore (0 means no bound)
+    static const uint32_t FIELD_THREAD_ID   = 0x02;
+    static const uint32_t FIELD_PARENT_ID   = 0x04; // a null id selects thread heads
+    static const uint32_t FIELD_ORIG_MSG_ID = 0x08;
+    static const uint32_t FIELD_AUTHOR_ID   = 0x10;
+    static const uint32_t FIELD_STATUS      = 0x20; // (mMsgStatus & mStatusMask) == (mStatusFilter & mStatusMask)
+
+    RsGxsMsgMetaQuery()
+        : mFields(0), mPublishedAfter(0), mPublishedBefore(0), mStatusMask(0), mStatusFilter(0) {}
+
+    uint32_t mFields;
+
+    time_t mPublishedAfter;
+    time_t mPublishedBefore;
+    RsGxsMessageId mThreadId;
+    RsGxsMessageId mParentId;
+    RsGxsMessageId mOrigMsgId;
+    RsGxsId mAuthorId;
+    uint32_t mStatusMask;
+    uint32_t mStatusFilter;
+};
+
 typedef std::map<RsGxsGroupId,      std::vector<RsNxsMsg*> > NxsMsgDataResult;
 typedef std::map<RsGxsGrpMsgIdPair, std::vector<RsNxsMsg*> > NxsMsgRelatedDataResult;
 typedef std::map<RsGxsGroupId,      std::vector<RsNxsMsg*> > GxsMsgResult; // <grpId, msgs>
@@ -181,6 +212,17 @@ public:
      */
     virtual int retrieveGxsMsgMetaData(const GxsMsgReq& msgIds, GxsMsgMetaResult& msgMeta) = 0;
 
+    /*!
+     * Retrieves meta data of the messages of a group that match the query. Unlike
+     * retrieveGxsMsgMetaData() above, the cost depends on the number of matching messages
+     * rather than on the size of the group.
+     * @param grpId group to look into
+     * @param query predicates the messages must match
+     * @param msgMeta matching meta data. Ownership is passed to the caller.
+     * @return error code
+     */
+    virtual int retrieveGxsMsgMetaData(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query, std::vector<RsGxsMsgMetaData*>& msgMeta) = 0;
+
     /*!
      * remove msgs in data store listed in msgIds param
      * @param msgIds ids of messages to be removed
@@ -844,10 +844,7 @@ int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uin
 		}
 
 		if(!keyId.isNull())
-		{
-			RsTlvPublicRSAKey& key = keys[keyId];
-			publishValidate &= GxsSecurity::validateNxsMsg(*msg, sign, key);
-		}
+			publishValidate &= GxsSecurity::validateNxsMsg(*msg, sign, mit->second);
 		else
 		{
             std::cerr << "(EE) public publish key not found in group that require publish key validation. This should not happen! msgId=" << metaData.mMsgId << ", grpId=" << metaData.mGroupId << std::endl;
@@ -2846,6 +2843,43 @@ void RsGenExchange::computeHash(const RsTlvBinaryData& data, RsFileHash& hash)
 	pHash.Complete(hash);
 }
 
+// Signature validation of received items, run in the RsGxsValidationPool. Each job only
+// reads the item, and the group keys which are shared by all jobs of the same group.
+
+class RsGenExchange::MsgValidationJob : public RsGxsValidationJob
+{
+public:
+	MsgValidationJob(RsGenExchange *exch, NxsMsgPendingVect::iterator pending, const RsGxsGrpMetaData *grpMeta, RsTlvSecurityKeySet& keys)
+	    : mExch(exch), mPending(pending), mGrpMeta(grpMeta), mKeys(&keys), mResult(exch->VALIDATE_FAIL) {}
+
+	virtual void run()
+	{
+		mResult = mExch->validateMsg(mPending->second.mItem, mGrpMeta->mGroupFlags, mGrpMeta->mSignFlags, *mKeys);
+	}
+
+	RsGenExchange *mExch;
+	NxsMsgPendingVect::iterator mPending;
+	const RsGxsGrpMetaData *mGrpMeta;
+	RsTlvSecurityKeySet *mKeys;
+	int mResult;
+};
+
+class RsGenExchange::GrpValidationJob : public RsGxsValidationJob
+{
+public:
+	GrpValidationJob(RsGenExchange *exch, NxsGrpPendValidVect::iterator pending)
+	    : mExch(exch), mPending(pending), mResult(exch->VALIDATE_FAIL) {}
+
+	virtual void run()
+	{
+		mResult = mExch->validateGrp(mPending->second.mItem);
+	}
+
+	RsGenExchange *mExch;
+	NxsGrpPendValidVect::iterator mPending;
+	int mResult;
+};
+
 void RsGenExchange::processRecvdMessages()
 {
     std::list<RsGxsMessageId> messages_to_reject ;
@@ -2908,9 +2942,13 @@ void RsGenExchange::processRecvdMessages()
 	    std::cerr << "  updating received messages:" << std::endl;
 #endif
 
-		// 3 - Validate each message
+		// 3 - Check the signatures of all messages at once in the validation threads. Key sets are prepared once per group.
 
-	    for(NxsMsgPendingVect::iterator pend_it = mMsgPendingValidate.begin();pend_it != mMsgPendingValidate.end();)
+		std::map<RsGxsGroupId,RsTlvSecurityKeySet> grpKeys;
+		std::vector<MsgValidationJob> jobs;
+		jobs.reserve(mMsgPendingValidate.size());
+
+	    for(NxsMsgPendingVect::iterator pend_it = mMsgPendingValidate.begin();pend_it != mMsgPendingValidate.end();++pend_it)
 	    {
 		    RsNxsMsg* msg = pend_it->second.mItem;
 
@@ -2934,25 +2972,42 @@ void RsGenExchange::processRecvdMessages()
 #ifdef GEN_EXCH_DEBUG
 			    std::cerr << "    msg info         : grp id=" << msg->grpId << ", msg id=" << msg->msgId << std::endl;
 #endif
-			// validate msg
-
 			if(mit == grpMetas.end())
 			{
 				std::cerr << "RsGenExchange::processRecvdMessages(): impossible situation: grp meta " << msg->grpId << " not available." << std::endl;
-				++pend_it ;
 				continue ;
 			}
 
-			const RsGxsGrpMetaData *grpMeta = mit->second;
-			RsTlvSecurityKeySet keys = grpMeta->keys ;
+			std::map<RsGxsGroupId,RsTlvSecurityKeySet>::iterator kit = grpKeys.find(msg->grpId);
 
-			GxsSecurity::createPublicKeysFromPrivateKeys(keys);	// make sure we have the public keys that correspond to the private ones, as it happens. Most of the time this call does nothing.
+			if(kit == grpKeys.end())
+			{
+				kit = grpKeys.insert(std::make_pair(msg->grpId,mit->second->keys)).first;
 
-			int validateReturn = validateMsg(msg, grpMeta->mGroupFlags, grpMeta->mSignFlags, keys);
+				GxsSecurity::createPublicKeysFromPrivateKeys(kit->second);	// make sure we have the public keys that correspond to the private ones, as it happens. Most of the time this call does nothing.
+			}
+
+			jobs.push_back(MsgValidationJob(this, pend_it, mit->second, kit->second));
+	    }
+
+		std::vector<RsGxsValidationJob*> job_list(jobs.size());
+
+		for(uint32_t i=0;i<jobs.size();++i)
+			job_list[i] = &jobs[i];
+
+		RsGxsValidationPool::instance().runJobs(job_list);
+
+		// 4 - Handle the validation results
+
+		for(uint32_t i=0;i<jobs.size();++i)
+		{
+			NxsMsgPendingVect::iterator pend_it = jobs[i].mPending;
+		    RsNxsMsg* msg = pend_it->second.mItem;
+			int validateReturn = jobs[i].mResult;
 
 #ifdef GEN_EXCH_DEBUG
-			std::cerr << "    grpMeta.mSignFlags: " << std::hex << grpMeta->mSignFlags << std::dec << std::endl;
-			std::cerr << "    grpMeta.mAuthFlags: " << std::hex << grpMeta->mAuthenFlags << std::dec << std::endl;
+			std::cerr << "    grpMeta.mSignFlags: " << std::hex << jobs[i].mGrpMeta->mSignFlags << std::dec << std::endl;
+			std::cerr << "    grpMeta.mAuthFlags: " << std::hex << jobs[i].mGrpMeta->mAuthenFlags << std::dec << std::endl;
 			std::cerr << "    message validation result: " << (int)validateReturn << std::endl;
 #endif
 
@@ -2990,17 +3045,11 @@ void RsGenExchange::processRecvdMessages()
 				delete msg ;
 			}
 			else if(validateReturn == VALIDATE_FAIL_TRY_LATER)
-			{
-				++pend_it ;
 				continue;
-			}
 
 			// Remove the entry from mMsgPendingValidate, but do not delete msg since it's either pushed into msg_to_store or deleted in the FAIL case!
 
-			NxsMsgPendingVect::iterator tmp = pend_it ;
-			++tmp ;
 			mMsgPendingValidate.erase(pend_it) ;
-			pend_it = tmp ;
 	    }
 
 	    if(!msgIds.empty())
@@ -3048,7 +3097,10 @@ void RsGenExchange::processRecvdGroups()
 	std::vector<RsGxsGroupId> existingGrpIds;
 	mDataStore->retrieveGroupIds(existingGrpIds);
 
-	// 2 - go through each and every new group data and validate the signatures.
+	// 2 - go through each and every new group data, drop the ones we won't validate, and check the signatures of the others in the validation threads.
+
+	std::vector<GrpValidationJob> jobs;
+	jobs.reserve(mGrpPendingValidate.size());
 
 	for(NxsGrpPendValidVect::iterator vit = mGrpPendingValidate.begin(); vit != mGrpPendingValidate.end();)
 	{
@@ -3080,9 +3132,24 @@ void RsGenExchange::processRecvdGroups()
 			continue;
 		}
 
-		// group signature validation
+		jobs.push_back(GrpValidationJob(this, vit));
+		++vit;
+	}
+
+	std::vector<RsGxsValidationJob*> job_list(jobs.size());
 
-		uint8_t ret = validateGrp(grp);
+	for(uint32_t i=0;i<jobs.size();++i)
+		job_list[i] = &jobs[i];
+
+	RsGxsValidationPool::instance().runJobs(job_list);
+
+	// 3 - handle the validation results
+
+	for(uint32_t i=0;i<jobs.size();++i)
+	{
+		NxsGrpPendValidVect::iterator vit = jobs[i].mPending;
+		RsNxsGrp* grp = vit->second.mItem;
+		int ret = jobs[i].mResult;
 
 		if(ret == VALIDATE_SUCCESS)
 		{
@@ -3134,16 +3201,12 @@ void RsGenExchange::processRecvdGroups()
 #ifdef GEN_EXCH_DEBUG
 			std::cerr << "  failed to validate incoming grp, trying again later. grpId: " << grp->grpId << std::endl;
 #endif
-			++vit ;
 			continue;
 		}
 
 		// Erase entry from the list
 
-		NxsGrpPendValidVect::iterator tmp(vit) ;
-		++tmp ;
 		mGrpPendingValidate.erase(vit) ;
-		vit = tmp ;
 	}
 
 	if(!grpIds.empty())
@@ -797,9 +797,10 @@ private:
      * @param msg message to be validated
      * @param grpFlag the distribution flag for the group the message belongs to
      * @param grpFlag the signature flag for the group the message belongs to
-     * @param grpKeySet the key set user has for the message's group
+     * @param grpKeySet the key set user has for the message's group, only read
      * @return VALIDATE_SUCCESS for success, VALIDATE_FAIL for fail,
      * 		   VALIDATE_ID_SIGN_NOT_AVAIL for Id sign key not avail (but requested)
+     * Called from the validation threads: must not touch the service data.
      */
     int validateMsg(RsNxsMsg* msg, const uint32_t& grpFlag, const uint32_t &signFlag, RsTlvSecurityKeySet& grpKeySet);
 
@@ -808,9 +809,15 @@ private:
 	 * @param grp group to be validated
 	 * @return VALIDATE_SUCCESS for success, VALIDATE_FAIL for fail,
 	 * 		   VALIDATE_ID_SIGN_NOT_AVAIL for Id sign key not avail (but requested)
+	 * Called from the validation threads: must not touch the service data.
 	 */
 	int validateGrp(RsNxsGrp* grp);
 
+	// validateMsg()/validateGrp() calls run in the RsGxsValidationPool
+
+	class MsgValidationJob ;
+	class GrpValidationJob ;
+
     /*!
      * Checks flag against a given privacy bit block
      * @param pos Determines 8 bit wide privacy block to check
@@ -24,6 +24,7 @@
  */
 
 #include <time.h>
+#include <algorithm>
 
 #include "rsgxsutil.h"
 #include "rsgxsdataaccess.h"
@@ -42,12 +43,115 @@
  * #define DATA_DEBUG	1
  **********/
 
+#define GXS_REQUEST_POOL_WORKERS 2
+#define GXS_WORKER_IDLE_WAIT_MS 1000
+
+/*!
+ * Used by waitToken() to be woken up when the request is processed
+ */
+class RsGxsTokenWaiter : public RsTokenObserver
+{
+public:
+	virtual void tokenFinished(uint32_t, uint32_t) { mSignal.wakeup(); }
+
+	RsWakeupSignal mSignal;
+};
+
+RsGxsRequestPool& RsGxsRequestPool::instance()
+{
+	// never deleted: the workers run until the process exits.
+
+	static RsGxsRequestPool *pool = new RsGxsRequestPool ;
+	return *pool ;
+}
+
+RsGxsRequestPool::RsGxsRequestPool()
+	: mPoolMtx("RsGxsRequestPool")
+{
+	for(uint32_t i=0;i<GXS_REQUEST_POOL_WORKERS;++i)
+	{
+		RsGxsRequestWorker *worker = new RsGxsRequestWorker(this);
+		worker->start("gxs requests");
+		mWorkers.push_back(worker);
+	}
+}
+
+void RsGxsRequestWorker::data_tick()
+{
+	if(!mPool->runNextRequest())
+		mPool->mWorkSignal.wait(GXS_WORKER_IDLE_WAIT_MS);
+}
+
+void RsGxsRequestPool::post(RsGxsDataAccess *da)
+{
+	{
+		RS_STACK_MUTEX(mPoolMtx) ;
+
+		if(std::find(mQueue.begin(),mQueue.end(),da) == mQueue.end())
+			mQueue.push_back(da) ;
+	}
+	mWorkSignal.wakeup() ;
+}
+
+bool RsGxsRequestPool::runNextRequest()
+{
+	RsGxsDataAccess *da ;
+	{
+		RS_STACK_MUTEX(mPoolMtx) ;
+
+		if(mQueue.empty())
+			return false ;
+
+		da = mQueue.front() ;
+		mQueue.pop_front() ;
+		mRunning.insert(da) ;
+
+		// let another worker serve the next data access meanwhile
+		if(!mQueue.empty())
+			mWorkSignal.wakeup() ;
+	}
+
+	// The data access schedules itself again when it has more requests to process.
+
+	da->processNextRequest() ;
+
+	{
+		RS_STACK_MUTEX(mPoolMtx) ;
+		mRunning.erase(mRunning.find(da)) ;
+	}
+	mIdleSignal.wakeup() ;
+
+	return true ;
+}
+
+void RsGxsRequestPool::remove(RsGxsDataAccess *da)
+{
+	while(true)
+	{
+		{
+			RS_STACK_MUTEX(mPoolMtx) ;
+
+			mQueue.remove(da) ;
+
+			if(mRunning.find(da) == mRunning.end())
+				return ;
+		}
+		mIdleSignal.wait(GXS_WORKER_IDLE_WAIT_MS) ;
+	}
+}
+
 RsGxsDataAccess::RsGxsDataAccess(RsGeneralDataService* ds) :
-    mDataStore(ds), mDataMutex("RsGxsDataAccess"), mNextToken(0) {}
+    mDataStore(ds), mDataMutex("RsGxsDataAccess"), mNextToken(0), mRunningRequest(NULL), mObserverMutex("RsGxsDataAccess observers")
+{
+}
 
 
 RsGxsDataAccess::~RsGxsDataAccess()
 {
+    // The pool must be done with this data access before the requests it may process are deleted.
+
+    RsGxsRequestPool::instance().remove(this);
+
     for(std::map<uint32_t, GxsRequest*>::const_iterator it(mRequests.begin());it!=mRequests.end();++it)
 		delete it->second ;
 }
@@ -315,13 +419,16 @@ void RsGxsDataAccess::setReq(GxsRequest* req, uint32_t token, uint32_t ansType,
 }
 void    RsGxsDataAccess::storeRequest(GxsRequest* req)
 {
-	RsStackMutex stack(mDataMutex); /****** LOCKED *****/
+	{
+		RsStackMutex stack(mDataMutex); /****** LOCKED *****/
 
-        req->status = GXS_REQUEST_V2_STATUS_PENDING;
-        req->reqTime = time(NULL);
-	mRequests[req->token] = req;
+		req->status = GXS_REQUEST_V2_STATUS_PENDING;
+		req->reqTime = time(NULL);
+		mRequests[req->token] = req;
+		mPendingRequests.push_back(req->token);
+	}
 
-	return;
+	RsGxsRequestPool::instance().post(this);
 }
 
 uint32_t RsGxsDataAccess::requestStatus(uint32_t token)
@@ -345,17 +452,80 @@ uint32_t RsGxsDataAccess::requestStatus(uint32_t token)
 	return status;
 }
 
-bool RsGxsDataAccess::cancelRequest(const uint32_t& token)
+uint32_t RsGxsDataAccess::waitToken(const uint32_t token, uint32_t max_wait_ms)
 {
-	RsStackMutex stack(mDataMutex); /****** LOCKED *****/
+	RsGxsTokenWaiter waiter;
 
-	GxsRequest* req = locked_retrieveRequest(token);
-	if (!req)
+	addTokenObserver(token, &waiter);
+	waiter.mSignal.wait(max_wait_ms);
+	removeTokenObserver(token, &waiter);
+
+	return requestStatus(token);
+}
+
+static bool isProcessed(uint32_t status)
+{
+	return status != RsTokenService::GXS_REQUEST_V2_STATUS_PENDING
+	    && status != RsTokenService::GXS_REQUEST_V2_STATUS_PARTIAL;
+}
+
+void RsGxsDataAccess::addTokenObserver(const uint32_t token, RsTokenObserver *obs)
+{
+	RsStackMutex stack(mObserverMutex); /****** LOCKED *****/
+
+	// The status is checked with the observer mutex locked, so that the request cannot
+	// be notified meanwhile: the observer is called exactly once.
+
+	uint32_t status = requestStatus(token);
+
+	if(isProcessed(status))
+		obs->tokenFinished(token, status);
+	else
+		mTokenObservers.insert(std::make_pair(token, obs));
+}
+
+void RsGxsDataAccess::removeTokenObserver(const uint32_t token, RsTokenObserver *obs)
+{
+	RsStackMutex stack(mObserverMutex); /****** LOCKED *****/
+
+	std::pair<std::multimap<uint32_t, RsTokenObserver*>::iterator, std::multimap<uint32_t, RsTokenObserver*>::iterator> range = mTokenObservers.equal_range(token);
+
+	for(std::multimap<uint32_t, RsTokenObserver*>::iterator it = range.first; it != range.second; ++it)
+		if(it->second == obs)
+		{
+			mTokenObservers.erase(it);
+			return;
+		}
+}
+
+void RsGxsDataAccess::notifyTokenObservers(const uint32_t& token, const uint32_t& status)
+{
+	RsStackMutex stack(mObserverMutex); /****** LOCKED *****/
+
+	std::pair<std::multimap<uint32_t, RsTokenObserver*>::iterator, std::multimap<uint32_t, RsTokenObserver*>::iterator> range = mTokenObservers.equal_range(token);
+
+	for(std::multimap<uint32_t, RsTokenObserver*>::iterator it = range.first; it != range.second; ++it)
+		it->second->tokenFinished(token, status);
+
+	mTokenObservers.erase(range.first, range.second);
+}
+
+bool RsGxsDataAccess::cancelRequest(const uint32_t& token)
+{
 	{
-		return false;
-	}
+		RsStackMutex stack(mDataMutex); /****** LOCKED *****/
+
+		GxsRequest* req = locked_retrieveRequest(token);
+		if (!req)
+		{
+			return false;
+		}
+
+		req->status = GXS_REQUEST_V2_STATUS_CANCELLED;
+	} // END OF MUTEX.
 
-	req->status = GXS_REQUEST_V2_STATUS_CANCELLED;
+	// wakes up waitToken() and forgets the observers: the request will not be notified again.
+	notifyTokenObservers(token, GXS_REQUEST_V2_STATUS_CANCELLED);
 
 	return true;
 }
@@ -740,6 +910,10 @@ void RsGxsDataAccess::processRequests()
 		{
 			GxsRequest* req = it->second;
 
+			// the request being processed is left alone, whatever its status.
+			if (req == mRunningRequest)
+				continue;
+
 			switch (req->status)
 			{
 			case GXS_REQUEST_V2_STATUS_PENDING:
@@ -783,106 +957,127 @@ void RsGxsDataAccess::processRequests()
 		clearRequest(*cit);
 	}
 
-	// process requests
-	while (true)
+	// process the requests the workers did not take yet
+	while (processNextRequest()) ;
+}
+
+bool RsGxsDataAccess::processNextRequest()
+{
+	GxsRequest* req = NULL;
 	{
-		GxsRequest* req = NULL;
+		RsStackMutex stack(mDataMutex); /******* LOCKED *******/
+
+		// Only one request at a time, whoever processes it (pool or tick), so that
+		// requests complete in order. The next one is scheduled when it is done.
+		if (mRunningRequest)
+			return false;
+
+		// get the oldest pending request. Cancelled or cleared requests are skipped.
+		while (!mPendingRequests.empty() && !req)
 		{
-			RsStackMutex stack(mDataMutex); /******* LOCKED *******/
+			GxsRequest* reqCheck = locked_retrieveRequest(mPendingRequests.front());
+			mPendingRequests.pop_front();
 
-			// get the first pending request
-			for (it = mRequests.begin(); it != mRequests.end(); ++it)
+			if (reqCheck && reqCheck->status == GXS_REQUEST_V2_STATUS_PENDING)
 			{
-				GxsRequest* reqCheck = it->second;
-				if (reqCheck->status == GXS_REQUEST_V2_STATUS_PENDING)
-				{
-					req = reqCheck;
-					req->status = GXS_REQUEST_V2_STATUS_PARTIAL;
-					break;
-				}
+				req = reqCheck;
+				req->status = GXS_REQUEST_V2_STATUS_PARTIAL;
+				mRunningRequest = req;
 			}
-		} // END OF MUTEX.
-
-		if (!req) {
-			break;
 		}
+	} // END OF MUTEX.
+
+	if (!req)
+		return false;
 
-		GroupMetaReq* gmr;
-		GroupDataReq* gdr;
-		GroupIdReq* gir;
+	GroupMetaReq* gmr;
+	GroupDataReq* gdr;
+	GroupIdReq* gir;
 
-		MsgMetaReq* mmr;
-		MsgDataReq* mdr;
-		MsgIdReq* mir;
-		MsgRelatedInfoReq* mri;
-		GroupStatisticRequest* gsr;
-		GroupSerializedDataReq* grr;
-		ServiceStatisticRequest* ssr;
+	MsgMetaReq* mmr;
+	MsgDataReq* mdr;
+	MsgIdReq* mir;
+	MsgRelatedInfoReq* mri;
+	GroupStatisticRequest* gsr;
+	GroupSerializedDataReq* grr;
+	ServiceStatisticRequest* ssr;
 
 #ifdef DATA_DEBUG
-		std::cerr << "RsGxsDataAccess::processRequests() Processing Token: " << req->token << " Status: "
-		          << req->status << " ReqType: " << req->reqType << " Age: "
-		          << now - req->reqTime << std::endl;
+	std::cerr << "RsGxsDataAccess::processNextRequest() Processing Token: " << req->token << " Status: "
+	          << req->status << " ReqType: " << req->reqType << " Age: "
+	          << time(NULL) - req->reqTime << std::endl;
 #endif
 
-		/* PROCESS REQUEST! */
-		bool ok = false;
+	/* PROCESS REQUEST! */
+	bool ok = false;
 
-		if((gmr = dynamic_cast<GroupMetaReq*>(req)) != NULL)
-		{
-			ok = getGroupSummary(gmr);
-		}
-		else if((gdr = dynamic_cast<GroupDataReq*>(req)) != NULL)
-		{
-			ok = getGroupData(gdr);
-		}
-		else if((gir = dynamic_cast<GroupIdReq*>(req)) != NULL)
-		{
-			ok = getGroupList(gir);
-		}
-		else if((mmr = dynamic_cast<MsgMetaReq*>(req)) != NULL)
-		{
-			ok = getMsgSummary(mmr);
-		}
-		else if((mdr = dynamic_cast<MsgDataReq*>(req)) != NULL)
-		{
-			ok = getMsgData(mdr);
-		}
-		else if((mir = dynamic_cast<MsgIdReq*>(req)) != NULL)
-		{
-			ok = getMsgList(mir);
-		}
-		else if((mri = dynamic_cast<MsgRelatedInfoReq*>(req)) != NULL)
-		{
-			ok = getMsgRelatedInfo(mri);
-		}
-		else if((gsr = dynamic_cast<GroupStatisticRequest*>(req)) != NULL)
-		{
-			ok = getGroupStatistic(gsr);
-		}
-		else if((ssr = dynamic_cast<ServiceStatisticRequest*>(req)) != NULL)
-		{
-			ok = getServiceStatistic(ssr);
-		}
-		else if((grr = dynamic_cast<GroupSerializedDataReq*>(req)) != NULL)
-		{
-			ok = getGroupSerializedData(grr);
-		}
+	if((gmr = dynamic_cast<GroupMetaReq*>(req)) != NULL)
+	{
+		ok = getGroupSummary(gmr);
+	}
+	else if((gdr = dynamic_cast<GroupDataReq*>(req)) != NULL)
+	{
+		ok = getGroupData(gdr);
+	}
+	else if((gir = dynamic_cast<GroupIdReq*>(req)) != NULL)
+	{
+		ok = getGroupList(gir);
+	}
+	else if((mmr = dynamic_cast<MsgMetaReq*>(req)) != NULL)
+	{
+		ok = getMsgSummary(mmr);
+	}
+	else if((mdr = dynamic_cast<MsgDataReq*>(req)) != NULL)
+	{
+		ok = getMsgData(mdr);
+	}
+	else if((mir = dynamic_cast<MsgIdReq*>(req)) != NULL)
+	{
+		ok = getMsgList(mir);
+	}
+	else if((mri = dynamic_cast<MsgRelatedInfoReq*>(req)) != NULL)
+	{
+		ok = getMsgRelatedInfo(mri);
+	}
+	else if((gsr = dynamic_cast<GroupStatisticRequest*>(req)) != NULL)
+	{
+		ok = getGroupStatistic(gsr);
+	}
+	else if((ssr = dynamic_cast<ServiceStatisticRequest*>(req)) != NULL)
+	{
+		ok = getServiceStatistic(ssr);
+	}
+	else if((grr = dynamic_cast<GroupSerializedDataReq*>(req)) != NULL)
+	{
+		ok = getGroupSerializedData(grr);
+	}
 
-		else
+	else
+	{
+		std::cerr << "RsGxsDataAccess::processNextRequest() Failed to process request, token: "
+		          << req->token << std::endl;
+	}
+
+	uint32_t token = req->token;
+	uint32_t status;
+	bool morePending;
+	{
+		RsStackMutex stack(mDataMutex); /******* LOCKED *******/
+		if (req->status == GXS_REQUEST_V2_STATUS_PARTIAL)
 		{
-			std::cerr << "RsGxsDataAccess::processRequests() Failed to process request, token: "
-			          << req->token << std::endl;
+			req->status = ok ? GXS_REQUEST_V2_STATUS_COMPLETE : GXS_REQUEST_V2_STATUS_FAILED;
 		}
+		status = req->status;
+		mRunningRequest = NULL;
+		morePending = !mPendingRequests.empty();
+	} // END OF MUTEX.
 
-		{
-			RsStackMutex stack(mDataMutex); /******* LOCKED *******/
-			if (req->status == GXS_REQUEST_V2_STATUS_PARTIAL)
-			{
-				req->status = ok ? GXS_REQUEST_V2_STATUS_COMPLETE : GXS_REQUEST_V2_STATUS_FAILED;
-			}
-		} // END OF MUTEX.
-	}
+	notifyTokenObservers(token, status);
+
+	if (morePending)
+		RsGxsRequestPool::instance().post(this);
+
+	return true;
 }
 
 bool RsGxsDataAccess::getGroupStatistic(const uint32_t &token, GxsGroupStatistic &grpStatistic)
@@ -1078,7 +1273,34 @@ bool RsGxsDataAccess::getMsgList(const GxsMsgReq& msgIds, const RsTokReqOptions&
 {
     GxsMsgMetaResult result;
 
-    mDataStore->retrieveGxsMsgMetaData(msgIds, result);
+    // When whole groups are requested, let the data store apply the filters it can, so
+    // that e.g. listing the threads of a forum does not load every post. The status filter
+    // is applied after picking the latest versions, so it cannot be pushed down in that case.
+
+    RsGxsMsgMetaQuery query;
+
+    if (opts.mOptions & RS_TOKREQOPT_MSG_THREAD)
+    {
+        query.mFields |= RsGxsMsgMetaQuery::FIELD_PARENT_ID;	// null parent id: thread heads
+    }
+
+    if (opts.mStatusMask && !(opts.mOptions & RS_TOKREQOPT_MSG_LATEST))
+    {
+        query.mFields |= RsGxsMsgMetaQuery::FIELD_STATUS;
+        query.mStatusMask = opts.mStatusMask;
+        query.mStatusFilter = opts.mStatusFilter;
+    }
+
+    GxsMsgReq explicitMsgIds;
+
+    for(GxsMsgReq::const_iterator mit = msgIds.begin(); mit != msgIds.end(); ++mit)
+        if(mit->second.empty() && query.mFields != 0)
+            mDataStore->retrieveGxsMsgMetaData(mit->first, query, result[mit->first]);
+        else
+            explicitMsgIds.insert(*mit);
+
+    if(!explicitMsgIds.empty())
+        mDataStore->retrieveGxsMsgMetaData(explicitMsgIds, result);
 
     /* CASEs this handles.
      * Input is groupList + Flags.
@@ -1370,43 +1592,57 @@ bool RsGxsDataAccess::getMsgRelatedInfo(MsgRelatedInfoReq *req)
 
         const RsGxsGrpMsgIdPair& grpMsgIdPair = *vit_msgIds;
 
-        // get meta data for all in group
-        GxsMsgMetaResult result;
-        GxsMsgReq msgIds;
-        msgIds.insert(std::make_pair(grpMsgIdPair.first, std::vector<RsGxsMessageId>()));
-        mDataStore->retrieveGxsMsgMetaData(msgIds, result);
-        std::vector<RsGxsMsgMetaData*>& metaV = result[grpMsgIdPair.first];
-        std::vector<RsGxsMsgMetaData*>::iterator vit_meta;
-
         // msg id to relate to
         const RsGxsMessageId& msgId = grpMsgIdPair.second;
         const RsGxsGroupId& grpId = grpMsgIdPair.first;
 
         std::vector<RsGxsMessageId> outMsgIds;
 
-        RsGxsMsgMetaData* origMeta = NULL;
-        for(vit_meta = metaV.begin(); vit_meta != metaV.end(); ++vit_meta)
-        {
-            RsGxsMsgMetaData* meta = *vit_meta;
-
-            if(msgId == meta->mMsgId)
-            {
-                origMeta = meta;
-                break;
-            }
-        }
+        // get meta data of the msg to relate to
+        GxsMsgMetaResult origResult;
+        GxsMsgReq msgIds;
+        msgIds[grpId].push_back(msgId);
+        mDataStore->retrieveGxsMsgMetaData(msgIds, origResult);
 
-        if(!origMeta)
+        if(origResult[grpId].empty())
         {
 #ifdef DATA_DEBUG
             std::cerr << "RsGxsDataAccess::getMsgRelatedInfo(): Cannot find meta of msgId (to relate to)!"
                       << std::endl;
 #endif
-            cleanseMsgMetaMap(result);
+            cleanseMsgMetaMap(origResult);
             return false;
         }
 
-        const RsGxsMessageId& origMsgId = origMeta->mOrigMsgId;
+        const RsGxsMessageId origMsgId = origResult[grpId].front()->mOrigMsgId;
+        cleanseMsgMetaMap(origResult);
+
+        // then only the related msgs, rather than the whole group
+
+        RsGxsMsgMetaQuery query;
+
+        if (onlyChildMsgs)
+        {
+            query.mFields = RsGxsMsgMetaQuery::FIELD_PARENT_ID;
+            query.mParentId = origMsgId;
+        }
+        else if (onlyThreadMsgs)
+        {
+            query.mFields = RsGxsMsgMetaQuery::FIELD_THREAD_ID;
+            query.mThreadId = msgId;
+        }
+        else
+        {
+            query.mFields = RsGxsMsgMetaQuery::FIELD_ORIG_MSG_ID;
+            query.mOrigMsgId = origMsgId;
+        }
+
+        GxsMsgMetaResult result;
+        std::vector<RsGxsMsgMetaData*>& metaV = result[grpId];
+        std::vector<RsGxsMsgMetaData*>::iterator vit_meta;
+
+        mDataStore->retrieveGxsMsgMetaData(grpId, query, metaV);
+
         std::map<RsGxsMessageId, RsGxsMsgMetaData*>& metaMap = filterMap[grpId];
 
         if (onlyLatestMsgs)
@@ -1864,18 +2100,23 @@ uint32_t RsGxsDataAccess::generatePublicToken()
 bool RsGxsDataAccess::updatePublicRequestStatus(const uint32_t& token,
 		const uint32_t& status)
 {
-	RsStackMutex stack(mDataMutex);
-	std::map<uint32_t, uint32_t>::iterator mit = mPublicToken.find(token);
-
-	if(mit != mPublicToken.end())
 	{
-		mit->second = status;
-	}
-	else
-	{
-		return false;
+		RsStackMutex stack(mDataMutex);
+		std::map<uint32_t, uint32_t>::iterator mit = mPublicToken.find(token);
+
+		if(mit != mPublicToken.end())
+		{
+			mit->second = status;
+		}
+		else
+		{
+			return false;
+		}
 	}
 
+	if(isProcessed(status))
+		notifyTokenObservers(token, status);
+
 	return true;
 }
 
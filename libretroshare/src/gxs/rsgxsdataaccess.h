@@ -26,14 +26,74 @@
  *
  */
 
+#include <list>
+#include <set>
+#include <vector>
+
 #include "retroshare/rstokenservice.h"
 #include "rsgxsrequesttypes.h"
 #include "rsgds.h"
+#include "util/rsthreads.h"
 
 
 typedef std::map< RsGxsGroupId, std::map<RsGxsMessageId, RsGxsMsgMetaData*> > MsgMetaFilter;
 typedef std::map< RsGxsGroupId, RsGxsGrpMetaData* > GrpMetaFilter;
 
+class RsGxsDataAccess ;
+class RsGxsRequestPool ;
+
+class RsGxsRequestWorker : public RsTickingThread
+{
+public:
+    explicit RsGxsRequestWorker(RsGxsRequestPool *pool) : mPool(pool) {}
+
+    virtual void data_tick() ;
+
+private:
+    RsGxsRequestPool *mPool ;
+};
+
+/*!
+ * Pool of threads shared by all GXS services, which processes the requests of
+ * the data accesses as soon as they are stored, so that request latency does not
+ * depend on the tick of the service. Data accesses are served in turn, one
+ * request at a time.
+ */
+class RsGxsRequestPool
+{
+public:
+    static RsGxsRequestPool& instance();
+
+    /*!
+     * Schedules the processing of the next pending request of da
+     */
+    void post(RsGxsDataAccess *da);
+
+    /*!
+     * Cancels the scheduled processing of da, and waits for the workers
+     * to be done with it. Needed before da is deleted.
+     */
+    void remove(RsGxsDataAccess *da);
+
+private:
+    friend class RsGxsRequestWorker ;
+
+    RsGxsRequestPool();
+
+    /*!
+     * Processes one request of the data access scheduled first.
+     * @return false if nothing was scheduled
+     */
+    bool runNextRequest();
+
+    RsMutex mPoolMtx ;
+    std::list<RsGxsDataAccess*> mQueue ;	/* scheduled data accesses, each at most once */
+    std::multiset<RsGxsDataAccess*> mRunning ;	/* data accesses a worker is processing a request of */
+    RsWakeupSignal mWorkSignal ;
+    RsWakeupSignal mIdleSignal ;
+    std::vector<RsGxsRequestWorker*> mWorkers ;
+};
+
 class RsGxsDataAccess : public RsTokenService
 {
 public:
@@ -126,6 +186,11 @@ public:
     /* Cancel Request */
     bool cancelRequest(const uint32_t &token);
 
+    /* Completion */
+    uint32_t waitToken(const uint32_t token, uint32_t max_wait_ms);
+    void addTokenObserver(const uint32_t token, RsTokenObserver *obs);
+    void removeTokenObserver(const uint32_t token, RsTokenObserver *obs);
+
 
     /** E: RsTokenService **/
 
@@ -161,10 +226,18 @@ public:
 
 
     /*!
-     * This must be called periodically to progress requests
+     * This must be called periodically to clean up old requests. It also
+     * processes the requests the workers did not take yet.
      */
     void processRequests();
 
+    /*!
+     * Processes the oldest pending request, if any. Requests are processed
+     * one at a time, so that they complete in the order they were made.
+     * @return false if there was no pending request, or one is being processed
+     */
+    bool processNextRequest();
+
     /*!
      * @param token
      * @param grpStatistic
@@ -298,6 +371,13 @@ private:
      */
     bool locked_updateRequestStatus(const uint32_t &token, const uint32_t &status);
 
+    /*!
+     * Calls and removes the observers of a processed request
+     * @param token the token of the request
+     * @param status the final status of the request
+     */
+    void notifyTokenObservers(const uint32_t &token, const uint32_t &status);
+
     /*!
      * Use to query the status and other values of a given token
      * @param token the toke of the request to check for
@@ -486,6 +566,11 @@ private:
     uint32_t mNextToken;
     std::map<uint32_t, uint32_t> mPublicToken;
     std::map<uint32_t, GxsRequest*> mRequests;
+    std::list<uint32_t> mPendingRequests;	/* tokens, in the order of the requests */
+    GxsRequest* mRunningRequest;	/* request being processed, NULL if none */
+
+    RsMutex mObserverMutex; /* protecting below. Never locked after mDataMutex. */
+    std::multimap<uint32_t, RsTokenObserver*> mTokenObservers;
 
 
 
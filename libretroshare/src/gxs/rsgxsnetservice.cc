@@ -255,6 +255,8 @@ static const uint32_t REJECTED_MESSAGE_RETRY_DELAY            =      24*3600; //
 static const uint32_t GROUP_STATS_UPDATE_DELAY                =          240; // update unsubscribed group statistics every 3 mins
 static const uint32_t GROUP_STATS_UPDATE_NB_PEERS             =            2; // number of peers to which the group stats are asked
 static const uint32_t MAX_ALLOWED_GXS_MESSAGE_SIZE            =       199000; // 200,000 bytes including signature and headers
+static const uint32_t MSG_ID_FILTER_MIN_RESEND_DELAY          =          600; // don't re-send a msg id filter to the same peer more often than every 10 mins
+static const uint32_t MSG_ID_FILTER_MAX_RESEND_DELAY          =         3600; // re-send (and rebuild) msg id filters every hour, in case the peer has restarted
 
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_UNKNOWN             = 0x00 ;
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_NO_ERROR            = 0x01 ;
@@ -415,6 +417,7 @@ int RsGxsNetService::tick()
     {
         mLastCleanRejectedMessages = now ;
         cleanRejectedMessages() ;
+        cleanMsgIdFilters() ;
     }
     return 1;
 }
@@ -488,6 +491,132 @@ void RsGxsNetService::cleanRejectedMessages()
             ++it ;
 }
 
+void RsGxsNetService::cleanMsgIdFilters()
+{
+    RS_STACK_MUTEX(mNxsMutex) ;
+    time_t now = time(NULL) ;
+
+    for(std::map<RsGxsGroupId,RsGxsMsgIdFilter>::iterator it(mLocalMsgIdFilters.begin());it!=mLocalMsgIdFilters.end();)
+        if(it->second.mTimeStamp + MSG_ID_FILTER_MAX_RESEND_DELAY < now)
+            mLocalMsgIdFilters.erase(it++) ;
+        else
+            ++it ;
+
+    for(std::map<RsPeerId,std::map<RsGxsGroupId,RsGxsMsgIdFilter::SendRecord> >::iterator it(mMsgIdFiltersSent.begin());it!=mMsgIdFiltersSent.end();)
+    {
+        for(std::map<RsGxsGroupId,RsGxsMsgIdFilter::SendRecord>::iterator it2(it->second.begin());it2!=it->second.end();)
+            if(it2->second.mSentTS + 2*MSG_ID_FILTER_MAX_RESEND_DELAY < now)
+                it->second.erase(it2++) ;
+            else
+                ++it2 ;
+
+        if(it->second.empty())
+            mMsgIdFiltersSent.erase(it++) ;
+        else
+            ++it ;
+    }
+
+    // Peers re-send their filter every hour. Older ones are probably from peers that went offline.
+
+    for(std::map<RsPeerId,std::map<RsGxsGroupId,RsGxsMsgIdFilter> >::iterator it(mPeerMsgIdFilters.begin());it!=mPeerMsgIdFilters.end();)
+    {
+        for(std::map<RsGxsGroupId,RsGxsMsgIdFilter>::iterator it2(it->second.begin());it2!=it->second.end();)
+            if(it2->second.mTimeStamp + 2*MSG_ID_FILTER_MAX_RESEND_DELAY < now)
+                it->second.erase(it2++) ;
+            else
+                ++it2 ;
+
+        if(it->second.empty())
+            mPeerMsgIdFilters.erase(it++) ;
+        else
+            ++it ;
+    }
+}
+
+void RsGxsNetService::locked_attachMsgIdFilter(const RsPeerId& peerId,const RsGxsGroupId& grpId,RsNxsSyncMsgReqItem *msg)
+{
+    time_t now = time(NULL) ;
+    uint32_t local_update_TS = 0 ;
+
+    ServerMsgMap::const_iterator sit = mServerMsgUpdateMap.find(grpId) ;
+
+    if(sit != mServerMsgUpdateMap.end())
+        local_update_TS = sit->second.msgUpdateTS ;
+
+    // The server keeps the last filter we sent, so we only send a new one when our own
+    // msg list has changed, and not too often. Sync requests stay small otherwise.
+
+    RsGxsMsgIdFilter::SendRecord& rec(mMsgIdFiltersSent[peerId][grpId]) ;
+
+    bool should_send = (rec.mSentTS == 0)
+                    || (rec.mUpdateTS != local_update_TS && rec.mSentTS + MSG_ID_FILTER_MIN_RESEND_DELAY < now)
+                    || (rec.mSentTS + MSG_ID_FILTER_MAX_RESEND_DELAY < now) ;
+
+    if(!should_send)
+        return ;
+
+    RsGxsMsgIdFilter& filter(mLocalMsgIdFilters[grpId]) ;
+
+    // The filter is built once and shared between all peers, until our msg list changes.
+
+    if(filter.mTimeStamp == 0 || filter.mUpdateTS != local_update_TS || filter.mTimeStamp + MSG_ID_FILTER_MAX_RESEND_DELAY < now)
+    {
+        RsGxsMessageId::std_vector msgIds ;
+        mDataStore->retrieveMsgIds(grpId, msgIds) ;
+
+        if(filter.init(msgIds.size()))
+            for(uint32_t i=0;i<msgIds.size();++i)
+                filter.add(msgIds[i]) ;
+
+        filter.mTimeStamp = now ;
+        filter.mUpdateTS = local_update_TS ;
+
+#ifdef NXS_NET_DEBUG_0
+        GXSNETDEBUG__G(grpId) << "  built msg id filter for group " << grpId << ": " << msgIds.size() << " ids, " << filter.toString().length()/2 << " bytes." << std::endl;
+#endif
+    }
+
+    rec.mSentTS = now ;
+    rec.mUpdateTS = local_update_TS ;
+
+    if(filter.empty())	// too many messages. The peer will send the full list.
+        return ;
+
+    msg->syncHash = filter.toString() ;
+    msg->flag |= RsNxsSyncMsgReqItem::FLAG_USE_MSG_ID_FILTER ;
+}
+
+const RsGxsMsgIdFilter *RsGxsNetService::locked_getPeerMsgIdFilter(const RsNxsSyncMsgReqItem *item)
+{
+    if(item->flag & RsNxsSyncMsgReqItem::FLAG_USE_MSG_ID_FILTER)
+    {
+        RsGxsMsgIdFilter filter ;
+
+        if(filter.fromString(item->syncHash))
+        {
+            filter.mTimeStamp = time(NULL) ;
+            mPeerMsgIdFilters[item->PeerId()][item->grpId] = filter ;
+        }
+        else
+        {
+            std::cerr << "(WW) received a msg sync req. from " << item->PeerId() << " with a wrong msg id filter. It will be ignored." << std::endl;
+            mPeerMsgIdFilters[item->PeerId()].erase(item->grpId) ;
+        }
+    }
+
+    std::map<RsPeerId,std::map<RsGxsGroupId,RsGxsMsgIdFilter> >::const_iterator it = mPeerMsgIdFilters.find(item->PeerId()) ;
+
+    if(it == mPeerMsgIdFilters.end())
+        return NULL ;
+
+    std::map<RsGxsGroupId,RsGxsMsgIdFilter>::const_iterator it2 = it->second.find(item->grpId) ;
+
+    if(it2 == it->second.end())
+        return NULL ;
+
+    return &it2->second ;
+}
+
 RsGxsGroupId RsGxsNetService::hashGrpId(const RsGxsGroupId& gid,const RsPeerId& pid)
 {
     static const uint32_t SIZE = RsGxsGroupId::SIZE_IN_BYTES + RsPeerId::SIZE_IN_BYTES ;
@@ -649,7 +778,12 @@ void RsGxsNetService::syncWithPeers()
 				msg->createdSinceTS = 0 ;
 
             if(encrypt_to_this_circle_id.isNull())
+            {
                 msg->grpId = grpId;
+
+                // Circle protected groups never get a filter: the request is sent in clear.
+                locked_attachMsgIdFilter(peerId,grpId,msg) ;
+            }
             else
             {
                 msg->grpId = hashGrpId(grpId,mNetMgr->getOwnId()) ;
@@ -4080,6 +4214,12 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 	    RsGxsGrpConfig& rec(locked_getGrpConfig(item->grpId)); // this creates it if needed. When the grp is unknown (and hashed) this will would create a unused entry
 	    rec.suppliers.ids.insert(peer) ;
     }
+
+    // Keep the msg id filter of the peer even if no update is sent now: the peer only sends
+    // it once in a while. Unknown groups are not stored, to avoid filling memory.
+
+    const RsGxsMsgIdFilter *peer_msg_id_filter = grp_is_known ? locked_getPeerMsgIdFilter(item) : NULL ;
+
     if(!peer_can_receive_update)
     {
 #ifdef NXS_NET_DEBUG_0
@@ -4120,17 +4260,26 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
         return ;
     }
 
-    GxsMsgReq req;
-    req[item->grpId] = std::vector<RsGxsMessageId>();
+    time_t now = time(NULL) ;
+
+    uint32_t max_send_delay = locked_getGrpConfig(item->grpId).msg_req_delay;	// we should use "sync" but there's only one variable used in the GUI: the req one.
+
+    // Only load the messages in the requested time window. Older ones would be dropped below anyway.
+
+    RsGxsMsgMetaQuery query;
+    query.mFields = RsGxsMsgMetaQuery::FIELD_PUBLISH_TS;
+    query.mPublishedAfter = item->createdSinceTS;
 
-    GxsMsgMetaResult metaResult;
-    mDataStore->retrieveGxsMsgMetaData(req, metaResult);
-    std::vector<RsGxsMsgMetaData*>& msgMetas = metaResult[item->grpId];
+    if(max_send_delay > 0 && now > (time_t)max_send_delay)
+        query.mPublishedAfter = std::max(query.mPublishedAfter, now - (time_t)max_send_delay);
+
+    std::vector<RsGxsMsgMetaData*> msgMetas;
+    mDataStore->retrieveGxsMsgMetaData(item->grpId, query, msgMetas);
 
 #ifdef NXS_NET_DEBUG_0
     GXSNETDEBUG_PG(item->PeerId(),item->grpId) << "   retrieving message meta data." << std::endl;
 #endif
-    if(req.empty())
+    if(msgMetas.empty())
     {
 #ifdef NXS_NET_DEBUG_0
 	    GXSNETDEBUG_PG(item->PeerId(),item->grpId) << "  No msg meta data.." << std::endl;
@@ -4145,9 +4294,9 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
     uint32_t transN = locked_getTransactionId();
     RsGxsCircleId should_encrypt_to_this_circle_id ;
 
-    time_t now = time(NULL) ;
-
-    uint32_t max_send_delay = locked_getGrpConfig(item->grpId).msg_req_delay;	// we should use "sync" but there's only one variable used in the GUI: the req one.
+#ifdef NXS_NET_DEBUG_0
+    uint32_t nb_filtered_ids = 0 ;
+#endif
 
     if(canSendMsgIds(msgMetas, *grpMeta, peer, should_encrypt_to_this_circle_id))
     {
@@ -4155,6 +4304,17 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 		{
 			RsGxsMsgMetaData* m = *vit;
 
+			// Skip messages the peer already has. Messages received since the peer's last update are always
+			// listed, so that a false positive in the filter cannot hide a new message.
+
+			if(peer_msg_id_filter != NULL && m->recvTS < item->updateTS && peer_msg_id_filter->contains(m->mMsgId))
+			{
+#ifdef NXS_NET_DEBUG_0
+				++nb_filtered_ids ;
+#endif
+				continue ;
+			}
+
             // Check reputation
 
             if(!m->mAuthorId.isNull())
@@ -4236,6 +4396,11 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 	    GXSNETDEBUG_PG(item->PeerId(),item->grpId) << "  vetting forbids sending. Nothing will be sent." << itemL.size() << " items." << std::endl;
 #endif
 
+#ifdef NXS_NET_DEBUG_0
+    if(peer_msg_id_filter != NULL)
+	    GXSNETDEBUG_PG(item->PeerId(),item->grpId) << "  msg id filter of the peer removed " << nb_filtered_ids << " items from the list." << std::endl;
+#endif
+
     if(!itemL.empty())
     {
 #ifdef NXS_NET_DEBUG_0
@@ -396,6 +396,15 @@ private:
     
     void syncWithPeers();
     void syncGrpStatistics();
+
+    /*!
+     * Msg id filters: a sync request may carry a bloom filter of the msg ids the client
+     * already has for the group, so that the server only lists the missing ones. Peers that
+     * never send a filter get the full list, as before.
+     */
+    void locked_attachMsgIdFilter(const RsPeerId& peerId, const RsGxsGroupId& grpId, RsNxsSyncMsgReqItem *msg);
+    const RsGxsMsgIdFilter *locked_getPeerMsgIdFilter(const RsNxsSyncMsgReqItem *item);
+    void cleanMsgIdFilters();
     void addGroupItemToList(NxsTransaction*& tr,
     		const RsGxsGroupId& grpId, uint32_t& transN,
     		std::list<RsNxsItem*>& reqList);
@@ -572,6 +581,10 @@ private:
     
     std::map<RsGxsMessageId,time_t> mRejectedMessages;
 
+    std::map<RsGxsGroupId,RsGxsMsgIdFilter> mLocalMsgIdFilters ;							// client side: filters of our own msg ids
+    std::map<RsPeerId,std::map<RsGxsGroupId,RsGxsMsgIdFilter::SendRecord> > mMsgIdFiltersSent ;	// client side: when filters were last sent
+    std::map<RsPeerId,std::map<RsGxsGroupId,RsGxsMsgIdFilter> > mPeerMsgIdFilters ;			// server side: last filter received from each peer
+
     std::vector<RsNxsGrp*> mNewGroupsToNotify ;
     std::vector<RsNxsMsg*> mNewMessagesToNotify ;
     std::set<RsGxsGroupId> mNewStatsToNotify ;
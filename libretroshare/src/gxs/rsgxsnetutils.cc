@@ -26,6 +26,10 @@
 #include "rsgxsnetutils.h"
 #include "pqi/p3servicecontrol.h"
 #include "pgp/pgpauxutils.h"
+#include "util/rsprint.h"
+#include "util/rsrandom.h"
+
+#include <algorithm>
 
  const time_t AuthorPending::EXPIRY_PERIOD_OFFSET = 30; // 30 seconds
  const int AuthorPending::MSG_PEND = 1;
@@ -313,3 +317,128 @@ int MsgCircleIdsRequestVetting::getType() const
 }
 
 
+
+static const uint32_t MSG_ID_FILTER_BITS_PER_ID = 10 ;		// ~1% false positives with 7 hashes
+static const uint32_t MSG_ID_FILTER_MAX_HASHES  = 7 ;
+static const uint32_t MSG_ID_FILTER_MIN_BYTES   = 64 ;
+static const uint32_t MSG_ID_FILTER_MAX_BYTES   = 16384 ;	// 32KB once hex encoded
+static const uint32_t MSG_ID_FILTER_HEADER_SIZE = 5 ;		// salt + number of hashes
+
+RsGxsMsgIdFilter::RsGxsMsgIdFilter()
+	: mTimeStamp(0), mUpdateTS(0), mSalt(0), mNbHashes(0)
+{
+}
+
+bool RsGxsMsgIdFilter::init(uint32_t n_ids)
+{
+	uint64_t n_bytes = ((uint64_t)n_ids * MSG_ID_FILTER_BITS_PER_ID + 7) / 8 ;
+
+	n_bytes = std::max(n_bytes,(uint64_t)MSG_ID_FILTER_MIN_BYTES) ;
+
+	// With too many ids for the max size, the filter would mostly answer "yes" and hide
+	// messages from the peer for a long time. Better not use it at all.
+
+	if(n_bytes > MSG_ID_FILTER_MAX_BYTES)
+	{
+		mBits.clear() ;
+		return false ;
+	}
+
+	mBits.clear() ;
+	mBits.resize(n_bytes,0) ;
+	mSalt = RSRandom::random_u32() ;
+	mNbHashes = std::max(1u,std::min(MSG_ID_FILTER_MAX_HASHES,(uint32_t)(0.69 * 8 * n_bytes / std::max(1u,n_ids)))) ;
+
+	return true ;
+}
+
+// Message ids are hashes already, so we just pick two salted 32 bits words from it, and
+// combine them in the usual double hashing scheme.
+
+uint32_t RsGxsMsgIdFilter::bitIndex(const RsGxsMessageId& id, uint32_t i) const
+{
+	const unsigned char *b = id.toByteArray() ;
+
+	uint32_t h1 = ((uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3])) ^ mSalt ;
+	uint32_t h2 = ((uint32_t(b[4]) << 24) | (uint32_t(b[5]) << 16) | (uint32_t(b[6]) << 8) | uint32_t(b[7])) ^ (mSalt * 0x9e3779b1) ;
+
+	h1 ^= h1 >> 15 ; h1 *= 0x2c1b3c6d ; h1 ^= h1 >> 12 ;
+	h2 ^= h2 >> 15 ; h2 *= 0x297a2d39 ; h2 ^= h2 >> 12 ;
+
+	return (h1 + i * (h2 | 1)) % (8 * mBits.size()) ;
+}
+
+void RsGxsMsgIdFilter::add(const RsGxsMessageId& id)
+{
+	if(mBits.empty())
+		return ;
+
+	for(uint32_t i=0;i<mNbHashes;++i)
+	{
+		uint32_t n = bitIndex(id,i) ;
+		mBits[n >> 3] |= (1 << (n & 7)) ;
+	}
+}
+
+bool RsGxsMsgIdFilter::contains(const RsGxsMessageId& id) const
+{
+	if(mBits.empty())
+		return false ;
+
+	for(uint32_t i=0;i<mNbHashes;++i)
+	{
+		uint32_t n = bitIndex(id,i) ;
+
+		if(!(mBits[n >> 3] & (1 << (n & 7))))
+			return false ;
+	}
+	return true ;
+}
+
+std::string RsGxsMsgIdFilter::toString() const
+{
+	if(mBits.empty())
+		return std::string() ;
+
+	unsigned char header[MSG_ID_FILTER_HEADER_SIZE] = { (unsigned char)(mSalt >> 24), (unsigned char)(mSalt >> 16), (unsigned char)(mSalt >> 8), (unsigned char)mSalt, mNbHashes } ;
+
+	return RsUtil::BinToHex(header,MSG_ID_FILTER_HEADER_SIZE) + RsUtil::BinToHex(&mBits[0],mBits.size()) ;
+}
+
+static bool hexDigit(char c,uint8_t& v)
+{
+	if(c >= '0' && c <= '9') { v = c - '0' ; return true ; }
+	if(c >= 'a' && c <= 'f') { v = c - 'a' + 10 ; return true ; }
+	if(c >= 'A' && c <= 'F') { v = c - 'A' + 10 ; return true ; }
+
+	return false ;
+}
+
+bool RsGxsMsgIdFilter::fromString(const std::string& s)
+{
+	mBits.clear() ;
+
+	if((s.length() & 1) || s.length() < 2*(MSG_ID_FILTER_HEADER_SIZE + MSG_ID_FILTER_MIN_BYTES) || s.length() > 2*(MSG_ID_FILTER_HEADER_SIZE + MSG_ID_FILTER_MAX_BYTES))
+		return false ;
+
+	std::vector<uint8_t> bytes(s.length()/2) ;
+
+	for(uint32_t i=0;i<bytes.size();++i)
+	{
+		uint8_t hi,lo ;
+
+		if(!hexDigit(s[2*i],hi) || !hexDigit(s[2*i+1],lo))
+			return false ;
+
+		bytes[i] = (hi << 4) | lo ;
+	}
+
+	if(bytes[4] == 0 || bytes[4] > MSG_ID_FILTER_MAX_HASHES)
+		return false ;
+
+	mSalt = (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]) ;
+	mNbHashes = bytes[4] ;
+	mBits.assign(bytes.begin() + MSG_ID_FILTER_HEADER_SIZE,bytes.end()) ;
+
+	return true ;
+}
@@ -289,5 +289,48 @@ public:
 	bool mShouldEncrypt;
 };
 
+/*!
+ * Bloom filter over the message ids of a group. Sent by a peer along with its
+ * msg sync request, so that the server only lists the messages that the peer
+ * does not already have. A false positive only delays a message: messages received
+ * since the peer's last update are always listed, and the salt changes every time
+ * the filter is rebuilt.
+ */
+class RsGxsMsgIdFilter
+{
+public:
+	RsGxsMsgIdFilter();
+
+	// sizes the filter for the given number of ids. Returns false if the filter would
+	// be too large or too inaccurate to be worth sending.
+	bool init(uint32_t n_ids);
+
+	void add(const RsGxsMessageId& id);
+	bool contains(const RsGxsMessageId& id) const;
+	bool empty() const { return mBits.empty(); }
+
+	// hex encoding, so that it travels in the syncHash string of RsNxsSyncMsgReqItem
+	std::string toString() const;
+	bool fromString(const std::string& s);
+
+	time_t mTimeStamp;		// build time (client side) or reception time (server side)
+	uint32_t mUpdateTS;		// local msg update TS of the group at build time
+
+	// Client side: what was last sent to a given peer for a given group.
+	struct SendRecord
+	{
+		SendRecord() : mSentTS(0), mUpdateTS(0) {}
+
+		time_t mSentTS;
+		uint32_t mUpdateTS;
+	};
+
+private:
+	uint32_t bitIndex(const RsGxsMessageId& id, uint32_t i) const;
+
+	uint32_t mSalt;
+	uint8_t mNbHashes;
+	std::vector<uint8_t> mBits;
+};
 
 #endif /* RSGXSNETUTILS_H_ */
@@ -24,6 +24,7 @@
  */
 
 #include <time.h>
+#include <thread>
 
 #include "rsgxsutil.h"
 #include "retroshare/rsgxsflags.h"
@@ -32,6 +33,8 @@
 #include "gxs/rsgixs.h"
 
 static const uint32_t MAX_GXS_IDS_REQUESTS_NET   =  10 ; // max number of requests from cache/net (avoids killing the system!)
+static const uint32_t MAX_GXS_VALIDATION_THREADS =   4 ; // threads checking signatures, besides the service thread asking for it
+static const uint32_t GXS_VALIDATION_IDLE_WAIT   = 1000 ; // ms
 
 //#define DEBUG_GXSUTIL 1
 
@@ -385,3 +388,109 @@ void RsGxsIntegrityCheck::getDeletedIds(std::list<RsGxsGroupId>& grpIds, std::ma
 	msgIds = mDeletedMsgs;
 }
 
+
+RsGxsValidationPool& RsGxsValidationPool::instance()
+{
+	// never deleted: the workers run until the process exits.
+
+	static RsGxsValidationPool *pool = new RsGxsValidationPool ;
+	return *pool ;
+}
+
+RsGxsValidationPool::RsGxsValidationPool()
+	: mPoolMtx("RsGxsValidationPool")
+{
+	// The calling thread also runs jobs, so one core is already taken.
+
+	uint32_t nb_threads = std::thread::hardware_concurrency() ;
+
+	if(nb_threads > 0)
+		--nb_threads ;
+
+	nb_threads = std::min(nb_threads,MAX_GXS_VALIDATION_THREADS) ;
+
+	for(uint32_t i=0;i<nb_threads;++i)
+	{
+		RsGxsValidationWorker *w = new RsGxsValidationWorker(this) ;
+		w->start("gxs validation") ;
+		mWorkers.push_back(w) ;
+	}
+#ifdef DEBUG_GXSUTIL
+	GXSUTIL_DEBUG() << "started " << nb_threads << " signature validation threads" << std::endl;
+#endif
+}
+
+void RsGxsValidationWorker::data_tick()
+{
+	if(!mPool->runNextJob(NULL))
+		mPool->mWorkSignal.wait(GXS_VALIDATION_IDLE_WAIT) ;
+}
+
+bool RsGxsValidationPool::runNextJob(Batch *batch)
+{
+	RsGxsValidationJob *job ;
+	{
+		RS_STACK_MUTEX(mPoolMtx) ;
+
+		if(batch == NULL)
+			for(std::list<Batch*>::const_iterator it(mBatches.begin());it!=mBatches.end() && batch == NULL;++it)
+				if((*it)->next < (*it)->jobs.size())
+					batch = *it ;
+
+		if(batch == NULL || batch->next >= batch->jobs.size())
+			return false ;
+
+		job = batch->jobs[batch->next++] ;
+
+		// wake up another worker for the remaining jobs
+
+		if(batch->next < batch->jobs.size())
+			mWorkSignal.wakeup() ;
+	}
+
+	job->run() ;
+
+	RS_STACK_MUTEX(mPoolMtx) ;
+
+	if(++batch->done == batch->jobs.size())
+		batch->finished.wakeup() ;
+
+	return true ;
+}
+
+void RsGxsValidationPool::runJobs(const std::vector<RsGxsValidationJob*>& jobs)
+{
+	if(jobs.empty())
+		return ;
+
+	if(jobs.size() == 1 || mWorkers.empty())
+	{
+		for(uint32_t i=0;i<jobs.size();++i)
+			jobs[i]->run() ;
+		return ;
+	}
+
+	Batch batch(jobs) ;
+	{
+		RS_STACK_MUTEX(mPoolMtx) ;
+		mBatches.push_back(&batch) ;
+	}
+	mWorkSignal.wakeup() ;
+
+	while(runNextJob(&batch)) ;
+
+	// All jobs are taken. Wait for the ones still running in the workers.
+
+	while(true)
+	{
+		{
+			RS_STACK_MUTEX(mPoolMtx) ;
+
+			mBatches.remove(&batch) ;
+
+			if(batch.done == jobs.size())
+				break ;
+		}
+		batch.finished.wait(GXS_VALIDATION_IDLE_WAIT) ;
+	}
+}
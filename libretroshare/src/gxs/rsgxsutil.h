@@ -222,6 +222,73 @@ private:
     	RsGixs *mGixs ;
 };
 
+/*!
+ * A signature check (or any other self contained piece of validation work)
+ * that can be run by the validation pool.
+ */
+class RsGxsValidationJob
+{
+public:
+	virtual ~RsGxsValidationJob() {}
+	virtual void run() = 0;
+};
+
+class RsGxsValidationPool ;
+
+class RsGxsValidationWorker : public RsTickingThread
+{
+public:
+	explicit RsGxsValidationWorker(RsGxsValidationPool *pool) : mPool(pool) {}
+
+	virtual void data_tick() ;
+
+private:
+	RsGxsValidationPool *mPool ;
+};
+
+/*!
+ * Pool of threads shared by all GXS services to check the RSA signatures of incoming
+ * groups and messages. Each job must only touch its own data, and whatever it calls
+ * must be thread safe.
+ */
+class RsGxsValidationPool
+{
+public:
+	static RsGxsValidationPool& instance();
+
+	/*!
+	 * Runs all jobs using the pool threads and the calling thread, which
+	 * also works on the batch. Returns when all jobs have been run.
+	 */
+	void runJobs(const std::vector<RsGxsValidationJob*>& jobs);
+
+private:
+	friend class RsGxsValidationWorker ;
+
+	struct Batch
+	{
+		Batch(const std::vector<RsGxsValidationJob*>& j) : jobs(j), next(0), done(0) {}
+
+		const std::vector<RsGxsValidationJob*>& jobs ;
+		uint32_t next ;
+		uint32_t done ;
+		RsWakeupSignal finished ;
+	};
+
+	RsGxsValidationPool();
+
+	/*!
+	 * Runs one job of the given batch, or of any batch if NULL.
+	 * @return false if there was nothing left to run
+	 */
+	bool runNextJob(Batch *batch);
+
+	RsMutex mPoolMtx ;
+	std::list<Batch*> mBatches ;
+	RsWakeupSignal mWorkSignal ;
+	std::vector<RsGxsValidationWorker*> mWorkers ;
+};
+
 class GroupUpdate
 {
 public:
@@ -0,0 +1,195 @@
+/*
+ * libretroshare/src/gxstunnel: gxstunneldhpool.cc
+ *
+ * Services for RetroShare.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "csoler@users.sourceforge.net".
+ *
+ */
+
+#include <iostream>
+#include <string>
+
+#include "openssl/err.h"
+
+#include "gxstunneldhpool.h"
+
+//#define DEBUG_GXS_TUNNEL_DH_POOL
+
+static const uint32_t GXS_TUNNEL_DH_POOL_IDLE_WAIT_MS = 1000 ;
+
+GxsTunnelDHKeyPool::GxsTunnelDHKeyPool(uint32_t pool_size)
+	: mPoolMtx("GxsTunnelDHKeyPool"), mPoolSize(pool_size), mGroupChecked(false)
+{
+}
+
+GxsTunnelDHKeyPool::~GxsTunnelDHKeyPool()
+{
+	for(std::list<DH*>::const_iterator it(mKeys.begin());it!=mKeys.end();++it)
+		DH_free(*it) ;
+}
+
+DH *GxsTunnelDHKeyPool::takeKey()
+{
+	DH *dh = NULL ;
+	{
+		RS_STACK_MUTEX(mPoolMtx); /********** STACK LOCKED MTX ******/
+
+		if(!mKeys.empty())
+		{
+			dh = mKeys.front() ;
+			mKeys.pop_front() ;
+		}
+	}
+	mRefillSignal.wakeup() ;
+
+	if(dh != NULL)
+		return dh ;
+
+#ifdef DEBUG_GXS_TUNNEL_DH_POOL
+	std::cerr << "GxsTunnelDHKeyPool: pool is empty. Generating key on demand." << std::endl;
+#endif
+	return generateKey() ;
+}
+
+void GxsTunnelDHKeyPool::setPoolSize(uint32_t size)
+{
+	std::list<DH*> to_free ;
+	{
+		RS_STACK_MUTEX(mPoolMtx); /********** STACK LOCKED MTX ******/
+
+		mPoolSize = size ;
+
+		while(mKeys.size() > mPoolSize)
+		{
+			to_free.push_back(mKeys.back()) ;
+			mKeys.pop_back() ;
+		}
+	}
+	for(std::list<DH*>::const_iterator it(to_free.begin());it!=to_free.end();++it)
+		DH_free(*it) ;
+
+	mRefillSignal.wakeup() ;
+}
+
+uint32_t GxsTunnelDHKeyPool::poolSize()
+{
+	RS_STACK_MUTEX(mPoolMtx); /********** STACK LOCKED MTX ******/
+	return mPoolSize ;
+}
+
+uint32_t GxsTunnelDHKeyPool::readyKeys()
+{
+	RS_STACK_MUTEX(mPoolMtx); /********** STACK LOCKED MTX ******/
+	return mKeys.size() ;
+}
+
+void GxsTunnelDHKeyPool::data_tick()
+{
+	bool full ;
+	{
+		RS_STACK_MUTEX(mPoolMtx); /********** STACK LOCKED MTX ******/
+
+		// Also generates a key when the pool is disabled, so that the DH group is checked before the first tunnel needs it.
+
+		full = mGroupChecked && mKeys.size() >= mPoolSize ;
+	}
+
+	if(full)
+	{
+		mRefillSignal.wait(GXS_TUNNEL_DH_POOL_IDLE_WAIT_MS) ;
+		return ;
+	}
+
+	DH *dh = generateKey() ;
+
+	if(dh == NULL)
+	{
+		mRefillSignal.wait(GXS_TUNNEL_DH_POOL_IDLE_WAIT_MS) ;
+		return ;
+	}
+
+	RS_STACK_MUTEX(mPoolMtx); /********** STACK LOCKED MTX ******/
+
+	if(mKeys.size() < mPoolSize)
+		mKeys.push_back(dh) ;
+	else
+		DH_free(dh) ;
+
+#ifdef DEBUG_GXS_TUNNEL_DH_POOL
+	std::cerr << "GxsTunnelDHKeyPool: " << mKeys.size() << " keys ready." << std::endl;
+#endif
+}
+
+DH *GxsTunnelDHKeyPool::generateKey()
+{
+	// We use our own DH group prime. This has been generated with command-line openssl and checked.
+
+	static const std::string dh_prime_2048_hex = "B3B86A844550486C7EA459FA468D3A8EFD71139593FE1C658BBEFA9B2FC0AD2628242C2CDC2F91F5B220ED29AAC271192A7374DFA28CDDCA70252F342D0821273940344A7A6A3CB70C7897A39864309F6CAC5C7EA18020EF882693CA2C12BB211B7BA8367D5A7C7252A5B5E840C9E8F081469EBA0B98BCC3F593A4D9C4D5DF539362084F1B9581316C1F80FDAD452FD56DBC6B8ED0775F596F7BB22A3FE2B4753764221528D33DB4140DE58083DB660E3E105123FC963BFF108AC3A268B7380FFA72005A1515C371287C5706FFA6062C9AC73A9B1A6AC842C2764CDACFC85556607E86611FDF486C222E4896CDF6908F239E177ACC641FCBFF72A758D1C10CBB" ;
+
+	DH *dh = DH_new() ;
+
+	if(!dh)
+	{
+		std::cerr << "  (EE) DH_new() failed." << std::endl;
+		return NULL ;
+	}
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
+	BN_hex2bn(&dh->p,dh_prime_2048_hex.c_str()) ;
+	BN_hex2bn(&dh->g,"5") ;
+#else
+	BIGNUM *pp=NULL ;
+	BIGNUM *gg=NULL ;
+
+	BN_hex2bn(&pp,dh_prime_2048_hex.c_str()) ;
+	BN_hex2bn(&gg,"5") ;
+
+	DH_set0_pqg(dh,pp,NULL,gg) ;
+#endif
+
+	// The group never changes, and checking it takes far longer than generating the key, so it is only checked once.
+
+	bool group_checked ;
+	{
+		RS_STACK_MUTEX(mPoolMtx); /********** STACK LOCKED MTX ******/
+		group_checked = mGroupChecked ;
+	}
+
+	if(!group_checked)
+	{
+		int codes = 0 ;
+
+		if(!DH_check(dh, &codes) || codes != 0)
+		{
+			std::cerr << "  (EE) DH check failed!" << std::endl;
+			DH_free(dh) ;
+			return NULL ;
+		}
+
+		RS_STACK_MUTEX(mPoolMtx); /********** STACK LOCKED MTX ******/
+		mGroupChecked = true ;
+	}
+
+	if(!DH_generate_key(dh))
+	{
+		std::cerr << "  (EE) DH generate_key() failed! Error code = " << ERR_get_error() << std::endl;
+		DH_free(dh) ;
+		return NULL ;
+	}
+	return dh ;
+}
@@ -0,0 +1,66 @@
+/*
+ * libretroshare/src/gxstunnel: gxstunneldhpool.h
+ *
+ * Services for RetroShare.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "csoler@users.sourceforge.net".
+ *
+ */
+
+#pragma once
+
+// Pool of DH key pairs for GXS tunnel sessions.
+//
+// Each new tunnel needs a fresh DH key pair. Generating it takes a few ms, but checking the DH group takes
+// much longer, and both used to happen in the tunnel service mutex. When many tunnels come up at once
+// (e.g. after reconnecting) the tunnel setup and all tunnel traffic stalled.
+//
+// The pool keeps a number of key pairs ready, and refills in its own thread. The group is checked only once.
+// When the pool is empty, the key is generated by the caller.
+
+#include <list>
+#include <openssl/dh.h>
+
+#include "util/rsthreads.h"
+
+class GxsTunnelDHKeyPool: public RsTickingThread
+{
+public:
+	explicit GxsTunnelDHKeyPool(uint32_t pool_size) ;
+	virtual ~GxsTunnelDHKeyPool() ;
+
+	// Returns a new DH key pair, that the caller frees with DH_free(). Returns NULL if the key cannot be generated.
+	DH *takeKey() ;
+
+	// Number of key pairs kept ready. 0 disables the pool: keys are then all generated on demand.
+	void setPoolSize(uint32_t size) ;
+	uint32_t poolSize() ;
+
+	// Number of key pairs currently ready.
+	uint32_t readyKeys() ;
+
+	virtual void data_tick() ;
+
+private:
+	DH *generateKey() ;
+
+	RsMutex mPoolMtx ;
+	std::list<DH*> mKeys ;
+	uint32_t mPoolSize ;
+	bool mGroupChecked ;
+	RsWakeupSignal mRefillSignal ;
+};
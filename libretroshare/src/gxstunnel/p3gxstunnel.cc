@@ -25,6 +25,8 @@
 
 
 #include <unistd.h>
+#include <math.h>
+#include <sys/time.h>
 
 #include "openssl/rand.h"
 #include "openssl/dh.h"
@@ -48,14 +50,22 @@
 //#define DEBUG_GXS_TUNNEL
 
 static const uint32_t GXS_TUNNEL_KEEP_ALIVE_TIMEOUT = 6 ; // send keep alive packet so as to avoid tunnel breaks.
+static const uint32_t GXS_TUNNEL_DH_KEY_POOL_SIZE   = 16 ; // DH key pairs kept ready for new tunnels.
 
 static const uint32_t RS_GXS_TUNNEL_DH_STATUS_UNINITIALIZED = 0x0000 ;
 static const uint32_t RS_GXS_TUNNEL_DH_STATUS_HALF_KEY_DONE = 0x0001 ;
 static const uint32_t RS_GXS_TUNNEL_DH_STATUS_KEY_AVAILABLE = 0x0002 ;
 
-static const uint32_t RS_GXS_TUNNEL_DELAY_BETWEEN_RESEND     = 10 ; // re-send every 10 secs.
 static const uint32_t RS_GXS_TUNNEL_DATA_PRINT_STORAGE_DELAY = 600 ; // store old message ids for 10 minutes.
 
+static const double   RS_GXS_TUNNEL_INITIAL_RTO              = 10.0 ; // re-send delay until the round trip time is measured.
+static const double   RS_GXS_TUNNEL_MIN_RTO                  = 2.0 ;
+static const double   RS_GXS_TUNNEL_MAX_RTO                  = 60.0 ;
+static const uint32_t RS_GXS_TUNNEL_INITIAL_WINDOW           = 8 ;    // number of data packets sent before the first ACK.
+static const uint32_t RS_GXS_TUNNEL_MAX_WINDOW               = 256 ;
+static const uint32_t RS_GXS_TUNNEL_MAX_SELECTIVE_ACKS       = 32 ;   // max number of out of order packets acknowledged in one ACK.
+static const double   RS_GXS_TUNNEL_RATE_UPDATE_DELAY        = 1.0 ;
+
 static const uint32_t GXS_TUNNEL_ENCRYPTION_HMAC_SIZE    = SHA_DIGEST_LENGTH ;
 static const uint32_t GXS_TUNNEL_ENCRYPTION_IV_SIZE      = 8 ;
 
@@ -69,6 +79,16 @@ static const uint8_t GXS_TUNNEL_APP_MAJOR_VERSION = 0x01 ;
 static const uint8_t GXS_TUNNEL_APP_MINOR_VERSION = 0x00 ;
 static const uint8_t GXS_TUNNEL_MIN_MAJOR_VERSION = 0x01 ;
 static const uint8_t GXS_TUNNEL_MIN_MINOR_VERSION = 0x00 ;
+
+// Clock of the windowed transport, in seconds. RsScopeTimer::currentTime() can't be used, since it wraps every 10000 s:
+// items sent just before the wrap would never time out, and the next round trip time sample would be wrong.
+
+static double tunnelTime()
+{
+    timeval tv ;
+    gettimeofday(&tv,NULL) ;
+    return tv.tv_sec + tv.tv_usec/1000000.0 ;
+}
         
 RsGxsTunnelService *rsGxsTunnel = NULL ;
 
@@ -76,7 +96,16 @@ p3GxsTunnelService::p3GxsTunnelService(RsGixs *pids)
             : mGixs(pids), mGxsTunnelMtx("GXS tunnel")
 {
 	mTurtle = NULL ;
-	mCurrentPacketCounter = 0 ;
+	mItemSink = NULL ;
+
+	mDHKeyPool = new GxsTunnelDHKeyPool(GXS_TUNNEL_DH_KEY_POOL_SIZE) ;
+	mDHKeyPool->start("gxs tunnel DH") ;
+}
+
+p3GxsTunnelService::~p3GxsTunnelService()
+{
+	mDHKeyPool->fullstop() ;
+	delete mDHKeyPool ;
 }
 
 void p3GxsTunnelService::connectToTurtleRouter(p3turtle *tr)
@@ -165,28 +194,15 @@ void p3GxsTunnelService::flush()
 		    }
     }
     
-    // Look at pending data item, and re-send them if necessary.
+    // Send ACKs and pending data items in the window of each tunnel, and re-send the ones that were not acknowledged in time.
     
     {
 	    RS_STACK_MUTEX(mGxsTunnelMtx); /********** STACK LOCKED MTX ******/
 
-	    time_t now = time(NULL) ;
+	    double now = tunnelTime() ;
 
-	    for(std::map<uint64_t, GxsTunnelData>::iterator it = pendingGxsTunnelDataItems.begin();it != pendingGxsTunnelDataItems.end();++it)
-		    if(now > RS_GXS_TUNNEL_DELAY_BETWEEN_RESEND + it->second.last_sending_attempt)
-		    {
-			    if(locked_sendEncryptedTunnelData(it->second.data_item))
-			    {                    		
-#ifdef DEBUG_GXS_TUNNEL    
-				    std::cerr << "  sending data item #" << std::hex << it->first << std::dec << std::endl;
-#endif
-				    it->second.last_sending_attempt = now ;
-			    }
-#ifdef DEBUG_GXS_TUNNEL    
-			    else
-				    std::cerr << "  Cannot send item " << std::hex << it->first << std::dec << std::endl;
-#endif
-		    }
+	    for(std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::iterator it = _gxs_tunnel_contacts.begin();it != _gxs_tunnel_contacts.end();++it)
+		    locked_sendPendingData(it->first,it->second,now) ;
     }
 
     // TODO:  also sweep GXS id map and disable any ID with no virtual peer id in the list.
@@ -205,6 +221,7 @@ void p3GxsTunnelService::flush()
 	{
 		std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::iterator tmp = it ;
 		++tmp ;
+		locked_deleteDataItems(it->second) ;
 		_gxs_tunnel_contacts.erase(it) ;
 		it=tmp ;
 		continue ;
@@ -295,6 +312,9 @@ void p3GxsTunnelService::handleIncomingItem(const RsGxsTunnelId& tunnel_id,RsGxs
     case RS_PKT_SUBTYPE_GXS_TUNNEL_DATA_ACK:	handleRecvTunnelDataAckItem(tunnel_id,dynamic_cast<RsGxsTunnelDataAckItem*>(item)) ;
 	    break ;
 
+    case RS_PKT_SUBTYPE_GXS_TUNNEL_DATA_SACK:	handleRecvTunnelDataSAckItem(tunnel_id,dynamic_cast<RsGxsTunnelDataSAckItem*>(item)) ;
+	    break ;
+
     case RS_PKT_SUBTYPE_GXS_TUNNEL_STATUS:		handleRecvStatusItem(tunnel_id,dynamic_cast<RsGxsTunnelStatusItem*>(item)) ;
 	    break ;
 
@@ -305,92 +325,408 @@ void p3GxsTunnelService::handleIncomingItem(const RsGxsTunnelId& tunnel_id,RsGxs
     delete item ;
 }
 
-void p3GxsTunnelService::handleRecvTunnelDataAckItem(const RsGxsTunnelId &/*id*/,RsGxsTunnelDataAckItem *item)
+// ACK from peers that do not sequence the data they receive. It acknowledges a single item.
+
+void p3GxsTunnelService::handleRecvTunnelDataAckItem(const RsGxsTunnelId &id,RsGxsTunnelDataAckItem *item)
 {
     RS_STACK_MUTEX(mGxsTunnelMtx); /********** STACK LOCKED MTX ******/
-    
-#ifdef DEBUG_GXS_TUNNEL    
+
+#ifdef DEBUG_GXS_TUNNEL
     std::cerr << "p3GxsTunnelService::handling RecvTunnelDataAckItem()" << std::endl;
     std::cerr << "  item counter = " << std::hex << item->unique_item_counter << std::dec << std::endl;
 #endif
-    
+
     // remove it from the queue.
-    
-    std::map<uint64_t,GxsTunnelData>::iterator it = pendingGxsTunnelDataItems.find(item->unique_item_counter) ;
-    
-    if(it == pendingGxsTunnelDataItems.end())
+
+    std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::iterator it = _gxs_tunnel_contacts.find(id) ;
+
+    if(it == _gxs_tunnel_contacts.end() || (item->unique_item_counter >> 32) != it->second.send_session)
     {
         std::cerr << "  (EE) item number " << std::hex << item->unique_item_counter << std::dec << " is unknown. This is unexpected." << std::endl;
         return ;
     }
-    
+
+    locked_acknowledgeData(it->second,(uint32_t)item->unique_item_counter,tunnelTime()) ;
+}
+
+void p3GxsTunnelService::handleRecvTunnelDataSAckItem(const RsGxsTunnelId &id,RsGxsTunnelDataSAckItem *item)
+{
+    RS_STACK_MUTEX(mGxsTunnelMtx); /********** STACK LOCKED MTX ******/
+
+#ifdef DEBUG_GXS_TUNNEL
+    std::cerr << "p3GxsTunnelService::handling RecvTunnelDataSAckItem()" << std::endl;
+    std::cerr << "  cumulative counter = " << std::hex << item->cumulative_counter << std::dec << ", " << item->selective_acks.size() << " selective ACKs" << std::endl;
+#endif
+
+    std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::iterator it = _gxs_tunnel_contacts.find(id) ;
+
+    if(it == _gxs_tunnel_contacts.end() || (item->cumulative_counter >> 32) != it->second.send_session)
+    {
+        std::cerr << "  (EE) ACK for unknown data session " << std::hex << (item->cumulative_counter >> 32) << std::dec << " in tunnel " << id << ". This is unexpected." << std::endl;
+        return ;
+    }
+
+    GxsTunnelPeerInfo& info(it->second) ;
+    double now = tunnelTime() ;
+    uint32_t cumulative = (uint32_t)item->cumulative_counter ;
+
+    for(std::map<uint32_t,GxsTunnelData>::iterator it2(info.outgoing_data.begin());it2!=info.outgoing_data.end() && it2->first <= cumulative;)
+    {
+        uint32_t seq = it2->first ;
+        ++it2 ;
+        locked_acknowledgeData(info,seq,now) ;
+    }
+
+    for(uint32_t i=0;i<item->selective_acks.size();++i)
+        locked_acknowledgeData(info,item->selective_acks[i],now) ;
+}
+
+void p3GxsTunnelService::locked_acknowledgeData(GxsTunnelPeerInfo& info,uint32_t seq,double now)
+{
+    std::map<uint32_t,GxsTunnelData>::iterator it = info.outgoing_data.find(seq) ;
+
+    if(it == info.outgoing_data.end() || it->second.send_count == 0)	// already acknowledged, or never sent.
+        return ;
+
+    // Only items sent once give a reliable round trip time.
+
+    if(it->second.send_count == 1)
+    {
+        double rtt = std::max(0.0,now - it->second.last_sending_attempt) ;
+
+        if(info.srtt == 0)
+        {
+            info.srtt = rtt ;
+            info.rttvar = rtt/2 ;
+        }
+        else
+        {
+            info.rttvar = 0.75*info.rttvar + 0.25*fabs(info.srtt - rtt) ;
+            info.srtt   = 0.875*info.srtt + 0.125*rtt ;
+        }
+
+        // Most items get a sample, so the variance gets small quickly. Keep the delay above twice the round trip time, which
+        // avoids re-sending all items in flight when the tunnel gets a bit slower.
+
+        info.rto = std::min(RS_GXS_TUNNEL_MAX_RTO,std::max(RS_GXS_TUNNEL_MIN_RTO,info.srtt + std::max(4*info.rttvar,info.srtt))) ;
+    }
+
+    // Grow the window quickly up to the size where packets were lost last time, then slowly.
+
+    if(info.send_window < info.send_window_threshold)
+        info.send_window += 1 ;
+    else
+        info.send_window += 1/info.send_window ;
+
+    info.send_window = std::min(info.send_window,(double)RS_GXS_TUNNEL_MAX_WINDOW) ;
+    info.bytes_acked += it->second.data_item->data_size ;
+
+    // Remember the last sent item that arrived. Items sent before it and not acknowledged are probably lost.
+
+    if(it->second.last_sending_attempt > info.last_acked_send_time || (it->second.last_sending_attempt == info.last_acked_send_time && seq > info.last_acked_seq))
+    {
+        info.last_acked_send_time = it->second.last_sending_attempt ;
+        info.last_acked_seq = seq ;
+    }
+
+#ifdef DEBUG_GXS_TUNNEL
+    std::cerr << "  data item #" << seq << " acknowledged. srtt=" << info.srtt << " rto=" << info.rto << " window=" << info.send_window << std::endl;
+#endif
     delete it->second.data_item ;
-    pendingGxsTunnelDataItems.erase(it) ;
+    info.outgoing_data.erase(it) ;
 }
 
-void p3GxsTunnelService::handleRecvTunnelDataItem(const RsGxsTunnelId& tunnel_id,RsGxsTunnelDataItem *item) 
+void p3GxsTunnelService::locked_sendPendingData(const RsGxsTunnelId& tunnel_id,GxsTunnelPeerInfo& info,double now)
 {
-    // imediately send an ACK for this item
-    
-    RsGxsTunnelDataAckItem *ackitem = new RsGxsTunnelDataAckItem ;
-    
-    ackitem->unique_item_counter = item->unique_item_counter ;
-    ackitem->PeerId(RsPeerId(tunnel_id)) ;
-    
+    if(info.last_rate_update == 0)
+        info.last_rate_update = now ;
+    else if(now > info.last_rate_update + RS_GXS_TUNNEL_RATE_UPDATE_DELAY)
     {
+        double dt = now - info.last_rate_update ;
+
+        info.send_rate    = 0.75*info.send_rate    + 0.25*info.bytes_acked/dt ;
+        info.receive_rate = 0.75*info.receive_rate + 0.25*info.bytes_received/dt ;
+        info.bytes_acked = 0 ;
+        info.bytes_received = 0 ;
+        info.last_rate_update = now ;
+    }
+
+    if(info.status != RS_GXS_TUNNEL_STATUS_CAN_TALK)
+        return ;
+
+    // 1 - acknowledge all sequenced items received since last flush at once.
+
+    if(info.ack_needed)
+    {
+        RsGxsTunnelDataSAckItem *ackitem = new RsGxsTunnelDataSAckItem ;
+
+        ackitem->cumulative_counter = ((uint64_t)info.recv_session << 32) + info.next_recv_seq - 1 ;
+
+        for(std::set<uint32_t>::const_iterator it(info.recv_out_of_order.begin());it!=info.recv_out_of_order.end() && ackitem->selective_acks.size() < RS_GXS_TUNNEL_MAX_SELECTIVE_ACKS;++it)
+            ackitem->selective_acks.push_back(*it) ;
+
+        ackitem->PeerId(RsPeerId(tunnel_id)) ;
+
+        if(locked_sendEncryptedTunnelData(ackitem))
+            info.ack_needed = false ;
+
+        delete ackitem ;
+    }
+
+    if(info.outgoing_data.empty())
+        return ;
+
+    // 2 - re-send items that were not acknowledged in time, and send new items as long as they fit in the window, which
+    //     starts at the oldest item not acknowledged. An item is also re-sent without waiting for the timeout when items
+    //     sent after it were acknowledged a while ago, since it was most probably lost.
+
+    uint32_t window_start = info.outgoing_data.begin()->first ;
+    bool timeout = false ;
+
+    for(std::map<uint32_t,GxsTunnelData>::iterator it(info.outgoing_data.begin());it!=info.outgoing_data.end();++it)
+    {
+        GxsTunnelData& tdata(it->second) ;
+
+        if(tdata.send_count == 0)
+        {
+            if(it->first >= window_start + (uint32_t)info.send_window)
+                break ;
+        }
+        else if(now >= tdata.last_sending_attempt + info.rto)
+            timeout = true ;
+        else
+        {
+            bool sent_before_acked_item = tdata.last_sending_attempt < info.last_acked_send_time
+                                          || (tdata.last_sending_attempt == info.last_acked_send_time && it->first < info.last_acked_seq) ;
+
+            if(!sent_before_acked_item || now < tdata.last_sending_attempt + 1.25*info.srtt)
+                continue ;
+        }
+
+        uint32_t dist = std::min(it->first - window_start,(uint32_t)0xffff) ;
+        tdata.data_item->flags = RS_GXS_TUNNEL_DATA_FLAG_SEQUENCED | (dist << RS_GXS_TUNNEL_DATA_WINDOW_BASE_SHIFT) ;
+
+        if(!locked_sendEncryptedTunnelData(tdata.data_item))
+        {
+#ifdef DEBUG_GXS_TUNNEL
+            std::cerr << "  Cannot send item " << std::hex << tdata.data_item->unique_item_counter << std::dec << std::endl;
+#endif
+            break ;
+        }
+#ifdef DEBUG_GXS_TUNNEL
+        std::cerr << "  sending data item #" << std::hex << tdata.data_item->unique_item_counter << std::dec << " (attempt " << tdata.send_count+1 << ")" << std::endl;
+#endif
+        if(tdata.send_count == 0)
+            ++info.total_data_packets_sent ;
+
+        ++tdata.send_count ;
+        tdata.last_sending_attempt = now ;
+    }
+
+    // Nothing came back in time: the tunnel is slower than measured, or congested. Halve the window and wait longer before
+    // re-sending, once per timeout period since all items sent at once time out together.
+
+    if(timeout && now >= info.last_window_reduction + info.rto)
+    {
+        info.send_window_threshold = std::max(info.send_window/2,2.0) ;
+        info.send_window = info.send_window_threshold ;
+        info.rto = std::min(2*info.rto,RS_GXS_TUNNEL_MAX_RTO) ;
+        info.last_window_reduction = now ;
+    }
+}
+
+void p3GxsTunnelService::handleRecvTunnelDataItem(const RsGxsTunnelId& tunnel_id,RsGxsTunnelDataItem *item)
+{
+    bool sequenced = item->flags & RS_GXS_TUNNEL_DATA_FLAG_SEQUENCED ;
+
+    // Items from peers that do not sequence them are imediately acknowledged one by one. Sequenced items
+    // are acknowledged all together in the next flush.
+
+    if(!sequenced)
+    {
+	    RsGxsTunnelDataAckItem *ackitem = new RsGxsTunnelDataAckItem ;
+
+	    ackitem->unique_item_counter = item->unique_item_counter ;
+	    ackitem->PeerId(RsPeerId(tunnel_id)) ;
+
 	    RS_STACK_MUTEX(mGxsTunnelMtx); /********** STACK LOCKED MTX ******/
 	    pendingGxsTunnelItems.push_back(ackitem) ;	// we use the queue that does not need an ACK, in order to avoid an infinite loop ;-)
     }
-    
+
     // notify the client for the received data
-    
-#ifdef DEBUG_GXS_TUNNEL    
+
+#ifdef DEBUG_GXS_TUNNEL
     std::cerr << "p3GxsTunnelService::handleRecvTunnelDataItem()" << std::endl;
     std::cerr << "    data size  = " << item->data_size << std::endl;
     std::cerr << "    service id = " << std::hex << item->service_id << std::dec << std::endl;
     std::cerr << "    counter id = " << std::hex << item->unique_item_counter << std::dec << std::endl;
 #endif
-    
-    RsGxsTunnelClientService *service = NULL ;
+
     RsGxsId peer_from ;
     bool is_client_side = false ;
-    
+    std::vector<RsGxsTunnelDataItem*> to_deliver ;
+    std::vector<RsGxsTunnelClientService*> services ;
+
     {
 	    RS_STACK_MUTEX(mGxsTunnelMtx); /********** STACK LOCKED MTX ******/
+            std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::iterator it2 = _gxs_tunnel_contacts.find(tunnel_id) ;
+
+            if(it2 == _gxs_tunnel_contacts.end())
+	    {
+		    std::cerr << "  (EE) no tunnel known with ID " << tunnel_id << ". Rejecting item." << std::endl;
+		    return ;
+	    }
+
 	    std::map<uint32_t,RsGxsTunnelClientService *>::const_iterator it = mRegisteredServices.find(item->service_id) ;
 
 	    if(it == mRegisteredServices.end())
-	    {
 		    std::cerr << "  (EE) no registered service with ID " << std::hex << item->service_id << std::dec << ". Rejecting item." << std::endl;
+	    else
+		    it2->second.client_services.insert(item->service_id) ;
+
+	    peer_from = it2->second.to_gxs_id ;
+	    is_client_side = (it2->second.direction == RsTurtleGenericDataItem::DIRECTION_CLIENT);
+
+            // Sequenced items are always recorded, even when rejected, so that they are acknowledged and do not block the window of the peer.
+
+            if(sequenced)
+		    locked_receiveSequencedData(it2->second,item,it != mRegisteredServices.end() && it->second->requiresOrderedDelivery(),to_deliver) ;
+            else if(it == mRegisteredServices.end())
 		    return ;
+            else
+            {
+		    // Check if the item has already been received. This is necessary because we actually re-send items until an ACK is received. If the ACK gets lost (connection interrupted) the
+		    // item may be received twice. This is conservative and ensure that no item is lost nor received twice.
+
+		    if(it2->second.received_data_prints.find(item->unique_item_counter) != it2->second.received_data_prints.end())
+		    {
+			    std::cerr << "(WW) received the same data item #" << std::hex << item->unique_item_counter << std::dec << " twice in last 20 mins. Tunnel id=" << tunnel_id << ". Probably a replay. Item will be dropped." << std::endl;
+			    return ;
+		    }
+		    it2->second.received_data_prints[item->unique_item_counter] = time(NULL) ;
+		    ++it2->second.total_data_packets_received ;
+		    it2->second.bytes_received += item->data_size ;
+
+		    to_deliver.push_back(item) ;
+            }
+
+            // Items held for ordered delivery may belong to other services than the one of the item we just received.
+
+            for(uint32_t i=0;i<to_deliver.size();++i)
+            {
+		    std::map<uint32_t,RsGxsTunnelClientService *>::const_iterator it3 = mRegisteredServices.find(to_deliver[i]->service_id) ;
+		    services.push_back(it3 == mRegisteredServices.end() ? NULL : it3->second) ;
+            }
+    }
+
+    for(uint32_t i=0;i<to_deliver.size();++i)
+    {
+	    if(services[i] != NULL && services[i]->acceptDataFromPeer(peer_from,tunnel_id,is_client_side))
+	    {
+		    services[i]->receiveData(tunnel_id,to_deliver[i]->data,to_deliver[i]->data_size) ;
+
+		    to_deliver[i]->data = NULL ;		// avoids deletion, since the client has the memory now
+		    to_deliver[i]->data_size = 0 ;
 	    }
-            service = it->second ;
-    
-            std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::iterator it2 = _gxs_tunnel_contacts.find(tunnel_id) ; 
-            
-            if(it2 != _gxs_tunnel_contacts.end())
+
+	    if(to_deliver[i] != item)		// the received item is deleted by the caller
+		    delete to_deliver[i] ;
+    }
+}
+
+void p3GxsTunnelService::locked_receiveSequencedData(GxsTunnelPeerInfo& info,RsGxsTunnelDataItem *item,bool ordered,std::vector<RsGxsTunnelDataItem*>& to_deliver)
+{
+    uint32_t session = item->unique_item_counter >> 32 ;
+    uint32_t seq     = (uint32_t)item->unique_item_counter ;
+    uint32_t dist    = item->flags >> RS_GXS_TUNNEL_DATA_WINDOW_BASE_SHIFT ;
+    uint32_t window_start = (dist < seq)?(seq - dist):1 ;	// oldest item the peer still waits an ACK for
+
+    info.ack_needed = true ;	// duplicates are acknowledged again, since the previous ACK may have been lost.
+
+    // The peer numbers its items in a new session: this is the first item we get from it, or it lost its state. Held items
+    // from the previous session will never get the missing items before them, so they are delivered now.
+
+    if(session != info.recv_session)
+    {
+	    for(std::map<uint32_t,RsGxsTunnelDataItem*>::const_iterator it(info.recv_held_data.begin());it!=info.recv_held_data.end();++it)
+		    to_deliver.push_back(it->second) ;
+
+	    info.recv_held_data.clear() ;
+	    info.recv_out_of_order.clear() ;
+	    info.recv_session = session ;
+	    info.next_recv_seq = window_start ;
+    }
+
+    // Items before the window of the peer are all acknowledged, possibly before we lost our own state. Don't wait for them.
+
+    if(window_start > info.next_recv_seq)
+    {
+	    info.next_recv_seq = window_start ;
+
+	    while(!info.recv_out_of_order.empty() && *info.recv_out_of_order.begin() < window_start)
+		    info.recv_out_of_order.erase(info.recv_out_of_order.begin()) ;
+    }
+
+    bool duplicate = (seq < info.next_recv_seq) || !info.recv_out_of_order.insert(seq).second ;
+
+    while(!info.recv_out_of_order.empty() && *info.recv_out_of_order.begin() <= info.next_recv_seq)
+    {
+	    if(*info.recv_out_of_order.begin() == info.next_recv_seq)
+		    ++info.next_recv_seq ;
+
+	    info.recv_out_of_order.erase(info.recv_out_of_order.begin()) ;
+    }
+
+    if(duplicate)
+    {
+#ifdef DEBUG_GXS_TUNNEL
+	    std::cerr << "  (II) dropping duplicate data item #" << std::hex << item->unique_item_counter << std::dec << std::endl;
+#endif
+    }
+    else
+    {
+	    ++info.total_data_packets_received ;
+	    info.bytes_received += item->data_size ;
+
+	    if(!ordered)
+		    to_deliver.push_back(item) ;
+	    else
 	    {
-		    it2->second.client_services.insert(item->service_id) ;
-		    peer_from = it2->second.to_gxs_id ;
-		    is_client_side = (it2->second.direction == RsTurtleGenericDataItem::DIRECTION_CLIENT);
+		    // The received item is deleted by the caller, so we take its data away.
+
+		    RsGxsTunnelDataItem *held_item = new RsGxsTunnelDataItem ;
+
+		    held_item->unique_item_counter = item->unique_item_counter ;
+		    held_item->service_id = item->service_id ;
+		    held_item->data_size = item->data_size ;
+		    held_item->data = item->data ;
+
+		    item->data = NULL ;
+		    item->data_size = 0 ;
+
+		    info.recv_held_data[seq] = held_item ;
 	    }
-            
-            // Check if the item has already been received. This is necessary because we actually re-send items until an ACK is received. If the ACK gets lost (connection interrupted) the
-            // item may be received twice. This is conservative and ensure that no item is lost nor received twice.
-            
-            if(it2->second.received_data_prints.find(item->unique_item_counter) != it2->second.received_data_prints.end())
-            {
-                std::cerr << "(WW) received the same data item #" << std::hex << item->unique_item_counter << std::dec << " twice in last 20 mins. Tunnel id=" << tunnel_id << ". Probably a replay. Item will be dropped." << std::endl;
-                return ;
-            }
-            it2->second.received_data_prints[item->unique_item_counter] = time(NULL) ;
     }
-    
-    if(service->acceptDataFromPeer(peer_from,tunnel_id,is_client_side))
-	    service->receiveData(tunnel_id,item->data,item->data_size) ;
-    
-    item->data = NULL ;		// avoids deletion, since the client has the memory now
-    item->data_size = 0 ;
+
+    // Held items are delivered as soon as all items before them are received.
+
+    while(!info.recv_held_data.empty() && info.recv_held_data.begin()->first < info.next_recv_seq)
+    {
+	    to_deliver.push_back(info.recv_held_data.begin()->second) ;
+	    info.recv_held_data.erase(info.recv_held_data.begin()) ;
+    }
+}
+
+void p3GxsTunnelService::locked_deleteDataItems(GxsTunnelPeerInfo& info)
+{
+    for(std::map<uint32_t,GxsTunnelData>::const_iterator it(info.outgoing_data.begin());it!=info.outgoing_data.end();++it)
+	    delete it->second.data_item ;
+
+    for(std::map<uint32_t,RsGxsTunnelDataItem*>::const_iterator it(info.recv_held_data.begin());it!=info.recv_held_data.end();++it)
+	    delete it->second ;
+
+    info.outgoing_data.clear() ;
+    info.recv_held_data.clear() ;
 }
 
 void p3GxsTunnelService::handleRecvStatusItem(const RsGxsTunnelId& tunnel_id, RsGxsTunnelStatusItem *cs)
@@ -1126,50 +1462,19 @@ bool p3GxsTunnelService::locked_sendDHPublicKey(const DH *dh,const RsGxsId& own_
 
 bool p3GxsTunnelService::locked_initDHSessionKey(DH *& dh)
 {
-    // We use our own DH group prime. This has been generated with command-line openssl and checked.
-    
-    static const std::string dh_prime_2048_hex = "B3B86A844550486C7EA459FA468D3A8EFD71139593FE1C658BBEFA9B2FC0AD2628242C2CDC2F91F5B220ED29AAC271192A7374DFA28CDDCA70252F342D0821273940344A7A6A3CB70C7897A39864309F6CAC5C7EA18020EF882693CA2C12BB211B7BA8367D5A7C7252A5B5E840C9E8F081469EBA0B98BCC3F593A4D9C4D5DF539362084F1B9581316C1F80FDAD452FD56DBC6B8ED0775F596F7BB22A3FE2B4753764221528D33DB4140DE58083DB660E3E105123FC963BFF108AC3A268B7380FFA72005A1515C371287C5706FFA6062C9AC73A9B1A6AC842C2764CDACFC85556607E86611FDF486C222E4896CDF6908F239E177ACC641FCBFF72A758D1C10CBB" ;
-
     if(dh != NULL)
     {
         DH_free(dh) ;
         dh = NULL ;
     }
 
-    dh = DH_new() ;
-
-    if(!dh)
-    {
-        std::cerr << "  (EE) DH_new() failed." << std::endl;
-        return false ;
-    }
-
-#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
-    BN_hex2bn(&dh->p,dh_prime_2048_hex.c_str()) ;
-    BN_hex2bn(&dh->g,"5") ;
-#else
-    BIGNUM *pp=NULL ;
-    BIGNUM *gg=NULL ;
-
-    BN_hex2bn(&pp,dh_prime_2048_hex.c_str()) ;
-    BN_hex2bn(&gg,"5") ;
+    // Keys normally come ready from the pool. They are only generated here when many tunnels start at once.
 
-    DH_set0_pqg(dh,pp,NULL,gg) ;
-#endif
-
-    int codes = 0 ;
+    dh = mDHKeyPool->takeKey() ;
 
-    if(!DH_check(dh, &codes) || codes != 0)
-    {
-        std::cerr << "  (EE) DH check failed!" << std::endl;
+    if(dh == NULL)
         return false ;
-    }
 
-    if(!DH_generate_key(dh))
-    {
-        std::cerr << "  (EE) DH generate_key() failed! Error code = " << ERR_get_error() << std::endl;
-        return false ;
-    }
 #ifdef DEBUG_GXS_TUNNEL
     std::cerr << "  (II) DH Session key inited." << std::endl;
 #endif
@@ -1265,6 +1570,9 @@ bool p3GxsTunnelService::locked_sendEncryptedTunnelData(RsGxsTunnelItem *item)
 	}
 
     it->second.total_sent += rssize ;	// counts the size of clear data that is sent
+
+    if(mItemSink != NULL)
+        return mItemSink->sendTunnelItem(item) ;
     
     memcpy(aes_key,it->second.aes_key,GXS_TUNNEL_AES_KEY_SIZE) ;
     RsPeerId virtual_peer_id = it->second.virtual_peer_id ;
@@ -1350,72 +1658,80 @@ bool p3GxsTunnelService::requestSecuredTunnel(const RsGxsId& to_gxs_id, const Rs
     return true ;
 }
 
-// This method generates an ID that should be unique for each packet sent to a same peer. Rather than a random value,
-// we use this counter because outgoing items are sorted in a map by their counter value. Using an increasing value
-// ensures that the packets are sent in the same order than received from the service. This can be useful in some cases,
-// for instance when services split their items while expecting them to arrive in the same order.
-
-uint64_t p3GxsTunnelService::locked_getPacketCounter()
-{
-	return mCurrentPacketCounter++ ;
-}
-
 bool p3GxsTunnelService::sendData(const RsGxsTunnelId &tunnel_id, uint32_t service_id, const uint8_t *data, uint32_t size)
 {
     // make sure that the tunnel ID is registered.
-    
-#ifdef DEBUG_GXS_TUNNEL    
+
+#ifdef DEBUG_GXS_TUNNEL
     std::cerr << "p3GxsTunnelService::sendData()" << std::endl;
     std::cerr << "  tunnel id : " << tunnel_id << std::endl;
     std::cerr << "  data size : " << size << std::endl;
     std::cerr << "  service id: " << std::hex << service_id << std::dec << std::endl;
 #endif
-    
+
     RS_STACK_MUTEX(mGxsTunnelMtx); /********** STACK LOCKED MTX ******/
-        
-    std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::const_iterator it = _gxs_tunnel_contacts.find(tunnel_id) ;
-    
+
+    std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::iterator it = _gxs_tunnel_contacts.find(tunnel_id) ;
+
     if(it == _gxs_tunnel_contacts.end())
     {
         std::cerr << "  (EE) no tunnel known with this ID. Sorry!" << std::endl;
         return false ;
     }
-    
+
     // make sure the service is registered.
-    
+
     if(mRegisteredServices.find(service_id) == mRegisteredServices.end())
     {
         std::cerr << "  (EE) no service registered with this ID. Please call rsGxsTunnel->registerClientService() at some point." << std::endl;
         return false ;
     }
-    
-#ifdef DEBUG_GXS_TUNNEL    
+
+#ifdef DEBUG_GXS_TUNNEL
     std::cerr << "  verifications fine! Storing in out queue with:" << std::endl;
 #endif
-    
+
+    GxsTunnelPeerInfo& info(it->second) ;
+
+    if(info.send_session == 0)		// first data sent in this tunnel
+    {
+        while(info.send_session == 0)
+            info.send_session = RSRandom::random_u32() ;
+
+        info.send_window = RS_GXS_TUNNEL_INITIAL_WINDOW ;
+        info.send_window_threshold = RS_GXS_TUNNEL_MAX_WINDOW ;
+        info.rto = RS_GXS_TUNNEL_INITIAL_RTO ;
+    }
+
+    uint32_t seq = info.next_send_seq++ ;
+
     RsGxsTunnelDataItem *item = new RsGxsTunnelDataItem ;
-            
-    item->unique_item_counter = locked_getPacketCounter() ;// this allows to make the item unique, while respecting the packet order!
-    item->flags = 0;						// not used yet.
+
+    item->unique_item_counter = ((uint64_t)info.send_session << 32) + seq ;// this allows to make the item unique, while respecting the packet order!
+    item->flags = RS_GXS_TUNNEL_DATA_FLAG_SEQUENCED;		// the window position is added when sending.
     item->service_id = service_id;
     item->data_size = size;					// encrypted data size
     item->data = (uint8_t*)rs_malloc(size);			// encrypted data
-    
+
     if(item->data == NULL)
+    {
         delete item ;
-    
+        return false ;
+    }
+
     item->PeerId(RsPeerId(tunnel_id)) ;
     memcpy(item->data,data,size) ;
-    
-    GxsTunnelData& tdata( pendingGxsTunnelDataItems[item->unique_item_counter] ) ;
-    
+
+    GxsTunnelData& tdata( info.outgoing_data[seq] ) ;
+
     tdata.data_item = item ;
     tdata.last_sending_attempt = 0 ;	// never sent until now
-    
-#ifdef DEBUG_GXS_TUNNEL    
+    tdata.send_count = 0 ;
+
+#ifdef DEBUG_GXS_TUNNEL
     std::cerr << "  counter id : " << std::hex << item->unique_item_counter << std::dec << std::endl;
 #endif
-    
+
     return true ;
 }
 
@@ -1508,20 +1824,32 @@ bool p3GxsTunnelService::getTunnelInfo(const RsGxsTunnelId& tunnel_id,GxsTunnelI
     if(it == _gxs_tunnel_contacts.end())
 	    return false ;
 
-    info.destination_gxs_id = it->second.to_gxs_id;     
-    info.source_gxs_id      = it->second.own_gxs_id;	
-    info.tunnel_status      = it->second.status;	          
-    info.total_size_sent    = it->second.total_sent;	         
-    info.total_size_received= it->second.total_received;	  
-    info.is_client_side     = (it->second.direction == RsTurtleGenericTunnelItem::DIRECTION_CLIENT);
+    locked_getTunnelInfo(it->first,it->second,info) ;
+    return true ;
+}
+
+void p3GxsTunnelService::locked_getTunnelInfo(const RsGxsTunnelId& tunnel_id,const GxsTunnelPeerInfo& info,GxsTunnelInfo& tinfo)
+{
+    tinfo.tunnel_id          = tunnel_id ;
+    tinfo.destination_gxs_id = info.to_gxs_id;
+    tinfo.source_gxs_id      = info.own_gxs_id;
+    tinfo.tunnel_status      = info.status;
+    tinfo.total_size_sent    = info.total_sent;
+    tinfo.total_size_received= info.total_received;
+    tinfo.is_client_side     = (info.direction == RsTurtleGenericTunnelItem::DIRECTION_CLIENT);
 
     // Data packets
 
-    info.pending_data_packets = 0;     
-    info.total_data_packets_sent=0 ;     
-    info.total_data_packets_received=0 ;
+    tinfo.pending_data_packets        = info.outgoing_data.size() ;
+    tinfo.total_data_packets_sent     = info.total_data_packets_sent ;
+    tinfo.total_data_packets_received = info.total_data_packets_received ;
 
-    return true ;
+    // Transport
+
+    tinfo.send_window  = (info.send_window > 0)?(uint32_t)info.send_window:RS_GXS_TUNNEL_INITIAL_WINDOW ;
+    tinfo.rtt          = info.srtt ;
+    tinfo.send_rate    = info.send_rate ;
+    tinfo.receive_rate = info.receive_rate ;
 }
 
 bool p3GxsTunnelService::closeExistingTunnel(const RsGxsTunnelId& tunnel_id, uint32_t service_id)
@@ -1604,6 +1932,7 @@ bool p3GxsTunnelService::closeExistingTunnel(const RsGxsTunnelId& tunnel_id, uin
 		    return false ;
 	    }
 
+	    locked_deleteDataItems(it->second) ;
 	    _gxs_tunnel_contacts.erase(it) ;
 
 	    // GxsTunnelService::removeVirtualPeerId() will be called by the turtle service.
@@ -1618,13 +1947,7 @@ bool p3GxsTunnelService::getTunnelsInfo(std::vector<RsGxsTunnelService::GxsTunne
     for(std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::const_iterator it(_gxs_tunnel_contacts.begin());it!=_gxs_tunnel_contacts.end();++it)
     {
         GxsTunnelInfo ti ;
-        
-        ti.tunnel_id = it->first ;
-        ti.destination_gxs_id = it->second.to_gxs_id ;
-        ti.source_gxs_id = it->second.own_gxs_id ;
-        ti.tunnel_status = it->second.status ;
-        ti.total_size_sent = it->second.total_sent ;
-        ti.total_size_received = it->second.total_received ;
+        locked_getTunnelInfo(it->first,it->second,ti) ;
         
         infos.push_back(ti) ;
     }
@@ -1657,7 +1980,11 @@ void p3GxsTunnelService::debug_dump()
     std::cerr << "  Pending items: " << std::endl;
     std::cerr << "    DH               : " << pendingDHItems.size() << std::endl;
     std::cerr << "    Tunnel Management: " << pendingGxsTunnelItems.size() << std::endl;
-    std::cerr << "    Data (client)    : " << pendingGxsTunnelDataItems.size() << std::endl;
+    uint32_t pending_data = 0 ;
+    for(std::map<RsGxsTunnelId,GxsTunnelPeerInfo>::const_iterator it=_gxs_tunnel_contacts.begin();it!=_gxs_tunnel_contacts.end();++it)
+        pending_data += it->second.outgoing_data.size() ;
+
+    std::cerr << "    Data (client)    : " << pending_data << std::endl;
 }
 
 
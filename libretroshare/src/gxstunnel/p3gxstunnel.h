@@ -30,7 +30,8 @@
 // Preconditions:
 //	* the secured tunnel service takes care of:
 //		- tunnel health: tunnels are kept alive using special items, re-openned when necessary, etc.
-//		- transport: items are ACK-ed and re-sent if never received
+//		- transport: items are ACK-ed and re-sent if never received. Items are numbered per tunnel and sent in a window
+//		  whose size follows the ACKs, with a re-send delay computed from the measured round trip time.
 //		- encryption: items are all encrypted and authenticated using PFS(DH)+HMAC(sha1)+AES(128)
 //	* each tunnel is associated to a specific GXS id on both sides. Consequently, services that request tunnels from different IDs to a 
 //		server for the same GXS id need to be handled correctly.
@@ -116,6 +117,7 @@
 #include <retroshare/rsgxstunnel.h>
 #include <services/p3service.h>
 #include <gxstunnel/rsgxstunnelitems.h>
+#include <gxstunnel/gxstunneldhpool.h>
 
 class RsGixs ;
 
@@ -125,6 +127,7 @@ class p3GxsTunnelService: public RsGxsTunnelService, public RsTurtleClientServic
 {
 public:
     explicit p3GxsTunnelService(RsGixs *pids) ;
+    virtual ~p3GxsTunnelService() ;
     virtual void connectToTurtleRouter(p3turtle *) ;
 
     // Creates the invite if the public key of the distant peer is available.
@@ -145,9 +148,18 @@ public:
     virtual RsServiceInfo getServiceInfo();
     
 private:
+    friend class TestGxsTunnelService ;	// unit tests of the windowed transport
+
     void flush() ;
     virtual void handleIncomingItem(const RsGxsTunnelId &tunnel_id, RsGxsTunnelItem *) ;
     
+    struct GxsTunnelData
+    {
+        RsGxsTunnelDataItem *data_item ;
+        double    last_sending_attempt ;
+        uint32_t  send_count ;			// 0 while the item waits for room in the window
+    };
+
     class GxsTunnelPeerInfo
     {
     public:
@@ -157,6 +169,29 @@ private:
             
             total_sent = 0 ;
             total_received = 0 ;
+
+            send_session = 0 ;
+            next_send_seq = 1 ;
+            send_window = 0 ;
+            send_window_threshold = 0 ;
+            srtt = 0 ;
+            rttvar = 0 ;
+            rto = 0 ;
+            last_acked_send_time = 0 ;
+            last_acked_seq = 0 ;
+            last_window_reduction = 0 ;
+
+            recv_session = 0 ;
+            next_recv_seq = 1 ;
+            ack_needed = false ;
+
+            total_data_packets_sent = 0 ;
+            total_data_packets_received = 0 ;
+            bytes_acked = 0 ;
+            bytes_received = 0 ;
+            last_rate_update = 0 ;
+            send_rate = 0 ;
+            receive_rate = 0 ;
         }
 
         time_t last_contact ; 		// used to keep track of working connexion
@@ -174,6 +209,38 @@ private:
         std::map<uint64_t,time_t> received_data_prints ; // list of recently received messages, to avoid duplicates. Kept for 20 mins at most.
         uint32_t total_sent ;
         uint32_t total_received ;
+
+        // Sending side. Outgoing items are numbered in a session picked at random, so that the peer can tell when we restart.
+
+        uint32_t send_session ;
+        uint32_t next_send_seq ;
+        std::map<uint32_t,GxsTunnelData> outgoing_data ;	// items not acknowledged yet, sorted by sequence number
+        double send_window ;				// max distance between the oldest unacknowledged item and the items we send
+        double send_window_threshold ;			// window size above which the window grows slowly
+        double srtt ;					// smoothed round trip time. 0 until measured.
+        double rttvar ;
+        double rto ;					// re-send delay
+        double last_acked_send_time ;			// sending time and number of the last sent item that was acknowledged
+        uint32_t last_acked_seq ;
+        double last_window_reduction ;
+
+        // Receiving side, for sequenced items
+
+        uint32_t recv_session ;
+        uint32_t next_recv_seq ;				// oldest sequence number not received
+        std::set<uint32_t> recv_out_of_order ;		// sequence numbers received after a hole
+        std::map<uint32_t,RsGxsTunnelDataItem*> recv_held_data ;	// items waiting for the hole to be filled, for services requiring order
+        bool ack_needed ;
+
+        // Statistics
+
+        uint32_t total_data_packets_sent ;
+        uint32_t total_data_packets_received ;
+        uint64_t bytes_acked ;				// since last rate update
+        uint64_t bytes_received ;
+        double last_rate_update ;
+        double send_rate ;
+        double receive_rate ;
     };
 
     class GxsTunnelDHInfo
@@ -190,12 +257,6 @@ private:
 	TurtleFileHash hash ;
     };
 
-    struct GxsTunnelData
-    {
-        RsGxsTunnelDataItem *data_item ;
-        time_t    last_sending_attempt ;
-    };
-    
     // This maps contains the current peers to talk to with distant chat.
     //
     std::map<RsGxsTunnelId,GxsTunnelPeerInfo> 		_gxs_tunnel_contacts ;		// current peers we can talk to
@@ -204,7 +265,6 @@ private:
     // List of items to be sent asap. Used to store items that we cannot pass directly to
     // sendTurtleData(), because of Mutex protection.
 
-    std::map<uint64_t,GxsTunnelData> 		pendingGxsTunnelDataItems ;	// items that need provable transport and encryption
     std::list<RsGxsTunnelItem*> 		pendingGxsTunnelItems ;		// items that do not need provable transport, yet need encryption
     std::list<RsGxsTunnelDHPublicKeyItem*> 	pendingDHItems ;		
 
@@ -230,7 +290,6 @@ private:
     void handleRecvDHPublicKey(RsGxsTunnelDHPublicKeyItem *item) ;
     bool locked_sendDHPublicKey(const DH *dh, const RsGxsId& own_gxs_id, const RsPeerId& virtual_peer_id) ;
     bool locked_initDHSessionKey(DH *&dh);
-	uint64_t locked_getPacketCounter();
 
     TurtleVirtualPeerId virtualPeerIdFromHash(const TurtleFileHash& hash) ;	// ... and to a hash for p3turtle
 
@@ -239,6 +298,15 @@ private:
     void handleRecvStatusItem(const RsGxsTunnelId& id,RsGxsTunnelStatusItem *item) ;
     void handleRecvTunnelDataItem(const RsGxsTunnelId& id,RsGxsTunnelDataItem *item) ;
     void handleRecvTunnelDataAckItem(const RsGxsTunnelId &id, RsGxsTunnelDataAckItem *item);
+    void handleRecvTunnelDataSAckItem(const RsGxsTunnelId &id, RsGxsTunnelDataSAckItem *item);
+
+    // windowed transport of data items
+
+    void locked_sendPendingData(const RsGxsTunnelId& tunnel_id,GxsTunnelPeerInfo& info,double now) ;
+    void locked_acknowledgeData(GxsTunnelPeerInfo& info,uint32_t seq,double now) ;
+    void locked_receiveSequencedData(GxsTunnelPeerInfo& info,RsGxsTunnelDataItem *item,bool ordered,std::vector<RsGxsTunnelDataItem*>& to_deliver) ;
+    void locked_getTunnelInfo(const RsGxsTunnelId& tunnel_id,const GxsTunnelPeerInfo& info,GxsTunnelInfo& tinfo) ;
+    static void locked_deleteDataItems(GxsTunnelPeerInfo& info) ;
     
     // Comunication with Turtle service
 
@@ -252,10 +320,19 @@ private:
     p3turtle 	*mTurtle ;
     RsGixs 	*mGixs ;
     RsMutex  	 mGxsTunnelMtx ;
+    GxsTunnelDHKeyPool *mDHKeyPool ;
     
-	uint64_t mCurrentPacketCounter ;
-
     std::map<uint32_t,RsGxsTunnelClientService*> mRegisteredServices ;
+
+    // When set, items to send to the tunnels are given to the sink instead of being encrypted. Used by tests.
+
+    class TunnelItemSink
+    {
+    public:
+        virtual ~TunnelItemSink() {}
+        virtual bool sendTunnelItem(RsGxsTunnelItem *item) = 0 ;
+    };
+    TunnelItemSink *mItemSink ;
     
     void debug_dump();
 
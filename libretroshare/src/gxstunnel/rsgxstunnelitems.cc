@@ -45,6 +45,7 @@ RsItem *RsGxsTunnelSerialiser::create_item(uint16_t service,uint8_t item_subtype
     {
     case RS_PKT_SUBTYPE_GXS_TUNNEL_DATA:          return new RsGxsTunnelDataItem();
     case RS_PKT_SUBTYPE_GXS_TUNNEL_DATA_ACK:      return new RsGxsTunnelDataAckItem();
+    case RS_PKT_SUBTYPE_GXS_TUNNEL_DATA_SACK:     return new RsGxsTunnelDataSAckItem();
     case RS_PKT_SUBTYPE_GXS_TUNNEL_DH_PUBLIC_KEY: return new RsGxsTunnelDHPublicKeyItem();
     case RS_PKT_SUBTYPE_GXS_TUNNEL_STATUS:        return new RsGxsTunnelStatusItem();
     default:
@@ -120,6 +121,11 @@ void RsGxsTunnelDataAckItem::serial_process(RsGenericSerializer::SerializeJob j,
 {
     RsTypeSerializer::serial_process<uint64_t>(j,ctx,unique_item_counter,"unique_item_counter") ;
 }
+void RsGxsTunnelDataSAckItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+{
+    RsTypeSerializer::serial_process<uint64_t>(j,ctx,cumulative_counter,"cumulative_counter") ;
+    RsTypeSerializer::serial_process          (j,ctx,selective_acks    ,"selective_acks") ;
+}
 
 
 
@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <vector>
 #include <openssl/ssl.h>
 
 #include "rsitems/rsserviceids.h"
@@ -47,6 +48,15 @@ const uint8_t RS_PKT_SUBTYPE_GXS_TUNNEL_DATA           = 0x01 ;
 const uint8_t RS_PKT_SUBTYPE_GXS_TUNNEL_DH_PUBLIC_KEY  = 0x02 ;
 const uint8_t RS_PKT_SUBTYPE_GXS_TUNNEL_STATUS         = 0x03 ;
 const uint8_t RS_PKT_SUBTYPE_GXS_TUNNEL_DATA_ACK       = 0x04 ;
+const uint8_t RS_PKT_SUBTYPE_GXS_TUNNEL_DATA_SACK      = 0x05 ;
+
+// Data item flags. Sequenced items carry a per-tunnel counter made of a 32 bits session number (high bits)
+// and a 32 bits sequence number (low bits). The 16 upper bits of the flags give the distance between the
+// item and the oldest item the sender still waits an ACK for, so that a receiver that lost its state knows
+// which items it should not wait for. Peers that do not know these flags see unique counters, as before.
+
+const uint32_t RS_GXS_TUNNEL_DATA_FLAG_SEQUENCED       = 0x0001 ;
+const uint32_t RS_GXS_TUNNEL_DATA_WINDOW_BASE_SHIFT    = 16 ;
 
 typedef uint64_t		GxsTunnelDHSessionId ;
 
@@ -75,7 +85,7 @@ public:
     RsGxsTunnelDataItem() :RsGxsTunnelItem(RS_PKT_SUBTYPE_GXS_TUNNEL_DATA), unique_item_counter(0), flags(0), service_id(0), data_size(0), data(NULL) {}
     explicit RsGxsTunnelDataItem(uint8_t subtype) :RsGxsTunnelItem(subtype) , unique_item_counter(0), flags(0), service_id(0), data_size(0), data(NULL) {}
 
-    virtual ~RsGxsTunnelDataItem() {}
+    virtual ~RsGxsTunnelDataItem() { free(data) ; }
     virtual void clear() {}
 
 	virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx);
@@ -118,6 +128,22 @@ class RsGxsTunnelDataAckItem: public RsGxsTunnelItem
 		uint64_t unique_item_counter ;					// unique identifier for that item
 };
 
+// Acknowledges sequenced data items: all items up to the cumulative counter, plus the out of order items
+// received after it. Only sent to peers who sent sequenced items.
+
+class RsGxsTunnelDataSAckItem: public RsGxsTunnelItem
+{
+	public:
+		RsGxsTunnelDataSAckItem() :RsGxsTunnelItem(RS_PKT_SUBTYPE_GXS_TUNNEL_DATA_SACK), cumulative_counter(0) {}
+
+		virtual ~RsGxsTunnelDataSAckItem() {}
+
+		virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx);
+
+		uint64_t cumulative_counter ;				// session and last sequence number received with no hole before it
+		std::vector<uint32_t> selective_acks ;			// sequence numbers received after a hole
+};
+
 
 // This class contains the public Diffie-Hellman parameters to be sent
 // when performing a DH agreement over a distant chat tunnel.
@@ -45,6 +45,7 @@ file_lists {
 			file_sharing/filelist_io.h \
 			file_sharing/directory_storage.h \
 			file_sharing/directory_updater.h \
+			file_sharing/directory_watcher.h \
 			file_sharing/rsfilelistitems.h \
 			file_sharing/dir_hierarchy.h \
 			file_sharing/file_tree.h \
@@ -55,6 +56,7 @@ file_lists {
 			file_sharing/filelist_io.cc \
 			file_sharing/directory_storage.cc \
 			file_sharing/directory_updater.cc \
+			file_sharing/directory_watcher.cc \
 			file_sharing/dir_hierarchy.cc \
 			file_sharing/file_tree.cc \
 			file_sharing/rsfilelistitems.cc
@@ -381,6 +383,8 @@ HEADERS +=	ft/ftchunkmap.h \
 			ft/ftextralist.h \
 			ft/ftfilecreator.h \
 			ft/ftfileprovider.h \
+			ft/ftfilewriter.h \
+			ft/ftchunkcache.h \
 			ft/ftfilesearch.h \
 			ft/ftsearch.h \
 			ft/ftserver.h \
@@ -513,6 +517,7 @@ HEADERS +=  services/autoproxy/p3i2pbob.h \
 HEADERS +=	turtle/p3turtle.h \
 			turtle/rsturtleitem.h \
 			turtle/turtletypes.h \
+			turtle/turtleroutingtable.h \
 			turtle/turtleclientservice.h
 
 HEADERS +=	util/folderiterator.h \
@@ -537,6 +542,7 @@ HEADERS +=	util/folderiterator.h \
 			util/rsrandom.h \
 			util/pugiconfig.h \  
 			util/rsmemcache.h \
+			util/rshashtable.h \
 			util/rstickevent.h \
 			util/rsrecogn.h \
 			util/rsscopetimer.h \
@@ -550,6 +556,8 @@ SOURCES +=	ft/ftchunkmap.cc \
 			ft/ftextralist.cc \
 			ft/ftfilecreator.cc \
 			ft/ftfileprovider.cc \
+			ft/ftfilewriter.cc \
+			ft/ftchunkcache.cc \
 			ft/ftfilesearch.cc \
 			ft/ftserver.cc \
 			ft/fttransfermodule.cc \
@@ -661,6 +669,7 @@ SOURCES +=  services/autoproxy/rsautoproxymonitor.cc \
 			services/p3serviceinfo.cc \
 
 SOURCES +=	turtle/p3turtle.cc \
+				turtle/turtleroutingtable.cc \
 				turtle/rsturtleitem.cc 
 #				turtle/turtlerouting.cc \
 #				turtle/turtlesearch.cc \
@@ -780,10 +789,12 @@ SOURCES += rsitems/rsnxsitems.cc \
 # gxs tunnels
 HEADERS += gxstunnel/p3gxstunnel.h \
 			  gxstunnel/rsgxstunnelitems.h \
+			  gxstunnel/gxstunneldhpool.h \
 			  retroshare/rsgxstunnel.h
 
 SOURCES += gxstunnel/p3gxstunnel.cc \
-				gxstunnel/rsgxstunnelitems.cc 
+				gxstunnel/rsgxstunnelitems.cc \
+				gxstunnel/gxstunneldhpool.cc
 
 # new serialization code
 HEADERS += serialiser/rsserializer.h \
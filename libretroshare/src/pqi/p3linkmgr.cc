@@ -130,7 +130,7 @@ std::string textPeerConnectState(peerConnectState &state)
 
 
 p3LinkMgrIMPL::p3LinkMgrIMPL(p3PeerMgrIMPL *peerMgr, p3NetMgrIMPL *netMgr)
-	:mPeerMgr(peerMgr), mNetMgr(netMgr), mLinkMtx("p3LinkMgr"),mStatusChanged(false)
+	:mPeerMgr(peerMgr), mNetMgr(netMgr), mLinkMtx("p3LinkMgr"),mStatusChanged(false),mWakeupSignal(NULL)
 {
 
 	{
@@ -313,6 +313,12 @@ void p3LinkMgrIMPL::tick()
 	tickMonitors();
 }
 
+void p3LinkMgrIMPL::setWakeupSignal(RsWakeupSignal *signal)
+{
+	RsStackMutex stack(mLinkMtx); /****** STACK LOCK MUTEX *******/
+	mWakeupSignal = signal;
+}
+
 
 void    p3LinkMgrIMPL::statusTick()
 {
@@ -879,6 +885,8 @@ bool p3LinkMgrIMPL::connectResult(const RsPeerId &id, bool success, bool isIncom
 			it->second.inConnAttempt = false;
 			it->second.connAddrs.clear();
 			mStatusChanged = true;
+			if (mWakeupSignal)
+				mWakeupSignal->wakeup();
 		}
 		else
 		{
@@ -911,6 +919,8 @@ bool p3LinkMgrIMPL::connectResult(const RsPeerId &id, bool success, bool isIncom
 				it->second.state &= (~RS_PEER_S_CONNECTED);
 				it->second.actions |= RS_PEER_DISCONNECTED;
 				mStatusChanged = true;
+				if (mWakeupSignal)
+					mWakeupSignal->wakeup();
 
 				updateLastContact = true; /* time of disconnect */
 			}
@@ -919,6 +929,8 @@ bool p3LinkMgrIMPL::connectResult(const RsPeerId &id, bool success, bool isIncom
 			{
 				it->second.actions |= RS_PEER_CONNECT_REQ;
 				mStatusChanged = true;
+				if (mWakeupSignal)
+					mWakeupSignal->wakeup();
 			}
 
 			if (it->second.dhtVisible)
@@ -1175,6 +1187,8 @@ void    p3LinkMgrIMPL::peerStatus(const RsPeerId& id, const pqiIpAddrSet &addrs,
 			it->second.state |= RS_PEER_S_ONLINE;
 			it->second.lastavailable = now;
 			mStatusChanged = true;
+			if (mWakeupSignal)
+				mWakeupSignal->wakeup();
 		}
 
 	}
@@ -2036,6 +2050,8 @@ bool  p3LinkMgrIMPL::locked_ConnectAttempt_Complete(peerConnectState *peer)
 
 		peer->actions |= RS_PEER_CONNECT_REQ;
 		mStatusChanged = true;
+		if (mWakeupSignal)
+			mWakeupSignal->wakeup();
 	    return true; 
 	} 
 	else 
@@ -2088,6 +2104,8 @@ int p3LinkMgrIMPL::addFriend(const RsPeerId &id, bool isVisible)
 		mFriendList[id] = pcs;
 
 		mStatusChanged = true;
+		if (mWakeupSignal)
+			mWakeupSignal->wakeup();
 	}
 	
 	mNetMgr->netAssistFriend(id, isVisible);
@@ -2129,6 +2147,8 @@ int p3LinkMgrIMPL::removeFriend(const RsPeerId &id)
 		mOthersList[id] = peer;
 
 		mStatusChanged = true;
+		if (mWakeupSignal)
+			mWakeupSignal->wakeup();
 		
 		mFriendList.erase(it);
 	}
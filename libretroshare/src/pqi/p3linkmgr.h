@@ -262,6 +262,9 @@ virtual bool	getFriendNetStatus(const RsPeerId &id, peerConnectState &state); //
 
 void 	tick();
 
+	/* wakes up the core loop whenever monitors have pending actions */
+void	setWakeupSignal(RsWakeupSignal *signal);
+
 	/* THIS COULD BE ADDED TO INTERFACE */
 void    setFriendVisibility(const RsPeerId &id, bool isVisible);
 
@@ -323,6 +326,7 @@ private:
         uint32_t mRetryPeriod;
 
 	bool     mStatusChanged;
+	RsWakeupSignal *mWakeupSignal;
 
 	struct sockaddr_storage mLocalAddress;
 
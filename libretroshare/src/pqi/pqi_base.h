@@ -64,13 +64,20 @@ class RsBwRates
 {
 	public:
 	RsBwRates()
-	:mRateIn(0), mRateOut(0), mMaxRateIn(0), mMaxRateOut(0), mQueueIn(0), mQueueOut(0) {return;}
+	:mRateIn(0), mRateOut(0), mMaxRateIn(0), mMaxRateOut(0), mQueueIn(0), mQueueOut(0),
+	 mRecvAllocs(0), mRecvAllocBytes(0), mRecvReuses(0), mRecvBufferedBytes(0) {return;}
 	float mRateIn;
 	float mRateOut;
 	float mMaxRateIn;
 	float mMaxRateOut;
 	int   mQueueIn;
 	int   mQueueOut;
+
+	// receive buffer usage, see PqiRecvBufferStats
+	uint32_t mRecvAllocs;
+	uint64_t mRecvAllocBytes;
+	uint32_t mRecvReuses;
+	uint32_t mRecvBufferedBytes;
 };
 
 
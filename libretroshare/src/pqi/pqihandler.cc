@@ -76,7 +76,7 @@ struct RsLog::logInfo pqihandlerzoneInfo = {RsLog::Default, "pqihandler"};
 #define RSITEM_DEBUG 1
 ****/
 
-pqihandler::pqihandler() : coreMtx("pqihandler")
+pqihandler::pqihandler() : coreMtx("pqihandler"), mWakeupSignal(NULL)
 {
     RsStackMutex stack(coreMtx); /**************** LOCKED MUTEX ****************/
 
@@ -313,6 +313,10 @@ int     pqihandler::ExtractRates(std::map<RsPeerId, RsBwRates> &ratemap, RsBwRat
 	total.mRateOut = 0;
 	total.mQueueIn = 0;
 	total.mQueueOut = 0;
+	total.mRecvAllocs = 0;
+	total.mRecvAllocBytes = 0;
+	total.mRecvReuses = 0;
+	total.mRecvBufferedBytes = 0;
 
 	/* Lock once rates have been retrieved */
 	RsStackMutex stack(coreMtx); /**************** LOCKED MUTEX ****************/
@@ -329,6 +333,10 @@ int     pqihandler::ExtractRates(std::map<RsPeerId, RsBwRates> &ratemap, RsBwRat
 		total.mRateOut += peerRates.mRateOut;
 		total.mQueueIn  += peerRates.mQueueIn;
 		total.mQueueOut += peerRates.mQueueOut;
+		total.mRecvAllocs += peerRates.mRecvAllocs;
+		total.mRecvAllocBytes += peerRates.mRecvAllocBytes;
+		total.mRecvReuses += peerRates.mRecvReuses;
+		total.mRecvBufferedBytes += peerRates.mRecvBufferedBytes;
 
 		ratemap[it->first] = peerRates;
 
@@ -33,7 +33,7 @@
 
 #include "pqi/pqi.h"             // for P3Interface, pqiPublisher
 #include "retroshare/rstypes.h"  // for RsPeerId
-#include "util/rsthreads.h"      // for RsStackMutex, RsMutex
+#include "util/rsthreads.h"      // for RsStackMutex, RsMutex, RsWakeupSignal
 
 class PQInterface;
 class RSTrafficClue;
@@ -87,6 +87,11 @@ class pqihandler: public P3Interface, public pqiPublisher
 
 		void	getCurrentRates(float &in, float &out);
 
+		// core loop wake-up: lets connection events be handled without
+		// waiting for the next scheduled tick.
+		void	setWakeupSignal(RsWakeupSignal *signal) { mWakeupSignal = signal; }
+		void	wakeupCore() { if(mWakeupSignal) mWakeupSignal->wakeup(); }
+
 		// TESTING INTERFACE.
 		int     ExtractRates(std::map<RsPeerId, RsBwRates> &ratemap, RsBwRates &totals);
 		int 	ExtractTrafficInfo(std::list<RSTrafficClue> &out_lst, std::list<RSTrafficClue> &in_lst);
@@ -128,6 +133,8 @@ protected:
 		time_t last_m ;
         	time_t mLastRateCapUpdate ;
 		float ticks_per_sec ;
+
+		RsWakeupSignal *mWakeupSignal ;
 };
 
 inline void pqihandler::setMaxRate(bool in, float val)
@@ -228,8 +228,14 @@ int pqiperson::notifyEvent(NetInterface *ni, int newState,
 		return 1;
 	}
 
-	RS_STACK_MUTEX(mNotifyMtx);
-	mNotifyQueue.push_back(NotifyData(ni, newState, remote_peer_address));
+	{
+		RS_STACK_MUTEX(mNotifyMtx);
+		mNotifyQueue.push_back(NotifyData(ni, newState, remote_peer_address));
+	}
+
+	// queued events are processed from tick(): don't wait for the next one.
+	if (pqipg)
+		pqipg->wakeupCore();
 	return 1;
 }
 
@@ -88,8 +88,10 @@ void pqiQoS::in_rsItem(void *ptr,int size,int priority)
 // }
 
 
-void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id) 
+void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id, void *& to_free) 
 {
+	to_free = NULL ;
+
 	// Go through the queues. Increment counters.
 
 	if(_nb_items == 0)
@@ -118,7 +120,7 @@ void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts,
         
         	// now chop a slice of this item
         
-        	void *res = _item_queues[last].slice(max_slice_size,size,starts,ends,packet_id) ;
+        	void *res = _item_queues[last].slice(max_slice_size,size,starts,ends,packet_id,to_free) ;
             
             	if(ends)
 			--_nb_items ;
@@ -77,8 +77,16 @@ public:
 			return item ;
 		}
 
-		void *slice(uint32_t max_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) 
+		// Returns a pointer to the next slice of the front item. The slice is a view into
+		// the item's serialized buffer, so no copy is made. When the slice is the last one
+		// of the item, the item is removed from the queue and its buffer is returned in
+		// to_free: the caller must free() it once done with the slice. Otherwise to_free
+		// is NULL and the view stays valid until the next call on this queue.
+
+		void *slice(uint32_t max_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id,void *& to_free)
 		{
+			to_free = NULL ;
+
 			if(_items.empty())
 				return NULL ;
 
@@ -93,7 +101,8 @@ public:
 				ends = true ;
 				size = rec.size ;
 
-				return pop() ;
+				to_free = pop() ;
+				return to_free ;
 			}
 			starts = (rec.current_offset == 0) ;
 			ends   = (rec.current_offset + max_size >= rec.size) ;
@@ -101,27 +110,15 @@ public:
 			if(rec.size <= rec.current_offset)
 			{
 				std::cerr << "(EE) severe error in slicing in QoS." << std::endl;
-				pop() ;
+				free(pop()) ;
 				return NULL ;
 			}
 
 			size = std::min(max_size, uint32_t((int)rec.size - (int)rec.current_offset)) ;
-			void *mem = rs_malloc(size) ;
-
-			if(!mem)
-			{
-				std::cerr << "(EE) memory allocation error in QoS." << std::endl;
-				pop() ;
-				return NULL ;
-			}
-
-			memcpy(mem,&((unsigned char*)rec.data)[rec.current_offset],size) ;
+			void *mem = &((unsigned char*)rec.data)[rec.current_offset] ;
 
 			if(ends)	// we're taking the whole stuff. So we can delete the entry.
-			{
-				free(rec.data) ;
-				_items.pop_front() ;
-			}
+				to_free = pop() ;
 			else
 				rec.current_offset += size ;	// by construction, !ends  implies  rec.current_offset < rec.size
 
@@ -150,9 +147,10 @@ public:
 		std::list<ItemRecord> _items ;
 	};
 
-	// This function pops items from the queue, y order of priority
+	// This function pops items from the queue, y order of priority. The returned slice
+	// is a view into the queued data. See ItemQueue::slice() for when to free to_free.
 	//
-	void *out_rsItem(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) ;
+	void *out_rsItem(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id,void *& to_free) ;
 
 	// This function is used to queue items.
 	//
@@ -36,6 +36,14 @@ pqiQoSstreamer::pqiQoSstreamer(PQInterface *parent, RsSerialiser *rss, const RsP
 	_total_item_count = 0 ;
 }
 
+pqiQoSstreamer::~pqiQoSstreamer()
+{
+	// the base class destructor cannot reach the QoS queue anymore: free the items still waiting to be sent.
+
+	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
+	locked_clear_out_queue() ;
+}
+
 int pqiQoSstreamer::getQueueSize(bool in) 
 {
 	if(in)
@@ -72,9 +80,9 @@ void pqiQoSstreamer::locked_clear_out_queue()
 	_total_item_count = 0 ;
 }
 
-void *pqiQoSstreamer::locked_pop_out_data(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id)
+void *pqiQoSstreamer::locked_pop_out_data(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id, void *& to_free)
 {
-	void *out = pqiQoS::out_rsItem(max_slice_size,size,starts,ends,packet_id) ;
+	void *out = pqiQoS::out_rsItem(max_slice_size,size,starts,ends,packet_id,to_free) ;
 
 	if(out != NULL) 
 	{
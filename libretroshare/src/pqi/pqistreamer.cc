@@ -60,6 +60,8 @@ static const int   PQISTREAM_SLICE_FLAG_ENDS 			= 0x02;		// these flags should b
 static const int   PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01     = 0x10;		// Protocol version ID. Should hold on the 4 lower bits.
 static const int   PQISTREAM_PARTIAL_PACKET_HEADER_SIZE	= 8;   		// Same size than normal header, to make the code simpler.
 static const int   PQISTREAM_PACKET_SLICING_PROBE_DELAY	= 60;  		// send every 60 secs.
+static const uint32_t PQISTREAM_RECV_ARENA_MAX_BUFFERS	= 4;   		// recycled partial packet buffers kept per connection.
+static const uint32_t PQISTREAM_RECV_BUFFER_MIN_SIZE	= 16384;	// initial size of a partial packet buffer.
 
 // This is a probe packet, that won't deserialise (it's empty) but will not cause problems to old peers either, since they will ignore
 // it. This packet however will be understood by new peers as a signal to enable packet slicing. This should go when all peers use the
@@ -294,15 +296,17 @@ int 	pqistreamer::tick_recv(uint32_t timeout)
 {
 	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
 
+	int readable = 0;
 	if (mBio->moretoread(timeout))
 	{
 		handleincoming_locked();
+		readable = 1;
 	}
     if(!(mBio->isactive()))
     {
         free_pend_locked();
     }
-	return 1;
+	return readable;
 }
 
 
@@ -322,7 +326,8 @@ int 	pqistreamer::tick_send(uint32_t timeout)
 		handleoutgoing_locked();
 	}
     
-	return 1;
+	// tell the caller whether some data is still waiting to be sent.
+	return (mPkt_wpending != NULL || locked_out_queue_size() > 0) ? 1 : 0;
 }
 
 int	pqistreamer::status()
@@ -577,12 +582,16 @@ int	pqistreamer::handleoutgoing_locked()
 		bool slice_starts=true ;
 		bool slice_ends=true ;
 		uint32_t slice_packet_id=0 ;
+		void *slice_to_free = NULL ;
 
 		do
 		{
             		int desired_packet_size = mAcceptsPacketSlicing?PQISTREAM_OPTIMAL_PACKET_SIZE:(getRsPktMaxSize());
                     
-			dta = locked_pop_out_data(desired_packet_size,slice_size,slice_starts,slice_ends,slice_packet_id) ;
+			// dta is a view into the queued item. The item's memory is handed over in
+			// slice_to_free once its last slice has been popped.
+
+			dta = locked_pop_out_data(desired_packet_size,slice_size,slice_starts,slice_ends,slice_packet_id,slice_to_free) ;
 
 			if(!dta)
 				break ;
@@ -592,9 +601,17 @@ int	pqistreamer::handleoutgoing_locked()
 #ifdef DEBUG_PACKET_SLICING
 				std::cerr << "sending full slice, old style. Size=" << slice_size << std::endl;
 #endif
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size) ;
-				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size],dta,slice_size) ;
-				free(dta);
+				if(!mPkt_wpending && dta == slice_to_free)
+				{
+					// first packet of this round: send the serialized buffer itself.
+					mPkt_wpending = dta ;
+					slice_to_free = NULL ;
+				}
+				else
+				{
+					mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size) ;
+					memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size],dta,slice_size) ;
+				}
 				mPkt_wpending_size += slice_size ;
 				++k ;
 			}
@@ -603,7 +620,9 @@ int	pqistreamer::handleoutgoing_locked()
 				if(slice_size > 0xffff || !mAcceptsPacketSlicing)
 				{
 					std::cerr << "(EE) protocol error in pqitreamer: slice size is too large and cannot be encoded." ;
+					free(slice_to_free) ;
 					free(mPkt_wpending) ;
+					mPkt_wpending = NULL ;
 					mPkt_wpending_size = 0;
 					return -1 ;
 				}
@@ -613,7 +632,6 @@ int	pqistreamer::handleoutgoing_locked()
 
 				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE) ;
 				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE],dta,slice_size) ;
-				free(dta);
 
 				// New2: pp ff xxxxxxxx ssss  [data, sss bytes] => [flags 1B] [protocol version 1B] [2^32 packet count] [2^16 size]
 
@@ -633,6 +651,12 @@ int	pqistreamer::handleoutgoing_locked()
 				mPkt_wpending_size += slice_size + PQISTREAM_PARTIAL_PACKET_HEADER_SIZE;
 				++k ;
 			}
+
+			if(slice_to_free)
+			{
+				free(slice_to_free) ;
+				slice_to_free = NULL ;
+			}
 		} 
                  while(mPkt_wpending_size < (uint32_t)maxbytes && mPkt_wpending_size < PQISTREAM_OPTIMAL_PACKET_SIZE && !DISABLE_PACKET_GROUPING) ;
              
@@ -1044,11 +1068,10 @@ RsItem *pqistreamer::addPartialPacket_locked(const void *block, uint32_t len, ui
 	    }
 	    PartialPacketRecord& rec = mPartialPackets[slice_packet_id] ;
 
-	    rec.mem = rs_malloc(slice_length) ;
-
-	    if(!rec.mem)
+	    if(!locked_reserveRecvBuffer(rec,slice_length))
 	    {
 		    std::cerr << " (EE) Cannot allocate memory for slice of size " << slice_length << std::endl;
+		    mPartialPackets.erase(slice_packet_id) ;
 		    return NULL ;
 	    }
 
@@ -1056,7 +1079,7 @@ RsItem *pqistreamer::addPartialPacket_locked(const void *block, uint32_t len, ui
 	    rec.size = slice_length ;
 
 #ifdef DEBUG_PACKET_SLICING
-	    std::cerr << " => stored in new record (size=" << rec.size << std::endl;
+	    std::cerr << " => stored in new record (size=" << rec.size << ", capacity=" << rec.capacity << std::endl;
 #endif
 
 	    return NULL ;	// no need to check for ending
@@ -1068,13 +1091,17 @@ RsItem *pqistreamer::addPartialPacket_locked(const void *block, uint32_t len, ui
 	    if(is_packet_starting)
 	    {
 		    std::cerr << "(WW) dropping unfinished existing packet that gets to be replaced by new starting packet." << std::endl;
-		    free(rec.mem);
-            		rec.mem = NULL ;
-		    rec.size = 0 ;
+		    rec.size = 0 ;	// keep the buffer, it will be overwritten.
 	    }
 	    // make sure this is a continuing packet, otherwise this is an error.
 
-	    rec.mem = realloc(rec.mem, rec.size + slice_length) ;
+	    if(!locked_reserveRecvBuffer(rec,rec.size + slice_length))
+	    {
+		    std::cerr << " (EE) Cannot allocate memory for partial packet of size " << rec.size + slice_length << ". Dropping" << std::endl;
+		    locked_releaseRecvBuffer(rec) ;
+		    mPartialPackets.erase(it) ;
+		    return NULL ;
+	    }
 	    memcpy( &((char*)rec.mem)[rec.size],slice_data,slice_length) ;
 	    rec.size += slice_length ;
 
@@ -1087,10 +1114,12 @@ RsItem *pqistreamer::addPartialPacket_locked(const void *block, uint32_t len, ui
 #ifdef DEBUG_PACKET_SLICING
 		    std::cerr << " => deserialising: mem=" << RsUtil::BinToHex((char*)rec.mem,std::min(8u,rec.size)) << std::endl;
 #endif
+		    // deserialise straight from the reassembly buffer, then give it back to the arena.
+
 		    RsItem *item = mRsSerialiser->deserialise(rec.mem, &rec.size);
 
 		    total_len = rec.size ;
-		    free(rec.mem) ;
+		    locked_releaseRecvBuffer(rec) ;
 		    mPartialPackets.erase(it) ;
 		    return item ;
 	    }
@@ -1104,6 +1133,88 @@ RsItem *pqistreamer::addPartialPacket_locked(const void *block, uint32_t len, ui
     }
 }
 
+bool pqistreamer::locked_reserveRecvBuffer(PartialPacketRecord& rec, uint32_t needed_size)
+{
+    if(rec.mem != NULL && rec.capacity >= needed_size)
+        return true ;
+
+    // An empty record can take any buffer from the arena. Pick the largest one, so that
+    // the packet is likely to fit without growing.
+
+    if(rec.size == 0 && !mRecvArena.empty())
+    {
+        uint32_t best = 0 ;
+
+        for(uint32_t i=1;i<mRecvArena.size();++i)
+            if(mRecvArena[i].capacity > mRecvArena[best].capacity)
+                best = i ;
+
+        if(rec.mem == NULL || mRecvArena[best].capacity > rec.capacity)
+        {
+            std::swap(rec.mem,mRecvArena[best].mem) ;
+            std::swap(rec.capacity,mRecvArena[best].capacity) ;
+
+            if(mRecvArena[best].mem == NULL)
+                mRecvArena.erase(mRecvArena.begin() + best) ;
+
+            ++mRecvBufferStats.reuses ;
+        }
+
+        if(rec.capacity >= needed_size)
+            return true ;
+    }
+
+    // Grow geometrically, so that a packet made of n slices costs O(log n) reallocs
+    // the first time, and none afterwards once the buffer is recycled.
+
+    uint32_t new_capacity = std::max(needed_size,std::max(2*rec.capacity,(uint32_t)PQISTREAM_RECV_BUFFER_MIN_SIZE)) ;
+
+    if(needed_size <= getRsPktMaxSize())
+        new_capacity = std::min(new_capacity,getRsPktMaxSize()) ;
+
+    void *mem = realloc(rec.mem,new_capacity) ;
+
+    if(mem == NULL)
+        return false ;
+
+    rec.mem = mem ;
+    rec.capacity = new_capacity ;
+
+    ++mRecvBufferStats.allocations ;
+    mRecvBufferStats.allocated_bytes += new_capacity ;
+
+    return true ;
+}
+
+void pqistreamer::locked_releaseRecvBuffer(PartialPacketRecord& rec)
+{
+    if(rec.mem != NULL)
+    {
+        if(mRecvArena.size() < PQISTREAM_RECV_ARENA_MAX_BUFFERS)
+        {
+            PartialPacketRecord free_rec ;
+            free_rec.mem = rec.mem ;
+            free_rec.capacity = rec.capacity ;
+
+            mRecvArena.push_back(free_rec) ;
+        }
+        else
+            free(rec.mem) ;
+    }
+
+    rec.mem = NULL ;
+    rec.size = 0 ;
+    rec.capacity = 0 ;
+}
+
+void pqistreamer::locked_clearRecvArena()
+{
+    for(uint32_t i=0;i<mRecvArena.size();++i)
+        free(mRecvArena[i].mem) ;
+
+    mRecvArena.clear() ;
+}
+
 /* BandWidth Management Assistance */
 
 float   pqistreamer::outTimeSlice_locked()
@@ -1263,6 +1374,9 @@ void pqistreamer::allocate_rpend_locked()
     if(mPkt_rpending == NULL)
         return ;
 
+    ++mRecvBufferStats.allocations ;
+    mRecvBufferStats.allocated_bytes += mPkt_rpend_size ;
+
     // avoid uninitialized (and random) memory read.
     memset(mPkt_rpending,0,mPkt_rpend_size) ;
 }
@@ -1311,6 +1425,7 @@ void pqistreamer::free_pend_locked()
 		free(it->second.mem) ;
 
 	mPartialPackets.clear() ;
+	locked_clearRecvArena() ;
     
 	// clean up outgoing. (cntrl packets)
 	locked_clear_out_queue() ;
@@ -1322,6 +1437,18 @@ int     pqistreamer::gatherStatistics(std::list<RSTrafficClue>& outqueue_lst,std
 
     return locked_gatherStatistics(outqueue_lst,inqueue_lst);
 }
+
+void pqistreamer::locked_getRecvBufferStats(PqiRecvBufferStats& recv_stats) const
+{
+    recv_stats = mRecvBufferStats ;
+    recv_stats.buffered_bytes = (mPkt_rpending != NULL)?mPkt_rpend_size:0 ;
+
+    for(uint32_t i=0;i<mRecvArena.size();++i)
+        recv_stats.buffered_bytes += mRecvArena[i].capacity ;
+
+    for(std::map<uint32_t,PartialPacketRecord>::const_iterator it(mPartialPackets.begin());it!=mPartialPackets.end();++it)
+        recv_stats.buffered_bytes += it->second.capacity ;
+}
 int     pqistreamer::getQueueSize(bool in)
 {
 	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
@@ -1340,6 +1467,14 @@ void    pqistreamer::getRates(RsBwRates &rates)
 
     rates.mQueueIn = mIncomingSize;
 	rates.mQueueOut = locked_out_queue_size();
+
+	PqiRecvBufferStats recv_stats ;
+	locked_getRecvBufferStats(recv_stats) ;
+
+	rates.mRecvAllocs = recv_stats.allocations ;
+	rates.mRecvAllocBytes = recv_stats.allocated_bytes ;
+	rates.mRecvReuses = recv_stats.reuses ;
+	rates.mRecvBufferedBytes = recv_stats.buffered_bytes ;
 }
 
 int pqistreamer::locked_out_queue_size() const
@@ -1383,12 +1518,13 @@ int pqistreamer::locked_gatherStatistics(std::list<RSTrafficClue>& out_lst,std::
     return 1 ;
 }
 
-void *pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, uint32_t &size, bool &starts, bool &ends, uint32_t &packet_id)
+void *pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, uint32_t &size, bool &starts, bool &ends, uint32_t &packet_id, void *& to_free)
 {
     size = 0 ;
     starts = true ;
     ends = true ;
     packet_id = 0 ;
+    to_free = NULL ;
     
 	void *res = NULL ;
 
@@ -1396,6 +1532,7 @@ void *pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, uint32_t &si
 	{
 		res = *(mOutPkts.begin()); 
 		mOutPkts.pop_front();
+		to_free = res ;
 #ifdef DEBUG_TRANSFERS
 		std::cerr << "pqistreamer::locked_pop_out_data() getting next pkt from mOutPkts queue";
 		std::cerr << std::endl;
@@ -32,6 +32,7 @@
 #include <iostream>               // for operator<<, basic_ostream, cerr, endl
 #include <list>                   // for list
 #include <map>                    // for map
+#include <vector>                 // for vector
 
 #include "pqi/pqi_base.h"         // for BinInterface (ptr only), PQInterface
 #include "retroshare/rsconfig.h"  // for RSTrafficClue
@@ -43,8 +44,24 @@ class RsSerialiser;
 
 struct PartialPacketRecord
 {
+    PartialPacketRecord() : mem(NULL), size(0), capacity(0) {}
+
     void *mem ;
     uint32_t size ;
+    uint32_t capacity ;	// allocated size of mem. Buffers are recycled through the receive arena.
+};
+
+// Heap allocations done by the receive path of a pqistreamer. Once the arena is warm
+// these should stop growing: partial packets are reassembled in recycled buffers.
+
+struct PqiRecvBufferStats
+{
+    PqiRecvBufferStats() : allocations(0), allocated_bytes(0), reuses(0), buffered_bytes(0) {}
+
+    uint32_t allocations ;		// number of malloc/realloc calls on the receive path
+    uint64_t allocated_bytes ;	// cumulated size of these allocations
+    uint32_t reuses ;			// partial packets that got a buffer from the arena
+    uint32_t buffered_bytes ;	// memory currently held by the arena and partial packets
 };
 
 /**
@@ -84,8 +101,8 @@ class pqistreamer: public PQInterface
         		virtual int reset() ;
 
 		int tick_bio();
-		int tick_send(uint32_t timeout);
-		int tick_recv(uint32_t timeout);
+		int tick_send(uint32_t timeout);	// returns 1 if outgoing data is still pending
+		int tick_recv(uint32_t timeout);	// returns 1 if the bio had data to read
 
 		/* Implementation */
 
@@ -95,8 +112,9 @@ class pqistreamer: public PQInterface
 		virtual int locked_out_queue_size() const ;
 		virtual void locked_clear_out_queue() ;
 		virtual int locked_compute_out_pkt_size() const ;
-		virtual void *locked_pop_out_data(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id);
+		virtual void *locked_pop_out_data(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id,void *& to_free);
 		virtual int   locked_gatherStatistics(std::list<RSTrafficClue>& outqueue_stats,std::list<RSTrafficClue>& inqueue_stats); // extracting data.
+		void          locked_getRecvBufferStats(PqiRecvBufferStats& recv_stats) const ;
 
         	void updateRates() ;
             	
@@ -185,6 +203,15 @@ class pqistreamer: public PQInterface
         RsItem *addPartialPacket_locked(const void *block, uint32_t len, uint32_t slice_packet_id,bool packet_starting,bool packet_ending,uint32_t& total_len);
         
         std::map<uint32_t,PartialPacketRecord> mPartialPackets ;
+
+        // Receive arena: buffers of finished partial packets are kept here and handed
+        // to the next starting packet, so that reassembly does not hit the heap.
+        bool locked_reserveRecvBuffer(PartialPacketRecord& rec, uint32_t needed_size);
+        void locked_releaseRecvBuffer(PartialPacketRecord& rec);
+        void locked_clearRecvArena();
+
+        std::vector<PartialPacketRecord> mRecvArena ;
+        PqiRecvBufferStats mRecvBufferStats ;
 };
 
 #endif //MRK_PQI_STREAMER_HEADER
@@ -26,6 +26,7 @@
 
 #include "pqi/pqithreadstreamer.h"
 #include <unistd.h>
+#include <algorithm>
 
 #define DEFAULT_STREAMER_TIMEOUT	  10000 // 10 ms.
 #define DEFAULT_STREAMER_SLEEP		   1000 // 1 ms.
@@ -34,7 +35,7 @@
 //#define PQISTREAMER_DEBUG
 
 pqithreadstreamer::pqithreadstreamer(PQInterface *parent, RsSerialiser *rss, const RsPeerId& id, BinInterface *bio_in, int bio_flags_in)
-:pqistreamer(rss, id, bio_in, bio_flags_in), mParent(parent), mTimeout(0), mThreadMutex("pqithreadstreamer")
+:pqistreamer(rss, id, bio_in, bio_flags_in), mParent(parent), mTimeout(0), mOutputPending(false), mSendBackoff(0), mThreadMutex("pqithreadstreamer")
 {
     mTimeout = DEFAULT_STREAMER_TIMEOUT;
     mSleepPeriod = DEFAULT_STREAMER_SLEEP;
@@ -69,13 +70,17 @@ void	pqithreadstreamer::data_tick()
 
     if (!isactive)
     {
+        mOutputPending = false;
+        mSendBackoff = 0;
         usleep(DEFAULT_STREAMER_IDLE_SLEEP);
         return ;
     }
 
+    // Don't wait for incoming data if we still have data to send.
+    bool received = false;
     {
         RsStackMutex stack(mThreadMutex);
-        tick_recv(recv_timeout);
+        received = (tick_recv(mOutputPending ? 0 : recv_timeout) > 0);
     }
 
     // Push Items, Outside of Mutex.
@@ -87,15 +92,22 @@ void	pqithreadstreamer::data_tick()
 
     {
         RsStackMutex stack(mThreadMutex);
-        tick_send(0);
+        mOutputPending = (tick_send(0) > 0);
     }
 
-    if (sleep_period)
-    {
+    // An idle peer is paced by the socket wait above. When the output stays
+    // pending, either the socket is full or the rate limit is reached: back off,
+    // up to the receive timeout, rather than polling every sleep period. Data
+    // not sent meanwhile is allowed in the next round by outAllowedBytes_locked().
+    if (!mOutputPending || received)
+        mSendBackoff = 0;
+    else if (mSendBackoff == 0)
+        mSendBackoff = sleep_period;
+    else if (mSendBackoff < recv_timeout)
+        mSendBackoff = std::min(2 * mSendBackoff, recv_timeout);
+
+    if (received && sleep_period)
         usleep(sleep_period);
-    }
+    else if (mSendBackoff)
+        usleep(mSendBackoff);
 }
-
-
-
-
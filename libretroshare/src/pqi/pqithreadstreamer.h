@@ -44,6 +44,8 @@ protected:
     PQInterface *mParent;
     uint32_t mTimeout;
     uint32_t mSleepPeriod;
+    bool mOutputPending;
+    uint32_t mSendBackoff;
 
 private:
     /* thread variables */
@@ -152,6 +152,11 @@ class RsConfigDataRates
 
 		mQueueIn = 0;
 		mQueueOut = 0;
+
+		mRecvAllocs = 0;
+		mRecvAllocBytes = 0;
+		mRecvReuses = 0;
+		mRecvBufferedBytes = 0;
 	}
 
 	/* all in kB/s */
@@ -169,6 +174,12 @@ class RsConfigDataRates
 
 	int 	mQueueIn;
 	int	mQueueOut;
+
+	/* receive buffers: heap allocations (count, bytes), buffers reused, bytes held */
+	uint32_t mRecvAllocs;
+	uint64_t mRecvAllocBytes;
+	uint32_t mRecvReuses;
+	uint32_t mRecvBufferedBytes;
 };
 
 class RSTrafficClue
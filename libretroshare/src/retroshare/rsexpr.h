@@ -131,6 +131,14 @@ public:
 
     virtual void linearize(LinearizedExpression& e) const = 0 ;
 	virtual std::string toStdString() const = 0 ;
+
+    /*!
+     * Lists strings of which a file name contains at least one (ignoring case)
+     * whenever the expression matches, so that indexed storages can avoid
+     * evaluating the expression on every file.
+     * @return false if the expression does not restrict the file name
+     */
+    virtual bool nameSubstrings(std::list<std::string>& /*strings*/) const { return false; }
 };
 
 class CompoundExpression : public Expression 
@@ -172,6 +180,7 @@ public:
 	}
 
     virtual void linearize(LinearizedExpression& e) const ;
+    virtual bool nameSubstrings(std::list<std::string>& strings) const ;
 private:
     Expression *Lexp;
     Expression *Rexp;
@@ -188,6 +197,7 @@ public:
 	virtual std::string toStdString(const std::string& varstr) const;
 protected:
     bool evalStr(const std::string &str);
+    bool termSubstrings(std::list<std::string>& strings) const;
 
     enum StringOperator Op;
     std::list<std::string> terms;
@@ -280,6 +290,7 @@ public:
     bool eval(const ExpFileEntry& file);
 
 	virtual std::string toStdString() const { return StringExpression::toStdString("NAME"); }
+    virtual bool nameSubstrings(std::list<std::string>& strings) const { return termSubstrings(strings); }
 
     virtual void linearize(LinearizedExpression& e) const
     {
@@ -310,6 +321,7 @@ public:
     bool eval(const ExpFileEntry& file);
 
 	virtual std::string toStdString()const { return StringExpression::toStdString("EXTENSION"); }
+    virtual bool nameSubstrings(std::list<std::string>& strings) const { return termSubstrings(strings); }	// the extension is part of the name
 
     virtual void linearize(LinearizedExpression& e) const
     {
@@ -134,6 +134,19 @@ struct SharedDirStats
     uint64_t total_shared_size ;
 };
 
+// Throughput of one of the threads that hash shared files.
+
+struct HashStorageWorkerStats
+{
+    HashStorageWorkerStats() : worker_id(0), hashed_files(0), hashed_bytes(0), speed(0) {}
+
+    uint32_t worker_id ;
+    std::string current_file ;	// file being hashed. Empty if the worker is idle.
+    uint64_t hashed_files ;
+    uint64_t hashed_bytes ;
+    uint32_t speed ;			// in MB/s, averaged over the last few seconds of work
+};
+
 // This class represents a tree of directories and files, only with their names size and hash. It is used to create collection links in the GUI
 // and to transmit directory information between services. This class is independent from the existing FileHierarchy classes used in storage because
 // we need a very copact serialization and storage size since we create links with it. Besides, we cannot afford to risk the leak of other local information
@@ -300,6 +313,7 @@ class RsFiles
         virtual void setFollowSymLinks(bool b)=0 ;
 		virtual void togglePauseHashingProcess() =0;		// pauses/resumes the hashing process.
 		virtual bool hashingProcessPaused() =0;
+		virtual void getHashingStats(std::vector<HashStorageWorkerStats>& stats) =0;	// one entry per hashing thread
 
 		virtual bool	getShareDownloadDirectory() = 0;
 		virtual bool 	shareDownloadDirectory(bool share) = 0;
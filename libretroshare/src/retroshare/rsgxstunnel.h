@@ -67,6 +67,12 @@ public:
         // Gives feedback about type of data that is allowed in. For security reasons, this always needs to be re-derived (Clients can return true on default)
         
         virtual bool acceptDataFromPeer(const RsGxsId& gxs_id,const RsGxsTunnelId& tunnel_id,bool is_client_side) = 0 ;
+
+        // Data is sent in a window of several packets, which may arrive out of order. Clients that need the data in the order
+        // it was sent (e.g. because they split their items) should return true. Data from peers that do not number their
+        // packets is always passed as it comes.
+
+        virtual bool requiresOrderedDelivery() const { return false ; }
     };
     
     class GxsTunnelInfo
@@ -87,6 +93,13 @@ public:
 	    uint32_t pending_data_packets;         // number of packets not acknowledged by other side, still on their way. Should be 0 unless something bad happens.
 	    uint32_t total_data_packets_sent ;     // total number of data packets sent (does not include tunnel management)
 	    uint32_t total_data_packets_received ; // total number of data packets received (does not include tunnel management)
+
+	    // Transport
+
+	    uint32_t send_window ;                 // max number of data packets in flight
+	    float    rtt ;                         // smoothed round trip time of data packets, in seconds. 0 until measured.
+	    float    send_rate ;                   // bytes of data acknowledged per second
+	    float    receive_rate ;                // bytes of data received per second
     };
     
     // This is the interface file for the secured tunnel service
@@ -118,6 +131,8 @@ public:
     
     // Data is sent through the established tunnel, possibly multiple times, until reception is acknowledged. If the tunnel does not exist, the item is rejected and 
     // an error is issued. In any case, the memory ownership of the data is *not* transferred to the tunnel service, so the client should delete it afterwards, if needed.
+    // Data is queued and sent as the tunnel window allows. Clients sending a lot of data can check pending_data_packets in the
+    // tunnel info to avoid queueing more than the tunnel can carry.
     
     virtual bool sendData(const RsGxsTunnelId& tunnel_id, uint32_t client_service_id, const uint8_t *data, uint32_t data_size) =0;
     
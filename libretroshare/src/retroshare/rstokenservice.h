@@ -111,6 +111,20 @@ struct RsTokReqOptions
 std::ostream &operator<<(std::ostream &out, const RsGroupMetaData &meta);
 std::ostream &operator<<(std::ostream &out, const RsMsgMetaData &meta);
 
+/*!
+ * Receives the completion of token requests, instead of polling requestStatus().
+ * It is called from a worker thread of the token service, once per token, when the
+ * request is processed (status COMPLETE, FAILED, or CANCELLED). The observer must not
+ * add or remove token observers from that call, but it may redeem the token.
+ */
+class RsTokenObserver
+{
+public:
+	virtual ~RsTokenObserver() {}
+
+	virtual void tokenFinished(uint32_t token, uint32_t status) = 0;
+};
+
 /*!
  * A proxy class for requesting generic service data for GXS
  * This seperates the request mechanism from the actual retrieval of data
@@ -198,6 +212,29 @@ public:
      */
     virtual uint32_t requestStatus(const uint32_t token) = 0;
 
+    /*!
+     * Blocks until the request is processed, or the time is up. Much cheaper than
+     * calling requestStatus() in a loop.
+     * @param token value of token to wait for
+     * @param max_wait_ms max time to wait in milliseconds
+     * @return the status of the request when returning
+     */
+    virtual uint32_t waitToken(const uint32_t token, uint32_t max_wait_ms) = 0;
+
+    /*!
+     * Registers an observer to be called once the request is processed. If it is
+     * already processed, the observer is called right away.
+     * @param token the token of the request to observe
+     * @param obs the observer. It must stay valid until called or removed.
+     */
+    virtual void addTokenObserver(const uint32_t token, RsTokenObserver *obs) = 0;
+
+    /*!
+     * Unregisters an observer that was not called yet. Once this returns, the observer
+     * will not be called anymore for this token.
+     */
+    virtual void removeTokenObserver(const uint32_t token, RsTokenObserver *obs) = 0;
+
     /*!
      * This request statistics on amount of data held
      * number of groups
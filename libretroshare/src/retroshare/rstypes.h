@@ -71,12 +71,19 @@ const uint32_t RS_DIRECTORY_COUNT    = 0x0004 ;
 class TransferInfo
 {
 	public:
+		TransferInfo() : tfRate(0), status(0), transfered(0), rtt(0), window(0), inFlight(0) {}
+
 		/**** Need Some of these Fields ****/
         RsPeerId peerId;
 		std::string name; /* if has alternative name? */
 		double tfRate; /* kbytes */
 		int  status; /* FT_STATE_... */
 		uint64_t transfered ; // used when no chunkmap data is available
+
+		/* request pipelining of download sources */
+		double rtt ;		// smoothed round trip time of data requests (seconds)
+		uint32_t window ;	// max bytes requested and not received yet
+		uint32_t inFlight ;	// bytes requested and not received yet
 };
 
 enum QueueMove { 	QUEUE_TOP 	 = 0x00, 
@@ -267,7 +274,7 @@ class FileChunksInfo
 {
 	public:
 		enum ChunkState { CHUNK_CHECKING=3, CHUNK_DONE=2, CHUNK_ACTIVE=1, CHUNK_OUTSTANDING=0 } ;
-		enum ChunkStrategy { CHUNK_STRATEGY_STREAMING, CHUNK_STRATEGY_RANDOM, CHUNK_STRATEGY_PROGRESSIVE } ;
+		enum ChunkStrategy { CHUNK_STRATEGY_STREAMING, CHUNK_STRATEGY_RANDOM, CHUNK_STRATEGY_PROGRESSIVE, CHUNK_STRATEGY_RAREST_FIRST } ;
 
 		struct SliceInfo
 		{
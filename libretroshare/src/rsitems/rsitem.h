@@ -1,6 +1,7 @@
 #pragma once
 
 #include <typeinfo> // for typeid
+#include <memory>
 
 #include "util/smallobject.h"
 #include "retroshare/rstypes.h"
@@ -77,17 +78,21 @@ class RsItem: public RsMemoryManagement::SmallObject
 class RsRawItem: public RsItem
 {
 public:
-	RsRawItem(uint32_t t, uint32_t size) : RsItem(t), len(size)
-	{ data = rs_malloc(len); }
-	virtual ~RsRawItem() { free(data); }
+	RsRawItem(uint32_t t, uint32_t size) : RsItem(t), data(rs_malloc(size),free), len(size) {}
+
+	// Copies share the serialised data, so that the same packet can be sent to several
+	// peers without serialising it again. The data must not be changed once shared.
+	RsRawItem(const RsRawItem& item) : RsItem(item), data(item.data), len(item.len) {}
+
+	virtual ~RsRawItem() {}
 
 	uint32_t getRawLength() { return len; }
-	void * getRawData() { return data; }
+	void * getRawData() { return data.get(); }
 
 	virtual void clear() {}
 	virtual std::ostream &print(std::ostream &out, uint16_t indent = 0);
 
 private:
-	void *data;
+	std::shared_ptr<void> data;
 	uint32_t len;
 };
@@ -134,19 +134,20 @@ RsServer::~RsServer()
         /* Thread Fn: Run the Core */
 void 	RsServer::data_tick()
 {
-#ifndef WINDOWS_SYS
-    usleep((int) (mTimeDelta * 1000000));
-#else
-    Sleep((int) (mTimeDelta * 1000));
-#endif
+    // Sleep until the next scheduled tick, unless pqi or the link manager
+    // wake us up because connection events are waiting to be processed.
+
+    bool woken = mCoreWakeup.wait((uint32_t) (mTimeDelta * 1000));
 
     double ts = getCurrentTS();
     double delta = ts - mLastts;
     
     /* for the fast ticked stuff */
-    if (delta > mTimeDelta)
+    if (woken || delta > mTimeDelta)
     {
 #ifdef	DEBUG_TICK
+        if (woken)
+            std::cerr << "Woken up after: " << delta << std::endl;
         std::cerr << "Delta: " << delta << std::endl;
         std::cerr << "Time Delta: " << mTimeDelta << std::endl;
         std::cerr << "Avg Tick Rate: " << mAvgTickRate << std::endl;
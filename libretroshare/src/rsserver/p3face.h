@@ -112,6 +112,9 @@ class RsServer: public RsControl, public RsTickingThread
 		/* mutex */
 		RsMutex coreMutex;
 
+		/* signalled by pqi/link managers when something needs a tick */
+		RsWakeupSignal mCoreWakeup;
+
 	private:
 
 		/****************************************/
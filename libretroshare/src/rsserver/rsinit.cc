@@ -47,6 +47,10 @@
 #include "rsserver/rsloginhandler.h"
 #include "rsserver/rsaccounts.h"
 
+#ifdef RS_ENABLE_GXS
+#include "util/retrodb.h"
+#endif
+
 #include <list>
 #include <string>
 
@@ -139,6 +143,12 @@ class RsInitConfig
 
 		bool udpListenerOnly;
 		std::string opModeStr;
+
+#ifdef RS_ENABLE_GXS
+		/* sqlite tuning of the GXS databases */
+		std::string gxsDbProfileStr;
+		RetroDbProfile gxsDbProfile;
+#endif
 };
 
 static RsInitConfig *rsInitConfig = NULL;
@@ -191,6 +201,9 @@ void RsInit::InitRsConfig()
 	rsInitConfig->debugLevel	= PQL_WARNING;
 	rsInitConfig->udpListenerOnly = false;
 	rsInitConfig->opModeStr = std::string("");
+#ifdef RS_ENABLE_GXS
+	rsInitConfig->gxsDbProfileStr = std::string("");
+#endif
 
 	/* setup the homePath (default save location) */
 	//	rsInitConfig->homePath = getHomePath();
@@ -334,6 +347,9 @@ int RsInit::InitRetroShare(int argc, char **argv, bool /* strictCheck */)
 #endif
 		        >> parameter('i',"ip-address"    ,rsInitConfig->inet           ,"nnn.nnn.nnn.nnn", "Force IP address to use (if cannot be detected)."      ,false)
 		        >> parameter('o',"opmode"        ,rsInitConfig->opModeStr      ,"opmode"    ,"Set Operating mode (Full, NoTurtle, Gaming, Minimal)."       ,false)
+#ifdef RS_ENABLE_GXS
+		        >> parameter("gxs-db-profile"    ,rsInitConfig->gxsDbProfileStr,"profile"   ,"Set GXS database storage profile (Default, Safe, Throughput).",false)
+#endif
 		        >> parameter('p',"port"          ,rsInitConfig->port           ,"port", "Set listenning port to use."                                      ,false)
 		        >> parameter('c',"base-dir"      ,opt_base_dir                 ,"directory", "Set base directory."                                         ,false)
 		        >> parameter('U',"user-id"       ,prefUserString               ,"ID", "[ocation Id] Sets Account to Use, Useful when Autologin is enabled.",false)
@@ -350,6 +366,10 @@ int RsInit::InitRetroShare(int argc, char **argv, bool /* strictCheck */)
 		if(rsInitConfig->outStderr)         rsInitConfig->haveLogFile    = false ;
 		if(!rsInitConfig->logfname.empty()) rsInitConfig->haveLogFile    = true;
 		if(rsInitConfig->inet != "127.0.0.1") rsInitConfig->forceLocalAddr = true;
+#ifdef RS_ENABLE_GXS
+		if(!rsInitConfig->gxsDbProfileStr.empty() && !RetroDbProfile::fromName(rsInitConfig->gxsDbProfileStr, rsInitConfig->gxsDbProfile))
+			std::cerr << "Unknown GXS database profile \"" << rsInitConfig->gxsDbProfileStr << "\", using default." << std::endl;
+#endif
 #ifdef LOCALNET_TESTING
 		if(!portRestrictions.empty())       doPortRestrictions           = true;
 #endif
@@ -1171,6 +1191,10 @@ int RsServer::StartupRetroShare()
 
     serviceCtrl->setServiceServer(pqih) ;
 
+	/* let connection events wake up the core loop */
+	pqih->setWakeupSignal(&mCoreWakeup);
+	mLinkMgr->setWakeupSignal(&mCoreWakeup);
+
 	/****** New Ft Server **** !!! */
     ftServer *ftserver = new ftServer(mPeerMgr, serviceCtrl);
     ftserver->setConfigDirectory(rsAccounts->PathAccountDirectory());
@@ -1245,7 +1269,7 @@ int RsServer::StartupRetroShare()
         /**** Identity service ****/
 
         RsGeneralDataService* gxsid_ds = new RsDataService(currGxsDir + "/", "gxsid_db",
-                        RS_SERVICE_GXS_TYPE_GXSID, NULL, rsInitConfig->gxs_passwd);
+                        RS_SERVICE_GXS_TYPE_GXSID, NULL, rsInitConfig->gxs_passwd, rsInitConfig->gxsDbProfile);
 
         // init gxs services
 	PgpAuxUtils *pgpAuxUtils = new PgpAuxUtilsImpl();
@@ -1253,7 +1277,7 @@ int RsServer::StartupRetroShare()
 
         // circles created here, as needed by Ids.
         RsGeneralDataService* gxscircles_ds = new RsDataService(currGxsDir + "/", "gxscircles_db",
-                        RS_SERVICE_GXS_TYPE_GXSCIRCLE, NULL, rsInitConfig->gxs_passwd);
+                        RS_SERVICE_GXS_TYPE_GXSCIRCLE, NULL, rsInitConfig->gxs_passwd, rsInitConfig->gxsDbProfile);
 
 	// create GxsCircles - early, as IDs need it.
         p3GxsCircles *mGxsCircles = new p3GxsCircles(gxscircles_ds, NULL, mGxsIdService, pgpAuxUtils);
@@ -1292,7 +1316,7 @@ int RsServer::StartupRetroShare()
 
         RsGeneralDataService* posted_ds = new RsDataService(currGxsDir + "/", "posted_db",
                         RS_SERVICE_GXS_TYPE_POSTED, 
-			NULL, rsInitConfig->gxs_passwd);
+			NULL, rsInitConfig->gxs_passwd, rsInitConfig->gxsDbProfile);
 
         p3Posted *mPosted = new p3Posted(posted_ds, NULL, mGxsIdService);
 
@@ -1310,7 +1334,7 @@ int RsServer::StartupRetroShare()
 #ifdef RS_USE_WIKI
         RsGeneralDataService* wiki_ds = new RsDataService(currGxsDir + "/", "wiki_db",
                         RS_SERVICE_GXS_TYPE_WIKI,
-                        NULL, rsInitConfig->gxs_passwd);
+                        NULL, rsInitConfig->gxs_passwd, rsInitConfig->gxsDbProfile);
 
         p3Wiki *mWiki = new p3Wiki(wiki_ds, NULL, mGxsIdService);
         // create GXS wiki service
@@ -1326,7 +1350,7 @@ int RsServer::StartupRetroShare()
         /**** Forum GXS service ****/
 
         RsGeneralDataService* gxsforums_ds = new RsDataService(currGxsDir + "/", "gxsforums_db",
-                                                            RS_SERVICE_GXS_TYPE_FORUMS, NULL, rsInitConfig->gxs_passwd);
+                                                            RS_SERVICE_GXS_TYPE_FORUMS, NULL, rsInitConfig->gxs_passwd, rsInitConfig->gxsDbProfile);
 
 
         p3GxsForums *mGxsForums = new p3GxsForums(gxsforums_ds, NULL, mGxsIdService);
@@ -1343,7 +1367,7 @@ int RsServer::StartupRetroShare()
         /**** Channel GXS service ****/
 
         RsGeneralDataService* gxschannels_ds = new RsDataService(currGxsDir + "/", "gxschannels_db",
-                                                            RS_SERVICE_GXS_TYPE_CHANNELS, NULL, rsInitConfig->gxs_passwd);
+                                                            RS_SERVICE_GXS_TYPE_CHANNELS, NULL, rsInitConfig->gxs_passwd, rsInitConfig->gxsDbProfile);
 
         p3GxsChannels *mGxsChannels = new p3GxsChannels(gxschannels_ds, NULL, mGxsIdService);
 
@@ -1359,7 +1383,7 @@ int RsServer::StartupRetroShare()
 #if 0 // PHOTO IS DISABLED FOR THE MOMENT
         /**** Photo service ****/
         RsGeneralDataService* photo_ds = new RsDataService(currGxsDir + "/", "photoV2_db",
-                        RS_SERVICE_GXS_TYPE_PHOTO, NULL, rsInitConfig->gxs_passwd);
+                        RS_SERVICE_GXS_TYPE_PHOTO, NULL, rsInitConfig->gxs_passwd, rsInitConfig->gxsDbProfile);
 
         // init gxs services
         mPhoto = new p3PhotoService(photo_ds, NULL, mGxsIdService);
@@ -1376,7 +1400,7 @@ int RsServer::StartupRetroShare()
         /**** Wire GXS service ****/
         RsGeneralDataService* wire_ds = new RsDataService(currGxsDir + "/", "wire_db",
                         RS_SERVICE_GXS_TYPE_WIRE, 
-			NULL, rsInitConfig->gxs_passwd);
+			NULL, rsInitConfig->gxs_passwd, rsInitConfig->gxsDbProfile);
 
         mWire = new p3Wire(wire_ds, NULL, mGxsIdService);
 
@@ -1401,7 +1425,8 @@ int RsServer::StartupRetroShare()
 #	ifdef RS_GXS_TRANS
 	RsGeneralDataService* gxstrans_ds = new RsDataService(
 	            currGxsDir + "/", "gxstrans_db", RS_SERVICE_TYPE_GXS_TRANS,
-	            NULL, rsInitConfig->gxs_passwd );
+	            NULL, rsInitConfig->gxs_passwd,
+	            rsInitConfig->gxsDbProfile );
 	mGxsTrans = new p3GxsTrans(gxstrans_ds, NULL, *mGxsIdService);
 
 	RsGxsNetService* gxstrans_ns = new RsGxsNetService(
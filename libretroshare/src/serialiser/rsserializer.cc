@@ -114,33 +114,33 @@ RsItem *RsConfigSerializer::deserialise(void *data, uint32_t *size)
 }
 bool RsGenericSerializer::serialise(RsItem *item,void *data,uint32_t *size)
 {
-	SerializeContext ctx(static_cast<uint8_t*>(data),0,mFormat,mFlags);
+	// Single pass: the item is written directly into the supplied buffer, which
+	// only needs to be large enough, and the header is back-patched with the
+	// final length. The size is only computed when the buffer turns out to be
+	// too small, in order to report it.
 
-	uint32_t tlvsize = this->size(item) ;
+	uint32_t header_size = (mFlags & SERIALIZATION_FLAG_SKIP_HEADER)?0:8 ;
 
-	if(tlvsize > *size)
+	if(*size < header_size)
 		throw std::runtime_error("Cannot serialise: not enough room.") ;
 
+	SerializeContext ctx(static_cast<uint8_t*>(data),*size,mFormat,mFlags);
+	ctx.mOffset = header_size ;
 
-    if(mFlags & SERIALIZATION_FLAG_SKIP_HEADER)
-		ctx.mOffset = 0;
-	else
-	{
-		if(!setRsItemHeader(data, tlvsize, item->PacketId(), tlvsize))
-		{
-			std::cerr << "RsSerializer::serialise_item(): ERROR. Not enough size!" << std::endl;
-			return false ;
-		}
-		ctx.mOffset = 8;
-	}
+	item->serial_process(RsGenericSerializer::SERIALIZE,ctx) ;
 
-	ctx.mSize = tlvsize;
+	if(!ctx.mOk)
+	{
+		if(this->size(item) > *size)
+			throw std::runtime_error("Cannot serialise: not enough room.") ;
 
-	item->serial_process(RsGenericSerializer::SERIALIZE,ctx) ;
+		std::cerr << "RsSerializer::serialise(): ERROR. Cannot serialise item!" << std::endl;
+		return false ;
+	}
 
-	if(ctx.mSize != ctx.mOffset)
+	if(header_size > 0 && !setRsItemHeader(data, ctx.mOffset, item->PacketId(), ctx.mOffset))
 	{
-		std::cerr << "RsSerializer::serialise(): ERROR. offset does not match expected size!" << std::endl;
+		std::cerr << "RsSerializer::serialise_item(): ERROR. Not enough size!" << std::endl;
 		return false ;
 	}
     *size = ctx.mOffset ;
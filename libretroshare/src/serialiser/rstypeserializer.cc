@@ -272,11 +272,16 @@ template<> bool RsTypeSerializer::serialize(uint8_t data[],uint32_t size,uint32_
 
     bool ok = serialize<uint32_t>(data,size,offset,r.second) ;
 
-    memcpy(&data[offset],r.first,r.second) ;
-    offset += r.second ;
+    ok = ok && (offset + r.second <= size) ;
 
     if(!ok)
+    {
         offset = saved_offset ;
+        return false ;
+    }
+
+    memcpy(&data[offset],r.first,r.second) ;
+    offset += r.second ;
 
     return ok;
 }
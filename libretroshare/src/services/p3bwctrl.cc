@@ -247,6 +247,11 @@ int  p3BandwidthControl::getTotalBandwidthRates(RsConfigDataRates &rates)
 	rates.mQueueIn = mTotalRates.mQueueIn;
 	rates.mQueueOut = mTotalRates.mQueueOut;
 
+	rates.mRecvAllocs = mTotalRates.mRecvAllocs;
+	rates.mRecvAllocBytes = mTotalRates.mRecvAllocBytes;
+	rates.mRecvReuses = mTotalRates.mRecvReuses;
+	rates.mRecvBufferedBytes = mTotalRates.mRecvBufferedBytes;
+
 	return 1;
 }
 
@@ -273,6 +278,11 @@ int p3BandwidthControl::getAllBandwidthRates(std::map<RsPeerId, RsConfigDataRate
         	rates.mQueueIn = bit->second.mRates.mQueueIn;
         	rates.mQueueOut = bit->second.mRates.mQueueOut;
 
+		rates.mRecvAllocs = bit->second.mRates.mRecvAllocs;
+		rates.mRecvAllocBytes = bit->second.mRates.mRecvAllocBytes;
+		rates.mRecvReuses = bit->second.mRates.mRecvReuses;
+		rates.mRecvBufferedBytes = bit->second.mRates.mRecvBufferedBytes;
+
 		ratemap[bit->first] = rates;
 	}			
 	return true ;
@@ -36,6 +36,7 @@
 #include "util/rsdir.h"
 #include "crypto/hashstream.h"
 #include "gxs/gxssecurity.h"
+#include "gxs/rsgxsutil.h"
 #include "retroshare/rspeers.h"
 
 
@@ -141,6 +142,7 @@ RsIdentity *rsIdentity = NULL;
 #define PGPHASH_PERIOD			60
 #define PGPHASH_RETRY_PERIOD		11
 #define PGPHASH_PROC_PERIOD		1
+#define PGPHASH_PROC_BATCH		200	// ids checked at each PGPHASH_PROC event
 
 #define RECOGN_PERIOD			90
 #define RECOGN_RETRY_PERIOD		17
@@ -1820,6 +1822,8 @@ bool SSGxsIdPgp::load(const std::string &input)
     char pgpline[RSGXSID_MAX_SERVICE_STRING];
     int timestamp = 0;
     uint32_t attempts = 0;
+    int unknown = 0;
+    issuerKeyUnknown = false;
     if (1 == sscanf(input.c_str(), "K:1 I:%[^)]", pgpline))
     {
         validatedSignature = true;
@@ -1827,6 +1831,16 @@ bool SSGxsIdPgp::load(const std::string &input)
         pgpId = RsPgpId(str_line);
         return true;
     }
+    else if (4 == sscanf(input.c_str(), "K:0 T:%d C:%d U:%d I:%[^)]", &timestamp, &attempts, &unknown, pgpline))
+    {
+        lastCheckTs = timestamp;
+        checkAttempts = attempts;
+        validatedSignature = false;
+        issuerKeyUnknown = (unknown != 0);
+        std::string str_line = pgpline;
+        pgpId = RsPgpId(str_line);
+        return true;
+    }
     else if (3 == sscanf(input.c_str(), "K:0 T:%d C:%d I:%[^)]", &timestamp, &attempts,pgpline))
     {
         lastCheckTs = timestamp;
@@ -1872,7 +1886,12 @@ std::string SSGxsIdPgp::save() const
         rs_sprintf(output, "K:0 T:%d C:%d", lastCheckTs, checkAttempts);
 
         if(!pgpId.isNull())
+        {
+            if(issuerKeyUnknown)
+                output += " U:1";
+
             output += " I:"+pgpId.toStdString();
+        }
     }
     return output;
 }
@@ -3346,7 +3365,8 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 	// We Will do this later!
 
 	std::vector<RsGxsIdGroup> groups;
-	bool groupsToProcess = false;
+	std::list<RsGxsIdGroup> groupsToProcess;
+	std::list<RsGxsIdGroup> groupsWaitingForKey;
 	bool ok = getGroupData(token, groups);
 
 	if(ok)
@@ -3406,6 +3426,11 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 
                 if (age < wait_period)
                 {
+                    // The last check failed because the key of the issuer was missing: recheck at once
+                    // if the key is known now. Other failures wait for the whole period.
+
+                    if (ssdata.pgp.issuerKeyUnknown && !ssdata.pgp.pgpId.isNull())
+                        groupsWaitingForKey.push_back(*vit);
 #ifdef DEBUG_IDS
                     std::cerr << " => discard." << std::endl;
 #endif // DEBUG_IDS
@@ -3422,9 +3447,7 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 			std::cerr << std::endl;
 #endif // DEBUG_IDS
 
-			RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
-			mGroupsToProcess.push_back(*vit);
-			groupsToProcess = true;
+			groupsToProcess.push_back(*vit);
 		}
 	}
 	else
@@ -3433,10 +3456,23 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 		std::cerr << std::endl;
 	}
 
-	if (groupsToProcess)
+	if (!groupsToProcess.empty() || !groupsWaitingForKey.empty())
 	{
 		// update PgpIdList -> if there are groups to process.
 		getPgpIdList();
+
+		RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
+
+		for(std::list<RsGxsIdGroup>::const_iterator it = groupsWaitingForKey.begin(); it != groupsWaitingForKey.end(); ++it)
+		{
+			SSGxsIdGroup ssdata;
+			ssdata.load(it->mMeta.mServiceString);
+
+			if (mPgpFingerprintMap.find(ssdata.pgp.pgpId) != mPgpFingerprintMap.end())
+				groupsToProcess.push_back(*it);
+		}
+
+		mGroupsToProcess.splice(mGroupsToProcess.end(), groupsToProcess);
 	}
 
 	// Schedule Processing.
@@ -3444,30 +3480,45 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 	return true;
 }
 
+class p3IdService::PgpCheckJob: public RsGxsValidationJob
+{
+public:
+	PgpCheckJob(p3IdService *service, const RsGxsIdGroup& grp)
+	    : mService(service), mGroup(grp), mResult(false), mIssuerKnown(false), mError(false) {}
+
+	virtual void run()
+	{
+		mResult = mService->checkId(mGroup, mPgpId, mIssuerKnown, mError);
+	}
+
+	p3IdService *mService;
+	RsGxsIdGroup mGroup;
+	RsPgpId mPgpId;
+	bool mResult;
+	bool mIssuerKnown;
+	bool mError;
+};
+
 bool p3IdService::pgphash_process()
 {
-	/* each time this is called - process one Id from mGroupsToProcess */
-	RsGxsIdGroup pg;
-	bool isDone = false;
+	/* each time this is called - process a batch of Ids from mGroupsToProcess */
+	std::vector<PgpCheckJob> jobs;
 	{
 		RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
-		if (!mGroupsToProcess.empty())
+
+		while (!mGroupsToProcess.empty() && jobs.size() < PGPHASH_PROC_BATCH)
 		{
-			pg = mGroupsToProcess.front();
+			jobs.push_back(PgpCheckJob(this, mGroupsToProcess.front()));
 			mGroupsToProcess.pop_front();
 
 #ifdef DEBUG_IDS
-			std::cerr << "p3IdService::pgphash_process() Popped Group: " << pg.mMeta.mGroupId;
+			std::cerr << "p3IdService::pgphash_process() Popped Group: " << jobs.back().mGroup.mMeta.mGroupId;
 			std::cerr << std::endl;
 #endif // DEBUG_IDS
 		}
-		else
-		{
-			isDone = true;
-		}
 	}
 
-	if (isDone)
+	if (jobs.empty())
 	{
 #ifdef DEBUG_IDS
 		std::cerr << "p3IdService::pgphash_process() List Empty... Done";
@@ -3477,62 +3528,75 @@ bool p3IdService::pgphash_process()
 		CacheArbitrationDone(BG_PGPHASH);
 		return true;
 	}
-	
 
-	SSGxsIdGroup ssdata;
-	ssdata.load(pg.mMeta.mServiceString); // attempt load - okay if fails.
+	std::vector<RsGxsValidationJob*> job_list(jobs.size());
 
-    RsPgpId pgpId;
-    bool error = false ;
+	for(uint32_t i=0;i<jobs.size();++i)
+		job_list[i] = &jobs[i];
 
-    if (checkId(pg, pgpId,error))
+	RsGxsValidationPool::instance().runJobs(job_list);
+
+	for(uint32_t i=0;i<jobs.size();++i)
 	{
-		/* found a match - update everything */
-		/* Consistency issues here - what if Reputation was recently updated? */
+		RsGxsIdGroup& pg(jobs[i].mGroup);
+
+		SSGxsIdGroup ssdata;
+		ssdata.load(pg.mMeta.mServiceString); // attempt load - okay if fails.
+
+		RsPgpId& pgpId(jobs[i].mPgpId);
+		bool error = jobs[i].mError ;
+
+		if (jobs[i].mResult)
+		{
+			/* found a match - update everything */
+			/* Consistency issues here - what if Reputation was recently updated? */
 
 #ifdef DEBUG_IDS
-		std::cerr << "p3IdService::pgphash_process() CheckId Success for Group: " << pg.mMeta.mGroupId;
-        std::cerr << " PgpId: " << pgpId;
-		std::cerr << std::endl;
+			std::cerr << "p3IdService::pgphash_process() CheckId Success for Group: " << pg.mMeta.mGroupId;
+			std::cerr << " PgpId: " << pgpId;
+			std::cerr << std::endl;
 #endif // DEBUG_IDS
 
-		/* update */
-		ssdata.pgp.validatedSignature = true;
-		ssdata.pgp.pgpId = pgpId;
+			/* update */
+			ssdata.pgp.validatedSignature = true;
+			ssdata.pgp.pgpId = pgpId;
+			ssdata.pgp.issuerKeyUnknown = false;
 
-	}
-    else if(error)
-    {
-            std::cerr << "Identity has an invalid signature. It will be deleted." << std::endl;
+		}
+		else if(error)
+		{
+			std::cerr << "Identity has an invalid signature. It will be deleted." << std::endl;
 
-            uint32_t token ;
-            deleteIdentity(token,pg) ;
-    }
-    else
-	{
+			uint32_t token ;
+			deleteIdentity(token,pg) ;
+		}
+		else
+		{
 #ifdef DEBUG_IDS
-		std::cerr << "p3IdService::pgphash_process() No Match for Group: " << pg.mMeta.mGroupId;
-		std::cerr << std::endl;
+			std::cerr << "p3IdService::pgphash_process() No Match for Group: " << pg.mMeta.mGroupId;
+			std::cerr << std::endl;
 #endif // DEBUG_IDS
 
-		ssdata.pgp.lastCheckTs = time(NULL);
-		ssdata.pgp.checkAttempts++;
-		ssdata.pgp.pgpId = pgpId;	// read from the signature, but not verified
-	}
+			ssdata.pgp.lastCheckTs = time(NULL);
+			ssdata.pgp.checkAttempts++;
+			ssdata.pgp.pgpId = pgpId;	// read from the signature, but not verified
+			ssdata.pgp.issuerKeyUnknown = !jobs[i].mIssuerKnown;
+		}
 
-    if(!error)
-    {
-        // update IdScore too.
-        ssdata.score.rep.updateIdScore(true, ssdata.pgp.validatedSignature);
-        ssdata.score.rep.update();
+		if(!error)
+		{
+			// update IdScore too.
+			ssdata.score.rep.updateIdScore(true, ssdata.pgp.validatedSignature);
+			ssdata.score.rep.update();
 
-        /* set new Group ServiceString */
-        uint32_t dummyToken = 0;
-        std::string serviceString = ssdata.save();
-        setGroupServiceString(dummyToken, pg.mMeta.mGroupId, serviceString);
+			/* set new Group ServiceString */
+			uint32_t dummyToken = 0;
+			std::string serviceString = ssdata.save();
+			setGroupServiceString(dummyToken, pg.mMeta.mGroupId, serviceString);
 
-        cache_update_if_cached(RsGxsId(pg.mMeta.mGroupId), serviceString);
-    }
+			cache_update_if_cached(RsGxsId(pg.mMeta.mGroupId), serviceString);
+		}
+	}
 
 	// Schedule Next Processing.
 	RsTickEvent::schedule_in(GXSID_EVENT_PGPHASH_PROC, PGPHASH_PROC_PERIOD);
@@ -3541,7 +3605,7 @@ bool p3IdService::pgphash_process()
 
 
 
-bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
+bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId, bool& issuer_known, bool& error)
 {
 #ifdef DEBUG_IDS
 	std::cerr << "p3IdService::checkId() Starting Match Check for RsGxsId: ";
@@ -3550,6 +3614,7 @@ bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
 #endif // DEBUG_IDS
 
     error = false ;
+    issuer_known = false ;
 
 	/* some sanity checking... make sure hash is the right size */
 
@@ -3586,10 +3651,29 @@ bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
 	std::cerr << std::endl;
 #endif // DEBUG_IDS
 
-	RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
+	// The issuer read from the signature designates the only key that can match. All known keys are
+	// only tried when the signature cannot be parsed.
+
+	std::map<RsPgpId, PGPFingerprintType> candidates;
+	{
+		RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
+
+		if (pgpId.isNull())
+			candidates = mPgpFingerprintMap;
+		else
+		{
+			std::map<RsPgpId, PGPFingerprintType>::const_iterator it = mPgpFingerprintMap.find(pgpId);
+
+			if (it != mPgpFingerprintMap.end())
+			{
+				candidates.insert(*it);
+				issuer_known = true;
+			}
+		}
+	}
 
 	std::map<RsPgpId, PGPFingerprintType>::iterator mit;
-	for(mit = mPgpFingerprintMap.begin(); mit != mPgpFingerprintMap.end(); ++mit)
+	for(mit = candidates.begin(); mit != candidates.end(); ++mit)
 	{
 		Sha1CheckSum hash;
         calcPGPHash(RsGxsId(grp.mMeta.mGroupId), mit->second, hash);
@@ -3644,7 +3728,7 @@ bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
 	}
 
 #ifdef DEBUG_IDS
-	std::cerr << "p3IdService::checkId() Checked " << mPgpFingerprintMap.size() << " Hashes without Match";
+	std::cerr << "p3IdService::checkId() Checked " << candidates.size() << " Hashes without Match";
 	std::cerr << std::endl;
 #endif // DEBUG_IDS
 
@@ -101,7 +101,7 @@ class SSGxsIdPgp: public SSBit
 {
 	public:
 	SSGxsIdPgp()
-	:validatedSignature(false), lastCheckTs(0), checkAttempts(0) { return; }
+	:validatedSignature(false), lastCheckTs(0), checkAttempts(0), issuerKeyUnknown(false) { return; }
 
 virtual	bool load(const std::string &input);
 virtual	std::string save() const;
@@ -110,6 +110,7 @@ virtual	std::string save() const;
 	time_t lastCheckTs;
 	uint32_t checkAttempts;
 	RsPgpId pgpId;
+	bool issuerKeyUnknown;	// the key of pgpId was not in the keyring at the last check
 };
 
 class SSGxsIdRecognTags: public SSBit 
@@ -392,6 +393,13 @@ protected:
 
 	virtual RsSerialiser *setupSerialiser() ;
 
+	/************************************************************************
+ * pgphash checks, protected for testing purposes.
+ *
+ */
+	// thread safe: called for a batch of ids at once in the RsGxsValidationPool.
+	bool checkId(const RsGxsIdGroup &grp, RsPgpId &pgp_id, bool &issuer_known, bool &error);
+	void getPgpIdList();
 
 private:
 
@@ -460,8 +468,7 @@ private:
 	bool pgphash_handlerequest(uint32_t token);
 	bool pgphash_process();
 
-	bool checkId(const RsGxsIdGroup &grp, RsPgpId &pgp_id, bool &error);
-	void getPgpIdList();
+	class PgpCheckJob ;
 
 	/* MUTEX PROTECTED DATA (mIdMtx - maybe should use a 2nd?) */
 
@@ -224,4 +224,43 @@ int p3FastService::sendItem(RsItem *si)
 	}
 }
 
+int p3FastService::sendItemToPeers(RsItem *si, const std::list<RsPeerId>& peers)
+{
+	RsStackMutex stack(srvMtx);  /*****   LOCK MUTEX *****/
+
+	uint32_t size = rsSerialiser->size(si);
+	if (!size)
+	{
+		std::cerr << "p3Service::sendItemToPeers() ERROR size == 0";
+		std::cerr << std::endl;
+		return 0;
+	}
+
+	RsRawItem raw(si->PacketId(), size);
+
+	if (!rsSerialiser->serialise(si, raw.getRawData(), &size) || size != raw.getRawLength())
+	{
+		std::cerr << "p3Service::sendItemToPeers() ERROR serialise failed. Item is: " << std::endl;
+		si->print(std::cerr,0) ;
+		return 0;
+	}
+	raw.setPriorityLevel(si->priority_level()) ;
+
+#ifdef SERV_DEBUG
+	std::cerr << "p3Service::sendItemToPeers() sending " << size << " bytes to " << peers.size() << " peers.";
+	std::cerr << std::endl;
+#endif
+	int sent = 0;
+
+	for(std::list<RsPeerId>::const_iterator it(peers.begin());it!=peers.end();++it)
+	{
+		RsRawItem *item = new RsRawItem(raw);	// shares the serialised data
+		item->PeerId(*it);
+
+		if (pqiService::send(item))
+			++sent;
+	}
+	return sent;
+}
+
 
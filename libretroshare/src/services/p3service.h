@@ -75,6 +75,9 @@ virtual ~p3FastService() { delete rsSerialiser; return; }
 
 /*************** INTERFACE ******************************/
 int             sendItem(RsItem *);
+	// Sends the same item to all given peers. It is serialised once, and the packets share
+	// the serialised data. The item is not deleted. Returns the number of packets sent.
+int             sendItemToPeers(RsItem *, const std::list<RsPeerId>& peers);
 virtual int	tick() { return 0; }
 /*************** INTERFACE ******************************/
 
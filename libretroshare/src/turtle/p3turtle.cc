@@ -89,6 +89,8 @@ static const time_t TUNNEL_CLEANING_LAPS_TIME  	         =  10 ;		/// clean tunn
 static const time_t TIME_BETWEEN_TUNNEL_MANAGEMENT_CALLS =   2 ;                /// Tunnel management calls every 2 secs.
 static const uint32_t MAX_TUNNEL_REQS_PER_SECOND         =   1 ;		/// maximum number of tunnel requests issued per second. Was 0.5 before
 static const uint32_t MAX_ALLOWED_SR_IN_CACHE            = 120 ;		/// maximum number of search requests allowed in cache. That makes 2 per sec.
+static const uint32_t MAX_LOCAL_SEARCHES_PER_CONTROL_TICK =  5 ;		/// local searches performed between two checks for new tunnel requests.
+static const uint32_t CONTROL_THREAD_IDLE_WAIT_MS         = 500 ;		/// the control thread is woken up when requests arrive.
 
 static const float depth_peer_probability[7] = { 1.0f,0.99f,0.9f,0.7f,0.6f,0.5,0.4f } ;
 
@@ -99,7 +101,7 @@ static const int MAX_TR_FORWARD_PER_SEC_LOWER_LIMIT     = 10 ;
 static const int DISTANCE_SQUEEZING_POWER               =  8 ;
 
 p3turtle::p3turtle(p3ServiceControl *sc,p3LinkMgr *lm)
-	:p3Service(), p3Config(), mServiceControl(sc), mLinkMgr(lm), mTurtleMtx("p3turtle")
+	:p3Service(), p3Config(), mServiceControl(sc), mLinkMgr(lm), mTurtleMtx("p3turtle"), mTurtleControlMtx("p3turtle control")
 {
 	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 
@@ -126,6 +128,25 @@ p3turtle::p3turtle(p3ServiceControl *sc,p3LinkMgr *lm)
 	_traffic_info.reset() ;
 	_max_tr_up_rate = MAX_TR_FORWARD_PER_SEC ;
 	_service_type = getServiceInfo().mServiceType ;
+
+	_control_thread = new TurtleControlThread(this) ;
+	_control_thread->start("turtle control") ;
+}
+
+p3turtle::~p3turtle()
+{
+	_control_thread->ask_for_stop() ;
+	_control_signal.wakeup() ;
+	_control_thread->fullstop() ;
+	delete _control_thread ;
+
+	RsStackMutex stack(mTurtleControlMtx); /********** STACK LOCKED MTX ******/
+
+	for(std::list<RsItem*>::const_iterator it(_control_items.begin());it!=_control_items.end();++it)
+		delete *it ;
+
+	for(std::list<RsTurtleSearchRequestItem*>::const_iterator it(_pending_local_searches.begin());it!=_pending_local_searches.end();++it)
+		delete *it ;
 }
 
 const std::string TURTLE_APP_NAME = "turtle";
@@ -239,6 +260,10 @@ int p3turtle::tick()
 			RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 			_last_tunnel_management_time = now ;
 
+			// Traffic in tunnels is recorded by the routing table, off the turtle mutex.
+			//
+			_routing_table.collectTrafficStatistics(_traffic_info_buffer) ;
+
 			// Update traffic statistics. The constants are important: they allow a smooth variation of the 
 			// traffic speed, which is used to moderate tunnel requests statistics.
 			//
@@ -299,27 +324,6 @@ int p3turtle::tick()
 // -----------------------------------------------------------------------------------//
 //
 
-// adds a virtual peer to the list that is communicated ot ftController.
-//
-void p3turtle::locked_addDistantPeer(const TurtleFileHash&,TurtleTunnelId tid)
-{
-	unsigned char tmp[RsPeerId::SIZE_IN_BYTES] ;
-	memset(tmp,0,RsPeerId::SIZE_IN_BYTES) ;
-
-	assert(sizeof(tid) == 4) ;
-
-	for(int i=0;i<4;++i)
-		tmp[i] = uint8_t( (tid >> ((3-i)*8)) & 0xff ) ;
-
-	RsPeerId virtual_peer_id(tmp) ;
-
-	_virtual_peers[virtual_peer_id] = tid ;
-#ifdef P3TURTLE_DEBUG
-	assert(_local_tunnels.find(tid)!=_local_tunnels.end()) ;
-#endif
-	_local_tunnels[tid].vpid = virtual_peer_id ;
-}
-
 void p3turtle::getSourceVirtualPeersList(const TurtleFileHash& hash,std::list<pqipeer>& list)
 {
 	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
@@ -331,12 +335,12 @@ void p3turtle::getSourceVirtualPeersList(const TurtleFileHash& hash,std::list<pq
 	if(it != _incoming_file_hashes.end())
 		for(uint32_t i=0;i<it->second.tunnels.size();++i)
 		{
-			std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it2 = _local_tunnels.find( it->second.tunnels[i] ) ;
+			TurtleTunnel tunnel ;
 
-			if(it2 != _local_tunnels.end())
+			if(_routing_table.getTunnel(it->second.tunnels[i],tunnel))
 			{
 				pqipeer vp ;
-				vp.id = it2->second.vpid ;
+				vp.id = tunnel.vpid ;
 				vp.name = "Virtual (distant) peer" ;
 				vp.state = RS_PEER_S_CONNECTED ;
 				vp.actions = RS_PEER_CONNECTED ;
@@ -385,7 +389,12 @@ void p3turtle::manageTunnels()
 			//
 			uint32_t total_speed = 0 ;
 			for(uint32_t i=0;i<it->second.tunnels.size();++i)
-				total_speed += _local_tunnels[it->second.tunnels[i]].speed_Bps ;
+			{
+				TurtleTunnel tunnel ;
+
+				if(_routing_table.getTunnel(it->second.tunnels[i],tunnel))
+					total_speed += tunnel.speed_Bps ;
+			}
 
 			static const float grow_speed = 1.0f ;	// speed at which the time increases.
 
@@ -422,16 +431,7 @@ void p3turtle::manageTunnels()
 
 void p3turtle::estimateTunnelSpeeds()
 {
-	RsStackMutex stack(mTurtleMtx) ;
-
-	for(std::map<TurtleTunnelId,TurtleTunnel>::iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
-	{
-		TurtleTunnel& tunnel(it->second) ;
-
-		float speed_estimate = tunnel.transfered_bytes / float(TUNNEL_SPEED_ESTIMATE_LAPSE) ;
-		tunnel.speed_Bps = 0.75*tunnel.speed_Bps + 0.25*speed_estimate ;
-		tunnel.transfered_bytes = 0 ;
-	}
+	_routing_table.estimateTunnelSpeeds(float(TUNNEL_SPEED_ESTIMATE_LAPSE)) ;
 }
 
 void p3turtle::autoWash()
@@ -533,8 +533,11 @@ void p3turtle::autoWash()
 		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 
 		std::vector<TurtleTunnelId> tunnels_to_close ;
+		std::map<TurtleTunnelId,TurtleTunnel> tunnels ;
 
-		for(std::map<TurtleTunnelId,TurtleTunnel>::iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
+		_routing_table.getTunnels(tunnels) ;
+
+		for(std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it(tunnels.begin());it!=tunnels.end();++it)
 			if(now > (time_t)(it->second.time_stamp + MAXIMUM_TUNNEL_IDLE_TIME))
 			{
 #ifdef P3TURTLE_DEBUG
@@ -581,9 +584,9 @@ void p3turtle::locked_closeTunnel(TurtleTunnelId tid,std::vector<std::pair<RsTur
 	// tunnel closing commands. In our case, this is not necessary, because if a tunnel is closed somewhere, its
 	// source is not going to be used and the tunnel will eventually disappear.
 	//
-	std::map<TurtleTunnelId,TurtleTunnel>::iterator it(_local_tunnels.find(tid)) ;
+	TurtleTunnel tunnel ;
 
-	if(it == _local_tunnels.end())
+	if(!_routing_table.removeTunnel(tid,tunnel))
 	{
 		std::cerr << "p3turtle: was asked to close tunnel " << reinterpret_cast<void*>(tid) << ", which actually doesn't exist." << std::endl ;
 		return ;
@@ -592,14 +595,13 @@ void p3turtle::locked_closeTunnel(TurtleTunnelId tid,std::vector<std::pair<RsTur
 	std::cerr << "p3turtle: Closing tunnel " << (void*)tid << std::endl ;
 #endif
 
-	if(it->second.local_src == _own_id)	// this is a starting tunnel. We thus remove
+	if(tunnel.local_src == _own_id)	// this is a starting tunnel. We thus remove
 																		// 	- the virtual peer from the vpid list
 																		// 	- the tunnel id from the file hash
 																		// 	- the virtual peer from the file sources in the file transfer controller.
 	{
-		TurtleTunnelId tid = it->first ;
-		TurtleVirtualPeerId vpid = it->second.vpid ;
-		TurtleFileHash hash = it->second.hash ;
+		TurtleVirtualPeerId vpid = tunnel.vpid ;
+		TurtleFileHash hash = tunnel.hash ;
 
 #ifdef P3TURTLE_DEBUG
 		std::cerr << "    Tunnel is a starting point. Also removing:" << std::endl ;
@@ -608,11 +610,7 @@ void p3turtle::locked_closeTunnel(TurtleTunnelId tid,std::vector<std::pair<RsTur
 #endif
 		std::pair<TurtleFileHash,TurtleVirtualPeerId> hash_vpid(hash,vpid) ;
 
-		// Let's be cautious. Normally we should never be here without consistent information,
-		// but still, this happens, rarely.
-		//
-		if(_virtual_peers.find(vpid) != _virtual_peers.end())  
-			_virtual_peers.erase(_virtual_peers.find(vpid)) ;
+		// The virtual peer is removed together with the tunnel.
 
 		std::map<TurtleFileHash,TurtleHashInfo>::iterator it(_incoming_file_hashes.find(hash)) ;
 
@@ -636,32 +634,18 @@ void p3turtle::locked_closeTunnel(TurtleTunnelId tid,std::vector<std::pair<RsTur
 			sources_to_remove.push_back(std::pair<RsTurtleClientService*,std::pair<TurtleFileHash,TurtleVirtualPeerId> >(it->second.service,hash_vpid)) ;
 		}
 	}
-	else if(it->second.local_dst == _own_id)	// This is a ending tunnel. We also remove the virtual peer id
+	else if(tunnel.local_dst == _own_id)	// This is a ending tunnel. We also remove the virtual peer id
 	{
 #ifdef P3TURTLE_DEBUG
 		std::cerr << "    Tunnel is a ending point. Also removing associated outgoing hash." ;
 #endif
-        std::map<TurtleTunnelId,RsTurtleClientService*>::iterator itHash = _outgoing_tunnel_client_services.find(tid);
-
-        if(itHash != _outgoing_tunnel_client_services.end())
+		if(tunnel.service != NULL)
 		{
-			TurtleVirtualPeerId vpid = it->second.vpid ;
-			TurtleFileHash hash = it->second.hash ;
-
-			std::pair<TurtleFileHash,TurtleVirtualPeerId> hash_vpid(hash,vpid) ;
+			std::pair<TurtleFileHash,TurtleVirtualPeerId> hash_vpid(tunnel.hash,tunnel.vpid) ;
 
-			sources_to_remove.push_back(std::pair<RsTurtleClientService*,std::pair<TurtleFileHash,TurtleVirtualPeerId> >(itHash->second,hash_vpid)) ;
-
-            _outgoing_tunnel_client_services.erase(itHash) ;
-
-			// Also remove the associated virtual peer
-			//
-			if(_virtual_peers.find(vpid) != _virtual_peers.end())  
-				_virtual_peers.erase(_virtual_peers.find(vpid)) ;
+			sources_to_remove.push_back(std::pair<RsTurtleClientService*,std::pair<TurtleFileHash,TurtleVirtualPeerId> >(tunnel.service,hash_vpid)) ;
 		}
 	}
-
-	_local_tunnels.erase(it) ;
 }
 
 void p3turtle::stopMonitoringTunnels(const RsFileHash& hash)
@@ -806,6 +790,7 @@ uint32_t p3turtle::generatePersonalFilePrint(const TurtleFileHash& hash,uint32_t
 int p3turtle::handleIncoming()
 {
 	int nhandled = 0;
+	bool control_items = false ;
 	// While messages read
 	//
 	RsItem *item = NULL;
@@ -822,35 +807,98 @@ int p3turtle::handleIncoming()
 
 			if(gti != NULL)
 				routeGenericTunnelItem(gti) ;	/// Generic packets, that travel through established tunnels. 
+			else if(item->PacketSubType() == RS_TURTLE_SUBTYPE_TUNNEL_OK)
+			{
+				/// Tunnel results create the routes, so they are handled in order with the tunnel items
+				/// that may follow them.
+				//
+				handleTunnelResult(dynamic_cast<RsTurtleTunnelOkItem *>(item)) ;
+				delete item ;
+			}
 			else			 							/// These packets should be destroyed by the client.
 			{
 				/// Special packets that require specific treatment, because tunnels do not exist for these packets.
-				/// These packets are destroyed here, after treatment.
+				/// These are handled by the control thread, so that search floods do not delay tunnel traffic.
 				//
-				switch(item->PacketSubType())
-				{
-					case RS_TURTLE_SUBTYPE_STRING_SEARCH_REQUEST:
-					case RS_TURTLE_SUBTYPE_REGEXP_SEARCH_REQUEST: handleSearchRequest(dynamic_cast<RsTurtleSearchRequestItem *>(item)) ;
-																				 break ;
+				RsStackMutex stack(mTurtleControlMtx); /********** STACK LOCKED MTX ******/
 
-					case RS_TURTLE_SUBTYPE_SEARCH_RESULT : handleSearchResult(dynamic_cast<RsTurtleSearchResultItem *>(item)) ;
-																		break ;
+				_control_items.push_back(item) ;
+				control_items = true ;
+			}
+		}
+	}
 
-					case RS_TURTLE_SUBTYPE_OPEN_TUNNEL   : handleTunnelRequest(dynamic_cast<RsTurtleOpenTunnelItem *>(item)) ;
-																		break ;
+	if(control_items)
+		_control_signal.wakeup() ;
 
-					case RS_TURTLE_SUBTYPE_TUNNEL_OK     : handleTunnelResult(dynamic_cast<RsTurtleTunnelOkItem *>(item)) ;
-																		break ;
+	return nhandled;
+}
 
-					default:
-																		std::cerr << "p3turtle::handleIncoming: Unknown packet subtype " << item->PacketSubType() << std::endl ;
-				}
-				delete item;
-			}
+void TurtleControlThread::data_tick()
+{
+	mTurtle->handleControlItems() ;
+}
+
+void p3turtle::handleControlItems()
+{
+	std::list<RsItem*> items ;
+	{
+		RsStackMutex stack(mTurtleControlMtx); /********** STACK LOCKED MTX ******/
+		items.swap(_control_items) ;
+	}
+
+	for(std::list<RsItem*>::const_iterator it(items.begin());it!=items.end();++it)
+	{
+		RsItem *item = *it ;
+
+		/// These packets are destroyed here, after treatment.
+		//
+		switch(item->PacketSubType())
+		{
+			case RS_TURTLE_SUBTYPE_STRING_SEARCH_REQUEST:
+			case RS_TURTLE_SUBTYPE_REGEXP_SEARCH_REQUEST: handleSearchRequest(dynamic_cast<RsTurtleSearchRequestItem *>(item)) ;
+																		 break ;
+
+			case RS_TURTLE_SUBTYPE_SEARCH_RESULT : handleSearchResult(dynamic_cast<RsTurtleSearchResultItem *>(item)) ;
+																break ;
+
+			case RS_TURTLE_SUBTYPE_OPEN_TUNNEL   : handleTunnelRequest(dynamic_cast<RsTurtleOpenTunnelItem *>(item)) ;
+																break ;
+
+			default:
+																std::cerr << "p3turtle::handleControlItems: Unknown packet subtype " << item->PacketSubType() << std::endl ;
 		}
+		delete item;
 	}
 
-	return nhandled;
+	// Local searches can be long. They are performed a few at a time, so that new tunnel requests do not wait
+	// for all pending searches to complete.
+	//
+	for(uint32_t i=0;i<MAX_LOCAL_SEARCHES_PER_CONTROL_TICK;++i)
+	{
+		RsTurtleSearchRequestItem *item = NULL ;
+		{
+			RsStackMutex stack(mTurtleControlMtx); /********** STACK LOCKED MTX ******/
+
+			if(_pending_local_searches.empty())
+				break ;
+
+			item = _pending_local_searches.front() ;
+			_pending_local_searches.pop_front() ;
+		}
+
+		performLocalSearch(item) ;
+		delete item ;
+	}
+
+	bool idle ;
+	{
+		RsStackMutex stack(mTurtleControlMtx); /********** STACK LOCKED MTX ******/
+		idle = _control_items.empty() && _pending_local_searches.empty() ;
+	}
+
+	if(idle)
+		_control_signal.wait(CONTROL_THREAD_IDLE_WAIT_MS) ;
 }
 
 // -----------------------------------------------------------------------------------//
@@ -859,8 +907,6 @@ int p3turtle::handleIncoming()
 //
 void p3turtle::handleSearchRequest(RsTurtleSearchRequestItem *item)
 {
-	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
-    
 	// take a look at the item and test against inconsistent values
 	// 	- If the item destimation is
 
@@ -879,84 +925,53 @@ void p3turtle::handleSearchRequest(RsTurtleSearchRequestItem *item)
 		std::cerr << "  Caught a turtle search item with arbitrary large size from " << item->PeerId() << " of size " << item_size << " and depth " << item->depth << ". This is not allowed => dropping." << std::endl;
 		return ;
 	}
-    
-	if(_search_requests_origins.size() > MAX_ALLOWED_SR_IN_CACHE)
+
+	// The mutex is only held to record the request. The tunnel results handled by the service
+	// thread need it, so the request is forwarded off-mutex.
 	{
+		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+		if(_search_requests_origins.size() > MAX_ALLOWED_SR_IN_CACHE)
+		{
 #ifdef P3TURTLE_DEBUG
-		std::cerr << "  Dropping, because the search request cache is full." << std::endl ;
+			std::cerr << "  Dropping, because the search request cache is full." << std::endl ;
 #endif
-		std::cerr << "  More than " << MAX_ALLOWED_SR_IN_CACHE << " search request in cache. A peer is probably trying to flood your network See the depth charts to find him." << std::endl;
-		return ;
-	}
+			std::cerr << "  More than " << MAX_ALLOWED_SR_IN_CACHE << " search request in cache. A peer is probably trying to flood your network See the depth charts to find him." << std::endl;
+			return ;
+		}
 
-	// If the item contains an already handled search request, give up.  This
-	// happens when the same search request gets relayed by different peers
-	//
-	if(_search_requests_origins.find(item->request_id) != _search_requests_origins.end())
-	{
+		// If the item contains an already handled search request, give up.  This
+		// happens when the same search request gets relayed by different peers
+		//
+		if(_search_requests_origins.find(item->request_id) != _search_requests_origins.end())
+		{
 #ifdef P3TURTLE_DEBUG
-		std::cerr << "  This is a bouncing request. Ignoring and deleting it." << std::endl ;
+			std::cerr << "  This is a bouncing request. Ignoring and deleting it." << std::endl ;
 #endif
-		return ;
-	}
+			return ;
+		}
 
-	// This is a new request. Let's add it to the request map, and forward it to
-	// open peers.
+		// This is a new request. Let's add it to the request map, and forward it to
+		// open peers.
 
-	TurtleRequestInfo& req( _search_requests_origins[item->request_id] ) ;
-	req.origin = item->PeerId() ;
-	req.time_stamp = time(NULL) ;
-	req.depth = item->depth ;
-	req.keywords = item->GetKeywords() ;
+		TurtleRequestInfo& req( _search_requests_origins[item->request_id] ) ;
+		req.origin = item->PeerId() ;
+		req.time_stamp = time(NULL) ;
+		req.depth = item->depth ;
+		req.keywords = item->GetKeywords() ;
+	}
 
 	// If it's not for us, perform a local search. If something found, forward the search result back.
+	// The search is done later by the control thread, off-mutex.
 
 	if(item->PeerId() != _own_id)
 	{
 #ifdef P3TURTLE_DEBUG
-		std::cerr << "  Request not from us. Performing local search" << std::endl ;
+		std::cerr << "  Request not from us. Queuing local search" << std::endl ;
 #endif
+		RsStackMutex stack(mTurtleControlMtx); /********** STACK LOCKED MTX ******/
 
-		std::list<TurtleFileInfo> result ;
-
-		item->performLocalSearch(result) ;
-
-		RsTurtleSearchResultItem *res_item = NULL ;
-		uint32_t item_size = 0 ;
-
-#ifdef P3TURTLE_DEBUG
-		if(!result.empty())
-			std::cerr << "  " << result.size() << " matches found. Sending back to origin (" << item->PeerId() << ")." << std::endl ;
-#endif
-		while(!result.empty())
-		{
-			// Let's chop search results items into several chunks of finite size to avoid exceeding streamer's capacity.
-			//
-			static const uint32_t RSTURTLE_MAX_SEARCH_RESPONSE_SIZE = 10000 ;
-
-			if(res_item == NULL)
-			{
-				res_item = new RsTurtleSearchResultItem ;
-				item_size = 0 ;
-
-				res_item->depth = 0 ;
-				res_item->request_id = item->request_id ;
-				res_item->PeerId(item->PeerId()) ;			// send back to the same guy
-			}
-			res_item->result.push_back(result.front()) ;
-
-            item_size += 8 /* size */ + result.front().hash.serial_size() + result.front().name.size() ;
-			result.pop_front() ;
-
-			if(item_size > RSTURTLE_MAX_SEARCH_RESPONSE_SIZE || result.empty())
-			{
-#ifdef P3TURTLE_DEBUG
-				std::cerr << "  Sending back chunk of size " << item_size << ", for " << res_item->result.size() << " elements." << std::endl ;
-#endif
-				sendItem(res_item) ;
-				res_item = NULL ;
-			}
-		}
+		_pending_local_searches.push_back(item->clone()) ;
 	}
 
 	// If search depth not too large, also forward this search request to all other peers.
@@ -1014,40 +1029,91 @@ void p3turtle::handleSearchRequest(RsTurtleSearchRequestItem *item)
 #endif
 }
 
-void p3turtle::handleSearchResult(RsTurtleSearchResultItem *item)
+void p3turtle::performLocalSearch(RsTurtleSearchRequestItem *item)
 {
-	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
-	// Find who actually sent the corresponding request.
-	//
-	std::map<TurtleRequestId,TurtleRequestInfo>::const_iterator it = _search_requests_origins.find(item->request_id) ;
 #ifdef P3TURTLE_DEBUG
-	std::cerr << "Received search result:" << std::endl ;
-	item->print(std::cerr,0) ;
+	std::cerr << "Performing local search for request " << (void*)item->request_id << " from peer " << item->PeerId() << std::endl ;
+#endif
+	std::list<TurtleFileInfo> result ;
+
+	item->performLocalSearch(result) ;
+
+	RsTurtleSearchResultItem *res_item = NULL ;
+	uint32_t item_size = 0 ;
+
+#ifdef P3TURTLE_DEBUG
+	if(!result.empty())
+		std::cerr << "  " << result.size() << " matches found. Sending back to origin (" << item->PeerId() << ")." << std::endl ;
 #endif
-	if(it == _search_requests_origins.end())
+	while(!result.empty())
 	{
-		// This is an error: how could we receive a search result corresponding to a search item we
-		// have forwarded but that it not in the list ??
+		// Let's chop search results items into several chunks of finite size to avoid exceeding streamer's capacity.
+		//
+		static const uint32_t RSTURTLE_MAX_SEARCH_RESPONSE_SIZE = 10000 ;
 
-		std::cerr << __PRETTY_FUNCTION__ << ": search result has no peer direction!" << std::endl ;
-		return ;
+		if(res_item == NULL)
+		{
+			res_item = new RsTurtleSearchResultItem ;
+			item_size = 0 ;
+
+			res_item->depth = 0 ;
+			res_item->request_id = item->request_id ;
+			res_item->PeerId(item->PeerId()) ;			// send back to the same guy
+		}
+		res_item->result.push_back(result.front()) ;
+
+		item_size += 8 /* size */ + result.front().hash.serial_size() + result.front().name.size() ;
+		result.pop_front() ;
+
+		if(item_size > RSTURTLE_MAX_SEARCH_RESPONSE_SIZE || result.empty())
+		{
+#ifdef P3TURTLE_DEBUG
+			std::cerr << "  Sending back chunk of size " << item_size << ", for " << res_item->result.size() << " elements." << std::endl ;
+#endif
+			sendItem(res_item) ;
+			res_item = NULL ;
+		}
+	}
+}
+
+void p3turtle::handleSearchResult(RsTurtleSearchResultItem *item)
+{
+	RsPeerId origin ;
+	{
+		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+		// Find who actually sent the corresponding request.
+		//
+		std::map<TurtleRequestId,TurtleRequestInfo>::const_iterator it = _search_requests_origins.find(item->request_id) ;
+#ifdef P3TURTLE_DEBUG
+		std::cerr << "Received search result:" << std::endl ;
+		item->print(std::cerr,0) ;
+#endif
+		if(it == _search_requests_origins.end())
+		{
+			// This is an error: how could we receive a search result corresponding to a search item we
+			// have forwarded but that it not in the list ??
+
+			std::cerr << __PRETTY_FUNCTION__ << ": search result has no peer direction!" << std::endl ;
+			return ;
+		}
+		origin = it->second.origin ;
 	}
 
 	// Is this result's target actually ours ?
 
-	if(it->second.origin == _own_id)
+	if(origin == _own_id)
 		returnSearchResult(item) ;		// Yes, so send upward.
 	else
 	{											// Nope, so forward it back.
 #ifdef P3TURTLE_DEBUG
-		std::cerr << "  Forwarding result back to " << it->second.origin << std::endl;
+		std::cerr << "  Forwarding result back to " << origin << std::endl;
 #endif
 		RsTurtleSearchResultItem *fwd_item = new RsTurtleSearchResultItem(*item) ;	// copy the item
 
 		// Normally here, we should setup the forward adress, so that the owner's
 		// of the files found can be further reached by a tunnel.
 
-		fwd_item->PeerId(it->second.origin) ;
+		fwd_item->PeerId(origin) ;
 		fwd_item->depth = 0 ; // obfuscate the depth for non immediate friends. Result will always be 0. This effectively removes the information.
 
 		sendItem(fwd_item) ;
@@ -1072,82 +1138,78 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 	item->print(std::cerr,1) ;
 #endif
 
-	{
-		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
-
-		// look for the tunnel id.
-		//
-		std::map<TurtleTunnelId,TurtleTunnel>::iterator it(_local_tunnels.find(item->tunnelId())) ;
+	// This is the data path: the turtle mutex is not used here, except to check that the hash of a
+	// client side tunnel is still monitored. The routing table only locks the shard of this tunnel.
+	//
+	uint32_t item_size = RsTurtleSerialiser().size(item);
+	TurtleTunnelId tunnel_id = item->tunnelId() ;
+	TurtleTunnel tunnel ;
 
-		if(it == _local_tunnels.end())
-		{
+	// look for the tunnel id.
+	//
+	if(!_routing_table.useTunnel(tunnel_id,item_size,item->shouldStampTunnel(),tunnel))
+	{
 #ifdef P3TURTLE_DEBUG
-			std::cerr << "p3turtle: got file map with unknown tunnel id " << (void*)item->tunnelId() << std::endl ;
+		std::cerr << "p3turtle: got file map with unknown tunnel id " << (void*)tunnel_id << std::endl ;
 #endif
-			delete item;
-			return ;
-		}
+		delete item;
+		return ;
+	}
 
-		TurtleTunnel& tunnel(it->second) ;
+	if(item->PeerId() == tunnel.local_dst)
+		item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_CLIENT) ;
+	else if(item->PeerId() == tunnel.local_src)
+		item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_SERVER) ;
+	else
+	{
+		std::cerr << "(EE) p3turtle::routeGenericTunnelItem(): item mismatches tunnel src/dst ids." << std::endl;
+		std::cerr << "(EE)          tunnel.local_src = " << tunnel.local_src << std::endl;
+		std::cerr << "(EE)          tunnel.local_dst = " << tunnel.local_dst << std::endl;
+		std::cerr << "(EE)            item->PeerId() = " << item->PeerId()    << std::endl;
+		std::cerr << "(EE) This item is probably lost while tunnel route got redefined. Deleting this item." << std::endl ;
+		delete item ;
+		return ;
+	}
 
-		// Only file data transfer updates tunnels time_stamp field, to avoid maintaining tunnel that are incomplete.
-		if(item->shouldStampTunnel())
-			tunnel.time_stamp = time(NULL) ;
+	TurtleTrafficStatisticsInfoOp traffic ;
 
-		tunnel.transfered_bytes += RsTurtleSerialiser().size(item);
+	// Let's figure out whether this packet is for us or not.
 
-		if(item->PeerId() == tunnel.local_dst)
-			item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_CLIENT) ;
-		else if(item->PeerId() == tunnel.local_src)
-			item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_SERVER) ;
-		else
-		{
-			std::cerr << "(EE) p3turtle::routeGenericTunnelItem(): item mismatches tunnel src/dst ids." << std::endl;
-			std::cerr << "(EE)          tunnel.local_src = " << tunnel.local_src << std::endl;
-			std::cerr << "(EE)          tunnel.local_dst = " << tunnel.local_dst << std::endl;
-			std::cerr << "(EE)            item->PeerId() = " << item->PeerId()    << std::endl;
-			std::cerr << "(EE) This item is probably lost while tunnel route got redefined. Deleting this item." << std::endl ;
-			delete item ;
-			return ;
-		}
-
-		// Let's figure out whether this packet is for us or not.
-
-		if(item->PeerId() == tunnel.local_dst && tunnel.local_src != _own_id) //direction == RsTurtleGenericTunnelItem::DIRECTION_CLIENT && 
-		{														 	
+	if(item->PeerId() == tunnel.local_dst && tunnel.local_src != _own_id) //direction == RsTurtleGenericTunnelItem::DIRECTION_CLIENT && 
+	{														 	
 #ifdef P3TURTLE_DEBUG
-			std::cerr << "  Forwarding generic item to peer " << tunnel.local_src << std::endl ;
+		std::cerr << "  Forwarding generic item to peer " << tunnel.local_src << std::endl ;
 #endif
-			item->PeerId(tunnel.local_src) ;
+		item->PeerId(tunnel.local_src) ;
 
-			_traffic_info_buffer.unknown_updn_Bps += RsTurtleSerialiser().size(item) ;
+		traffic.unknown_updn_Bps = item_size ;
+		_routing_table.recordTraffic(tunnel_id,traffic) ;
 
-			// This has been disabled for compilation reasons. Not sure we actually need it.
-			//
-			//if(dynamic_cast<RsTurtleFileDataItem*>(item) != NULL)
-			//	item->setPriorityLevel(QOS_PRIORITY_RS_TURTLE_FORWARD_FILE_DATA) ;
+		// This has been disabled for compilation reasons. Not sure we actually need it.
+		//
+		//if(dynamic_cast<RsTurtleFileDataItem*>(item) != NULL)
+		//	item->setPriorityLevel(QOS_PRIORITY_RS_TURTLE_FORWARD_FILE_DATA) ;
 
-			sendItem(item) ;
-			return ;
-		}
+		sendItem(item) ;
+		return ;
+	}
 
-		if(item->PeerId() == tunnel.local_src && tunnel.local_dst != _own_id) //direction == RsTurtleGenericTunnelItem::DIRECTION_SERVER &&
-		{
+	if(item->PeerId() == tunnel.local_src && tunnel.local_dst != _own_id) //direction == RsTurtleGenericTunnelItem::DIRECTION_SERVER &&
+	{
 #ifdef P3TURTLE_DEBUG
-			std::cerr << "  Forwarding generic item to peer " << tunnel.local_dst << std::endl ;
+		std::cerr << "  Forwarding generic item to peer " << tunnel.local_dst << std::endl ;
 #endif
-			item->PeerId(tunnel.local_dst) ;
-
-			_traffic_info_buffer.unknown_updn_Bps += RsTurtleSerialiser().size(item);
+		item->PeerId(tunnel.local_dst) ;
 
-			sendItem(item) ;
-			return ;
-        }
+		traffic.unknown_updn_Bps = item_size ;
+		_routing_table.recordTraffic(tunnel_id,traffic) ;
 
-        // item is for us. Use the locked region to record the data.
+		sendItem(item) ;
+		return ;
+	}
 
-        _traffic_info_buffer.data_dn_Bps += RsTurtleSerialiser().size(item);
-    }
+	traffic.data_dn_Bps = item_size ;
+	_routing_table.recordTraffic(tunnel_id,traffic) ;
 
 	// The packet was not forwarded, so it is for us. Let's treat it.
 	// This is done off-mutex, to avoid various deadlocks
@@ -1176,11 +1238,9 @@ void p3turtle::handleRecvGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 
 bool p3turtle::getTunnelServiceInfo(TurtleTunnelId tunnel_id,RsPeerId& vpid,RsFileHash& hash,RsTurtleClientService *& service)
 {
-	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+	TurtleTunnel tunnel ;
 
-	std::map<TurtleTunnelId,TurtleTunnel>::iterator it2(_local_tunnels.find(tunnel_id)) ;
-
-	if(it2 == _local_tunnels.end())
+	if(!_routing_table.getTunnel(tunnel_id,tunnel))
 	{
 #ifdef P3TURTLE_DEBUG
 		std::cerr << "p3turtle: unknown tunnel id " << (void*)tunnel_id << std::endl ;
@@ -1188,10 +1248,8 @@ bool p3turtle::getTunnelServiceInfo(TurtleTunnelId tunnel_id,RsPeerId& vpid,RsFi
 		return false;
 	}
 
-	TurtleTunnel& tunnel(it2->second) ;
-
 #ifdef P3TURTLE_DEBUG
-	assert(!tunnel.hash.empty()) ;
+	assert(!tunnel.hash.isNull()) ;
 
 	std::cerr << "  This is an endpoint for this file map." << std::endl ;
 	std::cerr << "  Forwarding data to the multiplexer." << std::endl ;
@@ -1202,50 +1260,50 @@ bool p3turtle::getTunnelServiceInfo(TurtleTunnelId tunnel_id,RsPeerId& vpid,RsFi
 	vpid = tunnel.vpid ;
 	hash = tunnel.hash ;
 
-	// Now sort out the case of client vs. server side items.
+	// Now sort out the case of client vs. server side items. Client side tunnels stop delivering data as soon
+	// as their hash is not monitored anymore, even if autowash has not closed them yet.
 	//
 	if(tunnel.local_src == _own_id)
 	{
+		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
 		std::map<TurtleFileHash,TurtleHashInfo>::const_iterator it = _incoming_file_hashes.find(hash) ;
 
-		if(it == _incoming_file_hashes.end())
+		if(it == _incoming_file_hashes.end() || _hashes_to_remove.find(hash) != _hashes_to_remove.end())
 		{
 			std::cerr << "p3turtle::handleRecvGenericTunnelItem(): hash " << hash << " for client side tunnel endpoint " << std::hex << tunnel_id << std::dec << " has been removed (probably a late response)! Dropping the item. " << std::endl;
 			return false;
 		}
 
 		service = it->second.service ;
+		return true ;
 	}
-	else if(tunnel.local_dst == _own_id)
+	if(tunnel.local_dst != _own_id)
 	{
-        std::map<TurtleTunnelId,RsTurtleClientService*>::const_iterator it = _outgoing_tunnel_client_services.find(tunnel_id) ;
-
-        if(it == _outgoing_tunnel_client_services.end())
-		{
-            std::cerr << "p3turtle::handleRecvGenericTunnelItem(): hash " << tunnel.hash << " for server side tunnel endpoint " << std::hex << tunnel_id << std::dec << " has been removed (probably a late response)! Dropping the item. " << std::endl;
-			return false;
-		}
-
-		service = it->second;
+		std::cerr << "p3turtle::handleRecvGenericTunnelItem(): hash " << hash << " for tunnel " << std::hex << tunnel_id << std::dec << ". Tunnel is not a end-point or a starting tunnel!! This is a serious consistency error." << std::endl;
+		return false ;
 	}
-	else
+	if(tunnel.service == NULL)
 	{
-		std::cerr << "p3turtle::handleRecvGenericTunnelItem(): hash " << hash << " for tunnel " << std::hex << it2->first << std::dec << ". Tunnel is not a end-point or a starting tunnel!! This is a serious consistency error." << std::endl;
-		return false ;
+		std::cerr << "p3turtle::handleRecvGenericTunnelItem(): hash " << hash << " for server side tunnel endpoint " << std::hex << tunnel_id << std::dec << " has been removed (probably a late response)! Dropping the item. " << std::endl;
+		return false;
 	}
 
+	service = tunnel.service ;
 	return true ;
 }
 // Send a data request into the correct tunnel for the given file hash
 //
 void p3turtle::sendTurtleData(const RsPeerId& virtual_peer_id,RsTurtleGenericTunnelItem *item)
 {
-	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+	// This is the data path: the turtle mutex is not used here.
 
-	// get the proper tunnel for this file hash and peer id.
-	std::map<TurtleVirtualPeerId,TurtleTunnelId>::const_iterator it(_virtual_peers.find(virtual_peer_id)) ;
+	uint32_t ss = RsTurtleSerialiser().size(item);
+	TurtleTunnelId tunnel_id ;
+	TurtleTunnel tunnel ;
 
-	if(it == _virtual_peers.end())
+	// get the proper tunnel for this file hash and peer id.
+	if(!_routing_table.useTunnel(virtual_peer_id,ss,item->shouldStampTunnel(),tunnel_id,tunnel))
 	{
 #ifdef P3TURTLE_DEBUG
 		std::cerr << "p3turtle::senddataRequest: cannot find virtual peer " << virtual_peer_id << " in VP list." << std::endl ;
@@ -1253,37 +1311,22 @@ void p3turtle::sendTurtleData(const RsPeerId& virtual_peer_id,RsTurtleGenericTun
 		delete item ;
 		return ;
 	}
-	TurtleTunnelId tunnel_id = it->second ;
-	std::map<TurtleTunnelId,TurtleTunnel>::iterator it2( _local_tunnels.find(tunnel_id) ) ;
-
-	if(it2 == _local_tunnels.end())
-	{
-		std::cerr << "p3turtle::client asked to send a packet through tunnel that has previously been deleted. Not a big issue unless it happens in masses." << std::endl;
-		delete item ;
-		return ;
-	}
-	TurtleTunnel& tunnel(it2->second) ;
 
 	item->tunnel_id = tunnel_id ;	// we should randomly select a tunnel, or something more clever.
 
-	uint32_t ss = RsTurtleSerialiser().size(item);
-
-	if(item->shouldStampTunnel())
-		tunnel.time_stamp = time(NULL) ;
-
-	tunnel.transfered_bytes += ss ;
+	TurtleTrafficStatisticsInfoOp traffic ;
 
 	if(tunnel.local_src == _own_id)
 	{
 		item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_SERVER) ;	
 		item->PeerId(tunnel.local_dst) ;
-		_traffic_info_buffer.data_dn_Bps += ss ;
+		traffic.data_dn_Bps = ss ;
 	}
 	else if(tunnel.local_dst == _own_id)
 	{
 		item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_CLIENT) ;	
 		item->PeerId(tunnel.local_src) ;
-		_traffic_info_buffer.data_up_Bps += ss ;
+		traffic.data_up_Bps = ss ;
 	}
 	else
 	{
@@ -1292,6 +1335,8 @@ void p3turtle::sendTurtleData(const RsPeerId& virtual_peer_id,RsTurtleGenericTun
 		return ;
 	}
 
+	_routing_table.recordTraffic(tunnel_id,traffic) ;
+
 #ifdef P3TURTLE_DEBUG
 	std::cerr << "p3turtle: sending service packet to virtual peer id " << virtual_peer_id << ", hash=0x" << tunnel.hash << ", tunnel = " << (void*)item->tunnel_id << ", next peer=" << tunnel.local_dst << std::endl ;
 #endif
@@ -1300,32 +1345,35 @@ void p3turtle::sendTurtleData(const RsPeerId& virtual_peer_id,RsTurtleGenericTun
 
 bool p3turtle::isTurtlePeer(const RsPeerId& peer_id) const
 {
-	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+	TurtleTunnelId tid ;
+	TurtleTunnel tunnel ;
 
-	return _virtual_peers.find(peer_id) != _virtual_peers.end() ;
+	return _routing_table.getTunnel(peer_id,tid,tunnel) ;
 }
 
 RsPeerId p3turtle::getTurtlePeerId(TurtleTunnelId tid) const
 {
-	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
-
-	std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it( _local_tunnels.find(tid) ) ;
+	TurtleTunnel tunnel ;
 
+	if(!_routing_table.getTunnel(tid,tunnel))
+	{
 #ifdef P3TURTLE_DEBUG
-	assert(it!=_local_tunnels.end()) ;
-	assert(it->second.vpid != "") ;
+		std::cerr << "p3turtle::getTurtlePeerId(): unknown tunnel id " << (void*)tid << std::endl ;
 #endif
+		return RsPeerId() ;
+	}
 
-	return it->second.vpid ;
+	return tunnel.vpid ;
 }
 
 bool p3turtle::isOnline(const RsPeerId& peer_id) const
 {
-	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+	TurtleTunnelId tid ;
+	TurtleTunnel tunnel ;
 
 	// we could do something mre clever here...
 	//
-	return _virtual_peers.find(peer_id) != _virtual_peers.end() ;
+	return _routing_table.getTunnel(peer_id,tid,tunnel) ;
 }
 
 
@@ -1397,11 +1445,17 @@ void p3turtle::handleTunnelRequest(RsTurtleOpenTunnelItem *item)
 	//
 
 	float forward_probability ;
+	float tr_dn_Bps ;
+	float max_tr_up_rate ;
 
 	{
 		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 		_traffic_info_buffer.tr_dn_Bps += RsTurtleSerialiser().size(item);
 
+		// copied for the forwarding below, which is done off-mutex.
+		tr_dn_Bps = _traffic_info.tr_dn_Bps ;
+		max_tr_up_rate = _max_tr_up_rate ;
+
 		float distance_to_maximum	= std::min(100.0f,_traffic_info.tr_up_Bps/(float)(TUNNEL_REQUEST_PACKET_SIZE*_max_tr_up_rate)) ;
 		float corrected_distance 	= pow(distance_to_maximum,DISTANCE_SQUEEZING_POWER) ;
 		forward_probability	= pow(depth_peer_probability[std::min((uint16_t)6,item->depth)],corrected_distance) ;
@@ -1460,8 +1514,6 @@ void p3turtle::handleTunnelRequest(RsTurtleOpenTunnelItem *item)
 	}
 
 	{
-		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
-
 		if(found)
 		{
 #ifdef P3TURTLE_DEBUG
@@ -1476,31 +1528,41 @@ void p3turtle::handleTunnelRequest(RsTurtleOpenTunnelItem *item)
 			res_item->PeerId(item->PeerId()) ;
 
 			TurtleTunnelId t_id = res_item->tunnel_id ;	// save it because sendItem deletes the item
+			TurtleVirtualPeerId vpid ;
 
-			sendItem(res_item) ;
-
-			// Note in the tunnels list that we have an ending tunnel here.
-			TurtleTunnel tt ;
-			tt.local_src = item->PeerId() ;
-			tt.hash = item->file_hash ;
-			tt.local_dst = _own_id ;	// this means us
-			tt.time_stamp = time(NULL) ;
-			tt.transfered_bytes = 0 ;
-			tt.speed_Bps = 0.0f ;
-
-			_local_tunnels[t_id] = tt ;
+			{
+				RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+				// Note in the tunnels list that we have an ending tunnel here.
+				TurtleTunnel tt ;
+				tt.local_src = item->PeerId() ;
+				tt.hash = item->file_hash ;
+				tt.local_dst = _own_id ;	// this means us
+				tt.time_stamp = time(NULL) ;
+				tt.transfered_bytes = 0 ;
+				tt.speed_Bps = 0.0f ;
+
+				if(!_routing_table.addTunnel(t_id,tt))
+				{
+#ifdef P3TURTLE_DEBUG
+					std::cerr << "Tunnel id " << (void*)t_id << " is already there. Not storing." << std::endl ;
+#endif
+				}
 
-			// We add a virtual peer for that tunnel+hash combination.
-			//
-			locked_addDistantPeer(item->file_hash,t_id) ;
+				// We add a virtual peer for that tunnel+hash combination, and store the service
+				// that handles the tunnel data.
+				//
+				_routing_table.setTunnelEndPoint(t_id,item->file_hash,service,vpid) ;
+			}
 
-			// Store some info string about the tunnel.
+			// The tunnel is sent back once it can route the items that will follow. The client service
+			// is notified off-mutex.
 			//
-            _outgoing_tunnel_client_services[t_id] = service ;
+			sendItem(res_item) ;
 
 			// Notify the client service that there's a new virtual peer id available as a client.
 			//
-			service->addVirtualPeer(item->file_hash,_local_tunnels[t_id].vpid,RsTurtleGenericTunnelItem::DIRECTION_CLIENT) ;
+			service->addVirtualPeer(item->file_hash,vpid,RsTurtleGenericTunnelItem::DIRECTION_CLIENT) ;
 
 			// We return straight, because when something is found, there's no need to digg a tunnel further.
 			//
@@ -1556,8 +1618,8 @@ void p3turtle::handleTunnelRequest(RsTurtleOpenTunnelItem *item)
 			// TR dn, we still need to control them to avoid flooding the pqiHandler outqueue. So we additionally moderate the 
 			// forward probability so as to reduct the output rate accordingly.
 			//
-			if(_traffic_info.tr_dn_Bps / (float)TUNNEL_REQUEST_PACKET_SIZE > _max_tr_up_rate)
-				forward_probability *= _max_tr_up_rate*TUNNEL_REQUEST_PACKET_SIZE / (float)_traffic_info.tr_dn_Bps ;
+			if(tr_dn_Bps / (float)TUNNEL_REQUEST_PACKET_SIZE > max_tr_up_rate)
+				forward_probability *= max_tr_up_rate*TUNNEL_REQUEST_PACKET_SIZE / tr_dn_Bps ;
 		}
 
 #ifdef P3TURTLE_DEBUG
@@ -1643,28 +1705,24 @@ void p3turtle::handleTunnelResult(RsTurtleTunnelOkItem *item)
 			it->second.responses.insert(item->tunnel_id) ;
 
 		// store tunnel info.
-		bool found = (_local_tunnels.find(item->tunnel_id) != _local_tunnels.end()) ;
-		TurtleTunnel& tunnel(_local_tunnels[item->tunnel_id]) ;
+		TurtleTunnel tunnel ;
 
-		if(found)
+		tunnel.local_src = it->second.origin ;
+		tunnel.local_dst = item->PeerId() ;
+		tunnel.time_stamp = time(NULL) ;
+		tunnel.transfered_bytes = 0 ;
+		tunnel.speed_Bps = 0.0f ;
+
+		if(!_routing_table.addTunnel(item->tunnel_id,tunnel))
 		{
 #ifdef P3TURTLE_DEBUG
 			std::cerr << "Tunnel id " << (void*)item->tunnel_id << " is already there. Not storing." << std::endl ;
 #endif
 		}
-		else
-		{
-			tunnel.local_src = it->second.origin ;
-			tunnel.local_dst = item->PeerId() ;
-			tunnel.hash.clear() ;
-			tunnel.time_stamp = time(NULL) ;
-			tunnel.transfered_bytes = 0 ;
-			tunnel.speed_Bps = 0.0f ;
-
 #ifdef P3TURTLE_DEBUG
+		else
 			std::cerr << "  storing tunnel info. src=" << tunnel.local_src << ", dst=" << tunnel.local_dst << ", id=" << item->tunnel_id << std::endl ;
 #endif
-		}
 
 		// Is this result's target actually ours ?
 
@@ -1696,8 +1754,6 @@ void p3turtle::handleTunnelResult(RsTurtleTunnelOkItem *item)
 						if(!found)
 							it->second.tunnels.push_back(item->tunnel_id) ;
 
-						tunnel.hash = it->first ;		// because it's a local tunnel
-
 						// Adds a virtual peer to the list of online peers.
 						// We do this later, because of the mutex protection.
 						//
@@ -1705,8 +1761,8 @@ void p3turtle::handleTunnelResult(RsTurtleTunnelOkItem *item)
 						new_hash = it->first ;
 						service = it->second.service ;
 
-						locked_addDistantPeer(new_hash,item->tunnel_id) ;
-						new_vpid = _local_tunnels[item->tunnel_id].vpid ; // save it for off-mutex usage.
+						// the hash is stored because it's a local tunnel. The vpid is saved for off-mutex usage.
+						_routing_table.setTunnelEndPoint(item->tunnel_id,new_hash,service,new_vpid) ;
 					}
 				}
 			if(!found)
@@ -2026,19 +2082,16 @@ void p3turtle::getTrafficStatistics(TurtleTrafficStatisticsInfo& info) const
 
 std::string p3turtle::getPeerNameForVirtualPeerId(const RsPeerId& virtual_peer_id)
 {
-	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
 	std::string name = "unknown";
-	std::map<TurtleVirtualPeerId,TurtleTunnelId>::const_iterator it(_virtual_peers.find(virtual_peer_id)) ;
-	if(it != _virtual_peers.end())
+	TurtleTunnelId tid ;
+	TurtleTunnel tunnel ;
+
+	if(_routing_table.getTunnel(virtual_peer_id,tid,tunnel))
 	{
-		std::map<TurtleTunnelId,TurtleTunnel>::iterator it2( _local_tunnels.find(it->second) ) ;	
-		if(it2 != _local_tunnels.end())
-		{
-			if(it2->second.local_src == _own_id)
-				mLinkMgr->getPeerName(it2->second.local_dst,name);
-			else
-				mLinkMgr->getPeerName(it2->second.local_src,name);
-		}
+		if(tunnel.local_src == _own_id)
+			mLinkMgr->getPeerName(tunnel.local_dst,name);
+		else
+			mLinkMgr->getPeerName(tunnel.local_src,name);
 	}
 	return name;
 }
@@ -2069,7 +2122,10 @@ void p3turtle::getInfo(	std::vector<std::vector<std::string> >& hashes_info,
 
 	tunnels_info.clear();
 
-	for(std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
+	std::map<TurtleTunnelId,TurtleTunnel> local_tunnels ;
+	_routing_table.getTunnels(local_tunnels) ;
+
+	for(std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it(local_tunnels.begin());it!=local_tunnels.end();++it)
 	{
 		tunnels_info.push_back(std::vector<std::string>()) ;
 		std::vector<std::string>& tunnel(tunnels_info.back()) ;
@@ -2139,12 +2195,11 @@ void p3turtle::dumpState()
 			std::cerr << " " << (void*)*it2 ;
 		//std::cerr << ", last_req=" << (void*)it->second.last_request << ", time_stamp = " << it->second.time_stamp << "(" << now-it->second.time_stamp << " secs ago)" << std::endl ;
 	}
-	std::cerr << "  Active outgoing file hashes: " << _outgoing_file_hashes.size() << std::endl ;
-    for(std::map<TurtleTunnelId,RsTurtleClientService*>::const_iterator it(_outgoing_file_hashes.begin());it!=_outgoing_file_hashes.end();++it)
-        std::cerr << "    TID=0x" << it->first << std::endl ;
+	std::map<TurtleTunnelId,TurtleTunnel> local_tunnels ;
+	_routing_table.getTunnels(local_tunnels) ;
 
 	std::cerr << "  Local tunnels:" << std::endl ;
-	for(std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it(_local_tunnels.begin());it!=_local_tunnels.end();++it)
+	for(std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it(local_tunnels.begin());it!=local_tunnels.end();++it)
 		std::cerr << "    " << (void*)it->first << ": from="
 					<< it->second.local_src << ", to=" << it->second.local_dst
 					<< ", hash=0x" << it->second.hash << ", ts=" << it->second.time_stamp << " (" << now-it->second.time_stamp << " secs ago)"
@@ -2165,8 +2220,9 @@ void p3turtle::dumpState()
 						<< " secs ago)" << std::endl ;
 
 	std::cerr << "  Virtual peers:" << std::endl ;
-	for(std::map<TurtleVirtualPeerId,TurtleTunnelId>::const_iterator it(_virtual_peers.begin());it!=_virtual_peers.end();++it)
-		std::cerr << "    id=" << it->first << ", tunnel=" << (void*)(it->second) << std::endl ;
+	for(std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it(local_tunnels.begin());it!=local_tunnels.end();++it)
+		if(!it->second.vpid.isNull())
+			std::cerr << "    id=" << it->second.vpid << ", tunnel=" << (void*)(it->first) << std::endl ;
 	std::cerr << "  Online peers: " << std::endl ;
 //	for(std::list<pqipeer>::const_iterator it(_online_peers.begin());it!=_online_peers.end();++it)
 //		std::cerr << "    id=" << it->id << ", name=" << it->name << ", state=" << it->state << ", actions=" << it->actions << std::endl ;
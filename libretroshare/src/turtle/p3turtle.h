@@ -152,6 +152,7 @@
 #include "rsturtleitem.h"
 #include "turtleclientservice.h"
 #include "turtlestatistics.h"
+#include "turtleroutingtable.h"
 
 //#define TUNNEL_STATISTICS
 
@@ -159,6 +160,7 @@ class ftServer ;
 class p3LinkMgr;
 class ftDataMultiplex;
 class RsSerialiser;
+class p3turtle;
 
 static const int TURTLE_MAX_SEARCH_DEPTH = 6 ;
 static const int TURTLE_MAX_SEARCH_REQ_ACCEPTED_SERIAL_SIZE = 200 ;
@@ -175,23 +177,6 @@ class TurtleRequestInfo
 		std::string keywords;
 };
 
-class TurtleTunnel
-{
-	public:
-		/* For all tunnels */
-
-		TurtlePeerId local_src ;		// where packets come from. Direction to the source.
-		TurtlePeerId local_dst ;		// where packets should go. Direction to the destination.
-		uint32_t	time_stamp ;			// last time the tunnel was actually used. Used for cleaning old tunnels.
-		uint32_t transfered_bytes ;	// total bytes transferred in this tunnel.
-		float speed_Bps ;             // speed of the traffic through the tunnel
-
-		/* For ending/starting tunnels only. */
-
-		TurtleFileHash hash;				// Hash of the file for this tunnel
-		TurtleVirtualPeerId vpid;		// Virtual peer id for this tunnel.
-};
-
 // This class keeps trace of the activity for the file hashes the turtle router is asked to monitor.
 //
 
@@ -205,6 +190,21 @@ class TurtleHashInfo
         bool use_aggressive_mode ;			// allow to re-digg tunnels even when some are already available
 };
 
+// Handles search requests/results and tunnel requests, so that they do not delay the items traveling in tunnels,
+// which are routed by the service thread. The turtle mutex is only held for bookkeeping while doing so, because
+// the service thread needs it to register the tunnels of incoming tunnel results.
+//
+class TurtleControlThread: public RsTickingThread
+{
+	public:
+		TurtleControlThread(p3turtle *turtle) : mTurtle(turtle) {}
+
+		virtual void data_tick() ;
+
+	private:
+		p3turtle *mTurtle ;
+};
+
 // Subclassing:
 //
 //		Class      | Brings what      | Usage
@@ -220,6 +220,7 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 {
 	public:
 		p3turtle(p3ServiceControl *sc,p3LinkMgr *lm) ;
+		virtual ~p3turtle() ;
 		virtual RsServiceInfo getServiceInfo();
 
 		// Enables/disable the service. Still ticks, but does nothing. Default is true.
@@ -325,6 +326,8 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		void sendTurtleData(const RsPeerId& virtual_peer_id, RsTurtleGenericTunnelItem *item) ;
 
 	private:
+		friend class TurtleControlThread ;
+
 		//--------------------------- Admin/Helper functions -------------------------//
 		
 		/// Generates a cyphered combination of ownId() and file hash
@@ -341,9 +344,6 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		/// initiates tunnels from here to any peers having the given file hash
 		TurtleRequestId diggTunnel(const TurtleFileHash& hash) ;	
 
-		/// adds info related to a new virtual peer.
-		void locked_addDistantPeer(const TurtleFileHash&, TurtleTunnelId) ;	
-
 		/// estimates the speed of the traffic into tunnels.
 		void estimateTunnelSpeeds() ;
 
@@ -358,9 +358,13 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		/// so that they can be removed off the turtle mutex.
 		void locked_closeTunnel(TurtleTunnelId tid,std::vector<std::pair<RsTurtleClientService*,std::pair<TurtleFileHash,TurtleVirtualPeerId> > >& peers_to_remove) ;	
 
-		/// Main routing function
+		/// Main routing function. Tunnel items and tunnel results are handled straight away. Search requests/results
+		/// and tunnel requests are queued for the control thread.
 		int handleIncoming(); 									
 
+		/// Handles the queued search requests/results and tunnel requests, then some of the pending local searches.
+		void handleControlItems() ;
+
 		/// Generic routing function for all tunnel packets that derive from RsTurtleGenericTunnelItem
 		void routeGenericTunnelItem(RsTurtleGenericTunnelItem *item) ;
 
@@ -376,8 +380,8 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 
 		//------ Functions connecting the turtle router to other components.----------//
 		
-		/// Performs a search calling local cache and search structure.
-		void performLocalSearch(const std::string& match_string,std::list<TurtleFileInfo>& result) ;
+		/// Performs a search calling local cache and search structure, and sends the results back to the request origin.
+		void performLocalSearch(RsTurtleSearchRequestItem *item) ;
 
 		/// Returns a search result upwards (possibly to the gui)
 		void returnSearchResult(RsTurtleSearchResultItem *item) ;
@@ -404,14 +408,17 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		/// stores adequate tunnels for each file hash locally managed
 		std::map<TurtleFileHash,TurtleHashInfo>				_incoming_file_hashes ;		
 
-		/// stores file info for each file we provide.
-        std::map<TurtleTunnelId,RsTurtleClientService *>	_outgoing_tunnel_client_services ;
-
-		/// local tunnels, stored by ids (Either transiting or ending).
-		std::map<TurtleTunnelId,TurtleTunnel > 				_local_tunnels ;				
-
-		/// Peers corresponding to each tunnel.
-		std::map<TurtleVirtualPeerId,TurtleTunnelId>			_virtual_peers ;				
+		/// local tunnels, stored by ids (Either transiting or ending), with the virtual peer of end-point tunnels.
+		/// Tunnels are added/removed with mTurtleMtx locked. Items are routed without it, and only delivered to
+		/// client side end-points after a short check of the monitored hashes.
+		TurtleRoutingTable										_routing_table ;
+
+		/// Search requests/results and tunnel requests waiting for the control thread, and local searches to perform.
+		RsMutex mTurtleControlMtx ;
+		std::list<RsItem*>										_control_items ;
+		std::list<RsTurtleSearchRequestItem*>					_pending_local_searches ;
+		RsWakeupSignal											_control_signal ;
+		TurtleControlThread									   *_control_thread ;
 
 		/// Hashes marked to be deleted.
         std::set<TurtleFileHash>								_hashes_to_remove ;
@@ -0,0 +1,214 @@
+/*
+ * libretroshare/src/turtle: turtleroutingtable.cc
+ *
+ * Services for RetroShare.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "csoler@users.sourceforge.net".
+ *
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "turtleroutingtable.h"
+
+TurtleRoutingTable::TurtleRoutingTable()
+{
+}
+
+TurtleVirtualPeerId TurtleRoutingTable::virtualPeerId(TurtleTunnelId tid)
+{
+	unsigned char tmp[TurtleVirtualPeerId::SIZE_IN_BYTES] ;
+	memset(tmp,0,TurtleVirtualPeerId::SIZE_IN_BYTES) ;
+
+	for(int i=0;i<4;++i)
+		tmp[i] = uint8_t( (tid >> ((3-i)*8)) & 0xff ) ;
+
+	return TurtleVirtualPeerId(tmp) ;
+}
+
+TurtleTunnelId TurtleRoutingTable::tunnelId(const TurtleVirtualPeerId& vpid)
+{
+	TurtleTunnelId tid = 0 ;
+
+	for(int i=0;i<4;++i)
+		tid = (tid << 8) + vpid.toByteArray()[i] ;
+
+	return tid ;
+}
+
+TurtleRoutingTable::Shard& TurtleRoutingTable::shard(TurtleTunnelId tid)
+{
+	return mShards[(tid ^ (tid >> 16)) % SHARD_COUNT] ;
+}
+const TurtleRoutingTable::Shard& TurtleRoutingTable::shard(TurtleTunnelId tid) const
+{
+	return mShards[(tid ^ (tid >> 16)) % SHARD_COUNT] ;
+}
+
+bool TurtleRoutingTable::addTunnel(TurtleTunnelId tid,const TurtleTunnel& tunnel)
+{
+	Shard& s(shard(tid)) ;
+	RS_STACK_MUTEX(s.mMtx); /********** STACK LOCKED MTX ******/
+
+	return s.mTunnels.insert(std::make_pair(tid,tunnel)).second ;
+}
+
+bool TurtleRoutingTable::setTunnelEndPoint(TurtleTunnelId tid,const TurtleFileHash& hash,RsTurtleClientService *service,TurtleVirtualPeerId& vpid)
+{
+	Shard& s(shard(tid)) ;
+	RS_STACK_MUTEX(s.mMtx); /********** STACK LOCKED MTX ******/
+
+	std::map<TurtleTunnelId,TurtleTunnel>::iterator it(s.mTunnels.find(tid)) ;
+
+	if(it == s.mTunnels.end())
+		return false ;
+
+	it->second.hash = hash ;
+	it->second.service = service ;
+	it->second.vpid = virtualPeerId(tid) ;
+
+	vpid = it->second.vpid ;
+	return true ;
+}
+
+bool TurtleRoutingTable::removeTunnel(TurtleTunnelId tid,TurtleTunnel& tunnel)
+{
+	Shard& s(shard(tid)) ;
+	RS_STACK_MUTEX(s.mMtx); /********** STACK LOCKED MTX ******/
+
+	std::map<TurtleTunnelId,TurtleTunnel>::iterator it(s.mTunnels.find(tid)) ;
+
+	if(it == s.mTunnels.end())
+		return false ;
+
+	tunnel = it->second ;
+	s.mTunnels.erase(it) ;
+	return true ;
+}
+
+bool TurtleRoutingTable::getTunnel(TurtleTunnelId tid,TurtleTunnel& tunnel) const
+{
+	const Shard& s(shard(tid)) ;
+	RS_STACK_MUTEX(s.mMtx); /********** STACK LOCKED MTX ******/
+
+	std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it(s.mTunnels.find(tid)) ;
+
+	if(it == s.mTunnels.end())
+		return false ;
+
+	tunnel = it->second ;
+	return true ;
+}
+
+bool TurtleRoutingTable::getTunnel(const TurtleVirtualPeerId& vpid,TurtleTunnelId& tid,TurtleTunnel& tunnel) const
+{
+	tid = tunnelId(vpid) ;
+
+	// only end-point tunnels have a virtual peer id
+
+	return !vpid.isNull() && getTunnel(tid,tunnel) && tunnel.vpid == vpid ;
+}
+
+void TurtleRoutingTable::getTunnels(std::map<TurtleTunnelId,TurtleTunnel>& tunnels) const
+{
+	tunnels.clear() ;
+
+	for(uint32_t i=0;i<SHARD_COUNT;++i)
+	{
+		RS_STACK_MUTEX(mShards[i].mMtx); /********** STACK LOCKED MTX ******/
+
+		tunnels.insert(mShards[i].mTunnels.begin(),mShards[i].mTunnels.end()) ;
+	}
+}
+
+void TurtleRoutingTable::estimateTunnelSpeeds(float time_lapse)
+{
+	for(uint32_t i=0;i<SHARD_COUNT;++i)
+	{
+		RS_STACK_MUTEX(mShards[i].mMtx); /********** STACK LOCKED MTX ******/
+
+		for(std::map<TurtleTunnelId,TurtleTunnel>::iterator it(mShards[i].mTunnels.begin());it!=mShards[i].mTunnels.end();++it)
+		{
+			TurtleTunnel& tunnel(it->second) ;
+
+			float speed_estimate = tunnel.transfered_bytes / time_lapse ;
+			tunnel.speed_Bps = 0.75*tunnel.speed_Bps + 0.25*speed_estimate ;
+			tunnel.transfered_bytes = 0 ;
+		}
+	}
+}
+
+void TurtleRoutingTable::collectTrafficStatistics(TurtleTrafficStatisticsInfoOp& info)
+{
+	for(uint32_t i=0;i<SHARD_COUNT;++i)
+	{
+		RS_STACK_MUTEX(mShards[i].mMtx); /********** STACK LOCKED MTX ******/
+
+		info = info + mShards[i].mTraffic ;
+		mShards[i].mTraffic.reset() ;
+	}
+}
+
+bool TurtleRoutingTable::useTunnel(TurtleTunnelId tid,uint32_t size,bool stamp,TurtleTunnel& tunnel)
+{
+	Shard& s(shard(tid)) ;
+	RS_STACK_MUTEX(s.mMtx); /********** STACK LOCKED MTX ******/
+
+	std::map<TurtleTunnelId,TurtleTunnel>::iterator it(s.mTunnels.find(tid)) ;
+
+	if(it == s.mTunnels.end())
+		return false ;
+
+	// Only file data transfer updates tunnels time_stamp field, to avoid maintaining tunnel that are incomplete.
+	if(stamp)
+		it->second.time_stamp = time(NULL) ;
+
+	it->second.transfered_bytes += size ;
+
+	tunnel = it->second ;
+	return true ;
+}
+
+bool TurtleRoutingTable::useTunnel(const TurtleVirtualPeerId& vpid,uint32_t size,bool stamp,TurtleTunnelId& tid,TurtleTunnel& tunnel)
+{
+	tid = tunnelId(vpid) ;
+
+	Shard& s(shard(tid)) ;
+	RS_STACK_MUTEX(s.mMtx); /********** STACK LOCKED MTX ******/
+
+	std::map<TurtleTunnelId,TurtleTunnel>::iterator it(s.mTunnels.find(tid)) ;
+
+	if(it == s.mTunnels.end() || vpid.isNull() || it->second.vpid != vpid)
+		return false ;
+
+	if(stamp)
+		it->second.time_stamp = time(NULL) ;
+
+	it->second.transfered_bytes += size ;
+
+	tunnel = it->second ;
+	return true ;
+}
+
+void TurtleRoutingTable::recordTraffic(TurtleTunnelId tid,const TurtleTrafficStatisticsInfoOp& traffic)
+{
+	Shard& s(shard(tid)) ;
+	RS_STACK_MUTEX(s.mMtx); /********** STACK LOCKED MTX ******/
+
+	s.mTraffic = s.mTraffic + traffic ;
+}
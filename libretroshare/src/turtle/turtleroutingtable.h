@@ -0,0 +1,123 @@
+/*
+ * libretroshare/src/turtle: turtleroutingtable.h
+ *
+ * Services for RetroShare.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "csoler@users.sourceforge.net".
+ *
+ */
+
+#pragma once
+
+// Table of the tunnels known to the turtle router.
+//
+// Every item that travels in a tunnel needs a lookup in this table. The table is split in shards, each with
+// its own mutex, so that forwarding tunnel data never waits for the turtle mutex, which is held while
+// handling search and tunnel requests, nor for the traffic of other tunnels.
+//
+// Tunnels are only added/removed by p3turtle with the turtle mutex locked, so the control side of the
+// router always sees a consistent table. The data side only updates the activity of existing tunnels.
+
+#include <map>
+
+#include "turtletypes.h"
+#include "turtlestatistics.h"
+#include "util/rsthreads.h"
+
+class RsTurtleClientService ;
+
+class TurtleTunnel
+{
+	public:
+		TurtleTunnel() : time_stamp(0),transfered_bytes(0),speed_Bps(0.0f),service(NULL) {}
+
+		/* For all tunnels */
+
+		TurtlePeerId local_src ;		// where packets come from. Direction to the source.
+		TurtlePeerId local_dst ;		// where packets should go. Direction to the destination.
+		uint32_t	time_stamp ;			// last time the tunnel was actually used. Used for cleaning old tunnels.
+		uint32_t transfered_bytes ;	// total bytes transferred in this tunnel.
+		float speed_Bps ;             // speed of the traffic through the tunnel
+
+		/* For ending/starting tunnels only. */
+
+		TurtleFileHash hash;				// Hash of the file for this tunnel
+		TurtleVirtualPeerId vpid;		// Virtual peer id for this tunnel.
+		RsTurtleClientService *service ;	// client service that receives the data of this tunnel.
+};
+
+class TurtleRoutingTable
+{
+	public:
+		TurtleRoutingTable() ;
+
+		/// Virtual peer id of an end-point tunnel. The tunnel id can be found back from it.
+		static TurtleVirtualPeerId virtualPeerId(TurtleTunnelId tid) ;
+		static TurtleTunnelId tunnelId(const TurtleVirtualPeerId& vpid) ;
+
+		//------------------------------ Control side -----------------------------//
+
+		/// Adds a new tunnel. Returns false if a tunnel with this id already exists, which is then left unchanged.
+		bool addTunnel(TurtleTunnelId tid,const TurtleTunnel& tunnel) ;
+
+		/// Makes an existing tunnel an end-point for the given hash and client service, and returns its virtual peer id.
+		bool setTunnelEndPoint(TurtleTunnelId tid,const TurtleFileHash& hash,RsTurtleClientService *service,TurtleVirtualPeerId& vpid) ;
+
+		/// Removes a tunnel, and returns what it was.
+		bool removeTunnel(TurtleTunnelId tid,TurtleTunnel& tunnel) ;
+
+		bool getTunnel(TurtleTunnelId tid,TurtleTunnel& tunnel) const ;
+		bool getTunnel(const TurtleVirtualPeerId& vpid,TurtleTunnelId& tid,TurtleTunnel& tunnel) const ;
+
+		/// Copies all tunnels. Used for maintenance and display, not on the data path.
+		void getTunnels(std::map<TurtleTunnelId,TurtleTunnel>& tunnels) const ;
+
+		/// Updates the speed of all tunnels from the bytes transferred during the last time_lapse seconds.
+		void estimateTunnelSpeeds(float time_lapse) ;
+
+		/// Adds the traffic recorded since the last call to the supplied statistics.
+		void collectTrafficStatistics(TurtleTrafficStatisticsInfoOp& info) ;
+
+		//------------------------------- Data side -------------------------------//
+
+		/// Records an item of the given size traveling through the tunnel and copies the tunnel. Returns false if the tunnel is unknown.
+		bool useTunnel(TurtleTunnelId tid,uint32_t size,bool stamp,TurtleTunnel& tunnel) ;
+
+		/// Same, for items sent by us to a virtual peer.
+		bool useTunnel(const TurtleVirtualPeerId& vpid,uint32_t size,bool stamp,TurtleTunnelId& tid,TurtleTunnel& tunnel) ;
+
+		/// Records traffic in the statistics of the shard of the tunnel.
+		void recordTraffic(TurtleTunnelId tid,const TurtleTrafficStatisticsInfoOp& traffic) ;
+
+	private:
+		static const uint32_t SHARD_COUNT = 16 ;
+
+		class Shard
+		{
+			public:
+				Shard() : mMtx("TurtleRoutingTable shard") {}
+
+				mutable RsMutex mMtx ;
+				std::map<TurtleTunnelId,TurtleTunnel> mTunnels ;
+				TurtleTrafficStatisticsInfoOp mTraffic ;
+		};
+
+		Shard& shard(TurtleTunnelId tid) ;
+		const Shard& shard(TurtleTunnelId tid) const ;
+
+		Shard mShards[SHARD_COUNT] ;
+};
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <retroshare/rsturtle.h>
 
 class TurtleTrafficStatisticsInfoOp: public TurtleTrafficStatisticsInfo
@@ -37,11 +37,15 @@
 #define ENABLE_ENCRYPTED_DB
 #endif
 
+// number of prepared statements kept per connection
+#define STATEMENT_CACHE_SIZE 32
+
 const int RetroDb::OPEN_READONLY = SQLITE_OPEN_READONLY;
 const int RetroDb::OPEN_READWRITE = SQLITE_OPEN_READWRITE;
 const int RetroDb::OPEN_READWRITE_CREATE = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
 
-RetroDb::RetroDb(const std::string &dbPath, int flags, const std::string& key) : mDb(NULL), mKey(key) {
+RetroDb::RetroDb(const std::string &dbPath, int flags, const std::string& key) : mDb(NULL), mKey(key),
+    mStatementCacheSize(STATEMENT_CACHE_SIZE), mStatementCacheHits(0), mStatementCacheMisses(0) {
 
     int rc = sqlite3_open_v2(dbPath.c_str(), &mDb, flags, NULL);
 
@@ -109,12 +113,15 @@ RetroDb::RetroDb(const std::string &dbPath, int flags, const std::string& key) :
 
 RetroDb::~RetroDb(){
 
+	clearStatementCache();
 	sqlite3_close(mDb);	// no-op if mDb is NULL (https://www.sqlite.org/c3ref/close.html)
 	mDb = NULL ;
 }
 
 void RetroDb::closeDb(){
 
+    clearStatementCache();
+
     int rc= sqlite3_close(mDb);
 	mDb = NULL ;
 
@@ -130,27 +137,34 @@ void RetroDb::closeDb(){
 
 bool RetroDb::execSQL(const std::string &query){
 
-    // prepare statement
-    sqlite3_stmt* stm = NULL;
-
 #ifdef RETRODB_DEBUG
     std::cerr << "Query: " << query << std::endl;
 #endif
 
-    int rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL);
+    // prepare statement
+    sqlite3_stmt* stm = acquireStatement(query);
 
     // check if there are any errors
-    if(rc != SQLITE_OK){
+    if(stm == NULL){
         std::cerr << "RetroDb::execSQL(): Error preparing statement\n";
         std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
                   << std::endl;
         return false;
     }
 
+    bool ok = stepStatement(stm, query, "RetroDb::execSQL()");
+
+    // hand statement back, cached statements are finalised when db is closed
+    releaseStatement(query, stm);
+    return ok;
+}
+
+bool RetroDb::stepStatement(sqlite3_stmt* stm, const std::string& query, const char* caller){
 
     uint32_t delta = 3;
     time_t stamp = time(NULL), now = 0;
     bool timeOut = false, ok = false;
+    int rc = SQLITE_OK;
 
     while(!timeOut){
 
@@ -180,24 +194,168 @@ bool RetroDb::execSQL(const std::string &query){
     if(!ok){
 
         if(rc == SQLITE_BUSY){
-            std::cerr << "RetroDb::execSQL()\n" ;
+            std::cerr << caller << "\n" ;
             std::cerr << "SQL timed out!" << std::endl;
         }else{
-            std::cerr << "RetroDb::execSQL(): Error executing statement (code: " << rc << ")\n";
+            std::cerr << caller << ": Error executing statement (code: " << rc << ")\n";
             std::cerr << "Sqlite Error msg: " <<  sqlite3_errmsg(mDb)
                       << std::endl;
-            std::cerr << "RetroDb::execSQL() Query: " <<  query << std::endl;
+            std::cerr << caller << " Query: " <<  query << std::endl;
         }
     }
 
-    // finalise statement or else db cannot be closed
-    sqlite3_finalize(stm);
     return ok;
 }
 
+sqlite3_stmt* RetroDb::acquireStatement(const std::string& query){
+
+    if(!isOpen())
+        return NULL;
+
+    std::map<std::string, StatementList::iterator>::iterator mit = mStatementCache.find(query);
+
+    if(mit != mStatementCache.end()){
+
+        // statement leaves the cache while in use, so that two cursors
+        // on the same query never share it
+        sqlite3_stmt* stm = mit->second->second;
+        mStatementLru.erase(mit->second);
+        mStatementCache.erase(mit);
+        ++mStatementCacheHits;
+        return stm;
+    }
+
+    ++mStatementCacheMisses;
+
+    sqlite3_stmt* stm = NULL;
+    int rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL);
+
+    if(rc != SQLITE_OK){
+        sqlite3_finalize(stm);
+        return NULL;
+    }
+
+    return stm;
+}
+
+void RetroDb::releaseStatement(const std::string& query, sqlite3_stmt* stm){
+
+    if(stm == NULL)
+        return;
+
+    // another statement for the same query was handed back first, or the
+    // db has been closed meanwhile. Queries with literal values are hardly
+    // ever run twice, they would only push reusable statements out
+    if(!isOpen() || mStatementCacheSize == 0 || sqlite3_bind_parameter_count(stm) == 0 ||
+       mStatementCache.find(query) != mStatementCache.end()){
+        sqlite3_finalize(stm);
+        return;
+    }
+
+    sqlite3_reset(stm);
+    sqlite3_clear_bindings(stm);
+
+    mStatementLru.push_front(std::make_pair(query, stm));
+    mStatementCache[query] = mStatementLru.begin();
+
+    while(mStatementLru.size() > mStatementCacheSize){
+        mStatementCache.erase(mStatementLru.back().first);
+        sqlite3_finalize(mStatementLru.back().second);
+        mStatementLru.pop_back();
+    }
+}
+
+void RetroDb::clearStatementCache(){
+
+    for(StatementList::iterator lit = mStatementLru.begin(); lit != mStatementLru.end(); ++lit)
+        sqlite3_finalize(lit->second);
+
+    mStatementLru.clear();
+    mStatementCache.clear();
+}
+
+bool RetroDb::applyProfile(const RetroDbProfile& profile){
+
+    if(!isOpen())
+        return false;
+
+    std::list<std::string> pragmas;
+
+    if(!profile.mJournalMode.empty())
+        pragmas.push_back("PRAGMA journal_mode=" + profile.mJournalMode + ";");
+
+    if(!profile.mSynchronous.empty())
+        pragmas.push_back("PRAGMA synchronous=" + profile.mSynchronous + ";");
+
+    if(profile.mMmapSize != 0){
+        std::ostringstream out;
+        out << "PRAGMA mmap_size=" << profile.mMmapSize << ";";
+        pragmas.push_back(out.str());
+    }
+
+    if(profile.mCacheSize != 0){
+        std::ostringstream out;
+        out << "PRAGMA cache_size=" << profile.mCacheSize << ";";
+        pragmas.push_back(out.str());
+    }
+
+    if(!profile.mTempStore.empty())
+        pragmas.push_back("PRAGMA temp_store=" + profile.mTempStore + ";");
+
+    bool ok = true;
+
+    // some of these pragmas return a row, so they cannot go through execSQL()
+    for(std::list<std::string>::iterator lit = pragmas.begin(); lit != pragmas.end(); ++lit){
+
+        char *err = NULL;
+        int rc = sqlite3_exec(mDb, lit->c_str(), NULL, NULL, &err);
+
+        if(rc != SQLITE_OK){
+            std::cerr << "RetroDb::applyProfile(): " << *lit << " failed, error code: " << rc;
+            if(err)
+                std::cerr << ", " << err;
+            std::cerr << std::endl;
+            ok = false;
+        }
+
+        sqlite3_free(err);
+    }
+
+#ifdef RETRODB_DEBUG
+    std::cerr << "RetroDb::applyProfile(): applied profile " << profile.mName << std::endl;
+#endif
+
+    return ok;
+}
+
+void RetroDb::setStatementCacheSize(uint32_t size){
+
+    mStatementCacheSize = size;
+
+    while(mStatementLru.size() > mStatementCacheSize){
+        mStatementCache.erase(mStatementLru.back().first);
+        sqlite3_finalize(mStatementLru.back().second);
+        mStatementLru.pop_back();
+    }
+}
+
+void RetroDb::getStatementCacheStats(uint32_t& hits, uint32_t& misses) const{
+
+    hits = mStatementCacheHits;
+    misses = mStatementCacheMisses;
+}
+
 RetroCursor* RetroDb::sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
                                const std::string& selection, const std::string& orderBy){
 
+    std::list<std::string> selectionArgs;
+    return sqlQuery(tableName, columns, selection, selectionArgs, orderBy);
+}
+
+RetroCursor* RetroDb::sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
+                               const std::string& selection, const std::list<std::string>& selectionArgs,
+                               const std::string& orderBy){
+
     if(tableName.empty() || columns.empty()){
         std::cerr << "RetroDb::sqlQuery(): No table or columns given" << std::endl;
         return NULL;
@@ -235,52 +393,128 @@ RetroCursor* RetroDb::sqlQuery(const std::string& tableName, const std::list<std
     std::cerr << "RetroDb::sqlQuery(): " << sqlQuery << std::endl;
 #endif
 
-    sqlite3_prepare_v2(mDb, sqlQuery.c_str(), sqlQuery.length(), &stmt, NULL);
-    return (new RetroCursor(stmt));
+    stmt = acquireStatement(sqlQuery);
+
+    if(stmt == NULL)
+        return (new RetroCursor(stmt));
+
+    std::list<RetroBind*> paramBindings;
+    int index = 0;
+
+    for(it = selectionArgs.begin(); it != selectionArgs.end(); ++it)
+        paramBindings.push_back(new RsStringBind(*it, ++index));
+
+    if(!bindValues(stmt, paramBindings)){
+        std::cerr << "RetroDb::sqlQuery(): Error binding selection values of " << sqlQuery << std::endl;
+        releaseStatement(sqlQuery, stmt);
+        return (new RetroCursor(NULL));
+    }
+
+    return (new RetroCursor(stmt, this, sqlQuery));
 }
 
 bool RetroDb::isOpen() const {
     return (mDb==NULL ? false : true);
 }
 
-bool RetroDb::sqlInsert(const std::string &table, const std::string& /* nullColumnHack */, const ContentValue &cv){
+bool RetroDb::sqlInsert(const std::string &table, const std::string& nullColumnHack, const ContentValue &cv){
 
-    std::map<std::string, uint8_t> keyTypeMap;
-    cv.getKeyTypeMap(keyTypeMap);
-    std::map<std::string, uint8_t>::iterator mit = keyTypeMap.begin();
+    std::list<ContentValue*> cvs;
+    cvs.push_back(const_cast<ContentValue*>(&cv));
 
-    // build columns part of insertion
-    std::string qColumns = table + "(";
+    return sqlInsert(table, nullColumnHack, cvs);
+}
 
-    for(; mit != keyTypeMap.end(); ++mit){
+bool RetroDb::sqlInsert(const std::string &table, const std::string& /* nullColumnHack */, const std::list<ContentValue*> &cvs){
 
-        qColumns += mit->first;
+    bool ok = true;
+    std::string sqlQuery;
+    sqlite3_stmt* stm = NULL;
+    std::map<std::string, uint8_t> stmKeyTypeMap;
 
-        ++mit;
+    for(std::list<ContentValue*>::const_iterator cit = cvs.begin(); cit != cvs.end(); ++cit){
 
-        // add comma if more columns left
-        if(mit == keyTypeMap.end())
-            qColumns += ")"; // close bracket if at end
-        else
-            qColumns += ",";
+        const ContentValue& cv = **cit;
 
-        --mit;
-    }
+        std::map<std::string, uint8_t> keyTypeMap;
+        cv.getKeyTypeMap(keyTypeMap);
 
-    // build values part of insertion
-    std::string qValues;
-    std::list<RetroBind*> paramBindings;
-    buildInsertQueryValue(keyTypeMap, cv, qValues, paramBindings);
+        // build values part of insertion
+        std::string qValues;
+        std::list<RetroBind*> paramBindings;
+        buildInsertQueryValue(keyTypeMap, cv, qValues, paramBindings);
 
-    // complete insertion query
-    std::string sqlQuery = "INSERT INTO " + qColumns + " " + qValues;
+        // rows with the same columns share the statement
+        if(stm == NULL || keyTypeMap != stmKeyTypeMap){
 
-    bool ok = execSQL_bind(sqlQuery, paramBindings);
+            if(stm != NULL)
+                releaseStatement(sqlQuery, stm);
+
+            // build columns part of insertion
+            std::string qColumns = table + "(";
+            std::map<std::string, uint8_t>::iterator mit = keyTypeMap.begin();
+
+            for(; mit != keyTypeMap.end(); ++mit){
+
+                if(mit != keyTypeMap.begin())
+                    qColumns += ",";
+
+                qColumns += mit->first;
+            }
+            qColumns += ")";
+
+            // complete insertion query
+            sqlQuery = "INSERT INTO " + qColumns + " " + qValues;
+            stmKeyTypeMap = keyTypeMap;
 
 #ifdef RETRODB_DEBUG
-    std::cerr << "RetroDb::sqlInsert(): " << sqlQuery << std::endl;
+            std::cerr << "RetroDb::sqlInsert(): " << sqlQuery << std::endl;
 #endif
 
+            stm = acquireStatement(sqlQuery);
+
+            if(stm == NULL){
+                std::cerr << "RetroDb::sqlInsert(): Error preparing statement\n";
+                std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
+                          << std::endl;
+            }
+        }
+
+        if(stm == NULL || !bindValues(stm, paramBindings) || !stepStatement(stm, sqlQuery, "RetroDb::sqlInsert()"))
+            ok = false;
+
+        if(stm != NULL){
+            sqlite3_reset(stm);
+            sqlite3_clear_bindings(stm);
+        }
+    }
+
+    if(stm != NULL)
+        releaseStatement(sqlQuery, stm);
+
+    return ok;
+}
+
+bool RetroDb::bindValues(sqlite3_stmt* stm, std::list<RetroBind*>& paramBindings){
+
+    bool ok = true;
+    std::list<RetroBind*>::iterator lit = paramBindings.begin();
+
+    for(; lit != paramBindings.end(); ++lit){
+        RetroBind* rb = *lit;
+
+        if(stm != NULL && !rb->bind(stm))
+        {
+        	std::cerr << "\nBind failed for index: " << rb->getIndex()
+        			  << std::endl;
+        	ok = false;
+        }
+
+        delete rb;
+        rb = NULL;
+    }
+
+    paramBindings.clear();
     return ok;
 }
 
@@ -317,82 +551,28 @@ bool RetroDb::rollbackTransaction()
 
 bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &paramBindings){
 
-    // prepare statement
-    sqlite3_stmt* stm = NULL;
-
 #ifdef RETRODB_DEBUG
     std::cerr << "Query: " << query << std::endl;
 #endif
 
-    int rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL);
+    // prepare statement
+    sqlite3_stmt* stm = acquireStatement(query);
 
     // check if there are any errors
-    if(rc != SQLITE_OK){
+    if(stm == NULL){
         std::cerr << "RetroDb::execSQL_bind(): Error preparing statement\n";
         std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
                   << std::endl;
+        bindValues(NULL, paramBindings);
         return false;
     }
 
-    std::list<RetroBind*>::iterator lit = paramBindings.begin();
-
-    for(; lit != paramBindings.end(); ++lit){
-        RetroBind* rb = *lit;
-
-        if(!rb->bind(stm))
-        {
-        	std::cerr << "\nBind failed for index: " << rb->getIndex()
-        			  << std::endl;
-        }
-
-        delete rb;
-        rb = NULL;
-    }
-
-    uint32_t delta = 3;
-    time_t stamp = time(NULL), now = 0;
-    bool timeOut = false, ok = false;
-
-    while(!timeOut){
-
-        rc = sqlite3_step(stm);
-
-        if(rc == SQLITE_DONE){
-            ok = true;
-            break;
-        }
-
-        if(rc != SQLITE_BUSY){
-            ok = false;
-            break;
-        }
-
-        now = time(NULL);
-        delta = stamp - now;
-
-        if(delta > TIME_LIMIT){
-            ok = false;
-            timeOut = true;
-        }
-        // TODO add sleep so not to waste
-        // precious cycles
-    }
-
-    if(!ok){
+    bindValues(stm, paramBindings);
 
-        if(rc == SQLITE_BUSY){
-            std::cerr << "RetroDb::execSQL_bind()\n" ;
-            std::cerr << "SQL timed out!" << std::endl;
-        }else{
-            std::cerr << "RetroDb::execSQL_bind(): Error executing statement (code: " << rc << ")\n";
-            std::cerr << "Sqlite Error msg: " <<  sqlite3_errmsg(mDb)
-                      << std::endl;
-            std::cerr << "RetroDb::execSQL_bind() Query: " <<  query << std::endl;
-        }
-    }
+    bool ok = stepStatement(stm, query, "RetroDb::execSQL_bind()");
 
-    // finalise statement or else db cannot be closed
-    sqlite3_finalize(stm);
+    // hand statement back, cached statements are finalised when db is closed
+    releaseStatement(query, stm);
     return ok;
 }
 
@@ -553,6 +733,13 @@ bool RetroDb::sqlDelete(const std::string &tableName, const std::string &whereCl
 
 bool RetroDb::sqlUpdate(const std::string &tableName, std::string whereClause, const ContentValue& cv){
 
+    std::list<std::string> whereArgs;
+    return sqlUpdate(tableName, whereClause, whereArgs, cv);
+}
+
+bool RetroDb::sqlUpdate(const std::string &tableName, const std::string& whereClause, const std::list<std::string>& whereArgs,
+                        const ContentValue& cv){
+
     std::string sqlQuery = "UPDATE " + tableName + " SET ";
 
 
@@ -578,6 +765,12 @@ bool RetroDb::sqlUpdate(const std::string &tableName, std::string whereClause, c
         sqlQuery += ";";
     }
 
+    // where values come after the SET values
+    int index = paramBindings.size();
+
+    for(std::list<std::string>::const_iterator it = whereArgs.begin(); it != whereArgs.end(); ++it)
+        paramBindings.push_back(new RsStringBind(*it, ++index));
+
     // execute query
     return execSQL_bind(sqlQuery, paramBindings);
 }
@@ -620,20 +813,74 @@ bool RetroDb::tableExists(const std::string &tableName)
     return result;
 }
 
+/********************** RetroDbProfile ************************/
+
+RetroDbProfile::RetroDbProfile()
+    : mName("Default"), mMmapSize(0), mCacheSize(0) {}
+
+RetroDbProfile RetroDbProfile::safe(){
+
+    RetroDbProfile profile;
+    profile.mName = "Safe";
+    profile.mJournalMode = "WAL";
+    profile.mSynchronous = "FULL";
+
+    return profile;
+}
+
+RetroDbProfile RetroDbProfile::throughput(){
+
+    RetroDbProfile profile;
+    profile.mName = "Throughput";
+    profile.mJournalMode = "WAL";
+    profile.mSynchronous = "NORMAL";
+    profile.mMmapSize = 64*1024*1024;
+    profile.mCacheSize = -8192;   // 8 MiB
+    profile.mTempStore = "MEMORY";
+
+    return profile;
+}
+
+bool RetroDbProfile::fromName(const std::string& name, RetroDbProfile& profile){
+
+    std::string lname;
+    for(std::string::const_iterator it = name.begin(); it != name.end(); ++it)
+        lname += tolower(*it);
+
+    if(lname == "default")
+        profile = RetroDbProfile();
+    else if(lname == "safe")
+        profile = safe();
+    else if(lname == "throughput")
+        profile = throughput();
+    else
+        return false;
+
+    return true;
+}
+
 /********************** RetroCursor ************************/
 
 RetroCursor::RetroCursor(sqlite3_stmt *stmt)
-    : mStmt(NULL) {
+    : mStmt(NULL), mDb(NULL) {
 
      open(stmt);
 }
 
+RetroCursor::RetroCursor(sqlite3_stmt *stmt, RetroDb* db, const std::string& query)
+    : mStmt(NULL), mDb(NULL) {
+
+     open(stmt);
+
+     if(isOpen()){
+         mDb = db;
+         mQuery = query;
+     }
+}
+
 RetroCursor::~RetroCursor(){
 
-    // finalise statement
-    if(mStmt){
-        sqlite3_finalize(mStmt);
-    }
+    close();
 }
 
 bool RetroCursor::moveToFirst(){
@@ -718,8 +965,16 @@ bool RetroCursor::close(){
     if(!isOpen())
         return false;
 
+    int rc = SQLITE_OK;
+
+    if(mDb != NULL){
+        // statement goes back to the cache it was taken from
+        mDb->releaseStatement(mQuery, mStmt);
+        mDb = NULL;
+        mQuery.clear();
+    }else
+        rc = sqlite3_finalize(mStmt);
 
-    int rc = sqlite3_finalize(mStmt);
     mStmt = NULL;
 
     return (rc == SQLITE_OK);
@@ -40,6 +40,42 @@
 
 class RetroCursor;
 
+/*!
+ * Set of sqlite tuning pragmas applied to a database when it is opened. \n
+ * Empty strings and zero sizes leave sqlite's own defaults untouched
+ */
+class RetroDbProfile
+{
+public:
+
+    RetroDbProfile();
+
+    /*!
+     * @param name one of "Default", "Safe" or "Throughput" (case insensitive)
+     * @param profile set to the named profile
+     * @return false if name is unknown, profile is then left unchanged
+     */
+    static bool fromName(const std::string& name, RetroDbProfile& profile);
+
+    /*!
+     * write ahead log with full syncs, a crash never loses a commit
+     */
+    static RetroDbProfile safe();
+
+    /*!
+     * write ahead log synced at checkpoints only, memory mapped io and \n
+     * a larger page cache, for nodes storing lots of GXS traffic
+     */
+    static RetroDbProfile throughput();
+
+    std::string mName;
+    std::string mJournalMode;   // PRAGMA journal_mode, e.g. WAL
+    std::string mSynchronous;   // PRAGMA synchronous, e.g. NORMAL
+    int64_t mMmapSize;          // PRAGMA mmap_size in bytes, ignored by sqlcipher for encrypted dbs
+    int32_t mCacheSize;         // PRAGMA cache_size, > 0 pages, < 0 KiB
+    std::string mTempStore;     // PRAGMA temp_store, e.g. MEMORY
+};
+
 /*!
  * RetroDb provide a means for Retroshare's core and \n
  * services to maintain an easy to use random access file via a database \n
@@ -130,6 +166,19 @@ public:
      */
     bool sqlInsert(const std::string& table,const  std::string& nullColumnHack, const ContentValue& cv);
 
+    /*!
+     * inserts several rows in a database table, using a single prepared \n
+     * statement which is rebound for each row. Rows holding a different set \n
+     * of keys than the first one are inserted with their own statement. \n
+     * The caller should wrap this in a transaction to get the full benefit
+     * @param table table you want to insert content values into
+     * @param nullColumnHack  SQL doesn't allow inserting a completely \n
+     *        empty row without naming at least one column name
+     * @param cvs hold entries to insert, one per row
+     * @return true if all insertions were successful, false otherwise
+     */
+    bool sqlInsert(const std::string& table,const  std::string& nullColumnHack, const std::list<ContentValue*>& cvs);
+
     /*!
      * update row in a database table
      * @param tableName the table on which to apply the UPDATE
@@ -139,6 +188,17 @@ public:
      */
     bool sqlUpdate(const std::string& tableName, const std::string whereClause, const ContentValue& cv);
 
+    /*!
+     * update row in a database table, with the where clause values bound as parameters
+     * @param tableName the table on which to apply the UPDATE
+     * @param whereClause formatted as where statement without 'WHERE' itself, with '?' in place of values
+     * @param whereArgs values replacing the '?' of whereClause, in order
+     * @param cv Values used to replace current values in accessed record
+     * @return true if update was successful, false otherwise
+     */
+    bool sqlUpdate(const std::string& tableName, const std::string& whereClause, const std::list<std::string>& whereArgs,
+                   const ContentValue& cv);
+
     /*!
      * Query the given table, returning a Cursor over the result set
      * @param tableName the table name
@@ -153,6 +213,17 @@ public:
     RetroCursor* sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
                           const std::string& selection, const std::string& orderBy);
 
+    /*!
+     * Query the given table, with the selection values bound as parameters. \n
+     * Queries run for every row should use this, so that their statement is cached
+     * @param selection filter formatted as an SQL WHERE clause, with '?' in place of values
+     * @param selectionArgs values replacing the '?' of selection, in order
+     * @return cursor over result set, this allocated resource should be free'd after use
+     */
+    RetroCursor* sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
+                          const std::string& selection, const std::list<std::string>& selectionArgs,
+                          const std::string& orderBy);
+
     /*!
      * delete row in an sql table
      * @param tableName the table on which to apply the DELETE
@@ -174,6 +245,26 @@ public:
      */
     bool tableExists(const std::string& tableName);
 
+    /*!
+     * Applies the pragmas of a storage profile to the opened database
+     * @param profile pragmas to apply
+     * @return false if one of the pragmas failed
+     */
+    bool applyProfile(const RetroDbProfile& profile);
+
+    /*!
+     * Sets the maximum number of prepared statements kept between calls. \n
+     * Least recently used statements are finalised first, 0 disables the cache
+     * @param size maximum number of cached statements
+     */
+    void setStatementCacheSize(uint32_t size);
+
+    /*!
+     * @param hits number of statements served from the cache
+     * @param misses number of statements which had to be prepared
+     */
+    void getStatementCacheStats(uint32_t& hits, uint32_t& misses) const;
+
 public:
 
     static const int OPEN_READONLY;
@@ -182,8 +273,42 @@ public:
 
 private:
 
+    friend class RetroCursor;
+
     bool execSQL_bind(const std::string &query, std::list<RetroBind*>& blobs);
 
+    /*!
+     * binds parameters to stm, bindings are deleted and the list emptied
+     * @param stm statement to bind, if NULL bindings are only deleted
+     * @return false if a binding failed
+     */
+    bool bindValues(sqlite3_stmt* stm, std::list<RetroBind*>& paramBindings);
+
+    /*!
+     * steps a statement which does not return rows until it is done
+     * @return false if there was an sqlite error or the db stayed busy
+     */
+    bool stepStatement(sqlite3_stmt* stm, const std::string& query, const char* caller);
+
+    /*!
+     * Returns a prepared statement for query, taken out of the cache if \n
+     * available. The statement must be handed back with releaseStatement()
+     * @return NULL if the statement could not be prepared
+     */
+    sqlite3_stmt* acquireStatement(const std::string& query);
+
+    /*!
+     * Resets the statement and keeps it for later use of the same query, \n
+     * evicting the least recently used statement if the cache is full. \n
+     * Statements without parameters are finalised: their values are part of the query.
+     */
+    void releaseStatement(const std::string& query, sqlite3_stmt* stm);
+
+    /*!
+     * finalises all cached statements, needed before the db can be closed
+     */
+    void clearStatementCache();
+
     /*!
      * Build the "VALUE" part of an insertiong sql query
      * @param parameter contains place holder query
@@ -204,6 +329,14 @@ private:
 
     sqlite3* mDb;
     const std::string mKey;
+
+    /* prepared statements by query text, most recently used at the front */
+    typedef std::list<std::pair<std::string, sqlite3_stmt*> > StatementList;
+    StatementList mStatementLru;
+    std::map<std::string, StatementList::iterator> mStatementCache;
+    uint32_t mStatementCacheSize;
+    uint32_t mStatementCacheHits;
+    uint32_t mStatementCacheMisses;
 };
 
 /*!
@@ -219,6 +352,13 @@ public:
      */
     RetroCursor(sqlite3_stmt*);
 
+    /*!
+     * Initialises a cursor on a statement obtained from db's statement \n
+     * cache, the statement is handed back to db when the cursor is closed
+     * @warning cursor must be deleted before db is closed or destroyed
+     */
+    RetroCursor(sqlite3_stmt*, RetroDb* db, const std::string& query);
+
     ~RetroCursor();
 
     /*!
@@ -319,6 +459,8 @@ public:
     }
 private:
     sqlite3_stmt* mStmt;
+    RetroDb* mDb;
+    std::string mQuery;
 };
 
 #endif // RSSQLITE_H
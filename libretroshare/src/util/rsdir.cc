@@ -555,64 +555,124 @@ bool RsDirUtil::hashFile(const std::string& filepath,
 #include <openssl/sha.h>
 #include <iomanip>
 
+#ifndef WINDOWS_SYS
+#include <sys/mman.h>
+#endif
+
+// Hints the kernel about the part of the file we are about to hash, so that it is read while we compute the SHA1 of
+// the current chunk. No-op where posix_fadvise() is not available.
+//
+// The part already hashed is left in the page cache: the file may be in use at the same time (played, uploaded...).
+
+static void hashReadAhead(FILE *fd,uint64_t offset,uint64_t len)
+{
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(fileno(fd), offset, len, POSIX_FADV_WILLNEED) ;
+#else
+	(void)fd ; (void)offset ; (void)len ;
+#endif
+}
+
 /* Function to hash, and get details of a file */
-bool RsDirUtil::getFileHash(const std::string& filepath, RsFileHash &hash, uint64_t &size, RsThread *thread /*= NULL*/)
+bool RsDirUtil::getFileHash(const std::string& filepath, RsFileHash &hash, uint64_t &size, RsThread *thread /*= NULL*/, bool use_mmap /*= false*/)
 {
 	FILE *fd;
 
 	if (NULL == (fd = RsDirUtil::rs_fopen(filepath.c_str(), "rb")))
 		return false;
 
-	int  len;
-	SHA_CTX *sha_ctx = new SHA_CTX;
+	SHA_CTX sha_ctx ;
 	unsigned char sha_buf[SHA_DIGEST_LENGTH];
 
-	static const uint32_t HASH_BUFFER_SIZE = 1024*1024*10 ;// allocate a 10MB buffer. Too small a buffer will cause multiple HD hits and slow down the hashing process.
-	RsTemporaryMemory gblBuf(HASH_BUFFER_SIZE) ;
-	//unsigned char gblBuf[512];
+	static const uint32_t HASH_BUFFER_SIZE = 1024*1024*10 ;// 10MB chunks. Too small a buffer will cause multiple HD hits and slow down the hashing process.
+	static const uint64_t HASH_MMAP_WINDOW = 1024*1024*64 ;	// size of mapped windows when using mmap. Keeps the address space usage low on 32 bits systems.
 
 	/* determine size */
  	fseeko64(fd, 0, SEEK_END);
 	size = ftello64(fd);
 	fseeko64(fd, 0, SEEK_SET);
 
-	/* check if thread is running */
-	bool isRunning = thread ? thread->isRunning() : true;
-	int runningCheckCount = 0;
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fileno(fd), 0, 0, POSIX_FADV_SEQUENTIAL) ;
+#endif
 
-	SHA1_Init(sha_ctx);
-	while(isRunning && (len = fread(gblBuf,1, HASH_BUFFER_SIZE, fd)) > 0)
+	SHA1_Init(&sha_ctx);
+
+	/* check if thread is asked to stop */
+	bool stopped = false ;
+	bool done = false ;
+
+#ifndef WINDOWS_SYS
+	if(use_mmap && size > 0)
 	{
-		SHA1_Update(sha_ctx, gblBuf, len);
+		// The next window is read ahead while the current one is hashed. Falls back to fread() if the file cannot be mapped.
+
+		uint64_t offset = 0 ;
+		hashReadAhead(fd,0,HASH_MMAP_WINDOW) ;
+
+		while(offset < size && !(stopped = (thread != NULL && thread->shouldStop())))
+		{
+			uint64_t len = std::min(HASH_MMAP_WINDOW, size - offset) ;
+			void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fileno(fd), offset) ;
+
+			if(map == MAP_FAILED)
+				break ;
 
-		if (thread && ++runningCheckCount > (10 * 1024)) {
-			/* check all 50MB if thread is running */
-			isRunning = thread->isRunning();
-			runningCheckCount = 0;
+			hashReadAhead(fd,offset+len,HASH_MMAP_WINDOW) ;
+#ifdef MADV_SEQUENTIAL
+			madvise(map, len, MADV_SEQUENTIAL) ;
+#endif
+			SHA1_Update(&sha_ctx, map, len);
+			munmap(map, len) ;
+
+			offset += len ;
 		}
+		done = (offset >= size) ;
+
+		if(!done && !stopped)
+			fseeko64(fd, offset, SEEK_SET);
 	}
+#else
+	(void)use_mmap ;
+#endif
 
-	/* Thread has ended */
-	if (isRunning == false)
+	if(!done && !stopped)
 	{
-		delete sha_ctx;
-		fclose(fd);
-		return false;
+		RsTemporaryMemory gblBuf(HASH_BUFFER_SIZE) ;
+
+		if(!gblBuf)
+		{
+			fclose(fd);
+			return false;
+		}
+
+		uint64_t offset = ftello64(fd) ;
+		int len ;
+
+		hashReadAhead(fd,offset,HASH_BUFFER_SIZE) ;
+
+		while(!(stopped = (thread != NULL && thread->shouldStop())) && (len = fread(gblBuf,1, HASH_BUFFER_SIZE, fd)) > 0)
+		{
+			// the next chunk is read by the kernel while we compute the SHA1 of this one.
+
+			hashReadAhead(fd,offset+len,HASH_BUFFER_SIZE) ;
+			SHA1_Update(&sha_ctx, gblBuf, len);
+
+			offset += len ;
+		}
 	}
 
-	/* reading failed for some reason */
-	if (ferror(fd))
+	/* Thread has been asked to stop, or reading failed for some reason */
+	if (stopped || ferror(fd))
 	{
-		delete sha_ctx;
 		fclose(fd);
 		return false;
 	}
 
-	SHA1_Final(&sha_buf[0], sha_ctx);
+	SHA1_Final(&sha_buf[0], &sha_ctx);
 
 	hash = Sha1CheckSum(sha_buf);
 
-	delete sha_ctx;
 	fclose(fd);
 	return true;
 }
@@ -104,7 +104,11 @@ bool    	cleanupDirectory(const std::string& dir, const std::set<std::string> &k
 bool    	cleanupDirectoryFaster(const std::string& dir, const std::set<std::string> &keepFiles);
 
 bool 		hashFile(const std::string& filepath,   std::string &name, RsFileHash &hash, uint64_t &size);
-bool 		getFileHash(const std::string& filepath,RsFileHash &hash, uint64_t &size, RsThread *thread = NULL);
+// Computes the SHA1 of a file. Stops early (and returns false) if the supplied thread is asked to stop. When use_mmap
+// is true, the file is mapped in memory piece by piece instead of being read into a buffer (ignored on Windows). Only
+// use it on files that are not truncated while being hashed.
+
+bool 		getFileHash(const std::string& filepath,RsFileHash &hash, uint64_t &size, RsThread *thread = NULL, bool use_mmap = false);
 
 Sha1CheckSum   sha1sum(const uint8_t *data,uint32_t size) ;
 Sha256CheckSum sha256sum(const uint8_t *data,uint32_t size) ;
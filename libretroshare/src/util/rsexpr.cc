@@ -185,6 +185,58 @@ bool StringExpression :: evalStr ( const std::string &str ){
     return false;
 }
 
+bool StringExpression::termSubstrings(std::list<std::string>& strings) const
+{
+    if(terms.empty())
+        return false;
+
+    switch (Op) {
+    case ContainsAllStrings:
+    {
+        // any single term will do. The longest one is the most selective.
+        std::list<std::string>::const_iterator longest = terms.begin();
+
+        for(std::list<std::string>::const_iterator iter = terms.begin(); iter != terms.end(); ++iter)
+            if(iter->length() > longest->length())
+                longest = iter;
+
+        strings.push_back(*longest);
+        return true;
+    }
+    case ContainsAnyStrings:
+    case EqualsString:
+        strings.insert(strings.end(), terms.begin(), terms.end());
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool CompoundExpression::nameSubstrings(std::list<std::string>& strings) const
+{
+    if (Lexp == NULL or Rexp == NULL)
+        return false;
+
+    switch (Op){
+    case AndOp:
+        // either side restricts the result
+        return Lexp->nameSubstrings(strings) || Rexp->nameSubstrings(strings);
+    case OrOp:
+    {
+        std::list<std::string> lstrings, rstrings;
+
+        if(!Lexp->nameSubstrings(lstrings) || !Rexp->nameSubstrings(rstrings))
+            return false;
+
+        strings.insert(strings.end(), lstrings.begin(), lstrings.end());
+        strings.insert(strings.end(), rstrings.begin(), rstrings.end());
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
 /*************************************************************************
  * linearization code
  *************************************************************************/
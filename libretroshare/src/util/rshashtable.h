@@ -0,0 +1,233 @@
+/*
+ * libretroshare/src/util: rshashtable.h
+ *
+ * Hash table for cryptographic ids, for RetroShare.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+
+/* Open addressing hash table, for keys that are hashes themselves (Sha1 sums, ids...).
+ *
+ * The key bytes are uniformly distributed already, so the first 8 bytes of the key are used as the hash value.
+ * Collisions are resolved by linear probing, and removed entries are filled by moving back the following entries
+ * of the same probe sequence, so that no tombstones are needed.
+ *
+ * The same key can be stored several times with different values (e.g. the same file shared at different places).
+ * Key/value pairs are unique.
+ *
+ * The Key class needs toByteArray() and SIZE_IN_BYTES >= 8, as in t_RsGenericIdType.
+ */
+
+template<class Key,class Value> class RsHashTable
+{
+public:
+	RsHashTable() : mSize(0) {}
+
+	uint32_t size() const { return mSize ; }
+	bool empty() const { return mSize == 0 ; }
+
+	void clear()
+	{
+		mSlots.clear() ;
+		mSize = 0 ;
+	}
+
+	// Adds the key/value pair. Returns false if it is already there.
+
+	bool insert(const Key& key,const Value& value)
+	{
+		if(2*(mSize+1) > mSlots.size())
+			resize(mSlots.empty()?INITIAL_SIZE:2*mSlots.size()) ;
+
+		uint32_t i = home(key) ;
+
+		for(;mSlots[i].used;i=next(i))
+			if(mSlots[i].key == key && mSlots[i].value == value)
+				return false ;
+
+		mSlots[i].key = key ;
+		mSlots[i].value = value ;
+		mSlots[i].used = true ;
+		++mSize ;
+
+		return true ;
+	}
+
+	// Single valued use: replaces the value of the key if any, adds the key otherwise.
+
+	void set(const Key& key,const Value& value)
+	{
+		int32_t i = locate(key) ;
+
+		if(i >= 0)
+			mSlots[i].value = value ;
+		else
+			insert(key,value) ;
+	}
+
+	// Returns the first value found for that key.
+
+	bool find(const Key& key,Value& value) const
+	{
+		int32_t i = locate(key) ;
+
+		if(i < 0)
+			return false ;
+
+		value = mSlots[i].value ;
+		return true ;
+	}
+
+	// Appends all values of that key. Returns false if none is found.
+
+	bool findAll(const Key& key,std::vector<Value>& values) const
+	{
+		bool found = false ;
+
+		if(mSize > 0)
+			for(uint32_t i=home(key);mSlots[i].used;i=next(i))
+				if(mSlots[i].key == key)
+				{
+					values.push_back(mSlots[i].value) ;
+					found = true ;
+				}
+
+		return found ;
+	}
+
+	// Removes the key/value pair.
+
+	bool erase(const Key& key,const Value& value)
+	{
+		if(mSize > 0)
+			for(uint32_t i=home(key);mSlots[i].used;i=next(i))
+				if(mSlots[i].key == key && mSlots[i].value == value)
+				{
+					removeSlot(i) ;
+					return true ;
+				}
+
+		return false ;
+	}
+
+	// Removes all values of that key. Returns the number of removed pairs.
+
+	uint32_t erase(const Key& key)
+	{
+		uint32_t n = 0 ;
+		int32_t i ;
+
+		while((i = locate(key)) >= 0)
+		{
+			removeSlot(i) ;
+			++n ;
+		}
+		return n ;
+	}
+
+	// Calls f(key,value) on all entries, in no particular order. The table must not be modified meanwhile.
+
+	template<class F> void forEach(F& f) const
+	{
+		for(uint32_t i=0;i<mSlots.size();++i)
+			if(mSlots[i].used)
+				f(mSlots[i].key,mSlots[i].value) ;
+	}
+
+private:
+	static const uint32_t INITIAL_SIZE = 64 ;	// needs to be a power of 2
+
+	struct Slot
+	{
+		Slot() : used(false) {}
+
+		Key key ;
+		Value value ;
+		bool used ;
+	};
+
+	uint32_t home(const Key& key) const
+	{
+		uint64_t h ;
+		memcpy(&h,key.toByteArray(),sizeof(h)) ;
+
+		return h & (mSlots.size()-1) ;
+	}
+	uint32_t next(uint32_t i) const { return (i+1) & (mSlots.size()-1) ; }
+
+	int32_t locate(const Key& key) const
+	{
+		if(mSize > 0)
+			for(uint32_t i=home(key);mSlots[i].used;i=next(i))
+				if(mSlots[i].key == key)
+					return i ;
+
+		return -1 ;
+	}
+
+	void removeSlot(uint32_t i)
+	{
+		// Move back the entries that follow in the probe sequence, when the free slot lies between their home
+		// position and their current position.
+
+		uint32_t j = i ;
+
+		for(j=next(j);mSlots[j].used;j=next(j))
+		{
+			uint32_t k = home(mSlots[j].key) ;
+
+			bool k_outside = (i <= j) ? (k <= i || k > j) : (k <= i && k > j) ;
+
+			if(k_outside)
+			{
+				mSlots[i] = mSlots[j] ;
+				i = j ;
+			}
+		}
+		mSlots[i].used = false ;
+		--mSize ;
+	}
+
+	void resize(uint32_t new_size)
+	{
+		std::vector<Slot> old_slots ;
+		old_slots.swap(mSlots) ;
+
+		mSlots.resize(new_size) ;
+
+		for(uint32_t i=0;i<old_slots.size();++i)
+			if(old_slots[i].used)
+			{
+				uint32_t j = home(old_slots[i].key) ;
+
+				while(mSlots[j].used)
+					j = next(j) ;
+
+				mSlots[j] = old_slots[i] ;
+			}
+	}
+
+	std::vector<Slot> mSlots ;
+	uint32_t mSize ;
+};
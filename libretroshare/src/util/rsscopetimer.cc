@@ -45,7 +45,7 @@ double RsScopeTimer::currentTime()
 {
 	timeval tv ;
 	gettimeofday(&tv,NULL) ;
-	return (tv.tv_sec % 10000) + tv.tv_usec/1000000.0f ;	// the %1000 is here to allow double precision to cover the decimals.
+	return (tv.tv_sec % 10000) + tv.tv_usec/1000000.0 ;	// the %1000 is here to allow double precision to cover the decimals.
 }
 
 void RsScopeTimer::start()
@@ -29,6 +29,7 @@
 #include <errno.h>    // for errno
 #include <iostream>
 #include <time.h>
+#include <sys/time.h>  // for gettimeofday()
 
 #ifdef __APPLE__
 int __attribute__((weak)) pthread_setname_np(const char *__buf) ;
@@ -292,6 +293,52 @@ void RsQueueThread::data_tick()
     usleep(mLastSleep * 1000); // mLastSleep msec
 }
 
+RsWakeupSignal::RsWakeupSignal()
+    : mSignalled(false)
+{
+    pthread_mutex_init(&mMtx, NULL);
+    pthread_cond_init(&mCond, NULL);
+}
+
+RsWakeupSignal::~RsWakeupSignal()
+{
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mMtx);
+}
+
+void RsWakeupSignal::wakeup()
+{
+    pthread_mutex_lock(&mMtx);
+    mSignalled = true ;
+    pthread_cond_signal(&mCond);
+    pthread_mutex_unlock(&mMtx);
+}
+
+bool RsWakeupSignal::wait(uint32_t max_wait_ms)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    uint64_t deadline_us = (uint64_t)now.tv_sec * 1000000 + now.tv_usec + (uint64_t)max_wait_ms * 1000 ;
+
+    struct timespec deadline;
+    deadline.tv_sec  = deadline_us / 1000000 ;
+    deadline.tv_nsec = (deadline_us % 1000000) * 1000 ;
+
+    pthread_mutex_lock(&mMtx);
+
+    while(!mSignalled)
+        if(pthread_cond_timedwait(&mCond, &mMtx, &deadline) == ETIMEDOUT)
+            break ;
+
+    bool signalled = mSignalled ;
+    mSignalled = false ;
+
+    pthread_mutex_unlock(&mMtx);
+
+    return signalled ;
+}
+
 void RsMutex::unlock()
 { 
 #ifdef RSTHREAD_SELF_LOCKING_GUARD
@@ -234,6 +234,26 @@ private:
     RsSemStruct *s ;
 };
 
+// Auto-reset wake-up signal. A thread blocks in wait() until another thread
+// calls wakeup() or the timeout expires. Wake-ups posted while nobody waits are
+// remembered, so that the next wait() returns immediately.
+class RsWakeupSignal
+{
+public:
+    RsWakeupSignal() ;
+    ~RsWakeupSignal() ;
+
+    void wakeup() ;
+
+    // Returns true if woken up by wakeup(), false if the timeout expired.
+    bool wait(uint32_t max_wait_ms) ;
+
+private:
+    pthread_mutex_t mMtx ;
+    pthread_cond_t  mCond ;
+    bool mSignalled ;
+};
+
 class RsThread;
 
 /* to create a thread! */
@@ -388,6 +388,8 @@ TransfersDialog::TransfersDialog(QWidget *parent)
 	connect(chunkRandomAct, SIGNAL(triggered()), this, SLOT(chunkRandom()));
 	chunkProgressiveAct = new QAction(QIcon(IMAGE_PRIORITYAUTO), tr("Progressive"), this);
 	connect(chunkProgressiveAct, SIGNAL(triggered()), this, SLOT(chunkProgressive()));
+	chunkRarestFirstAct = new QAction(QIcon(IMAGE_PRIORITYAUTO), tr("Rarest first"), this);
+	connect(chunkRarestFirstAct, SIGNAL(triggered()), this, SLOT(chunkRarestFirst()));
 	playAct = new QAction(QIcon(IMAGE_PLAY), tr( "Play" ), this );
 	connect( playAct , SIGNAL( triggered() ), this, SLOT( dlOpenFile() ) );
 	renameFileAct = new QAction(QIcon(IMAGE_RENAMEFILE), tr("Rename file..."), this);
@@ -616,6 +618,7 @@ void TransfersDialog::downloadListCustomPopupMenu( QPoint /*point*/ )
 	chunkMenu.addAction(chunkStreamingAct);
 	chunkMenu.addAction(chunkProgressiveAct);
 	chunkMenu.addAction(chunkRandomAct);
+	chunkMenu.addAction(chunkRarestFirstAct);
 
 	QMenu collectionMenu(tr("Collection"), this);
 	collectionMenu.setIcon(QIcon(IMAGE_LIBRARY));
@@ -1910,6 +1913,10 @@ void TransfersDialog::chunkProgressive()
 {
 	setChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE) ;
 }
+void TransfersDialog::chunkRarestFirst()
+{
+	setChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST) ;
+}
 void TransfersDialog::setChunkStrategy(FileChunksInfo::ChunkStrategy s)
 {
     std::set<RsFileHash> items;
@@ -135,6 +135,7 @@ private slots:
 
     void chunkRandom();
     void chunkProgressive();
+    void chunkRarestFirst();
     void chunkStreaming();
 
     void showDetailsDialog();
@@ -205,6 +206,7 @@ private:
     QAction *queueBottomAct;
     QAction *chunkRandomAct;
     QAction *chunkProgressiveAct;
+    QAction *chunkRarestFirstAct;
     QAction *chunkStreamingAct;
     QAction *detailsFileAct;
     QAction *renameFileAct;
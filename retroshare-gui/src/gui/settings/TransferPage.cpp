@@ -139,6 +139,7 @@ void TransferPage::load()
     case FileChunksInfo::CHUNK_STRATEGY_STREAMING: whileBlocking(ui._defaultStrategy_CB)->setCurrentIndex(0) ; break ;
     case FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE: whileBlocking(ui._defaultStrategy_CB)->setCurrentIndex(1) ; break ;
     case FileChunksInfo::CHUNK_STRATEGY_RANDOM: whileBlocking(ui._defaultStrategy_CB)->setCurrentIndex(2) ; break ;
+    case FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST: whileBlocking(ui._defaultStrategy_CB)->setCurrentIndex(3) ; break ;
     }
 
     switch(rsFiles->defaultEncryptionPolicy())
@@ -197,6 +198,9 @@ void TransferPage::updateDefaultStrategy(int i)
 
 		case 1: rsFiles->setDefaultChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE) ;
 				  break ;
+
+		case 3: rsFiles->setDefaultChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST) ;
+				  break ;
 		default: ;
 	}
 }
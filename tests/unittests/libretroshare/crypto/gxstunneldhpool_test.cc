@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+// from libretroshare
+
+#include "gxstunnel/gxstunneldhpool.h"
+
+static const BIGNUM *publicKey(DH *dh)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
+    return dh->pub_key ;
+#else
+    const BIGNUM *pub = NULL ;
+    DH_get0_key(dh,&pub,NULL) ;
+    return pub ;
+#endif
+}
+
+static bool keysAgree(DH *dh1,DH *dh2)
+{
+    std::vector<unsigned char> s1(DH_size(dh1)), s2(DH_size(dh2)) ;
+
+    return DH_compute_key(&s1[0],publicKey(dh2),dh1) == DH_size(dh1)
+        && DH_compute_key(&s2[0],publicKey(dh1),dh2) == DH_size(dh2)
+        && s1 == s2 ;
+}
+
+// Waits until the pool holds the given number of keys, for at most 10 s.
+
+static bool waitForKeys(GxsTunnelDHKeyPool& pool,uint32_t n)
+{
+    for(int i=0;i<200 && pool.readyKeys() != n;++i)
+        usleep(50*1000) ;
+
+    return pool.readyKeys() == n ;
+}
+
+// Stops the pool thread when the test returns, including on a failed assertion.
+
+class DHKeyPoolStopper
+{
+public:
+    explicit DHKeyPoolStopper(GxsTunnelDHKeyPool& pool) : mPool(pool) {}
+    ~DHKeyPoolStopper() { mPool.fullstop() ; }
+
+private:
+    GxsTunnelDHKeyPool& mPool ;
+};
+
+TEST(libretroshare_crypto, GxsTunnelDHKeyPool)
+{
+    GxsTunnelDHKeyPool pool(4) ;
+
+    // not started: keys are generated on demand
+
+    DH *dh1 = pool.takeKey() ;
+    DH *dh2 = pool.takeKey() ;
+
+    ASSERT_TRUE(dh1 != NULL) ;
+    ASSERT_TRUE(dh2 != NULL) ;
+    EXPECT_TRUE(keysAgree(dh1,dh2)) ;
+
+    DH_free(dh1) ;
+    DH_free(dh2) ;
+
+    EXPECT_EQ(0u,pool.readyKeys()) ;
+
+    // the pool thread keeps keys ready
+
+    pool.start("dh pool test") ;
+    DHKeyPoolStopper stopper(pool) ;
+
+    ASSERT_TRUE(waitForKeys(pool,4)) ;
+
+    DH *dh = pool.takeKey() ;
+    ASSERT_TRUE(dh != NULL) ;
+    DH_free(dh) ;
+
+    // the key taken is replaced
+
+    ASSERT_TRUE(waitForKeys(pool,4)) ;
+
+    std::vector<DH*> keys ;
+    for(int i=0;i<6;++i)
+    {
+        keys.push_back(pool.takeKey()) ;
+        ASSERT_TRUE(keys.back() != NULL) ;
+    }
+    for(int i=1;i<6;++i)
+        EXPECT_NE(0,BN_cmp(publicKey(keys[0]),publicKey(keys[i]))) ;
+    EXPECT_TRUE(keysAgree(keys[0],keys[5])) ;
+
+    for(int i=0;i<6;++i)
+        DH_free(keys[i]) ;
+
+    pool.setPoolSize(0) ;
+    EXPECT_EQ(0u,pool.poolSize()) ;
+    EXPECT_TRUE(waitForKeys(pool,0)) ;
+
+    DH *dh3 = pool.takeKey() ;
+    EXPECT_TRUE(dh3 != NULL) ;
+    DH_free(dh3) ;
+}
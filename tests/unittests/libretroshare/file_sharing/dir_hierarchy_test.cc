@@ -0,0 +1,260 @@
+/*
+ * libretroshare/src/tests/file_sharing: dir_hierarchy_test.cc
+ *
+ * RetroShare C++ Internal directory hierarchy tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+
+#include "file_sharing/dir_hierarchy.h"
+#include "retroshare/rsexpr.h"
+#include "util/rsrandom.h"
+
+static const char *NAME_WORDS[] = { "Beatles", "concert", "holiday", "Report", "mp3", "avi", "IMG", "draft", "Ab" } ;
+static const uint32_t NAME_WORDS_COUNT = sizeof(NAME_WORDS)/sizeof(NAME_WORDS[0]) ;
+
+static std::string random_name()
+{
+	std::string name ;
+	uint32_t n = 1 + RSRandom::random_u32()%3 ;
+
+	for(uint32_t i=0;i<n;++i)
+		name += std::string(NAME_WORDS[RSRandom::random_u32()%NAME_WORDS_COUNT]) + "_" ;
+
+	return name + RsFileHash::random().toStdString().substr(0,6) ;
+}
+
+// Reference implementation: linear scan over all hashed files.
+
+static std::set<std::string> linear_search(InternalFileHierarchyStorage& storage,const std::list<std::string>& terms)
+{
+	std::set<std::string> res ;
+
+	for(uint32_t i=0;i<storage.mNodes.size();++i)
+	{
+		if(storage.mNodes[i] == NULL || storage.mNodes[i]->type() != InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
+			continue ;
+
+		const InternalFileHierarchyStorage::FileEntry *fe = storage.getFileEntry(i) ;
+
+		if(fe->file_hash.isNull())
+			continue ;
+
+		for(std::list<std::string>::const_iterator it(terms.begin());it!=terms.end();++it)
+			if(fe->file_name.end() != std::search(fe->file_name.begin(),fe->file_name.end(),it->begin(),it->end(),RsRegularExpression::CompareCharIC()))
+			{
+				res.insert(fe->file_name) ;
+				break ;
+			}
+	}
+	return res ;
+}
+
+static std::set<std::string> to_names(InternalFileHierarchyStorage& storage,const std::list<DirectoryStorage::EntryIndex>& results)
+{
+	std::set<std::string> res ;
+
+	for(std::list<DirectoryStorage::EntryIndex>::const_iterator it(results.begin());it!=results.end();++it)
+	{
+		const InternalFileHierarchyStorage::FileEntry *fe = storage.getFileEntry(*it) ;
+		EXPECT_TRUE(fe != NULL) ;
+
+		if(fe != NULL)
+			res.insert(fe->file_name) ;
+	}
+	EXPECT_EQ(res.size(), results.size()) ;
+	return res ;
+}
+
+static void check_terms(InternalFileHierarchyStorage& storage,const std::list<std::string>& terms)
+{
+	std::list<DirectoryStorage::EntryIndex> results ;
+	storage.searchTerms(terms,results) ;
+
+	EXPECT_EQ(linear_search(storage,terms), to_names(storage,results)) ;
+}
+
+TEST(libretroshare_file_sharing, DirHierarchyNameIndex)
+{
+	InternalFileHierarchyStorage storage ;
+	std::map<std::string,DirectoryStorage::FileTS> files ;
+
+	// several rounds of adding/removing files, so that the index gets stale entries and is rebuilt.
+
+	for(uint32_t round=0;round<20;++round)
+	{
+		for(std::map<std::string,DirectoryStorage::FileTS>::iterator it(files.begin());it!=files.end();)
+			if(RSRandom::random_u32()%2)
+			{
+				std::map<std::string,DirectoryStorage::FileTS>::iterator tmp(it) ;
+				++tmp ;
+				files.erase(it) ;
+				it = tmp ;
+			}
+			else
+				++it ;
+
+		for(uint32_t i=0;i<500;++i)
+		{
+			DirectoryStorage::FileTS ts ;
+			ts.size = RSRandom::random_u32()%100000 ;
+			ts.modtime = 0 ;
+			files[random_name()] = ts ;
+		}
+
+		std::map<std::string,DirectoryStorage::FileTS> new_files ;
+		EXPECT_TRUE(storage.updateSubFilesList(0,files,new_files)) ;
+
+		// hash most of the files. Files without a hash are not searchable.
+
+		const InternalFileHierarchyStorage::DirEntry *de = storage.getDirEntry(0) ;
+		ASSERT_TRUE(de != NULL) ;
+
+		for(uint32_t i=0;i<de->subfiles.size();++i)
+			if(storage.getFileEntry(de->subfiles[i])->file_hash.isNull() && RSRandom::random_u32()%10 > 0)
+				storage.updateHash(de->subfiles[i],RsFileHash::random()) ;
+
+		// renaming, as done when updating a remote directory
+
+		const InternalFileHierarchyStorage::FileEntry *fe = storage.getFileEntry(de->subfiles[0]) ;
+		std::string new_name = "renamed_" + fe->file_name ;
+		files[new_name] = files[fe->file_name] ;
+		files.erase(fe->file_name) ;
+		storage.updateFile(de->subfiles[0],fe->file_hash,new_name,fe->file_size,fe->file_modtime) ;
+
+		std::list<std::string> terms ;
+
+		terms.push_back("beat") ;			check_terms(storage,terms) ;
+		terms.push_back("REPORT") ;			check_terms(storage,terms) ;
+		terms.clear() ;
+		terms.push_back("renamed") ;		check_terms(storage,terms) ;
+		terms.push_back("ab") ;				check_terms(storage,terms) ;	// too short for the index
+		terms.clear() ;
+		terms.push_back("nothing_like_this") ; check_terms(storage,terms) ;
+		terms.clear() ;
+		terms.push_back(new_name.substr(new_name.length()-6)) ; check_terms(storage,terms) ;
+	}
+
+	// bool expressions restricted by the name use the index too
+
+	std::list<std::string> strings ;
+	strings.push_back("concert") ;
+	strings.push_back("holiday") ;
+
+	RsRegularExpression::Expression *exp = new RsRegularExpression::CompoundExpression(RsRegularExpression::AndOp,
+	                new RsRegularExpression::NameExpression(RsRegularExpression::ContainsAllStrings,strings,true),
+	                new RsRegularExpression::SizeExpression(RsRegularExpression::Smaller,50000)) ;	// i.e. 50000 < size
+
+	std::list<std::string> name_strings ;
+	EXPECT_TRUE(exp->nameSubstrings(name_strings)) ;
+
+	std::list<DirectoryStorage::EntryIndex> results ;
+	storage.searchBoolExp(exp,results) ;
+
+	std::set<std::string> expected ;
+
+	for(uint32_t i=0;i<storage.mNodes.size();++i)
+	{
+		if(storage.mNodes[i] == NULL || storage.mNodes[i]->type() != InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
+			continue ;
+
+		const InternalFileHierarchyStorage::FileEntry *fe = storage.getFileEntry(i) ;
+
+		if(!fe->file_hash.isNull() && fe->file_size > 50000
+		        && fe->file_name.find("concert") != std::string::npos && fe->file_name.find("holiday") != std::string::npos)
+			expected.insert(fe->file_name) ;
+	}
+	EXPECT_EQ(expected, to_names(storage,results)) ;
+
+	delete exp ;
+}
+
+TEST(libretroshare_file_sharing, DirHierarchyNameIndexOrphans)
+{
+	InternalFileHierarchyStorage storage ;
+	std::map<std::string,DirectoryStorage::FileTS> files ;
+
+	for(uint32_t i=0;i<50;++i)
+	{
+		DirectoryStorage::FileTS ts ;
+		ts.size = 1000 ;
+		ts.modtime = 0 ;
+		files[random_name()] = ts ;
+	}
+
+	std::map<std::string,DirectoryStorage::FileTS> new_files ;
+	EXPECT_TRUE(storage.updateSubFilesList(0,files,new_files)) ;
+
+	InternalFileHierarchyStorage::DirEntry *de = static_cast<InternalFileHierarchyStorage::DirEntry*>(storage.mNodes[0]) ;
+
+	for(uint32_t i=0;i<de->subfiles.size();++i)
+		storage.updateHash(de->subfiles[i],RsFileHash::random()) ;
+
+	// the first search builds the index
+
+	const std::string orphan_name = storage.getFileEntry(de->subfiles[0])->file_name ;
+	std::list<std::string> terms ;
+	terms.push_back(orphan_name) ;
+	check_terms(storage,terms) ;
+
+	std::list<DirectoryStorage::EntryIndex> results ;
+	storage.searchTerms(terms,results) ;
+	EXPECT_EQ(1u, results.size()) ;
+
+	// a file that is not referenced by its directory anymore is removed by the consistency check, and cannot be found
+
+	de->subfiles.erase(de->subfiles.begin()) ;
+
+	std::string error_string ;
+	EXPECT_FALSE(storage.check(error_string)) ;
+
+	SharedDirStats stats ;
+	storage.getStatistics(stats) ;
+	EXPECT_EQ(49u, stats.total_number_of_files) ;
+	EXPECT_EQ(49000u, stats.total_shared_size) ;
+
+	results.clear() ;
+	storage.searchTerms(terms,results) ;
+	EXPECT_TRUE(results.empty()) ;
+
+	// the freed entry is re-used for a new file
+
+	files.erase(orphan_name) ;
+	DirectoryStorage::FileTS ts ;
+	ts.size = 1000 ;
+	ts.modtime = 0 ;
+	files["Beatles_new_file"] = ts ;
+	new_files.clear() ;
+	EXPECT_TRUE(storage.updateSubFilesList(0,files,new_files)) ;
+
+	for(uint32_t i=0;i<de->subfiles.size();++i)
+		if(storage.getFileEntry(de->subfiles[i])->file_hash.isNull())
+			storage.updateHash(de->subfiles[i],RsFileHash::random()) ;
+
+	EXPECT_TRUE(storage.check(error_string)) ;
+	check_terms(storage,terms) ;
+
+	terms.clear() ;
+	terms.push_back("beatles") ;
+	check_terms(storage,terms) ;
+}
@@ -0,0 +1,516 @@
+/*
+ * libretroshare/src/tests/file_sharing: dir_storage_test.cc
+ *
+ * RetroShare C++ file list saving, loading and unloading tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "file_sharing/dir_hierarchy.h"
+#include "file_sharing/directory_storage.h"
+#include "file_sharing/filelist_io.h"
+#include "pqi/authssl.h"
+#include "util/rsrandom.h"
+
+// File lists are encrypted with the node's key. This AuthSSL only copies the data, so that file lists can be
+// saved and loaded without a key.
+
+class TestAuthSSL: public AuthSSL
+{
+public:
+	TestAuthSSL() : mOwnId(RsPeerId::random()) {}
+
+	virtual bool encrypt(void *&out, int &outlen, const void *in, int inlen, const RsPeerId&) { return copy(out,outlen,in,inlen) ; }
+	virtual bool decrypt(void *&out, int &outlen, const void *in, int inlen) { return copy(out,outlen,in,inlen) ; }
+	virtual const RsPeerId& OwnId() { return mOwnId ; }
+
+	virtual bool validateOwnCertificate(X509 *, EVP_PKEY *) { return true ; }
+	virtual bool active() { return true ; }
+	virtual int InitAuth(const char *, const char *, const char *, std::string) { return 1 ; }
+	virtual bool CloseAuth() { return true ; }
+	virtual std::string getOwnLocation() { return std::string() ; }
+	virtual std::string SaveOwnCertificateToString() { return std::string() ; }
+	virtual bool SignData(std::string, std::string &) { return false ; }
+	virtual bool SignData(const void *, const uint32_t, std::string &) { return false ; }
+	virtual bool SignDataBin(std::string, unsigned char*, unsigned int*) { return false ; }
+	virtual bool SignDataBin(const void*, uint32_t, unsigned char*, unsigned int*) { return false ; }
+	virtual bool VerifyOwnSignBin(const void*, uint32_t, unsigned char*, unsigned int) { return false ; }
+	virtual bool VerifySignBin(const void *, const uint32_t, unsigned char *, unsigned int, const RsPeerId&) { return false ; }
+	virtual X509* SignX509ReqWithGPG(X509_REQ *, long) { return NULL ; }
+	virtual bool AuthX509WithGPG(X509 *,uint32_t&) { return false ; }
+	virtual int VerifyX509Callback(int, X509_STORE_CTX *) { return 0 ; }
+	virtual bool ValidateCertificate(X509 *, RsPeerId&) { return false ; }
+	virtual SSL_CTX *getCTX() { return NULL ; }
+	virtual void setCurrentConnectionAttemptInfo(const RsPgpId&,const RsPeerId&,const std::string&) {}
+	virtual void getCurrentConnectionAttemptInfo(RsPgpId&, RsPeerId&, std::string&) {}
+	virtual bool FailedCertificate(X509 *, const RsPgpId&,const RsPeerId&,const std::string&,const struct sockaddr_storage &, bool) { return false ; }
+	virtual bool CheckCertificate(const RsPeerId&, X509 *) { return false ; }
+
+private:
+	static bool copy(void *&out, int &outlen, const void *in, int inlen)
+	{
+		out = malloc(inlen) ;
+		memcpy(out,in,inlen) ;
+		outlen = inlen ;
+		return true ;
+	}
+
+	RsPeerId mOwnId ;
+};
+
+static std::string tempFileName()
+{
+	char path[] = "/tmp/dir_storage_testXXXXXX" ;
+	int fd = mkstemp(path) ;
+	EXPECT_NE(-1,fd) ;
+	close(fd) ;
+
+	return path ;
+}
+
+// Makes a few directories with files in them, some of them hashed. Removing a directory leaves free nodes.
+
+static void fillHierarchy(InternalFileHierarchyStorage& storage)
+{
+	std::set<std::string> subdirs ;
+	subdirs.insert("music") ;
+	subdirs.insert("pictures") ;
+	subdirs.insert("removed") ;
+
+	RsFileHash salt = RsFileHash::random() ;
+	ASSERT_TRUE(storage.updateSubDirectoryList(0,subdirs,salt)) ;
+
+	const InternalFileHierarchyStorage::DirEntry *root = storage.getDirEntry(0) ;
+	ASSERT_TRUE(root != NULL) ;
+	ASSERT_EQ(3u,root->subdirs.size()) ;
+
+	for(uint32_t i=0;i<root->subdirs.size();++i)
+	{
+		std::map<std::string,DirectoryStorage::FileTS> files, new_files ;
+
+		for(uint32_t j=0;j<10;++j)
+		{
+			DirectoryStorage::FileTS ts ;
+			ts.size = RSRandom::random_u32() ;
+			ts.modtime = RSRandom::random_u32() ;
+			files[RsFileHash::random().toStdString().substr(0,10) + ".ogg"] = ts ;
+		}
+		ASSERT_TRUE(storage.updateSubFilesList(root->subdirs[i],files,new_files)) ;
+
+		const InternalFileHierarchyStorage::DirEntry *de = storage.getDirEntry(root->subdirs[i]) ;
+
+		for(uint32_t j=0;j<de->subfiles.size();j+=2)
+			storage.updateHash(de->subfiles[j],RsFileHash::random()) ;
+
+		time_t ts = 1000+i ;
+		storage.setTS(root->subdirs[i],ts,&InternalFileHierarchyStorage::DirEntry::dir_update_time) ;
+	}
+
+	subdirs.erase("removed") ;
+	ASSERT_TRUE(storage.updateSubDirectoryList(0,subdirs,salt)) ;
+}
+
+static void compareHierarchies(const InternalFileHierarchyStorage& s1,const InternalFileHierarchyStorage& s2)
+{
+	ASSERT_EQ(s1.mNodes.size(),s2.mNodes.size()) ;
+
+	for(uint32_t i=0;i<s1.mNodes.size();++i)
+	{
+		if(s1.mNodes[i] == NULL)
+		{
+			EXPECT_TRUE(s2.mNodes[i] == NULL) ;
+			continue ;
+		}
+		ASSERT_TRUE(s2.mNodes[i] != NULL) ;
+		ASSERT_EQ(s1.mNodes[i]->type(),s2.mNodes[i]->type()) ;
+		EXPECT_EQ(s1.mNodes[i]->parent_index,s2.mNodes[i]->parent_index) ;
+		EXPECT_EQ(s1.mNodes[i]->row,s2.mNodes[i]->row) ;
+
+		if(s1.mNodes[i]->type() == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
+		{
+			const InternalFileHierarchyStorage::FileEntry *f1 = s1.getFileEntry(i) ;
+			const InternalFileHierarchyStorage::FileEntry *f2 = s2.getFileEntry(i) ;
+
+			EXPECT_EQ(f1->file_name,f2->file_name) ;
+			EXPECT_EQ(f1->file_size,f2->file_size) ;
+			EXPECT_EQ(f1->file_hash,f2->file_hash) ;
+			EXPECT_EQ(f1->file_modtime,f2->file_modtime) ;
+		}
+		else
+		{
+			const InternalFileHierarchyStorage::DirEntry *d1 = s1.getDirEntry(i) ;
+			const InternalFileHierarchyStorage::DirEntry *d2 = s2.getDirEntry(i) ;
+
+			EXPECT_EQ(d1->dir_name,d2->dir_name) ;
+			EXPECT_EQ(d1->dir_parent_path,d2->dir_parent_path) ;
+			EXPECT_EQ(d1->dir_hash,d2->dir_hash) ;
+			EXPECT_EQ(d1->dir_modtime,d2->dir_modtime) ;
+			EXPECT_EQ(d1->dir_update_time,d2->dir_update_time) ;
+			EXPECT_EQ(d1->dir_most_recent_time,d2->dir_most_recent_time) ;
+			EXPECT_EQ(d1->subdirs,d2->subdirs) ;
+			EXPECT_EQ(d1->subfiles,d2->subfiles) ;
+		}
+	}
+
+	SharedDirStats st1, st2 ;
+	s1.getStatistics(st1) ;
+	s2.getStatistics(st2) ;
+	EXPECT_EQ(st1.total_number_of_files,st2.total_number_of_files) ;
+	EXPECT_EQ(st1.total_shared_size,st2.total_shared_size) ;
+}
+
+// Writes the hierarchy in the format used before the compact format, one tagged section per node.
+
+static bool saveVersion1(const InternalFileHierarchyStorage& storage,const std::string& fname)
+{
+	unsigned char *buffer = NULL, *section = NULL ;
+	uint32_t buffer_size = 0, buffer_offset = 0, section_size = 0 ;
+	bool ok = true ;
+
+	ok = ok && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,(uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001) ;
+	ok = ok && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t) storage.mNodes.size()) ;
+
+	for(uint32_t i=0;i<storage.mNodes.size() && ok;++i)
+	{
+		if(storage.mNodes[i] == NULL)
+			continue ;
+
+		uint32_t section_offset = 0 ;
+
+		ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_PARENT_INDEX,(uint32_t)storage.mNodes[i]->parent_index) ;
+		ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_ROW         ,(uint32_t)storage.mNodes[i]->row) ;
+		ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX ,i) ;
+
+		if(storage.mNodes[i]->type() == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
+		{
+			const InternalFileHierarchyStorage::FileEntry *fe = storage.getFileEntry(i) ;
+
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_FILE_NAME     ,fe->file_name) ;
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_FILE_SIZE     ,fe->file_size) ;
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,fe->file_hash) ;
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,(uint32_t)fe->file_modtime) ;
+
+			ok = ok && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_FILE_ENTRY,section,section_offset) ;
+		}
+		else
+		{
+			const InternalFileHierarchyStorage::DirEntry *de = storage.getDirEntry(i) ;
+
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_FILE_NAME      ,de->dir_name) ;
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_DIR_HASH       ,de->dir_hash) ;
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,de->dir_parent_path) ;
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_MODIF_TS       ,(uint32_t)de->dir_modtime) ;
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_UPDATE_TS      ,(uint32_t)de->dir_update_time) ;
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,(uint32_t)de->dir_most_recent_time) ;
+
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de->subdirs.size()) ;
+			for(uint32_t j=0;j<de->subdirs.size();++j)
+				ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de->subdirs[j]) ;
+
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de->subfiles.size()) ;
+			for(uint32_t j=0;j<de->subfiles.size();++j)
+				ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de->subfiles[j]) ;
+
+			ok = ok && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIR_ENTRY,section,section_offset) ;
+		}
+	}
+
+	ok = ok && FileListIO::saveEncryptedDataToFile(fname,buffer,buffer_offset) ;
+
+	free(buffer) ;
+	free(section) ;
+	return ok ;
+}
+
+class DirStorageTest: public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		AuthSSL::setAuthSSL_debug(&mAuthSSL) ;
+		mPath = tempFileName() ;
+	}
+	virtual void TearDown()
+	{
+		AuthSSL::setAuthSSL_debug(NULL) ;
+		remove(mPath.c_str()) ;
+	}
+
+	TestAuthSSL mAuthSSL ;
+	std::string mPath ;
+};
+
+TEST_F(DirStorageTest, SaveLoad)
+{
+	InternalFileHierarchyStorage storage ;
+	fillHierarchy(storage) ;
+	ASSERT_TRUE(storage.save(mPath)) ;
+
+	InternalFileHierarchyStorage loaded ;
+	ASSERT_TRUE(loaded.load(mPath)) ;
+	compareHierarchies(storage,loaded) ;
+
+	// A truncated file is refused, and leaves an empty hierarchy.
+
+	ASSERT_EQ(0,truncate(mPath.c_str(),100)) ;
+	EXPECT_FALSE(loaded.load(mPath)) ;
+	EXPECT_EQ(1u,loaded.mNodes.size()) ;
+}
+
+TEST_F(DirStorageTest, LoadVersion1)
+{
+	InternalFileHierarchyStorage storage ;
+	fillHierarchy(storage) ;
+	ASSERT_TRUE(saveVersion1(storage,mPath)) ;
+
+	InternalFileHierarchyStorage loaded ;
+	ASSERT_TRUE(loaded.load(mPath)) ;
+	compareHierarchies(storage,loaded) ;
+
+	// Saving again writes the compact format, which gives the same hierarchy.
+
+	ASSERT_TRUE(loaded.save(mPath)) ;
+
+	InternalFileHierarchyStorage reloaded ;
+	ASSERT_TRUE(reloaded.load(mPath)) ;
+	compareHierarchies(storage,reloaded) ;
+}
+
+// Files that are not hashed yet are never put in the hash table, whatever the way they are added. They would all have
+// the same (null) key. Looking for the null hash finds them otherwise.
+
+static void checkUnhashedFiles(InternalFileHierarchyStorage& storage,const RsFileHash& hash)
+{
+	DirectoryStorage::EntryIndex indx ;
+
+	EXPECT_FALSE(storage.searchHash(RsFileHash(),indx)) ;
+	EXPECT_TRUE(storage.searchHash(hash,indx)) ;
+}
+
+TEST_F(DirStorageTest, UnhashedFiles)
+{
+	InternalFileHierarchyStorage storage ;
+	std::map<std::string,DirectoryStorage::FileTS> files, new_files ;
+
+	for(uint32_t i=0;i<20000;++i)
+	{
+		DirectoryStorage::FileTS ts ;
+		ts.size = 1000 ;
+		ts.modtime = 100 ;
+		files[RsFileHash::random().toStdString()] = ts ;
+	}
+	ASSERT_TRUE(storage.updateSubFilesList(0,files,new_files)) ;
+
+	const InternalFileHierarchyStorage::DirEntry *root = storage.getDirEntry(0) ;
+	ASSERT_TRUE(root != NULL) ;
+	ASSERT_EQ(20000u,root->subfiles.size()) ;
+
+	RsFileHash hash = RsFileHash::random() ;
+	storage.updateHash(root->subfiles[0],hash) ;
+	storage.updateHash(root->subfiles[1],RsFileHash::random()) ;
+	storage.updateHash(root->subfiles[1],RsFileHash()) ;	// back to unhashed
+
+	checkUnhashedFiles(storage,hash) ;
+
+	// compact format
+
+	ASSERT_TRUE(storage.save(mPath)) ;
+
+	InternalFileHierarchyStorage loaded ;
+	ASSERT_TRUE(loaded.load(mPath)) ;
+	checkUnhashedFiles(loaded,hash) ;
+
+	// format of the previous versions
+
+	ASSERT_TRUE(saveVersion1(storage,mPath)) ;
+
+	InternalFileHierarchyStorage loaded1 ;
+	ASSERT_TRUE(loaded1.load(mPath)) ;
+	checkUnhashedFiles(loaded1,hash) ;
+}
+
+class TestDirectoryStorage: public RemoteDirectoryStorage
+{
+public:
+	TestDirectoryStorage(const std::string& fname) : RemoteDirectoryStorage(RsPeerId::random(),fname) {}
+
+	bool loaded() const { RS_STACK_MUTEX(mDirStorageMtx) ; return mLoaded ; }
+	const InternalFileHierarchyStorage& hierarchy() const { return *mFileHierarchy ; }
+
+	void setHash(DirectoryStorage::EntryIndex indx,const RsFileHash& hash)
+	{
+		RS_STACK_MUTEX(mDirStorageMtx) ;
+		mFileHierarchy->updateHash(indx,hash) ;
+		mChanged = true ;
+	}
+
+	// pretends that the last access is old
+	void setIdle() { RS_STACK_MUTEX(mDirStorageMtx) ; mLastAccessTime = time(NULL) - 1000 ; }
+};
+
+TEST_F(DirStorageTest, UnloadReload)
+{
+	remove(mPath.c_str()) ;
+	TestDirectoryStorage storage(mPath) ;
+
+	std::set<std::string> subdirs ;
+	subdirs.insert("music") ;
+	ASSERT_TRUE(storage.updateSubDirectoryList(storage.root(),subdirs,RsFileHash::random())) ;
+
+	DirectoryStorage::EntryIndex music = *DirectoryStorage::DirIterator(&storage,storage.root()) ;
+
+	std::map<std::string,DirectoryStorage::FileTS> files, new_files ;
+	files["a.ogg"].size = 1000 ;
+	files["a.ogg"].modtime = 100 ;
+	files["b.ogg"].size = 2000 ;
+	files["b.ogg"].modtime = 200 ;
+	ASSERT_TRUE(storage.updateSubFilesList(music,files,new_files)) ;
+
+	// Changes have to be saved before unloading.
+
+	storage.checkUnload(0) ;
+	EXPECT_TRUE(storage.loaded()) ;
+
+	storage.checkSave() ;
+
+	InternalFileHierarchyStorage saved ;
+	ASSERT_TRUE(saved.load(mPath)) ;
+
+	SharedDirStats stats ;
+	storage.getStatistics(stats) ;
+	EXPECT_EQ(2u,stats.total_number_of_files) ;
+
+	// An iterator in use keeps the hierarchy loaded.
+	{
+		DirectoryStorage::FileIterator it(&storage,music) ;
+		storage.checkUnload(0) ;
+		EXPECT_TRUE(storage.loaded()) ;
+		EXPECT_EQ("a.ogg",it.name()) ;
+	}
+
+	storage.checkUnload(0) ;
+	EXPECT_FALSE(storage.loaded()) ;
+
+	// Statistics are kept while unloaded. Any access loads the hierarchy again.
+
+	storage.getStatistics(stats) ;
+	EXPECT_EQ(2u,stats.total_number_of_files) ;
+	EXPECT_EQ(3000u,stats.total_shared_size) ;
+	EXPECT_FALSE(storage.loaded()) ;
+
+	uint32_t nb_files = 0 ;
+	for(DirectoryStorage::FileIterator it(&storage,music);it;++it)
+		++nb_files ;
+
+	EXPECT_EQ(2u,nb_files) ;
+	EXPECT_TRUE(storage.loaded()) ;
+	compareHierarchies(saved,storage.hierarchy()) ;
+
+	// When the file cannot be read anymore, the hierarchy stays unloaded, and is not read again before a while.
+
+	storage.checkUnload(0) ;
+	EXPECT_FALSE(storage.loaded()) ;
+
+	std::string moved = mPath + ".moved" ;
+	ASSERT_EQ(0,rename(mPath.c_str(),moved.c_str())) ;
+
+	DirDetails details ;
+	storage.extractData(storage.root(),details) ;
+	EXPECT_FALSE(storage.loaded()) ;
+	EXPECT_TRUE(details.children.empty()) ;
+
+	ASSERT_EQ(0,rename(moved.c_str(),mPath.c_str())) ;
+
+	storage.extractData(storage.root(),details) ;
+	EXPECT_FALSE(storage.loaded()) ;
+	EXPECT_TRUE(details.children.empty()) ;
+}
+
+// The sync with the friend and the search for download sources use the hierarchy all the time. They must not keep it
+// in memory, nor load it when not needed.
+
+TEST_F(DirStorageTest, UnloadBookkeeping)
+{
+	remove(mPath.c_str()) ;
+	TestDirectoryStorage storage(mPath) ;
+
+	std::set<std::string> subdirs ;
+	subdirs.insert("music") ;
+	ASSERT_TRUE(storage.updateSubDirectoryList(storage.root(),subdirs,RsFileHash::random())) ;
+
+	DirectoryStorage::EntryIndex music = *DirectoryStorage::DirIterator(&storage,storage.root()) ;
+
+	std::map<std::string,DirectoryStorage::FileTS> files, new_files ;
+	files["a.ogg"].size = 1000 ;
+	files["a.ogg"].modtime = 100 ;
+	ASSERT_TRUE(storage.updateSubFilesList(music,files,new_files)) ;
+
+	RsFileHash hash = RsFileHash::random() ;
+	storage.setHash(*DirectoryStorage::FileIterator(&storage,music),hash) ;
+	ASSERT_TRUE(storage.setDirectoryUpdateTime(storage.root(),1000)) ;
+	storage.checkSave() ;
+
+	// Bookkeeping on a loaded hierarchy is not an access.
+
+	storage.setIdle() ;
+
+	time_t update_TS = 0 ;
+	RsFileHash dir_hash ;
+	DirectoryStorage::EntryIndex indx ;
+
+	EXPECT_TRUE(storage.getDirectoryUpdateTime(storage.root(),update_TS)) ;
+	EXPECT_TRUE(storage.getDirectoryUpdateTime(music,update_TS)) ;
+	EXPECT_TRUE(storage.getDirHashFromIndex(music,dir_hash)) ;
+	EXPECT_TRUE(storage.getIndexFromDirHash(dir_hash,indx)) ;
+	EXPECT_TRUE(storage.searchHash(hash,indx)) ;
+	{
+		DirectoryStorage::DirIterator it(&storage,storage.root()) ;
+	}
+	storage.checkUnload(600) ;
+	EXPECT_FALSE(storage.loaded()) ;
+
+	// The root is known while unloaded, and so are the hashes of the files.
+
+	EXPECT_TRUE(storage.getDirectoryUpdateTime(storage.root(),update_TS)) ;
+	EXPECT_EQ(1000,update_TS) ;
+	EXPECT_TRUE(storage.setDirectoryUpdateTime(storage.root(),2000)) ;
+	EXPECT_TRUE(storage.getDirHashFromIndex(storage.root(),dir_hash)) ;
+	EXPECT_TRUE(dir_hash.isNull()) ;
+	EXPECT_TRUE(storage.getIndexFromDirHash(dir_hash,indx)) ;
+	EXPECT_EQ(storage.root(),indx) ;
+	EXPECT_FALSE(storage.searchHash(RsFileHash::random(),indx)) ;
+	EXPECT_FALSE(storage.loaded()) ;
+
+	// Only a search that finds a file loads the hierarchy. It gets the update time set meanwhile.
+
+	EXPECT_TRUE(storage.searchHash(hash,indx)) ;
+	EXPECT_TRUE(storage.loaded()) ;
+	EXPECT_EQ("a.ogg",storage.hierarchy().getFileEntry(indx)->file_name) ;
+
+	EXPECT_TRUE(storage.getDirectoryUpdateTime(storage.root(),update_TS)) ;
+	EXPECT_EQ(2000,update_TS) ;
+
+	storage.checkUnload(600) ;
+	EXPECT_TRUE(storage.loaded()) ;		// the update time has to be saved first
+}
@@ -0,0 +1,167 @@
+/*
+ * libretroshare/src/tests/file_sharing: directory_watcher_test.cc
+ *
+ * RetroShare C++ Directory change journal tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "file_sharing/directory_watcher.h"
+#include "util/rsdir.h"
+
+#define WATCHER_TEST_DIR "directory_watcher_test"
+
+static void write_file(const std::string& name)
+{
+	FILE *f = fopen(name.c_str(),"wb") ;
+	ASSERT_TRUE(f != NULL) ;
+	fputs("some data",f) ;
+	fclose(f) ;
+}
+
+TEST(libretroshare_file_sharing, DirectoryWatcher)
+{
+	DirectoryWatcher watcher ;
+
+	if(!watcher.isAvailable())
+		return ;	// no inotify on this system
+
+	const std::string dir = WATCHER_TEST_DIR ;
+	const std::string sub = dir + "/sub" ;
+
+	RsDirUtil::checkCreateDirectory(dir) ;
+	RsDirUtil::checkCreateDirectory(sub) ;
+
+	watcher.beginSweep() ;
+	watcher.watch(dir) ;
+	watcher.watch(sub) ;
+	watcher.watch(dir + "/not_there") ;
+
+	EXPECT_FALSE(watcher.isComplete()) ;
+
+	watcher.beginSweep() ;
+	watcher.watch(dir) ;
+	watcher.watch(sub) ;
+
+	EXPECT_TRUE(watcher.isComplete()) ;
+
+	std::set<std::string> changed ;
+	EXPECT_TRUE(watcher.getChangedDirectories(changed)) ;
+	EXPECT_TRUE(changed.empty()) ;
+
+	// a new file is reported in its directory only
+
+	write_file(sub + "/file1") ;
+
+	EXPECT_TRUE(watcher.getChangedDirectories(changed)) ;
+	EXPECT_EQ(1u, changed.size()) ;
+	EXPECT_EQ(1u, changed.count(sub)) ;
+
+	// renaming across directories reports both
+
+	changed.clear() ;
+	EXPECT_EQ(0, rename((sub + "/file1").c_str(),(dir + "/file2").c_str())) ;
+
+	EXPECT_TRUE(watcher.getChangedDirectories(changed)) ;
+	EXPECT_EQ(2u, changed.size()) ;
+	EXPECT_EQ(1u, changed.count(sub)) ;
+	EXPECT_EQ(1u, changed.count(dir)) ;
+
+	// removing the sub-directory is reported in the parent
+
+	changed.clear() ;
+	EXPECT_EQ(0, rmdir(sub.c_str())) ;
+
+	EXPECT_TRUE(watcher.getChangedDirectories(changed)) ;
+	EXPECT_EQ(1u, changed.count(dir)) ;
+
+	changed.clear() ;
+	EXPECT_EQ(0, remove((dir + "/file2").c_str())) ;
+	EXPECT_EQ(0, rmdir(dir.c_str())) ;
+
+	EXPECT_TRUE(watcher.getChangedDirectories(changed)) ;
+	EXPECT_EQ(1u, changed.count(dir)) ;
+	EXPECT_EQ(0u, changed.count(sub)) ;
+}
+
+TEST(libretroshare_file_sharing, DirectoryWatcherUnwatch)
+{
+	DirectoryWatcher watcher ;
+
+	if(!watcher.isAvailable())
+		return ;	// no inotify on this system
+
+	const std::string dir = WATCHER_TEST_DIR ;
+	const std::string sub = dir + "/sub" ;
+	const std::string subsub = sub + "/sub" ;
+	const std::string other = dir + "/sub2" ;
+
+	RsDirUtil::checkCreateDirectory(dir) ;
+	RsDirUtil::checkCreateDirectory(sub) ;
+	RsDirUtil::checkCreateDirectory(subsub) ;
+	RsDirUtil::checkCreateDirectory(other) ;
+
+	watcher.beginSweep() ;
+	watcher.watch(dir) ;
+	watcher.watch(sub) ;
+	watcher.watch(subsub) ;
+	watcher.watch(other) ;
+	watcher.endSweep() ;
+
+	// a directory that is not shared anymore is not watched, nor anything below it
+
+	watcher.unwatchTree(sub) ;
+
+	write_file(sub + "/file1") ;
+	write_file(subsub + "/file1") ;
+	write_file(other + "/file1") ;
+
+	std::set<std::string> changed ;
+	EXPECT_TRUE(watcher.getChangedDirectories(changed)) ;
+	EXPECT_EQ(1u, changed.size()) ;
+	EXPECT_EQ(1u, changed.count(other)) ;
+
+	// directories that were not swept are not watched anymore
+
+	watcher.beginSweep() ;
+	watcher.watch(dir) ;
+	watcher.endSweep() ;
+
+	changed.clear() ;
+	write_file(other + "/file2") ;
+	write_file(dir + "/file1") ;
+
+	EXPECT_TRUE(watcher.getChangedDirectories(changed)) ;
+	EXPECT_EQ(1u, changed.size()) ;
+	EXPECT_EQ(1u, changed.count(dir)) ;
+
+	EXPECT_EQ(0, remove((sub + "/file1").c_str())) ;
+	EXPECT_EQ(0, remove((subsub + "/file1").c_str())) ;
+	EXPECT_EQ(0, remove((other + "/file1").c_str())) ;
+	EXPECT_EQ(0, remove((other + "/file2").c_str())) ;
+	EXPECT_EQ(0, remove((dir + "/file1").c_str())) ;
+	EXPECT_EQ(0, rmdir(subsub.c_str())) ;
+	EXPECT_EQ(0, rmdir(sub.c_str())) ;
+	EXPECT_EQ(0, rmdir(other.c_str())) ;
+	EXPECT_EQ(0, rmdir(dir.c_str())) ;
+}
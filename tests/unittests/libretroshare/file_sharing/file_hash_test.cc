@@ -0,0 +1,94 @@
+/*
+ * libretroshare/src/tests/file_sharing: file_hash_test.cc
+ *
+ * RetroShare C++ File hashing tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <vector>
+
+#include "util/rsdir.h"
+#include "util/rsrandom.h"
+#include "util/rsscopetimer.h"
+
+#define FILE_HASH_TEST_NAME "file_hash_test.bin"
+
+// Hashes a random file of the given size with both reading methods, and compares with the hash of the data in memory.
+// When benchmarking, also prints the throughput of each method.
+
+static void check_file_hash(uint32_t size,bool benchmark = false)
+{
+	std::vector<uint8_t> data(size) ;
+
+	if(size > 0)
+		RSRandom::random_bytes(&data[0],size) ;
+
+	FILE *f = fopen(FILE_HASH_TEST_NAME,"wb") ;
+	ASSERT_TRUE(f != NULL) ;
+	EXPECT_EQ(size, fwrite(data.empty()?NULL:&data[0],1,size,f)) ;
+	fclose(f) ;
+
+	RsFileHash expected = RsDirUtil::sha1sum(data.empty()?NULL:&data[0],size) ;
+
+	RsFileHash hash_read, hash_mmap ;
+	uint64_t size_read = 0, size_mmap = 0 ;
+
+	RsScopeTimer timer("") ;
+	EXPECT_TRUE(RsDirUtil::getFileHash(FILE_HASH_TEST_NAME,hash_read,size_read)) ;
+	double read_time = timer.duration() ;
+
+	timer.start() ;
+	EXPECT_TRUE(RsDirUtil::getFileHash(FILE_HASH_TEST_NAME,hash_mmap,size_mmap,NULL,true)) ;
+	double mmap_time = timer.duration() ;
+
+	EXPECT_EQ(expected, hash_read) ;
+	EXPECT_EQ(expected, hash_mmap) ;
+	EXPECT_EQ((uint64_t)size, size_read) ;
+	EXPECT_EQ((uint64_t)size, size_mmap) ;
+
+	if(benchmark)
+		std::cerr << "getFileHash() on " << size/(1024*1024) << " MB: read: " << size/read_time/(1024*1024)
+		          << " MB/s, mmap: " << size/mmap_time/(1024*1024) << " MB/s" << std::endl;
+
+	remove(FILE_HASH_TEST_NAME) ;
+}
+
+TEST(libretroshare_file_sharing, GetFileHash)
+{
+	check_file_hash(0) ;
+	check_file_hash(1) ;
+	check_file_hash(4096) ;
+	check_file_hash(10*1024*1024) ;			// exactly one read buffer
+	check_file_hash(25*1024*1024 + 17) ;	// several read buffers, partial last one
+
+	RsFileHash hash ;
+	uint64_t size = 0 ;
+
+	EXPECT_FALSE(RsDirUtil::getFileHash("file_hash_test_missing.bin",hash,size)) ;
+}
+
+// Benchmark, disabled by default. Run with --gtest_also_run_disabled_tests.
+
+TEST(libretroshare_file_sharing, DISABLED_GetFileHashBenchmark)
+{
+	check_file_hash(100*1024*1024,true) ;
+}
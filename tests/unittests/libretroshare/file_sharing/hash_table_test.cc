@@ -0,0 +1,177 @@
+/*
+ * libretroshare/src/tests/file_sharing: hash_table_test.cc
+ *
+ * RetroShare C++ hash table tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <set>
+#include <stdlib.h>
+
+#include "retroshare/rstypes.h"
+#include "util/rshashtable.h"
+#include "util/rsrandom.h"
+#include "util/rsscopetimer.h"
+
+TEST(libretroshare_file_sharing, RsHashTable)
+{
+	RsHashTable<RsFileHash,uint32_t> table ;
+	std::multimap<RsFileHash,uint32_t> reference ;
+	std::vector<RsFileHash> hashes ;
+
+	// Few different hashes, so that the same hash gets several values.
+
+	for(uint32_t i=0;i<2000;++i)
+		hashes.push_back(RsFileHash::random()) ;
+
+	for(uint32_t round=0;round<50000;++round)
+	{
+		const RsFileHash& hash(hashes[RSRandom::random_u32()%hashes.size()]) ;
+		uint32_t value = RSRandom::random_u32()%4 ;
+
+		bool present = false ;
+		std::multimap<RsFileHash,uint32_t>::iterator it = reference.lower_bound(hash) ;
+
+		for(;it!=reference.end() && it->first == hash;++it)
+			if(it->second == value)
+			{
+				present = true ;
+				break ;
+			}
+
+		if(RSRandom::random_u32()%3 == 0)
+		{
+			EXPECT_EQ(present,table.erase(hash,value)) ;
+
+			if(present)
+				reference.erase(it) ;
+		}
+		else
+		{
+			EXPECT_EQ(!present,table.insert(hash,value)) ;
+
+			if(!present)
+				reference.insert(std::make_pair(hash,value)) ;
+		}
+	}
+	EXPECT_EQ(reference.size(),table.size()) ;
+
+	for(uint32_t i=0;i<hashes.size();++i)
+	{
+		std::vector<uint32_t> values ;
+		std::multiset<uint32_t> ref_values, found_values ;
+
+		for(std::multimap<RsFileHash,uint32_t>::const_iterator it(reference.lower_bound(hashes[i]));it!=reference.end() && it->first == hashes[i];++it)
+			ref_values.insert(it->second) ;
+
+		EXPECT_EQ(!ref_values.empty(),table.findAll(hashes[i],values)) ;
+		found_values.insert(values.begin(),values.end()) ;
+
+		EXPECT_EQ(ref_values,found_values) ;
+
+		uint32_t value ;
+		EXPECT_EQ(!ref_values.empty(),table.find(hashes[i],value)) ;
+	}
+
+	// erasing a key removes all its values
+
+	for(uint32_t i=0;i<hashes.size();i+=2)
+		EXPECT_EQ(reference.count(hashes[i]),table.erase(hashes[i])) ;
+
+	for(uint32_t i=0;i<hashes.size();++i)
+	{
+		uint32_t value ;
+		EXPECT_EQ(i%2 == 1 && reference.count(hashes[i]) > 0,table.find(hashes[i],value)) ;
+	}
+
+	// single valued use
+
+	RsFileHash hash = RsFileHash::random() ;
+	uint32_t value = 0 ;
+
+	table.set(hash,1) ;
+	table.set(hash,2) ;
+
+	std::vector<uint32_t> values ;
+	EXPECT_TRUE(table.findAll(hash,values)) ;
+	EXPECT_EQ(1u,values.size()) ;
+	EXPECT_TRUE(table.find(hash,value)) ;
+	EXPECT_EQ(2u,value) ;
+
+	table.clear() ;
+	EXPECT_EQ(0u,table.size()) ;
+	EXPECT_FALSE(table.find(hash,value)) ;
+}
+
+// Compares the lookup throughput with the std::map that was used for file hashes. Half of the lookups
+// are misses, as for turtle tunnel requests. Set RS_HASH_TABLE_BENCH_LARGE to also run with 10M entries.
+
+static void bench_lookups(uint32_t n)
+{
+	std::vector<RsFileHash> hashes(n) ;
+
+	for(uint32_t i=0;i<n;++i)
+		hashes[i] = RsFileHash::random() ;
+
+	std::map<RsFileHash,uint32_t> map ;
+	RsHashTable<RsFileHash,uint32_t> table ;
+
+	for(uint32_t i=0;i<n;i+=2)
+	{
+		map[hashes[i]] = i ;
+		table.insert(hashes[i],i) ;
+	}
+
+	RsScopeTimer timer("") ;
+	uint32_t map_hits = 0 ;
+
+	for(uint32_t i=0;i<n;++i)
+		if(map.find(hashes[i]) != map.end())
+			++map_hits ;
+
+	double map_time = timer.duration() ;
+
+	timer.start() ;
+	uint32_t table_hits = 0 ;
+	uint32_t value ;
+
+	for(uint32_t i=0;i<n;++i)
+		if(table.find(hashes[i],value))
+			++table_hits ;
+
+	double table_time = timer.duration() ;
+
+	EXPECT_EQ(map_hits,table_hits) ;
+	EXPECT_EQ((n+1)/2,table_hits) ;
+
+	std::cerr << "File hash lookups with " << n/2 << " entries: std::map: " << n/map_time/1e6 << " M/s, RsHashTable: " << n/table_time/1e6 << " M/s" << std::endl;
+}
+
+// Benchmark, disabled by default. Run with --gtest_also_run_disabled_tests.
+
+TEST(libretroshare_file_sharing, DISABLED_RsHashTableLookupBenchmark)
+{
+	bench_lookups(2*1000000) ;
+
+	if(getenv("RS_HASH_TABLE_BENCH_LARGE") != NULL)
+		bench_lookups(2*10000000) ;
+}
@@ -0,0 +1,104 @@
+/*
+ * libretroshare/src/tests/ft: ftchunkcache_test.cc
+ *
+ * RetroShare C++ upload data cache tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <vector>
+
+#include "ft/ftchunkcache.h"
+#include "ft/ftfileprovider.h"
+#include "util/rsrandom.h"
+
+static const uint32_t SLICE_SIZE = 8000 ;
+
+TEST(libretroshare_ft, ChunkCacheUploads)
+{
+	std::string filename = "ftchunkcache_test.bin" ;
+	uint64_t size = 3*ftChunkCache::BLOCK_SIZE + 12345 ;
+
+	std::vector<unsigned char> ref(size) ;
+	RSRandom::random_bytes(&ref[0],size) ;
+
+	FILE *f = fopen(filename.c_str(),"wb") ;
+	ASSERT_TRUE(f != NULL) ;
+	ASSERT_EQ(1u,fwrite(&ref[0],size,1,f)) ;
+	fclose(f) ;
+
+	RsFileHash hash = RsFileHash::random() ;
+	ftChunkCache cache(2*ftChunkCache::BLOCK_SIZE + 12345) ;	// room for the last block, and two others
+
+	ftFileProvider provider1(filename,size,hash,&cache) ;
+	ftFileProvider provider2(filename,size,hash,&cache) ;		// another provider of the same file shares the cache
+
+	std::vector<RsPeerId> peers ;
+	for(uint32_t i=0;i<3;++i)
+		peers.push_back(RsPeerId::random()) ;
+
+	std::vector<unsigned char> data(SLICE_SIZE) ;
+
+	// Peers downloading the file sequentially, each in turn. Only the first one reads the disk.
+
+	for(uint64_t offset=0;offset<size;offset+=SLICE_SIZE)
+		for(uint32_t i=0;i<peers.size();++i)
+		{
+			uint32_t chunk_size = SLICE_SIZE ;
+
+			ASSERT_TRUE((i%2 ? provider1 : provider2).getFileData(peers[i],offset,chunk_size,&data[0])) ;
+			ASSERT_EQ(std::min((uint64_t)SLICE_SIZE,size-offset),(uint64_t)chunk_size) ;
+			ASSERT_TRUE(0 == memcmp(&data[0],&ref[offset],chunk_size)) ;
+		}
+
+	ftChunkCacheStats stats ;
+	cache.getStats(stats) ;
+
+	uint64_t requests = peers.size() * ((size + SLICE_SIZE - 1)/SLICE_SIZE) ;
+
+	EXPECT_EQ(requests,stats.hits + stats.misses) ;
+	EXPECT_LE(stats.misses,(uint64_t)peers.size() + 4) ;		// first slice of each peer, and one per block
+	EXPECT_EQ(4u,stats.loaded_blocks) ;
+	EXPECT_EQ(1u,stats.dropped_blocks) ;
+	EXPECT_EQ(3u,stats.cached_blocks) ;
+	EXPECT_LE(stats.cached_bytes,stats.max_bytes) ;
+
+	// Random requests don't read ahead, but are still served from the cache when possible.
+
+	for(uint32_t i=0;i<200;++i)
+	{
+		uint64_t offset = RSRandom::random_u64() % size ;
+		uint32_t chunk_size = SLICE_SIZE ;
+		RsPeerId peer = RsPeerId::random() ;
+
+		ASSERT_TRUE(provider1.getFileData(peer,offset,chunk_size,&data[0])) ;
+		ASSERT_TRUE(0 == memcmp(&data[0],&ref[offset],chunk_size)) ;
+	}
+	cache.getStats(stats) ;
+	EXPECT_EQ(4u,stats.loaded_blocks) ;
+
+	cache.setMaxSize(0) ;
+	cache.getStats(stats) ;
+	EXPECT_EQ(0u,stats.cached_blocks) ;
+	EXPECT_EQ(0u,stats.cached_bytes) ;
+
+	remove(filename.c_str()) ;
+}
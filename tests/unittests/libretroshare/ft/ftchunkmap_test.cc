@@ -0,0 +1,221 @@
+/*
+ * libretroshare/src/tests/ft: ftchunkmap_test.cc
+ *
+ * RetroShare C++ chunk scheduling tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <stdlib.h>
+
+#include "ft/ftchunkmap.h"
+
+// Simulation of a multi-source download, one tick per second. Each source is asked as much data per tick as it
+// sends, as ftTransferModule does, and sends the requested slices in order. Slices that are not received after
+// SIM_REASK_DELAY ticks are asked again to another source, as ftFileCreator does.
+
+static const uint32_t SIM_CHUNK_SIZE   = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
+static const uint32_t SIM_REASK_DELAY  = 120 ;
+static const uint32_t SIM_MAX_TICKS    = 5000 ;
+
+struct SimSource
+{
+	SimSource(uint32_t r,uint32_t first_chunk,uint32_t last_chunk,uint32_t stall = SIM_MAX_TICKS)
+		: rate(r),first(first_chunk),last(last_chunk),stall_tick(stall) { id = RsPeerId::random() ; }
+
+	struct Request
+	{
+		ftChunk::ChunkId slice_id ;
+		uint32_t remaining ;
+	};
+
+	RsPeerId id ;
+	uint32_t rate ;				// bytes per tick
+	uint32_t first,last ;		// chunks that this source has
+	uint32_t stall_tick ;		// the source stops sending at that time
+	std::list<Request> requests ;
+};
+
+struct SimSlice
+{
+	uint32_t size ;
+	uint32_t asked_tick ;
+};
+
+static uint32_t simulate_download(uint32_t nb_chunks,std::vector<SimSource> sources,FileChunksInfo::ChunkStrategy strategy)
+{
+	ChunkMap chunk_map((uint64_t)nb_chunks*SIM_CHUNK_SIZE,false) ;
+	chunk_map.setStrategy(strategy) ;
+
+	for(uint32_t i=0;i<sources.size();++i)
+	{
+		CompressedChunkMap cmap(nb_chunks,0) ;
+
+		for(uint32_t c=sources[i].first;c<=sources[i].last;++c)
+			cmap.set(c) ;
+
+		chunk_map.setPeerAvailabilityMap(sources[i].id,cmap) ;
+	}
+
+	std::map<ftChunk::ChunkId,SimSlice> pending ;
+
+	for(uint32_t tick=0;tick<SIM_MAX_TICKS;++tick)
+	{
+		for(uint32_t i=0;i<sources.size();++i)
+		{
+			SimSource& src(sources[i]) ;
+			bool active = tick < src.stall_tick ;
+
+			chunk_map.setSourceRate(src.id,active?src.rate:0) ;
+
+			if(!active)
+				continue ;
+
+			// send the data of the requested slices. The first copy of a slice received is kept.
+
+			uint32_t budget = src.rate ;
+
+			while(budget > 0 && !src.requests.empty())
+			{
+				SimSource::Request& req(src.requests.front()) ;
+				uint32_t n = std::min(budget,req.remaining) ;
+
+				budget -= n ;
+				req.remaining -= n ;
+
+				if(req.remaining > 0)
+					break ;
+
+				if(pending.erase(req.slice_id) > 0)
+					chunk_map.dataReceived(req.slice_id) ;
+
+				src.requests.pop_front() ;
+			}
+
+			// ask new slices for the next tick
+
+			uint32_t to_ask = src.rate ;
+
+			for(std::map<ftChunk::ChunkId,SimSlice>::iterator it(pending.begin());it!=pending.end() && to_ask > 0;++it)
+				if(it->second.asked_tick + SIM_REASK_DELAY < tick && it->first/SIM_CHUNK_SIZE >= src.first && it->first/SIM_CHUNK_SIZE <= src.last)
+				{
+					SimSource::Request req ;
+					req.slice_id = it->first ;
+					req.remaining = it->second.size ;
+					src.requests.push_back(req) ;
+
+					it->second.asked_tick = tick ;
+					to_ask -= std::min(to_ask,it->second.size) ;
+				}
+
+			while(to_ask > 0)
+			{
+				ftChunk chunk ;
+				bool map_needed ;
+				SimSource::Request req ;
+
+				if(chunk_map.getDataChunk(src.id,to_ask,chunk,map_needed))
+				{
+					SimSlice& slice(pending[chunk.id]) ;
+					slice.size = chunk.size ;
+					slice.asked_tick = tick ;
+
+					req.slice_id = chunk.id ;
+					req.remaining = chunk.size ;
+				}
+				else if(chunk_map.getEndGameSlice(src.id,req.slice_id))
+					req.remaining = pending[req.slice_id].size ;
+				else
+					break ;
+
+				src.requests.push_back(req) ;
+				to_ask -= std::min(to_ask,req.remaining) ;
+			}
+		}
+
+		std::vector<uint32_t> to_check ;
+		chunk_map.getChunksToCheck(to_check) ;
+
+		for(uint32_t i=0;i<to_check.size();++i)
+			chunk_map.setChunkCheckingResult(to_check[i],true) ;
+
+		if(chunk_map.isComplete())
+			return tick ;
+	}
+	return SIM_MAX_TICKS ;
+}
+
+static uint32_t average_download_time(uint32_t nb_chunks,const std::vector<SimSource>& sources,FileChunksInfo::ChunkStrategy strategy)
+{
+	static const uint32_t NB_RUNS = 5 ;
+	uint32_t total = 0 ;
+
+	for(uint32_t i=0;i<NB_RUNS;++i)
+		total += simulate_download(nb_chunks,sources,strategy) ;
+
+	return total / NB_RUNS ;
+}
+
+TEST(libretroshare_ft, ChunkMapRarestFirst)
+{
+	srand(1) ;
+
+	// Two sources have the beginning of the file. The only source of the end of the file is slower, and leaves
+	// after 20 ticks, which is just enough to get the end of the file from it if it is asked for nothing else.
+
+	std::vector<SimSource> sources ;
+	sources.push_back(SimSource(1024*1024, 0,29)) ;
+	sources.push_back(SimSource(1024*1024, 0,29)) ;
+	sources.push_back(SimSource( 640*1024, 0,39,20)) ;
+
+	uint32_t t_progressive = average_download_time(40,sources,FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE) ;
+	uint32_t t_random      = average_download_time(40,sources,FileChunksInfo::CHUNK_STRATEGY_RANDOM) ;
+	uint32_t t_rarest      = average_download_time(40,sources,FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST) ;
+
+	std::cerr << "Partial sources: download time progressive: " << t_progressive << ", random: " << t_random << ", rarest first: " << t_rarest << std::endl;
+
+	EXPECT_LT(t_rarest,t_progressive) ;
+	EXPECT_LT(t_rarest,t_random) ;
+	EXPECT_LE(t_rarest,20u) ;
+}
+
+TEST(libretroshare_ft, ChunkMapEndGame)
+{
+	srand(1) ;
+
+	// Three complete sources. One of them stops sending before the end: what it was asked for is
+	// asked to the faster sources right away, instead of after the re-ask delay.
+
+	std::vector<SimSource> sources ;
+	sources.push_back(SimSource(1024*1024, 0,29)) ;
+	sources.push_back(SimSource( 512*1024, 0,29)) ;
+	sources.push_back(SimSource( 128*1024, 0,29,15)) ;
+
+	uint32_t t_progressive = average_download_time(30,sources,FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE) ;
+	uint32_t t_rarest      = average_download_time(30,sources,FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST) ;
+
+	std::cerr << "Stalled source: download time progressive: " << t_progressive << ", rarest first: " << t_rarest << std::endl;
+
+	EXPECT_LT(t_rarest,t_progressive) ;
+	EXPECT_LT(t_rarest,SIM_REASK_DELAY) ;
+}
@@ -0,0 +1,254 @@
+/*
+ * libretroshare/src/tests/ft: ftfilecreator_test.cc
+ *
+ * RetroShare C++ download write queue and chunk hashing tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include <openssl/sha.h>
+
+#include "ft/ftchunkmap.h"
+#include "ft/ftfilecreator.h"
+#include "util/rsdiscspace.h"
+
+static const uint32_t CHUNK_SIZE = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
+
+// Content of the file at the given offset. The salt gives different data for the same offset.
+
+static std::vector<unsigned char> fileData(uint64_t offset,uint32_t size,uint8_t salt = 0)
+{
+	std::vector<unsigned char> data(size) ;
+
+	for(uint32_t i=0;i<size;++i)
+		data[i] = (uint8_t)(((offset+i)*7 + ((offset+i)>>11)) ^ salt) ;
+
+	return data ;
+}
+
+static Sha1CheckSum chunkSum(uint64_t file_size,uint32_t chunk)
+{
+	uint64_t offset = (uint64_t)chunk*CHUNK_SIZE ;
+	std::vector<unsigned char> data(fileData(offset,std::min((uint64_t)CHUNK_SIZE,file_size - offset))) ;
+
+	unsigned char md[SHA_DIGEST_LENGTH] ;
+	SHA1(&data[0],data.size(),md) ;
+
+	return Sha1CheckSum(md) ;
+}
+
+// The creator frees the data it receives.
+
+static void receive(ftFileCreator& fc,uint64_t offset,uint32_t size,uint8_t salt = 0)
+{
+	std::vector<unsigned char> data(fileData(offset,size,salt)) ;
+	void *buf = malloc(size) ;
+	memcpy(buf,&data[0],size) ;
+
+	fc.addFileData(offset,size,buf) ;
+}
+
+// Asks the creator for the next slices of the file, as ftTransferModule does.
+
+static void requestSlices(ftFileCreator& fc,const RsPeerId& peer,uint32_t nb,uint32_t size_hint,std::vector<std::pair<uint64_t,uint32_t> >& slices)
+{
+	slices.clear() ;
+
+	for(uint32_t i=0;i<nb;++i)
+	{
+		uint64_t offset = 0 ;
+		uint32_t size = 0 ;
+		bool map_needed = false ;
+
+		ASSERT_TRUE(fc.getMissingChunk(peer,size_hint,offset,size,map_needed)) ;
+		slices.push_back(std::make_pair(offset,size)) ;
+	}
+}
+
+static FileChunksInfo::ChunkState chunkState(ftFileCreator& fc,uint32_t chunk)
+{
+	FileChunksInfo info ;
+	fc.getChunkMap(info) ;
+
+	return info.chunks[chunk] ;
+}
+
+static bool fileContentIs(const std::string& path,uint64_t offset,const std::vector<unsigned char>& data)
+{
+	FILE *f = fopen(path.c_str(),"rb") ;
+
+	if(f == NULL)
+		return false ;
+
+	std::vector<unsigned char> buf(data.size()) ;
+	bool ok = fseek(f,offset,SEEK_SET) == 0 && fread(&buf[0],1,buf.size(),f) == buf.size() ;
+	fclose(f) ;
+
+	return ok && buf == data ;
+}
+
+class ftFileCreatorTest: public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		char path[] = "/tmp/ftfilecreator_testXXXXXX" ;
+		int fd = mkstemp(path) ;
+		ASSERT_NE(-1,fd) ;
+		close(fd) ;
+
+		mPath = path ;
+		mPeer = RsPeerId::random() ;
+
+		RsDiscSpace::setPartialsPath("/tmp") ;
+	}
+	virtual void TearDown()
+	{
+		remove(mPath.c_str()) ;
+	}
+
+	std::string mPath ;
+	RsPeerId mPeer ;
+};
+
+TEST_F(ftFileCreatorTest, WriteQueueMerge)
+{
+	static const uint64_t FILE_SIZE = 300000 ;
+
+	ftFileCreator fc(mPath,FILE_SIZE,RsFileHash::random(),true) ;
+	fc.setChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_STREAMING) ;
+
+	std::vector<std::pair<uint64_t,uint32_t> > slices ;
+	requestSlices(fc,mPeer,1,FILE_SIZE,slices) ;
+	ASSERT_EQ(0u,slices[0].first) ;
+	ASSERT_EQ(FILE_SIZE,slices[0].second) ;
+
+	uint32_t nb_blocks = 0, size = 0 ;
+
+	// Separate data gives separate writes.
+
+	receive(fc,0,10000) ;
+	receive(fc,20000,10000) ;
+	receive(fc,50000,10000) ;
+
+	fc.getWriteQueueInfo(nb_blocks,size) ;
+	EXPECT_EQ(3u,nb_blocks) ;
+	EXPECT_EQ(30000u,size) ;
+
+	// Data after a block is appended to it. Data that fills a hole merges both sides.
+
+	receive(fc,10000,10000) ;
+
+	fc.getWriteQueueInfo(nb_blocks,size) ;
+	EXPECT_EQ(2u,nb_blocks) ;
+	EXPECT_EQ(40000u,size) ;
+
+	// Data overlapping queued data replaces it, and the rest is merged.
+
+	receive(fc,25000,30000,0x55) ;
+
+	fc.getWriteQueueInfo(nb_blocks,size) ;
+	EXPECT_EQ(1u,nb_blocks) ;
+	EXPECT_EQ(60000u,size) ;
+
+	// Data before a block is merged with it.
+
+	receive(fc,60000,1000) ;
+	receive(fc,62000,1000) ;
+	receive(fc,61000,1000) ;
+
+	fc.getWriteQueueInfo(nb_blocks,size) ;
+	EXPECT_EQ(1u,nb_blocks) ;
+	EXPECT_EQ(63000u,size) ;
+
+	EXPECT_TRUE(fc.flushWriteQueue()) ;
+
+	fc.getWriteQueueInfo(nb_blocks,size) ;
+	EXPECT_EQ(0u,nb_blocks) ;
+	EXPECT_EQ(0u,size) ;
+
+	EXPECT_TRUE(fileContentIs(mPath,0,fileData(0,25000))) ;
+	EXPECT_TRUE(fileContentIs(mPath,25000,fileData(25000,30000,0x55))) ;
+	EXPECT_TRUE(fileContentIs(mPath,55000,fileData(55000,8000))) ;
+}
+
+TEST_F(ftFileCreatorTest, ChunkHashing)
+{
+	static const uint64_t FILE_SIZE = 2*CHUNK_SIZE + 1000 ;
+
+	ftFileCreator fc(mPath,FILE_SIZE,RsFileHash::random(),true) ;
+	fc.setChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_STREAMING) ;
+
+	std::vector<std::pair<uint64_t,uint32_t> > slices ;
+
+	// Chunk 0 arrives in order, and is hashed on reception.
+
+	requestSlices(fc,mPeer,4,CHUNK_SIZE/4,slices) ;
+
+	for(uint32_t i=0;i<slices.size();++i)
+		receive(fc,slices[i].first,slices[i].second) ;
+
+	EXPECT_EQ(FileChunksInfo::CHUNK_CHECKING,chunkState(fc,0)) ;
+	fc.verifyChunk(0,chunkSum(FILE_SIZE,0)) ;
+	EXPECT_EQ(FileChunksInfo::CHUNK_DONE,chunkState(fc,0)) ;
+
+	// Chunk 1 arrives in reverse order, partly written before the start of the chunk is received.
+	// The rest of the chunk is then read from the disk.
+
+	requestSlices(fc,mPeer,4,CHUNK_SIZE/4,slices) ;
+
+	for(int i=slices.size()-1;i>=0;--i)
+	{
+		receive(fc,slices[i].first,slices[i].second) ;
+
+		if(i == 2)
+			EXPECT_TRUE(fc.flushWriteQueue()) ;
+	}
+
+	fc.verifyChunk(1,chunkSum(FILE_SIZE,1)) ;
+	EXPECT_EQ(FileChunksInfo::CHUNK_DONE,chunkState(fc,1)) ;
+
+	// Chunk 2 first arrives with wrong data, partly read from the disk while checking it. It is then downloaded
+	// again. The data read from the disk for the second check must be the new one.
+
+	requestSlices(fc,mPeer,2,500,slices) ;
+
+	receive(fc,slices[1].first,slices[1].second,0x55) ;
+	EXPECT_TRUE(fc.flushWriteQueue()) ;
+	receive(fc,slices[0].first,slices[0].second,0x55) ;
+
+	fc.verifyChunk(2,chunkSum(FILE_SIZE,2)) ;
+	EXPECT_EQ(FileChunksInfo::CHUNK_OUTSTANDING,chunkState(fc,2)) ;
+
+	requestSlices(fc,mPeer,2,500,slices) ;
+
+	receive(fc,slices[1].first,slices[1].second) ;
+	EXPECT_TRUE(fc.flushWriteQueue()) ;
+	receive(fc,slices[0].first,slices[0].second) ;
+
+	fc.verifyChunk(2,chunkSum(FILE_SIZE,2)) ;
+	EXPECT_EQ(FileChunksInfo::CHUNK_DONE,chunkState(fc,2)) ;
+
+	EXPECT_TRUE(fc.finished()) ;
+}
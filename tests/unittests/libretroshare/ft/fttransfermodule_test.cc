@@ -0,0 +1,153 @@
+/*
+ * libretroshare/src/tests/ft: fttransfermodule_test.cc
+ *
+ * RetroShare C++ download window tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <list>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ft/ftdata.h"
+#include "ft/ftdatamultiplex.h"
+#include "ft/ftfilecreator.h"
+#include "ft/fttransfermodule.h"
+
+// Records the data requests sent to sources, so that the test can answer them or let them time out.
+
+class TestDataSend: public ftDataSend
+{
+public:
+	struct Request
+	{
+		RsPeerId peer_id ;
+		uint64_t offset ;
+		uint32_t size ;
+	};
+
+	virtual bool sendDataRequest(const RsPeerId& peerId, const RsFileHash&, uint64_t, uint64_t offset, uint32_t chunksize)
+	{
+		Request req ;
+		req.peer_id = peerId ;
+		req.offset = offset ;
+		req.size = chunksize ;
+
+		requests.push_back(req) ;
+		return true ;
+	}
+	virtual bool sendData(const RsPeerId&, const RsFileHash&, uint64_t, uint64_t, uint32_t, void *data) { free(data) ; return true ; }
+	virtual bool sendChunkMapRequest(const RsPeerId&,const RsFileHash&,bool) { return true ; }
+	virtual bool sendChunkMap(const RsPeerId&,const RsFileHash&,const CompressedChunkMap&,bool) { return true ; }
+	virtual bool sendSingleChunkCRCRequest(const RsPeerId&,const RsFileHash&,uint32_t) { return true ; }
+	virtual bool sendSingleChunkCRC(const RsPeerId&,const RsFileHash&,uint32_t,const Sha1CheckSum&) { return true ; }
+
+	// Answers all requests sent so far, and returns the number of bytes sent.
+
+	uint32_t answerRequests(ftTransferModule& tm)
+	{
+		uint32_t total = 0 ;
+
+		for(std::list<Request>::const_iterator it(requests.begin());it!=requests.end();++it)
+		{
+			void *data = calloc(1,it->size) ;	// freed by the transfer module
+			tm.recvFileData(it->peer_id,it->offset,it->size,data) ;
+			total += it->size ;
+		}
+		requests.clear() ;
+		return total ;
+	}
+
+	std::list<Request> requests ;
+};
+
+TEST(libretroshare_ft, TransferModuleWindow)
+{
+	static const uint32_t INITIAL_WINDOW = 64*1024 ;
+	static const uint32_t MINIMUM_WINDOW = 16*1024 ;
+
+	char path[] = "/tmp/fttransfermodule_testXXXXXX" ;
+	int fd = mkstemp(path) ;
+	ASSERT_NE(-1,fd) ;
+	close(fd) ;
+
+	RsPeerId own_id = RsPeerId::random() ;
+	RsPeerId source = RsPeerId::random() ;
+
+	TestDataSend data_send ;
+	ftDataMultiplex multiplex(own_id,&data_send,NULL) ;
+	ftFileCreator *creator = new ftFileCreator(path,64*1024*1024,RsFileHash::random(),true) ;
+	ftTransferModule tm(creator,&multiplex,NULL) ;
+
+	std::list<RsPeerId> sources ;
+	sources.push_back(source) ;
+	tm.setFileSources(sources) ;
+	tm.setPeerState(source,PQIPEER_DOWNLOADING,10*1024*1024) ;
+
+	TransferInfo info ;
+
+	// A new source is asked for the initial window.
+
+	tm.tick() ;
+	ASSERT_TRUE(tm.getPeerTransferStats(source,info)) ;
+	EXPECT_EQ(INITIAL_WINDOW,info.window) ;
+	EXPECT_EQ(INITIAL_WINDOW,info.inFlight) ;
+	EXPECT_FALSE(data_send.requests.empty()) ;
+
+	// Slow start: the window grows with every byte received, and completed requests give an rtt sample.
+
+	EXPECT_EQ(INITIAL_WINDOW,data_send.answerRequests(tm)) ;
+
+	ASSERT_TRUE(tm.getPeerTransferStats(source,info)) ;
+	EXPECT_EQ(2*INITIAL_WINDOW,info.window) ;
+	EXPECT_EQ(0u,info.inFlight) ;
+	EXPECT_LT(info.rtt,1.0) ;
+
+	tm.tick() ;
+	ASSERT_TRUE(tm.getPeerTransferStats(source,info)) ;
+	EXPECT_EQ(2*INITIAL_WINDOW,info.inFlight) ;
+
+	// Requests that are not answered time out after the min RTO (3 s). The window is then halved, and slow start ends.
+
+	data_send.requests.clear() ;
+	sleep(4) ;
+
+	tm.tick() ;
+	ASSERT_TRUE(tm.getPeerTransferStats(source,info)) ;
+	EXPECT_EQ(INITIAL_WINDOW,info.window) ;
+	EXPECT_EQ(INITIAL_WINDOW,info.inFlight) ;
+
+	// Out of slow start, the window follows the bandwidth delay product. The rate measured so far
+	// (64KB in 4 s) makes it smaller than the minimum window.
+
+	EXPECT_EQ(INITIAL_WINDOW,data_send.answerRequests(tm)) ;
+
+	ASSERT_TRUE(tm.getPeerTransferStats(source,info)) ;
+	EXPECT_EQ(MINIMUM_WINDOW,info.window) ;
+	EXPECT_EQ(0u,info.inFlight) ;
+
+	tm.tick() ;
+	ASSERT_TRUE(tm.getPeerTransferStats(source,info)) ;
+	EXPECT_EQ(MINIMUM_WINDOW,info.inFlight) ;
+
+	remove(path) ;
+}
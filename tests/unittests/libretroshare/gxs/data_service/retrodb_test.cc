@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <list>
+#include <string>
+
+#include "util/retrodb.h"
+
+#define RETRODB_TEST_NAME "retrodb_test_db"
+
+static void countRows(RetroDb& db, const std::string& selection, uint32_t& count,
+                      const std::list<std::string>& selectionArgs = std::list<std::string>())
+{
+	std::list<std::string> columns;
+	columns.push_back("id");
+
+	count = 0;
+	RetroCursor* c = db.sqlQuery("TEST", columns, selection, selectionArgs, "");
+
+	if(c && c->moveToFirst())
+	{
+		do
+			++count;
+		while(c->moveToNext());
+	}
+
+	delete c;
+}
+
+TEST(libretroshare_gxs, RetroDbStatementCache)
+{
+	remove(RETRODB_TEST_NAME);
+
+	RetroDb db(RETRODB_TEST_NAME, RetroDb::OPEN_READWRITE_CREATE);
+	ASSERT_TRUE(db.isOpen());
+	ASSERT_TRUE(db.execSQL("CREATE TABLE TEST (id INT, name TEXT, data BLOB);"));
+
+	// batch insert, the last row has a different set of columns
+	std::list<ContentValue*> cvs;
+	for(int i = 0; i < 100; ++i)
+	{
+		ContentValue* cv = new ContentValue;
+		cv->put("id", (int32_t)i);
+		cv->put("name", std::string("row"));
+		if(i != 99)
+		{
+			char data[4] = { (char)i, 1, 2, 3 };
+			cv->put("data", 4, data);
+		}
+		cvs.push_back(cv);
+	}
+
+	uint32_t hits = 0, misses = 0, hits2 = 0, misses2 = 0;
+	db.getStatementCacheStats(hits, misses);
+
+	EXPECT_TRUE(db.beginTransaction());
+	EXPECT_TRUE(db.sqlInsert("TEST", "", cvs));
+	EXPECT_TRUE(db.commitTransaction());
+
+	for(std::list<ContentValue*>::iterator it = cvs.begin(); it != cvs.end(); ++it)
+		delete *it;
+
+	// BEGIN, COMMIT and two INSERT statements were prepared, nothing more
+	db.getStatementCacheStats(hits2, misses2);
+	EXPECT_EQ(misses + 4, misses2);
+
+	uint32_t count = 0;
+	countRows(db, "", count);
+	EXPECT_EQ(100u, count);
+	countRows(db, "data IS NULL", count);
+	EXPECT_EQ(1u, count);
+
+	// same query again is served from the cache and rebound properly
+	db.getStatementCacheStats(hits, misses);
+	for(int i = 0; i < 10; ++i)
+	{
+		ContentValue cv;
+		cv.put("name", std::string("updated"));
+		EXPECT_TRUE(db.sqlUpdate("TEST", "id=?", std::list<std::string>(1, "5"), cv));
+		countRows(db, "name=?", count, std::list<std::string>(1, "updated"));
+		EXPECT_EQ(1u, count);
+	}
+	db.getStatementCacheStats(hits2, misses2);
+	EXPECT_EQ(misses + 2, misses2);
+	EXPECT_EQ(hits + 18, hits2);
+
+	// queries with literal values are not kept
+	db.getStatementCacheStats(hits, misses);
+	for(int i = 0; i < 10; ++i)
+	{
+		countRows(db, "id=5", count);
+		EXPECT_EQ(1u, count);
+	}
+	db.getStatementCacheStats(hits2, misses2);
+	EXPECT_EQ(misses + 10, misses2);
+	EXPECT_EQ(hits, hits2);
+
+	// two cursors on the same query must not share a statement
+	std::list<std::string> columns;
+	columns.push_back("id");
+	RetroCursor* c1 = db.sqlQuery("TEST", columns, "id<?", std::list<std::string>(1, "2"), "id");
+	RetroCursor* c2 = db.sqlQuery("TEST", columns, "id<?", std::list<std::string>(1, "2"), "id");
+	ASSERT_TRUE(c1 && c2);
+	EXPECT_TRUE(c1->moveToFirst());
+	EXPECT_TRUE(c2->moveToFirst());
+	EXPECT_TRUE(c1->moveToNext());
+	EXPECT_EQ(1, c1->getInt32(0));
+	EXPECT_EQ(0, c2->getInt32(0));
+	delete c1;
+	delete c2;
+
+	// a small cache evicts old statements but keeps working
+	db.setStatementCacheSize(2);
+	for(int i = 0; i < 20; ++i)
+	{
+		char sel[32], arg[16];
+		snprintf(sel, sizeof(sel), "id>=? AND id<%d", 100 + i);
+		snprintf(arg, sizeof(arg), "%d", i);
+		countRows(db, sel, count, std::list<std::string>(1, arg));
+		EXPECT_EQ(100u - i, count);
+	}
+
+	db.setStatementCacheSize(0);
+	countRows(db, "", count);
+	EXPECT_EQ(100u, count);
+
+	db.closeDb();
+	EXPECT_FALSE(db.isOpen());
+
+	remove(RETRODB_TEST_NAME);
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include "libretroshare/serialiser/support.h"
+#include "libretroshare/gxs/common/data_support.h"
+#include "gxs/rsgds.h"
+#include "gxs/rsdataservice.h"
+#include "util/rsdir.h"
+#include "util/rsscopetimer.h"
+
+#define PROFILE_DB_NAME "profile_bench_Store"
+
+static const int PROFILE_BENCH_MSGS  = 400;
+static const int PROFILE_BENCH_BATCH = 20;
+static const int PROFILE_BENCH_READS = 5;
+
+static void removeProfileDb()
+{
+	remove(PROFILE_DB_NAME);
+	remove(PROFILE_DB_NAME "-wal");
+	remove(PROFILE_DB_NAME "-shm");
+	remove(PROFILE_DB_NAME "-journal");
+}
+
+// Stores msgs in small transactions, as they arrive from the network, then
+// reads the whole group back a few times. When benchmarking, prints the
+// throughput of each so that profiles can be compared on the target machine.
+
+static void run_profile(const RetroDbProfile& profile, bool benchmark)
+{
+	removeProfileDb();
+
+	RsDataService* store = new RsDataService(".", PROFILE_DB_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM, NULL, "", profile);
+	RsGxsGroupId grpId = RsGxsGroupId::random();
+
+	RsScopeTimer timer("");
+
+	for(int i = 0; i < PROFILE_BENCH_MSGS; i += PROFILE_BENCH_BATCH)
+	{
+		RsNxsMsgDataTemporaryList msgs;
+
+		for(int j = 0; j < PROFILE_BENCH_BATCH; ++j)
+		{
+			RsNxsMsg* msg = new RsNxsMsg(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+			RsGxsMsgMetaData* msgMeta = new RsGxsMsgMetaData();
+			init_item(*msg);
+			init_item(msgMeta);
+
+			msg->metaData = msgMeta;
+			msgMeta->mMsgId = msg->msgId;
+			msgMeta->mGroupId = msg->grpId = grpId;
+
+			msgs.push_back(msg);
+		}
+
+		store->storeMessage(msgs);
+	}
+
+	double store_time = timer.duration();
+
+	if(!profile.mJournalMode.empty())
+		EXPECT_TRUE(RsDirUtil::fileExists(PROFILE_DB_NAME "-wal"));
+
+	for(int i = 0; i < PROFILE_BENCH_READS; ++i)
+	{
+		GxsMsgReq req;
+		req[grpId] = std::vector<RsGxsMessageId>();
+
+		t_RsGxsGenericDataTemporaryMapVector<RsNxsMsg> msgResult;
+		store->retrieveNxsMsgs(req, msgResult, false, true);
+
+		EXPECT_EQ((size_t)PROFILE_BENCH_MSGS, msgResult[grpId].size());
+	}
+
+	double read_time = timer.duration() - store_time;
+
+	if(benchmark)
+		std::cerr << "RsDataService profile " << profile.mName
+		          << ": storeMessage(): " << PROFILE_BENCH_MSGS/store_time << " msgs/s"
+		          << ", retrieveNxsMsgs(): " << PROFILE_BENCH_MSGS*PROFILE_BENCH_READS/read_time << " msgs/s" << std::endl;
+
+	store->resetDataStore();
+	delete store;
+
+	removeProfileDb();
+}
+
+TEST(libretroshare_gxs, RsDataServiceProfiles)
+{
+	RetroDbProfile profile;
+
+	EXPECT_FALSE(RetroDbProfile::fromName("unknown", profile));
+	EXPECT_EQ("Default", profile.mName);
+
+	EXPECT_TRUE(RetroDbProfile::fromName("throughput", profile));
+	EXPECT_EQ("WAL", profile.mJournalMode);
+
+	run_profile(RetroDbProfile(), false);
+	run_profile(RetroDbProfile::safe(), false);
+	run_profile(RetroDbProfile::throughput(), false);
+}
+
+// Benchmark, disabled by default. Run with --gtest_also_run_disabled_tests.
+
+TEST(libretroshare_gxs, DISABLED_RsDataServiceProfilesBenchmark)
+{
+	run_profile(RetroDbProfile(), true);
+	run_profile(RetroDbProfile::safe(), true);
+	run_profile(RetroDbProfile::throughput(), true);
+}
@@ -23,6 +23,7 @@ TEST(libretroshare_gxs, RsDataService)
 
     test_groupStoreAndRetrieve();
     test_messageStoresAndRetrieve();
+    test_messageMetaQuery();
 }
 
 
@@ -295,6 +296,128 @@ void test_messageStoresAndRetrieve()
 }
 
 
+static bool matchesQuery(const RsGxsMsgMetaData *m, const RsGxsMsgMetaQuery& q)
+{
+    if(q.mFields & RsGxsMsgMetaQuery::FIELD_PUBLISH_TS)
+    {
+        if(q.mPublishedAfter > 0 && m->mPublishTs < q.mPublishedAfter) return false;
+        if(q.mPublishedBefore > 0 && m->mPublishTs > q.mPublishedBefore) return false;
+    }
+    if((q.mFields & RsGxsMsgMetaQuery::FIELD_THREAD_ID) && m->mThreadId != q.mThreadId) return false;
+    if((q.mFields & RsGxsMsgMetaQuery::FIELD_PARENT_ID) && m->mParentId != q.mParentId) return false;
+    if((q.mFields & RsGxsMsgMetaQuery::FIELD_ORIG_MSG_ID) && m->mOrigMsgId != q.mOrigMsgId) return false;
+    if((q.mFields & RsGxsMsgMetaQuery::FIELD_AUTHOR_ID) && m->mAuthorId != q.mAuthorId) return false;
+    if((q.mFields & RsGxsMsgMetaQuery::FIELD_STATUS) && (m->mMsgStatus & q.mStatusMask) != (q.mStatusFilter & q.mStatusMask)) return false;
+
+    return true;
+}
+
+static void checkQuery(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& q, const std::map<RsGxsMessageId, RsGxsMsgMetaData*>& stored)
+{
+    std::set<RsGxsMessageId> expected;
+
+    for(std::map<RsGxsMessageId, RsGxsMsgMetaData*>::const_iterator it = stored.begin(); it != stored.end(); ++it)
+        if(it->second->mGroupId == grpId && matchesQuery(it->second, q))
+            expected.insert(it->first);
+
+    std::vector<RsGxsMsgMetaData*> result;
+    dStore->retrieveGxsMsgMetaData(grpId, q, result);
+
+    std::set<RsGxsMessageId> got;
+
+    for(uint32_t i = 0; i < result.size(); i++)
+    {
+        got.insert(result[i]->mMsgId);
+        delete result[i];
+    }
+
+    EXPECT_TRUE(expected == got);
+}
+
+/*!
+ * Checks that queries on msg meta data return exactly
+ * the messages that match all predicates
+ */
+void test_messageMetaQuery()
+{
+    setUp();
+
+    RsGxsGroupId grpId0 = RsGxsGroupId::random();
+    RsGxsGroupId grpId1 = RsGxsGroupId::random();
+
+    // a few threads and authors, so that the predicates select something
+    std::vector<RsGxsMessageId> threads;
+    std::vector<RsGxsId> authors;
+
+    threads.push_back(RsGxsMessageId());
+    for(int i = 0; i < 4; i++)
+    {
+        threads.push_back(RsGxsMessageId::random());
+        authors.push_back(RsGxsId::random());
+    }
+
+    RsNxsMsgDataTemporaryList msgs;
+    std::map<RsGxsMessageId, RsGxsMsgMetaData*> stored;
+
+    for(int i = 0; i < 200; i++)
+    {
+        RsNxsMsg *msg = new RsNxsMsg(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+        RsGxsMsgMetaData *msgMeta = new RsGxsMsgMetaData();
+        init_item(*msg);
+        init_item(msgMeta);
+
+        msg->metaData = msgMeta;
+        msgMeta->mMsgId = msg->msgId;
+        msgMeta->mGroupId = msg->grpId = (i%4 == 0) ? grpId1 : grpId0;
+        msgMeta->mThreadId = threads[rand()%threads.size()];
+        msgMeta->mParentId = (rand()%3 == 0) ? RsGxsMessageId() : msgMeta->mThreadId;
+        msgMeta->mOrigMsgId = (rand()%2 == 0) ? msgMeta->mMsgId : threads[1];
+        msgMeta->mAuthorId = authors[rand()%authors.size()];
+
+        stored[msg->msgId] = msgMeta;
+        msgs.push_back(msg);
+    }
+
+    dStore->storeMessage(msgs);
+
+    RsGxsMsgMetaQuery q;
+    checkQuery(grpId0, q, stored);
+
+    q.mFields = RsGxsMsgMetaQuery::FIELD_PUBLISH_TS;
+    q.mPublishedAfter = 100;
+    checkQuery(grpId0, q, stored);
+    q.mPublishedBefore = 200;
+    checkQuery(grpId0, q, stored);
+
+    q = RsGxsMsgMetaQuery();
+    q.mFields = RsGxsMsgMetaQuery::FIELD_THREAD_ID;
+    q.mThreadId = threads[2];
+    checkQuery(grpId0, q, stored);
+
+    q = RsGxsMsgMetaQuery();
+    q.mFields = RsGxsMsgMetaQuery::FIELD_PARENT_ID;	// thread heads
+    checkQuery(grpId0, q, stored);
+    checkQuery(grpId1, q, stored);
+
+    q = RsGxsMsgMetaQuery();
+    q.mFields = RsGxsMsgMetaQuery::FIELD_ORIG_MSG_ID;
+    q.mOrigMsgId = threads[1];
+    checkQuery(grpId1, q, stored);
+
+    q = RsGxsMsgMetaQuery();
+    q.mFields = RsGxsMsgMetaQuery::FIELD_AUTHOR_ID | RsGxsMsgMetaQuery::FIELD_STATUS;
+    q.mAuthorId = authors[0];
+    q.mStatusMask = 0x3;
+    q.mStatusFilter = 0x1;
+    checkQuery(grpId0, q, stored);
+
+    q.mFields |= RsGxsMsgMetaQuery::FIELD_THREAD_ID | RsGxsMsgMetaQuery::FIELD_PUBLISH_TS;
+    q.mThreadId = threads[3];
+    q.mPublishedAfter = 50;
+    checkQuery(grpId0, q, stored);
+
+    tearDown();
+}
 
 void setUp(){
     dStore = new RsDataService(".", DATA_BASE_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
@@ -9,6 +9,8 @@ void test_messageStoresAndRetrieve();
 
 void test_groupStoreAndRetrieve();
 
+void test_messageMetaQuery();
+
 void test_storeAndDeleteGroup();
 void test_storeAndDeleteMessage();
 
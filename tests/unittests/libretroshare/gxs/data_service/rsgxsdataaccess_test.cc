@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+
+#include "libretroshare/gxs/common/data_support.h"
+#include "gxs/rsdataservice.h"
+#include "gxs/rsgxsdataaccess.h"
+
+#define ACCESS_DB_NAME "data_access_Store"
+
+class TokenCounter : public RsTokenObserver
+{
+public:
+	TokenCounter() : mMtx("TokenCounter"), mCalls(0), mStatus(0) {}
+
+	virtual void tokenFinished(uint32_t, uint32_t status)
+	{
+		RS_STACK_MUTEX(mMtx);
+		++mCalls;
+		mStatus = status;
+	}
+
+	RsMutex mMtx;
+	int mCalls;
+	uint32_t mStatus;
+};
+
+// Group meta data retrieval waits until it is released, which keeps the requests behind it pending.
+
+class BlockingDataService : public RsDataService
+{
+public:
+	BlockingDataService(const std::string& name)
+	    : RsDataService(".", name, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM) {}
+
+	virtual int retrieveGxsGrpMetaData(RsGxsGrpMetaTemporaryMap& grp)
+	{
+		mRelease.wait(10000);
+		return RsDataService::retrieveGxsGrpMetaData(grp);
+	}
+
+	RsWakeupSignal mRelease;
+};
+
+class CancelThread : public RsSingleJobThread
+{
+public:
+	CancelThread(RsGxsDataAccess *access, uint32_t token) : mAccess(access), mToken(token) {}
+
+	virtual void run()
+	{
+		usleep(100 * 1000);
+		mAccess->cancelRequest(mToken);
+	}
+
+	RsGxsDataAccess *mAccess;
+	uint32_t mToken;
+};
+
+// Requests are processed by the workers of the data access: nobody calls processRequests() here.
+
+TEST(libretroshare_gxs, RsGxsDataAccessCompletion)
+{
+	remove(ACCESS_DB_NAME);
+
+	RsDataService* store = new RsDataService(".", ACCESS_DB_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+	RsGxsDataAccess* access = new RsGxsDataAccess(store);
+
+	std::list<RsGxsGroupId> ids;
+	ids.push_back(RsGxsGroupId::random());
+
+	// waiting
+
+	RsTokReqOptions opts;
+	opts.mReqType = GXS_REQUEST_TYPE_GROUP_IDS;
+	uint32_t token;
+
+	EXPECT_TRUE(access->requestGroupInfo(token, 0, opts));
+	EXPECT_EQ(RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE, access->waitToken(token, 5000));
+
+	std::list<RsGxsGroupId> result;
+	EXPECT_TRUE(access->getGroupList(token, result));
+	EXPECT_TRUE(result.empty());
+
+	// observers
+
+	TokenCounter counter;
+	opts.mReqType = GXS_REQUEST_TYPE_GROUP_META;
+
+	EXPECT_TRUE(access->requestGroupInfo(token, 0, opts, ids));
+	access->addTokenObserver(token, &counter);
+	access->waitToken(token, 5000);
+
+	{
+		RS_STACK_MUTEX(counter.mMtx);
+		EXPECT_EQ(1, counter.mCalls);
+		EXPECT_EQ(RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE, counter.mStatus);
+	}
+
+	// an observer added once the request is processed is called right away
+
+	access->addTokenObserver(token, &counter);
+	{
+		RS_STACK_MUTEX(counter.mMtx);
+		EXPECT_EQ(2, counter.mCalls);
+	}
+
+	// public tokens
+
+	uint32_t public_token = access->generatePublicToken();
+	access->addTokenObserver(public_token, &counter);
+	access->updatePublicRequestStatus(public_token, RsTokenService::GXS_REQUEST_V2_STATUS_FAILED);
+	{
+		RS_STACK_MUTEX(counter.mMtx);
+		EXPECT_EQ(3, counter.mCalls);
+		EXPECT_EQ(RsTokenService::GXS_REQUEST_V2_STATUS_FAILED, counter.mStatus);
+	}
+
+	// unknown tokens fail at once
+
+	EXPECT_EQ(RsTokenService::GXS_REQUEST_V2_STATUS_FAILED, access->waitToken(token + 1000, 5000));
+
+	delete access;
+	delete store;
+	remove(ACCESS_DB_NAME);
+}
+
+// Cancelling a pending request wakes up whoever waits for it.
+
+TEST(libretroshare_gxs, RsGxsDataAccessCancel)
+{
+	remove(ACCESS_DB_NAME);
+
+	BlockingDataService* store = new BlockingDataService(ACCESS_DB_NAME);
+	RsGxsDataAccess* access = new RsGxsDataAccess(store);
+
+	RsTokReqOptions opts;
+	opts.mReqType = GXS_REQUEST_TYPE_GROUP_IDS;
+	uint32_t running, pending;
+
+	EXPECT_TRUE(access->requestGroupInfo(running, 0, opts));
+	EXPECT_TRUE(access->requestGroupInfo(pending, 0, opts));
+
+	TokenCounter counter;
+	access->addTokenObserver(pending, &counter);
+
+	CancelThread canceller(access, pending);
+	canceller.start("cancel");
+
+	// cancelled requests are reported as failed
+
+	time_t start = time(NULL);
+	EXPECT_EQ(RsTokenService::GXS_REQUEST_V2_STATUS_FAILED, access->waitToken(pending, 10000));
+	EXPECT_GE(start + 2, time(NULL));
+
+	{
+		RS_STACK_MUTEX(counter.mMtx);
+		EXPECT_EQ(1, counter.mCalls);
+		EXPECT_EQ(RsTokenService::GXS_REQUEST_V2_STATUS_CANCELLED, counter.mStatus);
+	}
+
+	// the cancelled request is skipped, and its observers are not called again
+
+	store->mRelease.wakeup();
+	EXPECT_EQ(RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE, access->waitToken(running, 5000));
+
+	EXPECT_EQ(RsTokenService::GXS_REQUEST_V2_STATUS_FAILED, access->requestStatus(pending));
+	{
+		RS_STACK_MUTEX(counter.mMtx);
+		EXPECT_EQ(1, counter.mCalls);
+	}
+
+	while(canceller.isRunning())
+		usleep(10 * 1000);
+
+	delete access;
+	delete store;
+	remove(ACCESS_DB_NAME);
+}
+
+// Requests of a data access complete in the order they were made, even when the pool workers and the
+// tick of the service process them at the same time. Statuses are read from the newest request to the
+// oldest: once a completed request is seen, all older ones must be completed as well.
+
+TEST(libretroshare_gxs, RsGxsDataAccessOrder)
+{
+	remove(ACCESS_DB_NAME);
+	remove(ACCESS_DB_NAME "2");
+
+	RsDataService* store = new RsDataService(".", ACCESS_DB_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+	RsDataService* store2 = new RsDataService(".", ACCESS_DB_NAME "2", RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+	RsGxsDataAccess* access = new RsGxsDataAccess(store);
+	RsGxsDataAccess* access2 = new RsGxsDataAccess(store2);
+
+	RsTokReqOptions opts;
+	opts.mReqType = GXS_REQUEST_TYPE_GROUP_IDS;
+
+	std::vector<uint32_t> tokens;
+	uint32_t token;
+
+	for(int i=0;i<100;++i)
+	{
+		EXPECT_TRUE(access->requestGroupInfo(token, 0, opts));
+		tokens.push_back(token);
+
+		// the other data access shares the pool
+		EXPECT_TRUE(access2->requestGroupInfo(token, 0, opts));
+
+		if(i%10 == 0)
+			access->processRequests();
+	}
+
+	bool all_done = false;
+	time_t deadline = time(NULL) + 10;
+
+	while(!all_done && time(NULL) < deadline)
+	{
+		bool newer_done = false;
+		all_done = true;
+
+		for(int i=tokens.size()-1;i>=0;--i)
+		{
+			bool done = (access->requestStatus(tokens[i]) == RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE);
+
+			EXPECT_TRUE(done || !newer_done);
+			newer_done = newer_done || done;
+			all_done = all_done && done;
+		}
+	}
+	EXPECT_TRUE(all_done);
+
+	EXPECT_EQ(RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE, access2->waitToken(token, 5000));
+
+	delete access;
+	delete access2;
+	delete store;
+	delete store2;
+	remove(ACCESS_DB_NAME);
+	remove(ACCESS_DB_NAME "2");
+}
@@ -0,0 +1,71 @@
+/*
+ * rsgxsmsgidfilter_test.cc
+ *
+ * Checks the bloom filter that peers attach to their msg sync requests.
+ */
+
+#include <gtest/gtest.h>
+
+#include "gxs/rsgxsnetutils.h"
+
+static RsGxsMessageId::std_vector random_ids(uint32_t n)
+{
+	RsGxsMessageId::std_vector ids ;
+
+	for(uint32_t i=0;i<n;++i)
+		ids.push_back(RsGxsMessageId::random()) ;
+
+	return ids ;
+}
+
+TEST(libretroshare_gxs, gxs_msg_id_filter)
+{
+	static const uint32_t N = 2000 ;
+
+	RsGxsMessageId::std_vector ids = random_ids(N) ;
+	RsGxsMsgIdFilter filter ;
+
+	EXPECT_TRUE(filter.empty()) ;
+	EXPECT_FALSE(filter.contains(ids[0])) ;
+
+	ASSERT_TRUE(filter.init(N)) ;
+
+	for(uint32_t i=0;i<N;++i)
+		filter.add(ids[i]) ;
+
+	// no false negatives
+
+	for(uint32_t i=0;i<N;++i)
+		EXPECT_TRUE(filter.contains(ids[i])) ;
+
+	// a few false positives, and the same ones after a round trip through the sync item string
+
+	RsGxsMsgIdFilter filter2 ;
+	ASSERT_TRUE(filter2.fromString(filter.toString())) ;
+
+	RsGxsMessageId::std_vector others = random_ids(10*N) ;
+	uint32_t false_positives = 0 ;
+
+	for(uint32_t i=0;i<others.size();++i)
+	{
+		EXPECT_EQ(filter.contains(others[i]),filter2.contains(others[i])) ;
+
+		if(filter.contains(others[i]))
+			++false_positives ;
+	}
+
+	std::cerr << "Msg id filter: " << filter.toString().length()/2 << " bytes for " << N << " ids, " << false_positives << " false positives out of " << others.size() << std::endl;
+
+	EXPECT_LT(false_positives, others.size()/50) ;
+
+	// malformed strings and huge groups are refused
+
+	RsGxsMsgIdFilter filter3 ;
+	EXPECT_FALSE(filter3.fromString("")) ;
+	EXPECT_FALSE(filter3.fromString(std::string(filter.toString().length(),'z'))) ;
+	EXPECT_FALSE(filter3.fromString(filter.toString().substr(1))) ;
+	EXPECT_TRUE(filter3.empty()) ;
+
+	EXPECT_FALSE(filter3.init(1000000)) ;
+	EXPECT_TRUE(filter3.empty()) ;
+}
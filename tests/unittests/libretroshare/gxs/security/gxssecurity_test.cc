@@ -31,6 +31,7 @@
 #include <iostream>
 #include <sstream>
 #include "gxs/gxssecurity.h"
+#include "gxs/rsgxsutil.h"
 #include "util/rsdir.h"
 
 TEST(libretroshare_gxs, GxsSecurity)
@@ -101,3 +102,50 @@ TEST(libretroshare_gxs, GxsSecurity)
 }
 
 
+
+class SignatureCheckJob: public RsGxsValidationJob
+{
+public:
+	SignatureCheckJob(const RsTlvPublicRSAKey& key) : mKey(key),mResult(false) {}
+
+	virtual void run()
+	{
+		mResult = GxsSecurity::validateSignature((char*)mData.data(),mData.size(),mKey,mSignature) ;
+	}
+
+	const RsTlvPublicRSAKey& mKey ;
+	std::vector<unsigned char> mData ;
+	RsTlvKeySignature mSignature ;
+	bool mResult ;
+};
+
+TEST(libretroshare_gxs, GxsValidationPool)
+{
+	RsTlvPublicRSAKey pub_key ;
+	RsTlvPrivateRSAKey priv_key ;
+
+	EXPECT_TRUE(GxsSecurity::generateKeyPair(pub_key,priv_key)) ;
+
+	// sign random data, and corrupt one item out of three
+
+	std::vector<SignatureCheckJob> jobs(50,SignatureCheckJob(pub_key)) ;
+	std::vector<RsGxsValidationJob*> job_list ;
+
+	for(uint32_t i=0;i<jobs.size();++i)
+	{
+		jobs[i].mData.resize(100 + RSRandom::random_u32()%1000) ;
+		RSRandom::random_bytes(jobs[i].mData.data(),jobs[i].mData.size()) ;
+
+		EXPECT_TRUE(GxsSecurity::getSignature((char*)jobs[i].mData.data(),jobs[i].mData.size(),priv_key,jobs[i].mSignature) );
+
+		if(i%3 == 0)
+			jobs[i].mData[0] ^= 0xff ;
+
+		job_list.push_back(&jobs[i]) ;
+	}
+
+	RsGxsValidationPool::instance().runJobs(job_list) ;
+
+	for(uint32_t i=0;i<jobs.size();++i)
+		EXPECT_EQ(i%3 != 0,jobs[i].mResult) ;
+}
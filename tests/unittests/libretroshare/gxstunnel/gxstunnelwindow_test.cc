@@ -0,0 +1,407 @@
+/*
+ * libretroshare/src/tests/gxstunnel: gxstunnelwindow_test.cc
+ *
+ * RetroShare C++ GXS tunnel windowed transport tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <time.h>
+
+#include "gxstunnel/p3gxstunnel.h"
+#include "gxstunnel/rsgxstunnelitems.h"
+
+static const uint32_t TEST_SERVICE_ID = 0xa0 ;
+
+class TestTunnelClient: public RsGxsTunnelService::RsGxsTunnelClientService
+{
+public:
+	virtual void notifyTunnelStatus(const GXSTunnelId&,uint32_t) {}
+	virtual void receiveData(const GXSTunnelId&,unsigned char *data,uint32_t) { free(data) ; }
+	virtual void connectToGxsTunnelService(RsGxsTunnelService *) {}
+	virtual bool acceptDataFromPeer(const RsGxsId&,const GXSTunnelId&,bool) { return true ; }
+};
+
+// Catches the items sent to the tunnels, after a round trip through the serialiser, instead of encrypting them.
+// This class is a friend of p3GxsTunnelService.
+
+class TestGxsTunnelService: public p3GxsTunnelService, public p3GxsTunnelService::TunnelItemSink
+{
+public:
+	typedef p3GxsTunnelService::GxsTunnelPeerInfo GxsTunnelPeerInfo ;
+
+	TestGxsTunnelService() : p3GxsTunnelService(NULL)
+	{
+		registerClientService(TEST_SERVICE_ID,&mClient) ;
+		mItemSink = this ;
+	}
+
+	virtual ~TestGxsTunnelService()
+	{
+		for(std::map<GXSTunnelId,GxsTunnelPeerInfo>::iterator it(_gxs_tunnel_contacts.begin());it!=_gxs_tunnel_contacts.end();++it)
+			locked_deleteDataItems(it->second) ;
+
+		clearSent() ;
+	}
+
+	virtual bool sendTunnelItem(RsGxsTunnelItem *item)
+	{
+		RsGxsTunnelSerialiser ser ;
+		uint32_t size = ser.size(item) ;
+		std::vector<uint8_t> buf(size) ;
+
+		if(!ser.serialise(item,&buf[0],&size))
+			return false ;
+
+		RsGxsTunnelItem *copy = dynamic_cast<RsGxsTunnelItem*>(ser.deserialise(&buf[0],&size)) ;
+
+		if(copy == NULL)
+			return false ;
+
+		copy->PeerId(item->PeerId()) ;
+		mSent.push_back(copy) ;
+		return true ;
+	}
+
+	GXSTunnelId addTunnel()
+	{
+		GXSTunnelId id = GXSTunnelId::random() ;
+		_gxs_tunnel_contacts[id].status = RS_GXS_TUNNEL_STATUS_CAN_TALK ;
+		return id ;
+	}
+
+	GxsTunnelPeerInfo& tunnel(const GXSTunnelId& id) { return _gxs_tunnel_contacts[id] ; }
+
+	// Gives the data items to the receiving side. Returns the sequence numbers of the delivered items, in delivery order.
+
+	std::vector<uint32_t> receive(GxsTunnelPeerInfo& info,RsGxsTunnelDataItem *item,bool ordered)
+	{
+		std::vector<RsGxsTunnelDataItem*> to_deliver ;
+		locked_receiveSequencedData(info,item,ordered,to_deliver) ;
+
+		std::vector<uint32_t> seqs ;
+
+		for(uint32_t i=0;i<to_deliver.size();++i)
+		{
+			seqs.push_back((uint32_t)to_deliver[i]->unique_item_counter) ;
+
+			if(to_deliver[i] != item)
+				delete to_deliver[i] ;
+		}
+		delete item ;
+		return seqs ;
+	}
+
+	void sendPendingData(const GXSTunnelId& id,double now) { locked_sendPendingData(id,tunnel(id),now) ; }
+	void receiveSAck(const GXSTunnelId& id,RsGxsTunnelDataSAckItem *item) { handleRecvTunnelDataSAckItem(id,item) ; }
+	void acknowledge(const GXSTunnelId& id,uint32_t seq,double now) { locked_acknowledgeData(tunnel(id),seq,now) ; }
+
+	void clearSent()
+	{
+		for(uint32_t i=0;i<mSent.size();++i)
+			delete mSent[i] ;
+		mSent.clear() ;
+	}
+
+	TestTunnelClient mClient ;
+	std::vector<RsGxsTunnelItem*> mSent ;
+};
+
+static RsGxsTunnelDataItem *makeDataItem(uint32_t session,uint32_t seq,uint32_t dist)
+{
+	RsGxsTunnelDataItem *item = new RsGxsTunnelDataItem ;
+
+	item->unique_item_counter = ((uint64_t)session << 32) + seq ;
+	item->flags = RS_GXS_TUNNEL_DATA_FLAG_SEQUENCED | (dist << RS_GXS_TUNNEL_DATA_WINDOW_BASE_SHIFT) ;
+	item->service_id = TEST_SERVICE_ID ;
+	item->data_size = 4 ;
+	item->data = (unsigned char *)malloc(4) ;
+	memcpy(item->data,&seq,4) ;
+
+	return item ;
+}
+
+// The service is shared by all tests, since its DH key pool thread should not be stopped right after being started.
+
+class GxsTunnelWindowTest: public ::testing::Test
+{
+protected:
+	static void SetUpTestCase() { mService = new TestGxsTunnelService ; }
+	static void TearDownTestCase() { delete mService ; mService = NULL ; }
+
+	virtual void SetUp() { mService->clearSent() ; }
+
+	static TestGxsTunnelService *mService ;
+};
+
+TestGxsTunnelService *GxsTunnelWindowTest::mService = NULL ;
+
+static std::vector<uint32_t> seqs(uint32_t a)                                  { return std::vector<uint32_t>(1,a) ; }
+static std::vector<uint32_t> seqs(uint32_t a,uint32_t b)                       { std::vector<uint32_t> v(seqs(a)) ; v.push_back(b) ; return v ; }
+static std::vector<uint32_t> seqs(uint32_t a,uint32_t b,uint32_t c)            { std::vector<uint32_t> v(seqs(a,b)) ; v.push_back(c) ; return v ; }
+
+TEST_F(GxsTunnelWindowTest, ReceiveOrderedWithHoles)
+{
+	TestGxsTunnelService& service(*mService) ;
+	GXSTunnelId id = service.addTunnel() ;
+	TestGxsTunnelService::GxsTunnelPeerInfo& info(service.tunnel(id)) ;
+
+	EXPECT_EQ(seqs(1),service.receive(info,makeDataItem(7,1,0),true)) ;
+	EXPECT_TRUE(info.ack_needed) ;
+
+	// 3 and 4 wait for 2.
+
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,3,2),true).empty()) ;
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,4,3),true).empty()) ;
+	EXPECT_EQ(2u,info.next_recv_seq) ;
+	EXPECT_EQ(2u,info.recv_out_of_order.size()) ;
+	EXPECT_EQ(2u,info.recv_held_data.size()) ;
+
+	EXPECT_EQ(seqs(2,3,4),service.receive(info,makeDataItem(7,2,1),true)) ;
+	EXPECT_EQ(5u,info.next_recv_seq) ;
+	EXPECT_TRUE(info.recv_out_of_order.empty()) ;
+	EXPECT_TRUE(info.recv_held_data.empty()) ;
+	EXPECT_EQ(4u,info.total_data_packets_received) ;
+}
+
+TEST_F(GxsTunnelWindowTest, ReceiveUnorderedWithHoles)
+{
+	TestGxsTunnelService& service(*mService) ;
+	GXSTunnelId id = service.addTunnel() ;
+	TestGxsTunnelService::GxsTunnelPeerInfo& info(service.tunnel(id)) ;
+
+	EXPECT_EQ(seqs(1),service.receive(info,makeDataItem(7,1,0),false)) ;
+	EXPECT_EQ(seqs(3),service.receive(info,makeDataItem(7,3,2),false)) ;
+	EXPECT_EQ(2u,info.next_recv_seq) ;
+	EXPECT_EQ(seqs(2),service.receive(info,makeDataItem(7,2,1),false)) ;
+	EXPECT_EQ(4u,info.next_recv_seq) ;
+	EXPECT_TRUE(info.recv_held_data.empty()) ;
+}
+
+TEST_F(GxsTunnelWindowTest, ReceiveDuplicates)
+{
+	TestGxsTunnelService& service(*mService) ;
+	GXSTunnelId id = service.addTunnel() ;
+	TestGxsTunnelService::GxsTunnelPeerInfo& info(service.tunnel(id)) ;
+
+	EXPECT_EQ(seqs(1),service.receive(info,makeDataItem(7,1,0),true)) ;
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,3,2),true).empty()) ;
+
+	// Items re-sent because the ACK was lost are not delivered again, but acknowledged again.
+
+	info.ack_needed = false ;
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,1,0),true).empty()) ;
+	EXPECT_TRUE(info.ack_needed) ;
+
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,3,2),true).empty()) ;
+	EXPECT_EQ(1u,info.recv_held_data.size()) ;
+	EXPECT_EQ(2u,info.total_data_packets_received) ;
+
+	EXPECT_EQ(seqs(2,3),service.receive(info,makeDataItem(7,2,1),true)) ;
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,3,2),false).empty()) ;
+	EXPECT_EQ(3u,info.total_data_packets_received) ;
+}
+
+TEST_F(GxsTunnelWindowTest, ReceiveSessionChange)
+{
+	TestGxsTunnelService& service(*mService) ;
+	GXSTunnelId id = service.addTunnel() ;
+	TestGxsTunnelService::GxsTunnelPeerInfo& info(service.tunnel(id)) ;
+
+	EXPECT_EQ(seqs(1),service.receive(info,makeDataItem(7,1,0),true)) ;
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,3,2),true).empty()) ;
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,5,4),true).empty()) ;
+
+	// The peer restarted: the items it lost will never come, so the held items are delivered before the new ones.
+
+	EXPECT_EQ(seqs(3,5,1),service.receive(info,makeDataItem(8,1,0),true)) ;
+	EXPECT_EQ(8u,info.recv_session) ;
+	EXPECT_EQ(2u,info.next_recv_seq) ;
+	EXPECT_TRUE(info.recv_out_of_order.empty()) ;
+	EXPECT_TRUE(info.recv_held_data.empty()) ;
+
+	// Same sequence numbers in the new session are new items.
+
+	EXPECT_EQ(seqs(2),service.receive(info,makeDataItem(8,2,1),true)) ;
+}
+
+TEST_F(GxsTunnelWindowTest, ReceiveWindowStartMoves)
+{
+	TestGxsTunnelService& service(*mService) ;
+	GXSTunnelId id = service.addTunnel() ;
+	TestGxsTunnelService::GxsTunnelPeerInfo& info(service.tunnel(id)) ;
+
+	EXPECT_EQ(seqs(1),service.receive(info,makeDataItem(7,1,0),true)) ;
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,4,3),true).empty()) ;
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,6,5),true).empty()) ;
+
+	// The sender got ACKs for all items up to 3, that we lost: it does not wait for them anymore, and neither do we.
+
+	EXPECT_EQ(seqs(4,5,6),service.receive(info,makeDataItem(7,5,1),true)) ;
+	EXPECT_EQ(7u,info.next_recv_seq) ;
+	EXPECT_TRUE(info.recv_out_of_order.empty()) ;
+	EXPECT_TRUE(info.recv_held_data.empty()) ;
+
+	// An item that was acknowledged already is a duplicate.
+
+	EXPECT_TRUE(service.receive(info,makeDataItem(7,2,1),true).empty()) ;
+
+	// A receiver that lost its state starts at the window of the sender.
+
+	TestGxsTunnelService::GxsTunnelPeerInfo fresh ;
+	EXPECT_TRUE(service.receive(fresh,makeDataItem(7,10,2),true).empty()) ;
+	EXPECT_EQ(8u,fresh.next_recv_seq) ;
+	EXPECT_EQ(seqs(8),service.receive(fresh,makeDataItem(7,8,0),true)) ;
+	EXPECT_EQ(seqs(9,10),service.receive(fresh,makeDataItem(7,9,1),true)) ;
+	EXPECT_EQ(11u,fresh.next_recv_seq) ;
+}
+
+TEST_F(GxsTunnelWindowTest, SendWindowAndSAck)
+{
+	TestGxsTunnelService& service(*mService) ;
+	GXSTunnelId sender = service.addTunnel() ;
+	GXSTunnelId receiver = service.addTunnel() ;
+	uint8_t data[100] = { 0 } ;
+
+	for(uint32_t i=0;i<12;++i)
+		EXPECT_TRUE(service.sendData(sender,TEST_SERVICE_ID,data,sizeof(data))) ;
+
+	TestGxsTunnelService::GxsTunnelPeerInfo& sinfo(service.tunnel(sender)) ;
+	EXPECT_EQ(12u,sinfo.outgoing_data.size()) ;
+
+	// Only the initial window is sent. Each item tells how far it is from the oldest unacknowledged item.
+
+	double now = time(NULL) ;	// same clock as the ACKs handled by the service
+	service.sendPendingData(sender,now) ;
+
+	ASSERT_EQ(8u,service.mSent.size()) ;
+
+	for(uint32_t i=0;i<service.mSent.size();++i)
+	{
+		RsGxsTunnelDataItem *item = dynamic_cast<RsGxsTunnelDataItem*>(service.mSent[i]) ;
+		ASSERT_TRUE(item != NULL) ;
+		EXPECT_EQ(i+1,(uint32_t)item->unique_item_counter) ;
+		EXPECT_EQ(sinfo.send_session,(uint32_t)(item->unique_item_counter >> 32)) ;
+		EXPECT_EQ(RS_GXS_TUNNEL_DATA_FLAG_SEQUENCED | (i << RS_GXS_TUNNEL_DATA_WINDOW_BASE_SHIFT),item->flags) ;
+		EXPECT_EQ(sizeof(data),item->data_size) ;
+	}
+
+	// Item 3 is lost. The others reach the receiver, which acknowledges them all in one item.
+
+	TestGxsTunnelService::GxsTunnelPeerInfo& rinfo(service.tunnel(receiver)) ;
+	std::vector<RsGxsTunnelItem*> sent(service.mSent) ;
+	service.mSent.clear() ;
+
+	for(uint32_t i=0;i<sent.size();++i)
+		if(i == 2)
+			delete sent[i] ;
+		else
+			service.receive(rinfo,dynamic_cast<RsGxsTunnelDataItem*>(sent[i]),false) ;
+
+	service.sendPendingData(receiver,now) ;
+
+	ASSERT_EQ(1u,service.mSent.size()) ;
+	RsGxsTunnelDataSAckItem *sack = dynamic_cast<RsGxsTunnelDataSAckItem*>(service.mSent[0]) ;
+	ASSERT_TRUE(sack != NULL) ;
+	EXPECT_EQ(((uint64_t)sinfo.send_session << 32) + 2,sack->cumulative_counter) ;
+	ASSERT_EQ(5u,sack->selective_acks.size()) ;
+
+	for(uint32_t i=0;i<sack->selective_acks.size();++i)
+		EXPECT_EQ(i+4,sack->selective_acks[i]) ;
+
+	EXPECT_FALSE(rinfo.ack_needed) ;
+
+	// The sender forgets acknowledged items, and its window grows by one item per ACK.
+
+	service.receiveSAck(sender,sack) ;
+	service.clearSent() ;
+
+	EXPECT_EQ(5u,sinfo.outgoing_data.size()) ;
+	EXPECT_TRUE(sinfo.outgoing_data.find(3) != sinfo.outgoing_data.end()) ;
+	EXPECT_EQ(15.0,sinfo.send_window) ;
+	EXPECT_GT(sinfo.rto,0.0) ;
+
+	// ACKs for other sessions are ignored.
+
+	RsGxsTunnelDataSAckItem other ;
+	other.cumulative_counter = ((uint64_t)(sinfo.send_session+1) << 32) + 10 ;
+	service.receiveSAck(sender,&other) ;
+	EXPECT_EQ(5u,sinfo.outgoing_data.size()) ;
+
+	// Once the delay is over, item 3 is sent again along with the new items. The window now starts at 3.
+
+	service.sendPendingData(sender,now + sinfo.rto) ;
+
+	ASSERT_EQ(5u,service.mSent.size()) ;
+
+	for(uint32_t i=0;i<service.mSent.size();++i)
+	{
+		RsGxsTunnelDataItem *item = dynamic_cast<RsGxsTunnelDataItem*>(service.mSent[i]) ;
+		ASSERT_TRUE(item != NULL) ;
+
+		uint32_t seq = (i == 0)?3:(i+8) ;
+		EXPECT_EQ(seq,(uint32_t)item->unique_item_counter) ;
+		EXPECT_EQ(RS_GXS_TUNNEL_DATA_FLAG_SEQUENCED | ((seq-3) << RS_GXS_TUNNEL_DATA_WINDOW_BASE_SHIFT),item->flags) ;
+	}
+	EXPECT_EQ(2u,sinfo.outgoing_data[3].send_count) ;
+
+	// The time out means congestion: the window is halved.
+
+	EXPECT_EQ(7.5,sinfo.send_window) ;
+}
+
+TEST_F(GxsTunnelWindowTest, TimeAcrossOldClockWrap)
+{
+	TestGxsTunnelService& service(*mService) ;
+	GXSTunnelId sender = service.addTunnel() ;
+	uint8_t data[100] = { 0 } ;
+
+	EXPECT_TRUE(service.sendData(sender,TEST_SERVICE_ID,data,sizeof(data))) ;
+	EXPECT_TRUE(service.sendData(sender,TEST_SERVICE_ID,data,sizeof(data))) ;
+
+	TestGxsTunnelService::GxsTunnelPeerInfo& sinfo(service.tunnel(sender)) ;
+
+	// Sent just before the point where a clock modulo 10000 s would wrap, acknowledged just after it.
+
+	double before_wrap = 19999.5 ;
+	service.sendPendingData(sender,before_wrap) ;
+	ASSERT_EQ(2u,service.mSent.size()) ;
+	service.clearSent() ;
+
+	service.acknowledge(sender,1,before_wrap + 0.6) ;
+
+	EXPECT_EQ(1u,sinfo.outgoing_data.size()) ;
+	EXPECT_NEAR(0.6,sinfo.srtt,1e-6) ;
+	EXPECT_EQ(2.0,sinfo.rto) ;
+
+	// Item 2 is not re-sent before its time out, and is re-sent once it is over.
+
+	service.sendPendingData(sender,before_wrap + 0.7) ;
+	EXPECT_TRUE(service.mSent.empty()) ;
+
+	service.sendPendingData(sender,before_wrap + sinfo.rto) ;
+	ASSERT_EQ(1u,service.mSent.size()) ;
+
+	RsGxsTunnelDataItem *item = dynamic_cast<RsGxsTunnelDataItem*>(service.mSent[0]) ;
+	ASSERT_TRUE(item != NULL) ;
+	EXPECT_EQ(2u,(uint32_t)item->unique_item_counter) ;
+	EXPECT_EQ(2u,sinfo.outgoing_data[2].send_count) ;
+}
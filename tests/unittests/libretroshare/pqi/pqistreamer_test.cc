@@ -0,0 +1,394 @@
+/*
+ * libretroshare/src/tests/pqi: pqistreamer_test.cc
+ *
+ * RetroShare C++ streamer receive buffer and outgoing slicing tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <vector>
+
+#include "pqi/pqistreamer.h"
+#include "pqi/pqiqosstreamer.h"
+#include "serialiser/rsserial.h"
+
+// Gives the streamer the bytes that were queued, as a socket would. Reads never return partial data.
+// Sent data is kept. Writes can be made to fail, in which case nothing is written, as with SSL_write().
+
+class TestBinInterface: public BinInterface
+{
+public:
+	TestBinInterface() : mActive(true), mCanSend(true), mFailedWrites(0), mReadTimeout(0) {}
+
+	virtual int tick() { return 1; }
+	virtual int senddata(void *data, int len)
+	{
+		mWrites.push_back(std::vector<uint8_t>((uint8_t*)data,(uint8_t*)data+len)) ;
+
+		if(mFailedWrites > 0)
+		{
+			--mFailedWrites ;
+			return -1 ;
+		}
+		mSent.insert(mSent.end(),(uint8_t*)data,(uint8_t*)data+len) ;
+		return len ;
+	}
+	virtual int readdata(void *data, int len)
+	{
+		if(len > (int)mData.size())
+			return 0 ;
+
+		memcpy(data,&mData[0],len) ;
+		mData.erase(mData.begin(),mData.begin()+len) ;
+		return len ;
+	}
+	virtual int netstatus() { return 1; }
+	virtual int isactive() { return mActive; }
+	virtual bool moretoread(uint32_t usec) { mReadTimeout = usec; return !mData.empty(); }
+	virtual bool cansend(uint32_t) { return mCanSend; }
+	virtual int close() { return 1; }
+	virtual RsFileHash gethash() { return RsFileHash(); }
+	virtual bool bandwidthLimited() { return false; }
+
+	// Queues a packet slice, using the header of the packet slicing protocol. The content is not a valid
+	// item: only the reassembly of the packets is tested here.
+
+	void addSlice(uint32_t packet_id,uint8_t flags,uint32_t size)
+	{
+		uint8_t header[8] = { 0x10, flags, uint8_t(packet_id >> 24), uint8_t(packet_id >> 16), uint8_t(packet_id >> 8), uint8_t(packet_id), uint8_t(size >> 8), uint8_t(size) } ;
+
+		mData.insert(mData.end(),header,header+8) ;
+		mData.insert(mData.end(),size,0x55) ;
+	}
+
+	std::vector<uint8_t> mData ;
+
+	bool mActive ;
+	bool mCanSend ;
+	int mFailedWrites ;
+	uint32_t mReadTimeout ;		// timeout of the last wait for incoming data
+	std::vector<std::vector<uint8_t> > mWrites ;	// all write attempts
+	std::vector<uint8_t> mSent ;
+};
+
+class TestStreamer: public pqistreamer
+{
+public:
+	TestStreamer(BinInterface *bio) : pqistreamer(new RsSerialiser(), RsPeerId::random(), bio, BIN_FLAGS_NO_CLOSE) {}
+
+	void readAll()
+	{
+		while(tick_recv(0)) ;
+	}
+};
+
+static void addPacket(TestBinInterface& bio,uint32_t packet_id)
+{
+	bio.addSlice(packet_id,0x01,10000) ;
+	bio.addSlice(packet_id,0x00,10000) ;
+	bio.addSlice(packet_id,0x02,10000) ;
+}
+
+TEST(libretroshare_pqi, StreamerRecvBuffers)
+{
+	TestBinInterface bio ;
+	TestStreamer streamer(&bio) ;
+
+	RsBwRates rates ;
+	streamer.getRates(rates) ;
+	EXPECT_EQ(0u,rates.mRecvAllocs) ;
+	EXPECT_EQ(0u,rates.mRecvAllocBytes) ;
+	EXPECT_EQ(0u,rates.mRecvBufferedBytes) ;
+
+	// The first packet allocates the read buffer and a reassembly buffer, which grows once.
+
+	addPacket(bio,1) ;
+	streamer.readAll() ;
+
+	streamer.getRates(rates) ;
+	uint32_t allocs = rates.mRecvAllocs ;
+	uint64_t alloc_bytes = rates.mRecvAllocBytes ;
+
+	EXPECT_EQ(3u,allocs) ;
+	EXPECT_EQ(0u,rates.mRecvReuses) ;
+	EXPECT_GE(alloc_bytes,30000u) ;
+	EXPECT_GE(rates.mRecvBufferedBytes,30000u) ;
+
+	// The next packets reuse the reassembly buffer, and do not allocate anything.
+
+	for(uint32_t i=2;i<7;++i)
+		addPacket(bio,i) ;
+
+	streamer.readAll() ;
+	EXPECT_TRUE(bio.mData.empty()) ;
+
+	streamer.getRates(rates) ;
+	EXPECT_EQ(allocs,rates.mRecvAllocs) ;
+	EXPECT_EQ(alloc_bytes,rates.mRecvAllocBytes) ;
+	EXPECT_EQ(5u,rates.mRecvReuses) ;
+
+	// Interleaved packets need a second buffer, that is kept afterwards.
+
+	bio.addSlice(10,0x01,10000) ;
+	bio.addSlice(11,0x01,10000) ;
+	bio.addSlice(10,0x02,10000) ;
+	bio.addSlice(11,0x02,10000) ;
+	streamer.readAll() ;
+
+	streamer.getRates(rates) ;
+	EXPECT_EQ(allocs+2,rates.mRecvAllocs) ;
+	EXPECT_EQ(6u,rates.mRecvReuses) ;
+
+	addPacket(bio,12) ;
+	streamer.readAll() ;
+
+	RsBwRates rates2 ;
+	streamer.getRates(rates2) ;
+	EXPECT_EQ(rates.mRecvAllocs,rates2.mRecvAllocs) ;
+	EXPECT_EQ(rates.mRecvBufferedBytes,rates2.mRecvBufferedBytes) ;
+}
+
+// Outgoing items are sliced by pqiQoS. The streamer owns the queued buffers.
+
+class TestQoSStreamer: public pqiQoSstreamer
+{
+public:
+	TestQoSStreamer(BinInterface *bio) : pqiQoSstreamer(NULL, new RsSerialiser(), RsPeerId::random(), bio, BIN_FLAGS_NO_CLOSE) {}
+
+	// Queues a buffer of the given size. Its content is not a valid item, since it is not deserialised.
+
+	std::vector<uint8_t> queue(uint32_t size)
+	{
+		std::vector<uint8_t> data(size) ;
+
+		for(uint32_t i=0;i<size;++i)
+			data[i] = uint8_t(i*7) ;
+
+		void *ptr = rs_malloc(size) ;
+		memcpy(ptr,&data[0],size) ;
+
+		RS_STACK_MUTEX(mStreamerMtx) ;
+		locked_storeInOutputQueue(ptr,size,3) ;
+		return data ;
+	}
+
+	int send() { return tick_send(0) ; }
+	int recv() { return tick_recv(0) ; }
+
+	void dataTick() { data_tick() ; }
+	uint32_t sendBackoff() const { return mSendBackoff ; }
+	bool outputPending() const { return mOutputPending ; }
+};
+
+static const uint8_t SLICING_PROBE[8] = { 0x02, 0xaa, 0xbb, 0xcc, 0x00, 0x00, 0x00, 0x08 } ;
+
+// Tells the streamer that the peer accepts packet slices.
+
+static void acceptSlicing(TestBinInterface& bio,TestQoSStreamer& streamer)
+{
+	bio.mData.insert(bio.mData.end(),SLICING_PROBE,SLICING_PROBE+8) ;
+	while(streamer.recv()) ;
+}
+
+struct SentSlice
+{
+	uint8_t flags ;
+	uint32_t packet_id ;
+	std::vector<uint8_t> data ;
+};
+
+// Splits the sent stream into slices. The probe that the streamer sends first is skipped.
+
+static bool parseSent(const std::vector<uint8_t>& sent,std::vector<SentSlice>& slices)
+{
+	uint32_t offset = 0 ;
+
+	if(sent.size() >= 8 && !memcmp(&sent[0],SLICING_PROBE,8))
+		offset = 8 ;
+
+	while(offset + 8 <= sent.size())
+	{
+		if(sent[offset] != 0x10)
+			return false ;
+
+		SentSlice s ;
+		s.flags = sent[offset+1] ;
+		s.packet_id = (sent[offset+2] << 24) + (sent[offset+3] << 16) + (sent[offset+4] << 8) + sent[offset+5] ;
+		uint32_t size = (sent[offset+6] << 8) + sent[offset+7] ;
+
+		if(offset + 8 + size > sent.size())
+			return false ;
+
+		s.data.assign(sent.begin()+offset+8,sent.begin()+offset+8+size) ;
+		slices.push_back(s) ;
+		offset += 8 + size ;
+	}
+	return offset == sent.size() ;
+}
+
+// A large item goes out in several slices that are views into its buffer, which is freed once, with the last one.
+// Run under valgrind or ASan to check the frees.
+
+TEST(libretroshare_pqi, StreamerSendSlices)
+{
+	TestBinInterface bio ;
+	TestQoSStreamer streamer(&bio) ;
+	acceptSlicing(bio,streamer) ;
+
+	std::vector<uint8_t> data = streamer.queue(2000) ;
+
+	while(streamer.send()) ;
+
+	std::vector<SentSlice> slices ;
+	ASSERT_TRUE(parseSent(bio.mSent,slices)) ;
+	ASSERT_EQ(4u,slices.size()) ;
+
+	std::vector<uint8_t> received ;
+
+	for(uint32_t i=0;i<slices.size();++i)
+	{
+		EXPECT_EQ(slices[0].packet_id,slices[i].packet_id) ;
+		EXPECT_EQ((i == 0)?0x01:0x00,slices[i].flags & 0x01) ;		// starts
+		EXPECT_EQ((i == 3)?0x02:0x00,slices[i].flags & 0x02) ;		// ends
+		received.insert(received.end(),slices[i].data.begin(),slices[i].data.end()) ;
+	}
+	EXPECT_TRUE(received == data) ;
+	EXPECT_EQ(0,streamer.getQueueSize(false)) ;
+}
+
+// A write that does not complete leaves the data in the pending buffer, which is written again as is on the next tick.
+
+TEST(libretroshare_pqi, StreamerSendResumes)
+{
+	TestBinInterface bio ;
+	TestQoSStreamer streamer(&bio) ;
+	acceptSlicing(bio,streamer) ;
+
+	std::vector<uint8_t> data = streamer.queue(2000) ;
+
+	bio.mFailedWrites = 1 ;
+	EXPECT_EQ(1,streamer.send()) ;
+	ASSERT_EQ(1u,bio.mWrites.size()) ;
+	EXPECT_TRUE(bio.mSent.empty()) ;
+
+	while(streamer.send()) ;
+
+	ASSERT_GE(bio.mWrites.size(),2u) ;
+	EXPECT_TRUE(bio.mWrites[0] == bio.mWrites[1]) ;
+
+	std::vector<SentSlice> slices ;
+	ASSERT_TRUE(parseSent(bio.mSent,slices)) ;
+
+	std::vector<uint8_t> received ;
+	for(uint32_t i=0;i<slices.size();++i)
+		received.insert(received.end(),slices[i].data.begin(),slices[i].data.end()) ;
+
+	EXPECT_TRUE(received == data) ;
+}
+
+// Items that cannot be sent, and data pending when the connection goes down, are freed exactly once.
+// Run under valgrind or ASan to check for leaks and double frees.
+
+TEST(libretroshare_pqi, StreamerSendErrorAndReset)
+{
+	TestBinInterface bio ;
+
+	{
+		// Without packet slicing, an item larger than the maximum packet size cannot be sent.
+
+		TestQoSStreamer streamer(&bio) ;
+		streamer.queue(getRsPktMaxSize() + 1000) ;
+
+		for(int i=0;i<10 && streamer.send();++i) ;
+
+		EXPECT_EQ(0,streamer.getQueueSize(false)) ;
+		EXPECT_TRUE(bio.mSent.empty()) ;
+	}
+	{
+		// The connection goes down while an item is half sent, and a write is pending.
+
+		TestQoSStreamer streamer(&bio) ;
+		acceptSlicing(bio,streamer) ;
+		streamer.queue(2000) ;
+		streamer.queue(100000) ;
+
+		bio.mFailedWrites = 1 ;
+		EXPECT_EQ(1,streamer.send()) ;
+		EXPECT_EQ(2,streamer.getQueueSize(false)) ;
+
+		bio.mActive = false ;
+		EXPECT_EQ(0,streamer.send()) ;
+		EXPECT_EQ(0,streamer.getQueueSize(false)) ;
+		bio.mActive = true ;
+	}
+	{
+		// Items still queued, one of them half sent, and the pending write are freed with the streamer.
+
+		TestQoSStreamer streamer(&bio) ;
+		acceptSlicing(bio,streamer) ;
+		streamer.queue(100000) ;
+		streamer.queue(2000) ;
+
+		bio.mFailedWrites = 1 ;
+		EXPECT_EQ(1,streamer.send()) ;
+		EXPECT_EQ(2,streamer.getQueueSize(false)) ;
+	}
+}
+
+// While the output stays blocked, the streamer thread backs off up to the receive timeout instead of
+// polling the socket every millisecond. It waits for incoming data again once everything is sent.
+
+TEST(libretroshare_pqi, StreamerSendBackoff)
+{
+	TestBinInterface bio ;
+	TestQoSStreamer streamer(&bio) ;
+
+	streamer.dataTick() ;
+	EXPECT_FALSE(streamer.outputPending()) ;
+	EXPECT_EQ(10000u,bio.mReadTimeout) ;
+	EXPECT_EQ(0u,streamer.sendBackoff()) ;
+
+	size_t sent = bio.mSent.size() ;	// the packet slicing probe
+
+	bio.mCanSend = false ;
+	streamer.queue(2000) ;
+
+	uint32_t expected[] = { 1000, 2000, 4000, 8000, 10000, 10000 } ;
+
+	for(int i=0;i<6;++i)
+	{
+		streamer.dataTick() ;
+		EXPECT_TRUE(streamer.outputPending()) ;
+		EXPECT_EQ(expected[i],streamer.sendBackoff()) ;
+	}
+	EXPECT_EQ(0u,bio.mReadTimeout) ;	// no wait for incoming data while output is pending
+	EXPECT_EQ(sent,bio.mSent.size()) ;
+
+	bio.mCanSend = true ;
+	streamer.dataTick() ;
+
+	EXPECT_FALSE(streamer.outputPending()) ;
+	EXPECT_EQ(0u,streamer.sendBackoff()) ;
+	EXPECT_EQ(sent + 2000,bio.mSent.size()) ;
+
+	streamer.dataTick() ;
+	EXPECT_EQ(10000u,bio.mReadTimeout) ;
+}
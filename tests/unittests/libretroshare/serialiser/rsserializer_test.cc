@@ -0,0 +1,168 @@
+/*
+ * libretroshare/src/tests/serialiser: rsserializer_test.cc
+ *
+ * RetroShare Serialiser.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare@lunamutt.com".
+ *
+ */
+
+#include <string.h>
+#include <stdexcept>
+
+#include "support.h"
+#include "libretroshare/gxs/common/data_support.h"
+#include "rsitems/rsnxsitems.h"
+#include "chat/rschatitems.h"
+#include "turtle/rsturtleitem.h"
+#include "util/rsrandom.h"
+#include "util/rsscopetimer.h"
+
+// defined in rsmsgitem_test.cc
+void init_item(RsChatMsgItem& cmi);
+
+static const uint32_t BENCH_ROUNDS = 20000 ;
+static const uint8_t  CANARY = 0xa5 ;
+
+// Checks that serialise() works in one pass into a buffer larger than the
+// item, that it stays within the item size, and that it refuses a buffer that
+// is too small without writing past its end.
+
+static void test_single_pass(RsItem& item, RsGenericSerializer& ser, const std::string& name)
+{
+	uint32_t size = ser.size(&item) ;
+	uint32_t capacity = size + 512 ;
+
+	std::vector<uint8_t> buffer(capacity, CANARY) ;
+	uint32_t sersize = capacity ;
+
+	EXPECT_TRUE(ser.serialise(&item, &buffer[0], &sersize)) ;
+	EXPECT_EQ(size, sersize) ;
+	EXPECT_EQ(size, getRsItemSize(&buffer[0])) ;
+
+	for(uint32_t i=size;i<capacity;++i)
+		EXPECT_EQ(CANARY, buffer[i]) ;
+
+	uint32_t sersize2 = sersize ;
+	RsItem *output = ser.deserialise(&buffer[0], &sersize2) ;
+
+	EXPECT_TRUE(output != NULL) ;
+	EXPECT_EQ(sersize, sersize2) ;
+	delete output ;
+
+	std::vector<uint8_t> small(size, CANARY) ;
+	uint32_t small_size = size - 1 ;
+
+	EXPECT_THROW(ser.serialise(&item, &small[0], &small_size), std::runtime_error) ;
+	EXPECT_EQ(CANARY, small[size-1]) ;
+}
+
+// Prints the cost of the former size()+serialise() sequence against serialise() alone.
+
+static void bench_single_pass(RsItem& item, RsGenericSerializer& ser, const std::string& name)
+{
+	uint32_t size = ser.size(&item) ;
+	uint32_t capacity = size + 512 ;
+
+	std::vector<uint8_t> buffer(capacity) ;
+	uint32_t sersize ;
+
+	RsScopeTimer timer("") ;
+	for(uint32_t i=0;i<BENCH_ROUNDS;++i)
+	{
+		sersize = ser.size(&item) ;
+		ser.serialise(&item, &buffer[0], &sersize) ;
+	}
+	double t1 = timer.duration() ;
+
+	timer.start() ;
+	for(uint32_t i=0;i<BENCH_ROUNDS;++i)
+	{
+		sersize = capacity ;
+		ser.serialise(&item, &buffer[0], &sersize) ;
+	}
+	double t2 = timer.duration() ;
+
+	std::cerr << name << " (" << size << " bytes): size()+serialise(): " << t1*1e9/BENCH_ROUNDS
+	          << " ns/item, serialise(): " << t2*1e9/BENCH_ROUNDS << " ns/item" << std::endl;
+}
+
+static void single_pass_items(void (*f)(RsItem&, RsGenericSerializer&, const std::string&))
+{
+	RsNxsMsg nxsmsg(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM) ;
+	init_item(nxsmsg) ;
+	RsNxsSerialiser nxsser(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM) ;
+	f(nxsmsg, nxsser, "RsNxsMsg") ;
+
+	RsTurtleGenericDataItem tdata ;
+	tdata.tunnel_id = RSRandom::random_u32() ;
+	tdata.data_size = 8000 ;
+	tdata.data_bytes = rs_malloc(tdata.data_size) ;
+	RSRandom::random_bytes((unsigned char*)tdata.data_bytes, tdata.data_size) ;
+	RsTurtleSerialiser turtleser ;
+	f(tdata, turtleser, "RsTurtleGenericDataItem") ;
+
+	RsChatMsgItem chatmsg ;
+	init_item(chatmsg) ;
+	RsChatSerialiser chatser ;
+	f(chatmsg, chatser, "RsChatMsgItem") ;
+}
+
+TEST(libretroshare_serialiser, RsGenericSerializerSinglePass)
+{
+	single_pass_items(test_single_pass) ;
+}
+
+// Benchmark, disabled by default. Run with --gtest_also_run_disabled_tests.
+
+TEST(libretroshare_serialiser, DISABLED_RsGenericSerializerSinglePassBenchmark)
+{
+	single_pass_items(bench_single_pass) ;
+}
+
+// Copies of a raw item share the serialised data, which must survive the
+// original item, and serialise to the same packet.
+
+TEST(libretroshare_serialiser, RsRawItemSharedData)
+{
+	const uint32_t size = 1000 ;
+
+	RsRawItem *raw = new RsRawItem(0x02001100,size) ;
+	RSRandom::random_bytes((unsigned char *)raw->getRawData(),size) ;
+
+	std::vector<unsigned char> original((unsigned char *)raw->getRawData(),(unsigned char *)raw->getRawData()+size) ;
+
+	RsRawItem *copy = new RsRawItem(*raw) ;
+	copy->PeerId(RsPeerId::random()) ;
+
+	EXPECT_EQ(raw->getRawData(),copy->getRawData()) ;
+	EXPECT_EQ(size,copy->getRawLength()) ;
+	EXPECT_EQ(raw->PacketId(),copy->PacketId()) ;
+	EXPECT_NE(raw->PeerId(),copy->PeerId()) ;
+
+	delete raw ;
+
+	RsRawSerialiser rss ;
+	std::vector<unsigned char> packet(size) ;
+	uint32_t pktsize = size ;
+
+	EXPECT_TRUE(rss.serialise(copy,packet.data(),&pktsize)) ;
+	EXPECT_EQ(size,pktsize) ;
+	EXPECT_TRUE(packet == original) ;
+
+	delete copy ;
+}
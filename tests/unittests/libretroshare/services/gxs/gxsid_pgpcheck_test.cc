@@ -0,0 +1,198 @@
+/*
+ * unittests/libretroshare/services/gxs: gxsid_pgpcheck_test.cc
+ *
+ * Checks of the PGP signatures of identities.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare@lunamutt.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <openssl/sha.h>
+
+// from libretroshare
+#include "gxs/rsdataservice.h"
+#include "services/p3idservice.h"
+#include "util/rsdir.h"
+
+// local
+#include "FakePgpAuxUtils.h"
+
+// The signature of the test identities is the issuer id, written in hex. Anything else cannot be parsed.
+
+class PgpCheckAuxUtils: public FakePgpAuxUtils
+{
+public:
+	PgpCheckAuxUtils(const RsPeerId& ownId) : FakePgpAuxUtils(ownId) {}
+
+	virtual bool parseSignature(unsigned char *sign, unsigned int signlen, RsPgpId& issuer) const
+	{
+		if (signlen != RsPgpId::SIZE_IN_BYTES*2)
+			return false;
+
+		issuer = RsPgpId(std::string((char *) sign, signlen));
+		return !issuer.isNull();
+	}
+};
+
+class PgpCheckIdService: public p3IdService
+{
+public:
+	PgpCheckIdService(RsGeneralDataService *gds, PgpAuxUtils *pgpUtils) : p3IdService(gds, NULL, pgpUtils) {}
+
+	using p3IdService::checkId;
+	using p3IdService::getPgpIdList;
+};
+
+static RsGxsIdGroup makeIdGroup(const PGPFingerprintType& fp, const std::string& sign)
+{
+	RsGxsIdGroup grp;
+	grp.mMeta.mGroupId = RsGxsGroupId::random();
+
+	// same hash as the one of p3IdService
+	RsGxsId id(grp.mMeta.mGroupId);
+	unsigned char hash[SHA_DIGEST_LENGTH];
+	SHA_CTX sha_ctx;
+	SHA1_Init(&sha_ctx);
+	SHA1_Update(&sha_ctx, id.toStdString().c_str(), id.toStdString().length());
+	SHA1_Update(&sha_ctx, fp.toByteArray(), fp.SIZE_IN_BYTES);
+	SHA1_Final(hash, &sha_ctx);
+
+	grp.mPgpIdHash = Sha1CheckSum(hash);
+	grp.mPgpIdSign = sign;
+	return grp;
+}
+
+class GxsIdPgpCheckTest: public ::testing::Test
+{
+protected:
+	GxsIdPgpCheckTest() : mDir("./gxsid_pgpcheck_test/") {}
+
+	virtual void SetUp()
+	{
+		RsDirUtil::checkCreateDirectory(mDir);
+
+		mKnownPeer = RsPeerId::random();
+		mUnknownPeer = RsPeerId::random();
+
+		mPgpUtils = new PgpCheckAuxUtils(mKnownPeer);
+		mService = new PgpCheckIdService(new RsDataService(mDir, "gxsid_db", RS_SERVICE_GXS_TYPE_GXSID, NULL, "testpassword"), mPgpUtils);
+		mService->getPgpIdList();
+
+		mKnownId = mPgpUtils->getPGPId(mKnownPeer);
+		mUnknownId = mPgpUtils->getPGPId(mUnknownPeer);
+		mPgpUtils->getKeyFingerprint(mKnownId, mKnownFp);
+		mPgpUtils->getKeyFingerprint(mUnknownId, mUnknownFp);
+	}
+
+	virtual void TearDown()
+	{
+		delete mService;
+		delete mPgpUtils;
+
+		std::set<std::string> filesToKeep;
+		RsDirUtil::cleanupDirectory(mDir, filesToKeep);
+	}
+
+	std::string mDir;
+	RsPeerId mKnownPeer, mUnknownPeer;
+	RsPgpId mKnownId, mUnknownId;
+	PGPFingerprintType mKnownFp, mUnknownFp;
+	PgpCheckAuxUtils *mPgpUtils;
+	PgpCheckIdService *mService;
+};
+
+TEST_F(GxsIdPgpCheckTest, KnownIssuer)
+{
+	RsPgpId pgpId;
+	bool issuer_known = false;
+	bool error = true;
+
+	EXPECT_TRUE(mService->checkId(makeIdGroup(mKnownFp, mKnownId.toStdString()), pgpId, issuer_known, error));
+	EXPECT_EQ(mKnownId, pgpId);
+	EXPECT_TRUE(issuer_known);
+	EXPECT_FALSE(error);
+
+	// Signed by a known key, but not linked to it: no match, and no reason to check again early.
+
+	EXPECT_FALSE(mService->checkId(makeIdGroup(mUnknownFp, mKnownId.toStdString()), pgpId, issuer_known, error));
+	EXPECT_EQ(mKnownId, pgpId);
+	EXPECT_TRUE(issuer_known);
+	EXPECT_FALSE(error);
+}
+
+TEST_F(GxsIdPgpCheckTest, UnknownIssuer)
+{
+	RsGxsIdGroup grp = makeIdGroup(mUnknownFp, mUnknownId.toStdString());
+	RsPgpId pgpId;
+	bool issuer_known = true;
+	bool error = true;
+
+	EXPECT_FALSE(mService->checkId(grp, pgpId, issuer_known, error));
+	EXPECT_EQ(mUnknownId, pgpId);
+	EXPECT_FALSE(issuer_known);
+	EXPECT_FALSE(error);
+
+	// The issuer is saved, so that the id is checked again when its key is received.
+
+	SSGxsIdPgp ssdata;
+	ssdata.lastCheckTs = 1000;
+	ssdata.checkAttempts = 1;
+	ssdata.pgpId = pgpId;
+	ssdata.issuerKeyUnknown = !issuer_known;
+
+	SSGxsIdPgp loaded;
+	EXPECT_TRUE(loaded.load(ssdata.save()));
+	EXPECT_FALSE(loaded.validatedSignature);
+	EXPECT_EQ(1000, loaded.lastCheckTs);
+	EXPECT_EQ(1u, loaded.checkAttempts);
+	EXPECT_EQ(mUnknownId, loaded.pgpId);
+	EXPECT_TRUE(loaded.issuerKeyUnknown);
+
+	// Strings saved before the flag existed still load.
+
+	EXPECT_TRUE(loaded.load("K:0 T:1000 C:1 I:" + mUnknownId.toStdString()));
+	EXPECT_EQ(mUnknownId, loaded.pgpId);
+	EXPECT_FALSE(loaded.issuerKeyUnknown);
+
+	mPgpUtils->addPeerIdToPgpList(mUnknownPeer);
+	mService->getPgpIdList();
+
+	EXPECT_TRUE(mService->checkId(grp, pgpId, issuer_known, error));
+	EXPECT_EQ(mUnknownId, pgpId);
+	EXPECT_TRUE(issuer_known);
+	EXPECT_FALSE(error);
+}
+
+TEST_F(GxsIdPgpCheckTest, UnparsableSignature)
+{
+	RsPgpId pgpId;
+	bool issuer_known = true;
+	bool error = true;
+
+	// All known keys are tried.
+
+	EXPECT_TRUE(mService->checkId(makeIdGroup(mKnownFp, "not a signature"), pgpId, issuer_known, error));
+	EXPECT_EQ(mKnownId, pgpId);
+	EXPECT_FALSE(error);
+
+	EXPECT_FALSE(mService->checkId(makeIdGroup(mUnknownFp, "not a signature"), pgpId, issuer_known, error));
+	EXPECT_TRUE(pgpId.isNull());
+	EXPECT_FALSE(issuer_known);
+	EXPECT_FALSE(error);
+}
@@ -0,0 +1,196 @@
+/*
+ * libretroshare/src/tests/turtle: turtleroutingtable_test.cc
+ *
+ * RetroShare C++ turtle routing table tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include "turtle/turtleroutingtable.h"
+
+static TurtleTunnel makeTunnel(const TurtlePeerId& src,const TurtlePeerId& dst)
+{
+	TurtleTunnel tunnel ;
+
+	tunnel.local_src = src ;
+	tunnel.local_dst = dst ;
+	tunnel.time_stamp = time(NULL) ;
+
+	return tunnel ;
+}
+
+TEST(libretroshare_turtle, TurtleRoutingTable)
+{
+	TurtleRoutingTable table ;
+	TurtlePeerId own_id = TurtlePeerId::random() ;
+	TurtlePeerId friend1 = TurtlePeerId::random() ;
+	TurtlePeerId friend2 = TurtlePeerId::random() ;
+	TurtleFileHash hash = TurtleFileHash::random() ;
+	RsTurtleClientService *service = reinterpret_cast<RsTurtleClientService*>(0x1234) ;
+
+	TurtleTunnel tunnel ;
+	TurtleTunnelId tid ;
+
+	// transiting tunnel
+
+	EXPECT_TRUE(table.addTunnel(0x11223344,makeTunnel(friend1,friend2))) ;
+	EXPECT_FALSE(table.addTunnel(0x11223344,makeTunnel(friend2,friend1))) ;
+
+	ASSERT_TRUE(table.getTunnel(0x11223344,tunnel)) ;
+	EXPECT_EQ(friend1,tunnel.local_src) ;
+	EXPECT_EQ(friend2,tunnel.local_dst) ;
+	EXPECT_TRUE(tunnel.vpid.isNull()) ;
+	EXPECT_TRUE(tunnel.service == NULL) ;
+
+	// a transiting tunnel has no virtual peer
+
+	EXPECT_FALSE(table.getTunnel(TurtleRoutingTable::virtualPeerId(0x11223344),tid,tunnel)) ;
+	EXPECT_FALSE(table.getTunnel(TurtlePeerId(),tid,tunnel)) ;
+
+	// end-point tunnel
+
+	TurtleVirtualPeerId vpid ;
+
+	EXPECT_FALSE(table.setTunnelEndPoint(0x55667788,hash,service,vpid)) ;
+	EXPECT_TRUE(table.addTunnel(0x55667788,makeTunnel(friend1,own_id))) ;
+	EXPECT_TRUE(table.setTunnelEndPoint(0x55667788,hash,service,vpid)) ;
+
+	EXPECT_EQ(TurtleRoutingTable::virtualPeerId(0x55667788),vpid) ;
+	EXPECT_EQ(0x55667788u,TurtleRoutingTable::tunnelId(vpid)) ;
+
+	ASSERT_TRUE(table.getTunnel(vpid,tid,tunnel)) ;
+	EXPECT_EQ(0x55667788u,tid) ;
+	EXPECT_EQ(hash,tunnel.hash) ;
+	EXPECT_EQ(vpid,tunnel.vpid) ;
+	EXPECT_TRUE(tunnel.service == service) ;
+
+	// data path
+
+	EXPECT_FALSE(table.useTunnel(0x99999999,100,true,tunnel)) ;
+
+	ASSERT_TRUE(table.useTunnel(0x11223344,100,true,tunnel)) ;
+	ASSERT_TRUE(table.useTunnel(vpid,50,false,tid,tunnel)) ;
+	EXPECT_EQ(0x55667788u,tid) ;
+
+	TurtleTrafficStatisticsInfoOp traffic ;
+	traffic.unknown_updn_Bps = 100 ;
+	table.recordTraffic(0x11223344,traffic) ;
+	traffic.reset() ;
+	traffic.data_up_Bps = 50 ;
+	table.recordTraffic(0x55667788,traffic) ;
+
+	TurtleTrafficStatisticsInfoOp info ;
+	table.collectTrafficStatistics(info) ;
+	EXPECT_EQ(100.0f,info.unknown_updn_Bps) ;
+	EXPECT_EQ(50.0f,info.data_up_Bps) ;
+
+	info.reset() ;
+	table.collectTrafficStatistics(info) ;
+	EXPECT_EQ(0.0f,info.unknown_updn_Bps) ;
+
+	table.estimateTunnelSpeeds(1.0f) ;
+
+	std::map<TurtleTunnelId,TurtleTunnel> tunnels ;
+	table.getTunnels(tunnels) ;
+	ASSERT_EQ(2u,tunnels.size()) ;
+	EXPECT_EQ(25.0f,tunnels[0x11223344].speed_Bps) ;
+	EXPECT_EQ(0u,tunnels[0x11223344].transfered_bytes) ;
+	EXPECT_EQ(12.5f,tunnels[0x55667788].speed_Bps) ;
+
+	// removal
+
+	ASSERT_TRUE(table.removeTunnel(0x55667788,tunnel)) ;
+	EXPECT_EQ(vpid,tunnel.vpid) ;
+	EXPECT_FALSE(table.removeTunnel(0x55667788,tunnel)) ;
+	EXPECT_FALSE(table.getTunnel(vpid,tid,tunnel)) ;
+	EXPECT_FALSE(table.useTunnel(vpid,50,false,tid,tunnel)) ;
+}
+
+// Items are routed while tunnels are added and removed by another thread.
+
+class TurtleRoutingTableDataThread: public RsSingleJobThread
+{
+	public:
+		TurtleRoutingTableDataThread(TurtleRoutingTable& table,uint32_t nb_tunnels) : mTable(table),mNbTunnels(nb_tunnels),mRoutedItems(0) {}
+
+		virtual void run()
+		{
+			TurtleTunnel tunnel ;
+
+			for(uint32_t n=0;n<200;++n)
+				for(uint32_t i=0;i<mNbTunnels;++i)
+					if(mTable.useTunnel(i,10,true,tunnel))
+						++mRoutedItems ;
+		}
+
+		TurtleRoutingTable& mTable ;
+		uint32_t mNbTunnels ;
+		uint32_t mRoutedItems ;
+};
+
+TEST(libretroshare_turtle, TurtleRoutingTableConcurrentAccess)
+{
+	static const uint32_t NB_TUNNELS = 1000 ;
+
+	TurtleRoutingTable table ;
+	TurtlePeerId friend1 = TurtlePeerId::random() ;
+	TurtlePeerId friend2 = TurtlePeerId::random() ;
+
+	for(uint32_t i=0;i<NB_TUNNELS;i+=2)
+		table.addTunnel(i,makeTunnel(friend1,friend2)) ;
+
+	TurtleRoutingTableDataThread thread1(table,NB_TUNNELS) ;
+	TurtleRoutingTableDataThread thread2(table,NB_TUNNELS) ;
+
+	thread1.start("turtle test 1") ;
+	thread2.start("turtle test 2") ;
+
+	// odd tunnels are opened and closed while items are routed
+
+	TurtleTunnel tunnel ;
+
+	for(uint32_t n=0;n<20;++n)
+		for(uint32_t i=1;i<NB_TUNNELS;i+=2)
+			if(n%2 == 0)
+				table.addTunnel(i,makeTunnel(friend2,friend1)) ;
+			else
+				table.removeTunnel(i,tunnel) ;
+
+	while(thread1.isRunning() || thread2.isRunning())
+		usleep(10*1000) ;
+
+	EXPECT_LE(200*NB_TUNNELS/2,thread1.mRoutedItems) ;
+	EXPECT_LE(200*NB_TUNNELS/2,thread2.mRoutedItems) ;
+
+	// all items were counted in the even tunnels
+
+	std::map<TurtleTunnelId,TurtleTunnel> tunnels ;
+	table.getTunnels(tunnels) ;
+
+	EXPECT_EQ(NB_TUNNELS/2,tunnels.size()) ;
+
+	for(std::map<TurtleTunnelId,TurtleTunnel>::const_iterator it(tunnels.begin());it!=tunnels.end();++it)
+	{
+		EXPECT_EQ(0u,it->first%2) ;
+		EXPECT_EQ(2*200*10u,it->second.transfered_bytes) ;
+	}
+}
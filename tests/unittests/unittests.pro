@@ -274,7 +274,8 @@ SOURCES +=  unittests.cc \
 
 ################################## Crypto ##################################
 
-SOURCES += libretroshare/crypto/chacha20_test.cc
+SOURCES += libretroshare/crypto/chacha20_test.cc \
+	libretroshare/crypto/gxstunneldhpool_test.cc
 
 ################################ Serialiser ################################
 HEADERS +=  libretroshare/serialiser/support.h \
@@ -286,6 +287,7 @@ SOURCES +=  libretroshare/serialiser/rsturtleitem_test.cc \
 		libretroshare/serialiser/rsmsgitem_test.cc \
 		libretroshare/serialiser/rsstatusitem_test.cc \
 		libretroshare/serialiser/rsnxsitems_test.cc \
+		libretroshare/serialiser/rsserializer_test.cc \
 		libretroshare/serialiser/rsgxsiditem_test.cc \
 #		libretroshare/serialiser/rsphotoitem_test.cc \
 		libretroshare/serialiser/tlvbase_test2.cc \
@@ -326,7 +328,8 @@ SOURCES +=  libretroshare/gxs/nxs_test/nxsdummyservices.cc \
 	libretroshare/gxs/nxs_test/rsgxsnetservice_test.cc \
 	libretroshare/gxs/nxs_test/nxsmsgsync_test.cc \
 	libretroshare/gxs/nxs_test/nxsgrpsync_test.cc \ 
-	libretroshare/gxs/nxs_test/nxsgrpsyncdelayed.cc
+	libretroshare/gxs/nxs_test/nxsgrpsyncdelayed.cc \
+	libretroshare/gxs/nxs_test/rsgxsmsgidfilter_test.cc
 	
 HEADERS += libretroshare/gxs/gen_exchange/genexchangetester.h \
 	libretroshare/gxs/gen_exchange/gxspublishmsgtest.h \
@@ -352,7 +355,10 @@ SOURCES += libretroshare/gxs/security/gxssecurity_test.cc
 HEADERS += libretroshare/gxs/data_service/rsdataservice_test.h \
 
 SOURCES += libretroshare/gxs/data_service/rsdataservice_test.cc \
+	libretroshare/gxs/data_service/retrodb_test.cc \
+	libretroshare/gxs/data_service/rsdataservice_profile_test.cc \
 	libretroshare/gxs/data_service/rsgxsdata_test.cc \
+	libretroshare/gxs/data_service/rsgxsdataaccess_test.cc \
 
 
 ################################ dbase #####################################
@@ -365,6 +371,33 @@ SOURCES += libretroshare/gxs/data_service/rsdataservice_test.cc \
 #	libretroshare/dbase/ficachetest.cc \
 #	libretroshare/dbase/fimontest.cc \
 
+############################ file_sharing ##################################
+
+SOURCES += libretroshare/file_sharing/dir_hierarchy_test.cc \
+	libretroshare/file_sharing/file_hash_test.cc \
+	libretroshare/file_sharing/directory_watcher_test.cc \
+	libretroshare/file_sharing/hash_table_test.cc \
+	libretroshare/file_sharing/dir_storage_test.cc
+
+################################## ft ######################################
+
+SOURCES += libretroshare/ft/ftchunkcache_test.cc \
+	libretroshare/ft/ftfilecreator_test.cc \
+	libretroshare/ft/ftchunkmap_test.cc \
+	libretroshare/ft/fttransfermodule_test.cc
+
+################################## pqi #####################################
+
+SOURCES += libretroshare/pqi/pqistreamer_test.cc
+
+################################# turtle ####################################
+
+SOURCES += libretroshare/turtle/turtleroutingtable_test.cc
+
+############################### gxstunnel ##################################
+
+SOURCES += libretroshare/gxstunnel/gxstunnelwindow_test.cc
+
 
 ############################### services ###################################
 
@@ -390,6 +423,7 @@ SOURCES += libretroshare/services/gxs/rsgxstestitems.cc \
 	libretroshare/services/gxs/nxsbasic_test.cc \
 	libretroshare/services/gxs/nxspair_tests.cc \
 	libretroshare/services/gxs/gxscircle_tests.cc \
+	libretroshare/services/gxs/gxsid_pgpcheck_test.cc \
 
 #	libretroshare/services/gxs/gxscircle_mintest.cc \
 